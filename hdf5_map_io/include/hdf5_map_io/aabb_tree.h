@@ -0,0 +1,216 @@
+#ifndef HDF5_MAP_IO__AABB_TREE_H_
+#define HDF5_MAP_IO__AABB_TREE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace hdf5_map_io
+{
+
+/**
+ * @brief Result of a ray cast against an AABBTree.
+ */
+struct RayHit
+{
+    /// Index of the hit face
+    uint32_t face;
+    /// Ray parameter of the hit, i.e. the hit point is origin + distance * direction
+    float distance;
+    /// Barycentric coordinates of the hit point with respect to the second and the third vertex of the face
+    float u;
+    float v;
+};
+
+/**
+ * @brief Result of a closest point query against an AABBTree.
+ */
+struct PointHit
+{
+    /// Index of the closest face
+    uint32_t face;
+    /// Distance of the query point to the closest point
+    float distance;
+    /// Barycentric coordinates of the closest point with respect to the second and the third vertex of the face
+    float u;
+    float v;
+    /// The closest point on the face
+    float point[3];
+};
+
+/**
+ * @brief Bounding volume hierarchy of axis aligned boxes over the faces of a triangle mesh.
+ *
+ * The tree holds its own copy of the vertices and face indices in the flat layout used by the map format,
+ * i.e. three floats per vertex and three vertex indices per face. It is built once by recursively splitting
+ * the faces at the median of their centroids along the longest axis. Large subtrees are built in parallel
+ * if OpenMP is available. All queries are const and may be run concurrently.
+ */
+class AABBTree
+{
+public:
+    /**
+     * @brief Builds the tree over the given mesh.
+     *
+     * @param vertices Vertex positions, three floats per vertex
+     * @param faceIds Vertex indices, three per face
+     * @param maxLeafSize Maximum number of faces in a leaf
+     */
+    AABBTree(const std::vector<float>& vertices, const std::vector<uint32_t>& faceIds, size_t maxLeafSize = 4);
+
+    /**
+     * @brief Builds the tree over the given mesh.
+     *
+     * @param vertices Vertex positions, three floats per vertex
+     * @param numVertices Number of vertices
+     * @param faceIds Vertex indices, three per face
+     * @param numFaces Number of faces
+     * @param maxLeafSize Maximum number of faces in a leaf
+     */
+    AABBTree(
+        const float* vertices,
+        size_t numVertices,
+        const uint32_t* faceIds,
+        size_t numFaces,
+        size_t maxLeafSize = 4
+    );
+
+    /**
+     * @brief Finds the closest intersection of a ray with the mesh. Faces are hit from both sides.
+     *
+     * @param origin Origin of the ray
+     * @param direction Direction of the ray, does not need to be normalized
+     * @param hit The closest hit, only valid if true is returned
+     * @param maxDistance Hits farther away than this ray parameter are ignored
+     * @return true if the ray hits the mesh
+     */
+    bool intersectRay(
+        const float origin[3],
+        const float direction[3],
+        RayHit& hit,
+        float maxDistance = std::numeric_limits<float>::infinity()
+    ) const;
+
+    /**
+     * @brief Finds the point on the mesh closest to the given point.
+     *
+     * @param point The query point
+     * @param hit The closest point, only valid if true is returned
+     * @param maxDistance Points farther away than this are ignored
+     * @return true if a point within maxDistance was found
+     */
+    bool closestPoint(
+        const float point[3],
+        PointHit& hit,
+        float maxDistance = std::numeric_limits<float>::infinity()
+    ) const;
+
+    /**
+     * @brief Collects the faces whose bounding box overlaps the given axis aligned box.
+     *
+     * @param min Lower corner of the box
+     * @param max Upper corner of the box
+     * @param faces The overlapping faces in ascending order, appended to the vector
+     */
+    void facesInBox(const float min[3], const float max[3], std::vector<uint32_t>& faces) const;
+
+    /**
+     * @brief Collects the faces with at least one point within the given distance of a center point.
+     *
+     * @param center Center of the sphere
+     * @param radius Radius of the sphere
+     * @param faces The faces within the sphere in ascending order, appended to the vector
+     */
+    void facesInSphere(const float center[3], float radius, std::vector<uint32_t>& faces) const;
+
+    /**
+     * @brief Returns the positions of the three vertices of a face.
+     */
+    void getFaceVertices(uint32_t face, float a[3], float b[3], float c[3]) const;
+
+    /**
+     * @brief Returns the number of faces in the tree.
+     */
+    size_t numFaces() const
+    {
+        return m_faceIds.size() / 3;
+    }
+
+    /**
+     * @brief Returns the number of vertices in the tree.
+     */
+    size_t numVertices() const
+    {
+        return m_vertices.size() / 3;
+    }
+
+    /**
+     * @brief Returns the vertices, three floats per vertex.
+     */
+    const std::vector<float>& getVertices() const
+    {
+        return m_vertices;
+    }
+
+    /**
+     * @brief Returns the vertex indices, three per face.
+     */
+    const std::vector<uint32_t>& getFaceIds() const
+    {
+        return m_faceIds;
+    }
+
+private:
+    /**
+     * A node is a leaf if count is not zero, its faces are m_faceOrder[offset, offset + count). Otherwise it is an
+     * inner node whose children are stored at m_nodes[offset] and m_nodes[offset + 1].
+     */
+    struct Node
+    {
+        float min[3];
+        float max[3];
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    void build(size_t maxLeafSize);
+
+    void buildNode(
+        uint32_t nodeIndex,
+        uint32_t begin,
+        uint32_t end,
+        size_t maxLeafSize,
+        const std::vector<float>& centroids,
+        std::atomic<uint32_t>& nextNode
+    );
+
+    bool intersectFace(
+        uint32_t face,
+        const float origin[3],
+        const float direction[3],
+        float maxDistance,
+        RayHit& hit
+    ) const;
+
+    static float boxDistanceSquared(const Node& node, const float point[3]);
+
+    static bool intersectBox(
+        const Node& node,
+        const float origin[3],
+        const float invDirection[3],
+        float maxDistance,
+        float& entryDistance
+    );
+
+    std::vector<float> m_vertices;
+    std::vector<uint32_t> m_faceIds;
+    /// Face indices sorted such that the faces of each leaf are consecutive
+    std::vector<uint32_t> m_faceOrder;
+    std::vector<Node> m_nodes;
+};
+
+} // namespace hdf5_map_io
+
+#endif // HDF5_MAP_IO__AABB_TREE_H_
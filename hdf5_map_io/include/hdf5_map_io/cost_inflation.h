@@ -0,0 +1,131 @@
+#ifndef HDF5_MAP_IO__COST_INFLATION_H_
+#define HDF5_MAP_IO__COST_INFLATION_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "hdf5_map_io/mesh_adjacency.h"
+
+namespace hdf5_map_io
+{
+
+/**
+ * @brief Options of CostInflation, analogous to the inflation of 2D costmaps.
+ */
+struct InflationOptions
+{
+    /// Vertices with at least this cost are lethal, the costs around them are inflated
+    float lethalCost = 1.0f;
+    /// Vertices up to this distance from a lethal vertex get the lethal cost, e.g. the inscribed radius of the robot
+    float inscribedRadius = 0.25f;
+    /// Vertices up to this distance from a lethal vertex get an inflated cost, which decays beyond the inscribed radius
+    float inflationRadius = 0.5f;
+    /// Exponential decay of the inflated cost per unit of distance beyond the inscribed radius
+    float costScalingFactor = 10.0f;
+};
+
+/**
+ * @brief Inflates a vertex cost layer by the geodesic distance of each vertex to the nearest lethal vertex.
+ *
+ * The distances are computed by a multi source Dijkstra over the edges of the mesh, bounded by the inflation radius.
+ * Each thread runs it from a region of lethal vertices with a bucket queue, i.e. Dial's algorithm, and lowers the
+ * shared distances atomically, so the regions meet without locks. As the distances follow the edges, they are
+ * slightly longer than the true geodesic distances on coarse meshes.
+ *
+ * The inflated cost of a vertex is the larger one of its own cost and lethalCost * exp(-costScalingFactor *
+ * (distance - inscribedRadius)), the lethal cost within the inscribed radius and zero beyond the inflation radius.
+ *
+ * After the costs of a few vertices changed, update() only recomputes the distances in their surroundings.
+ */
+class CostInflation
+{
+public:
+    /**
+     * @brief Creates the inflation of a mesh. The vertices and the adjacency are not copied, they have to exist as
+     * long as the inflation.
+     *
+     * @param vertices Vertex positions, three floats per vertex
+     * @param vertexAdjacency Neighbors of each vertex, see buildVertexAdjacency
+     * @param options The inflation options
+     */
+    CostInflation(const float* vertices, AdjacencyView vertexAdjacency, const InflationOptions& options);
+
+    /**
+     * @brief Inflates the given costs from scratch
+     *
+     * @param costs One cost per vertex
+     */
+    void inflate(const std::vector<float>& costs);
+
+    /**
+     * @brief Changes the costs of some vertices and updates the inflation around them
+     *
+     * @param vertexIds The changed vertices
+     * @param costs The new cost of each changed vertex, costs[i] belongs to vertexIds[i]. A vertex given more than
+     * once gets its last cost.
+     * @return The vertices whose inflated cost changed, in ascending order
+     */
+    std::vector<uint32_t> update(const std::vector<uint32_t>& vertexIds, const std::vector<float>& costs);
+
+    /**
+     * @brief Returns the costs which are inflated, one per vertex
+     */
+    const std::vector<float>& getCosts() const
+    {
+        return m_costs;
+    }
+
+    /**
+     * @brief Returns the inflated costs, one per vertex
+     */
+    const std::vector<float>& getInflatedCosts() const
+    {
+        return m_inflatedCosts;
+    }
+
+    /**
+     * @brief Returns the distance of a vertex to the nearest lethal vertex, infinity beyond the inflation radius
+     */
+    float getDistance(size_t vertex) const
+    {
+        return m_distances[vertex].load(std::memory_order_relaxed);
+    }
+
+private:
+    bool isLethal(float cost) const
+    {
+        return cost >= m_options.lethalCost;
+    }
+
+    float inflatedCost(float cost, float distance) const;
+
+    float edgeLength(uint32_t a, uint32_t b) const;
+
+    /**
+     * Lowers the distances of the neighborhood of the seeds, whose distances are set already. The seeds are split
+     * into regions, which are processed in parallel. The vertices whose distance was lowered are appended to lowered,
+     * if given.
+     */
+    void propagate(const std::vector<uint32_t>& seeds, std::vector<uint32_t>* lowered);
+
+    /**
+     * Returns the vertices within the inflation radius of the sources, the sources included.
+     */
+    std::vector<uint32_t> collectNeighborhood(const std::vector<uint32_t>& sources);
+
+    const float* m_vertices;
+    AdjacencyView m_adjacency;
+    InflationOptions m_options;
+
+    std::vector<float> m_costs;
+    std::vector<float> m_inflatedCosts;
+    std::vector<std::atomic<float>> m_distances;
+    /// Distances of collectNeighborhood, infinity outside of a call
+    std::vector<float> m_scratch;
+};
+
+} // namespace hdf5_map_io
+
+#endif // HDF5_MAP_IO__COST_INFLATION_H_
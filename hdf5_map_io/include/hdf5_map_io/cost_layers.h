@@ -0,0 +1,91 @@
+#ifndef HDF5_MAP_IO__COST_LAYERS_H_
+#define HDF5_MAP_IO__COST_LAYERS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hdf5_map_io
+{
+
+class HDF5MapIO;
+
+/**
+ * @brief Options of computeGeometricCostLayers.
+ *
+ * The neighborhood of a vertex is a vertical cylinder around it, i.e. all vertices within the radius in the xy plane
+ * and the height range above or below it. The height range keeps steps higher than the radius visible, but separates
+ * the levels of multi story maps, e.g. a bridge and the ground below it.
+ */
+struct CostLayerOptions
+{
+    /// Radius of the neighborhood in the xy plane
+    float radius = 0.3f;
+    /// Largest height difference of a vertex of the neighborhood to the vertex
+    float heightRange = 1.0f;
+};
+
+/**
+ * @brief The geometric cost layers of a mesh, one value per vertex each.
+ */
+struct GeometricCostLayers
+{
+    /// Mean angle in radians between the normal of the vertex and the normals of its neighborhood
+    std::vector<float> roughness;
+    /// Difference between the highest and the lowest vertex of the neighborhood
+    std::vector<float> heightDifference;
+    /// Angle in radians between the normal of the vertex and the z axis
+    std::vector<float> slope;
+    /// Largest distance of a vertex of the neighborhood to the tangent plane of the vertex
+    std::vector<float> stepHeight;
+};
+
+/**
+ * @brief Computes area weighted vertex normals of a mesh. Vertices without faces get the z axis as normal.
+ *
+ * @param vertices Vertex positions, three floats per vertex
+ * @param numVertices Number of vertices
+ * @param faceIds Vertex indices, three per face
+ * @param numFaces Number of faces
+ * @return Normals, three floats per vertex
+ */
+std::vector<float> computeVertexNormals(
+    const float* vertices,
+    size_t numVertices,
+    const uint32_t* faceIds,
+    size_t numFaces
+);
+
+/**
+ * @brief Computes the geometric cost layers of a mesh.
+ *
+ * The neighborhood of each vertex, see CostLayerOptions, includes the vertex itself. It is found with a grid of cells
+ * as large as the cylinder, whose cells are sorted along the z axis within each column, so a query only searches a
+ * range of cells in each of nine columns. All layers are computed in one pass over the vertices, which
+ * runs in parallel if OpenMP is available.
+ *
+ * @param vertices Vertex positions, three floats per vertex
+ * @param normals Vertex normals, three floats per vertex
+ * @param numVertices Number of vertices
+ * @param options The neighborhood of each vertex
+ * @return The cost layers
+ */
+GeometricCostLayers computeGeometricCostLayers(
+    const float* vertices,
+    const float* normals,
+    size_t numVertices,
+    const CostLayerOptions& options = CostLayerOptions()
+);
+
+/**
+ * @brief Computes the geometric cost layers of the map and writes them as the cost layers roughness, height_diff,
+ * slope and step_height. The normals of the map are used if it has some, otherwise they are computed.
+ *
+ * @param map The map
+ * @param options The neighborhood of each vertex
+ */
+void writeGeometricCostLayers(HDF5MapIO& map, const CostLayerOptions& options = CostLayerOptions());
+
+} // namespace hdf5_map_io
+
+#endif // HDF5_MAP_IO__COST_LAYERS_H_
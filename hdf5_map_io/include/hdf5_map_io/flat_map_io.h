@@ -0,0 +1,155 @@
+#ifndef HDF5_MAP_IO__FLAT_MAP_IO_H_
+#define HDF5_MAP_IO__FLAT_MAP_IO_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "hdf5_map_io/map_span.h"
+
+namespace hdf5_map_io
+{
+
+class HDF5MapIO;
+
+/**
+ * @brief Entry of the table of contents of a flat map file, describing one section.
+ */
+struct FlatMapSection
+{
+    /// Name of the section, e.g. vertices, costs/roughness or labels/tree/1
+    char name[64];
+    /// Value type, see FlatMapIO::ValueType
+    uint32_t type;
+    /// Number of values per row, e.g. three per vertex
+    uint32_t width;
+    /// Byte offset of the values from the start of the file
+    uint64_t offset;
+    /// Number of values
+    uint64_t size;
+};
+
+/**
+ * This class reads the flat map format, an alternative container for the geometry, normals, colors, cost layers and
+ * labels of a map. The file starts with a small header followed by a table of contents and the sections, each
+ * aligned to 64 bytes and holding the values in the layout of the HDF5 map, i.e. three floats per vertex and three
+ * vertex indices per face.
+ *
+ * The file is memory mapped on construction and only the table of contents is read, so opening a map does not
+ * depend on its size. The accessors return spans pointing into the mapping without copying. The operating system
+ * loads the pages on first access and shares them between all processes mapping the same file.
+ *
+ * Flat maps are written by writeFlatMap and converted back by writeHDF5Map. They are read only, the HDF5 map stays
+ * the format for editing. The map server of mesh_msgs_hdf5 does not read flat maps yet, as it also writes labels,
+ * cost updates and levels of detail into its map.
+ */
+class FlatMapIO
+{
+public:
+    /**
+     * @brief Value types of the sections
+     */
+    enum ValueType : uint32_t
+    {
+        Float32 = 0,
+        UInt32 = 1,
+        UInt8 = 2
+    };
+
+    /**
+     * @brief Memory maps the flat map file.
+     */
+    FlatMapIO(std::string filename);
+
+    /**
+     * @brief Unmaps the file. All spans returned before are invalid afterwards.
+     */
+    ~FlatMapIO();
+
+    FlatMapIO(const FlatMapIO&) = delete;
+    FlatMapIO& operator=(const FlatMapIO&) = delete;
+
+    /**
+     * @brief Returns the number of vertices
+     */
+    size_t getNumVertices() const;
+
+    /**
+     * @brief Returns the number of faces
+     */
+    size_t getNumFaces() const;
+
+    /**
+     * @brief Returns vertices span
+     */
+    MapSpan<float> getVertices() const;
+
+    /**
+     * @brief Returns face ids span
+     */
+    MapSpan<uint32_t> getFaceIds() const;
+
+    /**
+     * @brief Returns vertex normals span
+     */
+    MapSpan<float> getVertexNormals() const;
+
+    /**
+     * @brief Returns vertex colors span
+     */
+    MapSpan<uint8_t> getVertexColors() const;
+
+    /**
+     * @brief Returns one costlayer as float span.
+     */
+    MapSpan<float> getVertexCosts(std::string costlayer) const;
+
+    /**
+     * @brief returns the names of all available costlayers
+     */
+    std::vector<std::string> getCostLayers() const;
+
+    /**
+     * @brief Returns all available label groups
+     */
+    std::vector<std::string> getLabelGroups() const;
+
+    /**
+     * @brief  Returns all labels inside the given group
+     */
+    std::vector<std::string> getAllLabelsOfGroup(std::string groupName) const;
+
+    /**
+     * @brief Returns face ids for the given label inside the group.
+     */
+    MapSpan<uint32_t> getFaceIdsOfLabel(std::string groupName, std::string labelName) const;
+
+private:
+    template <typename T>
+    MapSpan<T> getSection(const std::string& name, ValueType type) const;
+
+    std::vector<std::string> listSections(const std::string& prefix) const;
+
+    // the mapped file
+    const uint8_t* m_data;
+    size_t m_size;
+
+    // table of contents by section name
+    std::unordered_map<std::string, FlatMapSection> m_sections;
+};
+
+/**
+ * @brief Writes the geometry, normals, colors, cost layers and labels of the HDF5 map into a flat map file.
+ */
+void writeFlatMap(HDF5MapIO& map, std::string filename);
+
+/**
+ * @brief Writes the content of a flat map into a new HDF5 map file.
+ */
+void writeHDF5Map(const FlatMapIO& map, std::string filename);
+
+} // namespace hdf5_map_io
+
+#endif // HDF5_MAP_IO__FLAT_MAP_IO_H_
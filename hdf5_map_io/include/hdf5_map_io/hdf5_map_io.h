@@ -9,6 +9,8 @@
 #include <H5Tpublic.h>
 #include <highfive/H5File.hpp>
 
+#include "hdf5_map_io/mesh_adjacency.h"
+
 namespace hf = HighFive;
 
 namespace hdf5_map_io
@@ -47,6 +49,31 @@ struct MapMaterial {
     uint8_t b;
 };
 
+/**
+ * Helper struct describing a level of detail stored in the map.
+ */
+struct MapLodLevel {
+    uint32_t level;
+    uint32_t numFaces;
+    uint32_t meshFaces;
+    float error;
+};
+
+/**
+ * Helper struct for a patch of geometry appended to the map, e.g. a new scan of an online mapper.
+ *
+ * The face ids index the vertices of the whole map, the first vertex of the patch has the index getNumVertices().
+ * Thus faces can connect the patch to the existing mesh. Normals and colors have three values per vertex, the costs
+ * one value per vertex and layer.
+ */
+struct MapPatch {
+    std::vector<float> vertices;
+    std::vector<uint32_t> faceIds;
+    std::vector<float> normals;
+    std::vector<uint8_t> colors;
+    std::unordered_map<std::string, std::vector<float>> costs;
+};
+
 /**
  * This class if responsible for the map format. It tries to abstract most if not all calls to the
  * underlying HDF5 API and the HighFive wrapper. Furthermore it ensures the defined map format is always
@@ -55,22 +82,46 @@ struct MapMaterial {
  * NOTE: the map file is held open for the whole live time of this object. Thus it is possible that some data is
  * only written to disc if the destructor is called or the program has ended. Also make sure the map file is not opened
  * in any other way. (i.e. with the HDF5 Viewer). This will always lead to errors trying to access the file.
+ *
+ * The only exception is the single writer / multiple reader (SWMR) mode of HDF5: one process opens the map with
+ * SwmrWrite and any number of processes open it with SwmrRead at the same time. The writer makes its changes visible
+ * by calling flush(), the readers refresh each dataset before reading it and always see a consistent state.
+ * SWMR requires the file format of HDF5 1.10, so the map has to be created with SwmrWrite. HDF5 does not allow the
+ * writer to add or remove data sets, groups or attributes once readers may attach. Thus the writer first creates all
+ * cost layers, labels and other channels it is going to write and then calls startSwmrWrite(). Afterwards existing
+ * data sets are only written in place or, like the geometry and the cost layers, extended by appendPatch().
  */
 class HDF5MapIO
 {
 public:
     /**
-     * @brief Opens a map file for reading and writing.
+     * @brief The ways to open a map file.
      */
-    HDF5MapIO(std::string filename);
+    enum AccessMode
+    {
+        /// Exclusive access for reading and writing
+        ReadWrite,
+        /// Writing while SwmrRead readers access the file
+        SwmrWrite,
+        /// Reading while a SwmrWrite writer accesses the file
+        SwmrRead
+    };
 
     /**
-     * @brief Creates a map file (or truncates if the file already exists).
+     * @brief Opens a map file for reading and writing, or in one of the SWMR modes. With SwmrWrite readers can attach
+     * after startSwmrWrite() has been called.
+     */
+    HDF5MapIO(std::string filename, AccessMode mode = ReadWrite);
+
+    /**
+     * @brief Creates a map file (or truncates if the file already exists). With SwmrWrite the file is created in the
+     * HDF5 1.10 format and readers can attach after startSwmrWrite() has been called.
      */
     HDF5MapIO(
         std::string filename,
         const std::vector<float>& vertices,
-        const std::vector<uint32_t>& face_ids
+        const std::vector<uint32_t>& face_ids,
+        AccessMode mode = ReadWrite
     );
 
     /**
@@ -88,6 +139,16 @@ public:
      */
     std::vector<uint32_t> getFaceIds();
 
+    /**
+     * @brief Returns the number of vertices without reading them
+     */
+    size_t getNumVertices();
+
+    /**
+     * @brief Returns the number of faces without reading them
+     */
+    size_t getNumFaces();
+
     /**
      * @brief Returns vertex normals vector
      */
@@ -98,6 +159,18 @@ public:
      */
     std::vector<uint8_t> getVertexColors();
 
+    /**
+     * @brief Returns the normals of the given vertices, three values per vertex. Only the chunks holding them are
+     * read, so a small region of a large map is cheap. Empty if the map has no normals.
+     */
+    std::vector<float> getVertexNormals(const std::vector<uint32_t>& vertexIds);
+
+    /**
+     * @brief Returns the colors of the given vertices, three values per vertex, reading only the chunks holding them.
+     * Empty if the map has no colors.
+     */
+    std::vector<uint8_t> getVertexColors(const std::vector<uint32_t>& vertexIds);
+
     /**
      * @brief Returns textures vector
      */
@@ -155,11 +228,37 @@ public:
      */
     std::vector<float> getVertexCosts(std::string costlayer);
 
+    /**
+     * @brief Returns the costs of the given vertices, reading only the chunks holding them. Empty if the layer does
+     * not exist.
+     */
+    std::vector<float> getVertexCosts(std::string costlayer, const std::vector<uint32_t>& vertexIds);
+
     /**
      * @brief returns the names of all available costlayers
      */
     std::vector<std::string> getCostLayers();
 
+    /**
+     * @brief Returns all stored levels of detail, ordered from fine to coarse
+     */
+    std::vector<MapLodLevel> getLodLevels();
+
+    /**
+     * @brief Returns the face ids of the given level of detail. They index the vertices of the full mesh.
+     */
+    std::vector<uint32_t> getLodFaceIds(uint32_t level);
+
+    /**
+     * @brief Returns the stored vertex adjacency. It is empty if none is stored or the mesh has changed since.
+     */
+    MeshAdjacency getVertexAdjacency();
+
+    /**
+     * @brief Returns the stored face adjacency. It is empty if none is stored or the mesh has changed since.
+     */
+    MeshAdjacency getFaceAdjacency();
+
     /**
      * @brief Returns the image in the group, if it exists. If not an empty struct is returned
      */
@@ -218,6 +317,75 @@ public:
      */
     void addHeightDifference(std::vector<float>& diff);
 
+    /**
+     * @brief Adds the costlayer with the given name to the attributes group.
+     */
+    void addVertexCosts(std::string costlayer, std::vector<float>& costs);
+
+    /**
+     * @brief Returns whether costs can be written to the costlayer, i.e. it is not one of the geometry or attribute
+     * channels of the map and it either does not exist yet or is a one dimensional data set of floats.
+     */
+    bool canWriteVertexCosts(const std::string& costlayer);
+
+    /**
+     * @brief Creates the costlayer or overwrites all of its values. A layer of the same size is written in place,
+     * otherwise it is replaced, which is not possible after startSwmrWrite().
+     */
+    void writeVertexCosts(std::string costlayer, const std::vector<float>& costs);
+
+    /**
+     * @brief Overwrites the costs of the vertices firstVertex to firstVertex + costs.size() - 1 in place, the rest
+     * of the layer is not touched.
+     */
+    void updateVertexCosts(std::string costlayer, size_t firstVertex, const std::vector<float>& costs);
+
+    /**
+     * @brief Overwrites the costs of the given vertices in place, costs[i] is the new cost of vertexIds[i]. Runs of
+     * neighboring vertex ids are written together, so local changes are cheap even for large layers.
+     */
+    void updateVertexCosts(
+        std::string costlayer,
+        const std::vector<uint32_t>& vertexIds,
+        const std::vector<float>& costs
+    );
+
+    /**
+     * @brief Appends the patch to the map, only the new data is written. All per vertex channels of the map, i.e.
+     * normals, colors and cost layers, have to be given for the new vertices, so they keep matching the vertices.
+     * Channels which do not exist yet can only be added to an empty map. Maps with texture coordinates or materials
+     * can not be extended, as a patch has neither.
+     *
+     * The geometry and channels are stored in chunked data sets which can grow. Data sets of maps written by other
+     * tools are converted once, which rewrites them and is not possible after startSwmrWrite().
+     *
+     * @return the index of the first vertex of the patch
+     */
+    size_t appendPatch(const MapPatch& patch);
+
+    /**
+     * @brief Adds a level of detail, the faces of a simplified mesh which reference the vertices of the full mesh.
+     * The number of faces of the full mesh is stored along with it, so outdated levels can be detected.
+     */
+    void addLodLevel(uint32_t level, std::vector<uint32_t>& faceIds, float error);
+
+    /**
+     * @brief Removes all levels of detail from the file.
+     */
+    bool removeLodLevels();
+
+    /**
+     * @brief Stores the vertex adjacency of the mesh, e.g. as built by buildVertexAdjacency, replacing a stored one.
+     * The size of the mesh is stored along with it, so outdated adjacencies are detected.
+     */
+    void addVertexAdjacency(const MeshAdjacency& adjacency);
+
+    /**
+     * @brief Stores the face adjacency of the mesh, e.g. as built by buildFaceAdjacency, replacing a stored one.
+     * The size of the mesh is stored along with it, so outdated adjacencies are detected.
+     */
+    void addFaceAdjacency(const MeshAdjacency& adjacency);
+
     /**
      * @brief Adds an image with given data set name to the given group
      */
@@ -239,21 +407,54 @@ public:
     bool removeAllLabels();
 
     /**
-     * @brief Flushes the file. All opened buffers are saved to disc.
+     * @brief Flushes the file. All opened buffers are saved to disc. In SwmrWrite mode this publishes the changes
+     * to the readers.
      */
     void flush();
 
+    /**
+     * @brief Lets SwmrRead readers attach to a map opened or created with SwmrWrite, everything written so far is
+     * published to them. Data sets, groups and attributes can not be added or removed afterwards, all other methods
+     * which would do so throw.
+     */
+    void startSwmrWrite();
+
+    /**
+     * @brief Returns the mode the map file has been opened with.
+     */
+    AccessMode getAccessMode() const;
+
 private:
+    AccessMode m_mode;
+
+    // whether startSwmrWrite has been called, the structure of the file is fixed from then on
+    bool m_swmrWriting;
+
+    // file id of the SWMR read access, held open to let m_file share it
+    hid_t m_swmrFileId;
+
     hf::File m_file;
 
     void creatOrGetGroups();
 
+    // throws if data sets, groups or attributes can not be added or removed, i.e. while SWMR writing
+    void checkStructureChangeable();
+
+    // opens the data set and, in SwmrRead mode, loads its latest state from the file
+    hf::DataSet getDataSet(const hf::Group& group, const std::string& name);
+
     size_t getSize(hf::DataSet& data_set);
+
+    MeshAdjacency getAdjacency(const std::string& name, size_t size);
+
+    void addAdjacency(const std::string& name, const MeshAdjacency& adjacency, size_t size);
     // group names
     static constexpr const char* CHANNELS_GROUP = "/mesh/channels";
     static constexpr const char* CLUSTERSETS_GROUP = "/mesh/clustersets";
     static constexpr const char* TEXTURES_GROUP = "/mesh/textures";
     static constexpr const char* LABELS_GROUP = "/mesh/labels";
+    static constexpr const char* LOD_GROUP = "/mesh/lod";
+    static constexpr const char* ADJACENCY_GROUP = "/mesh/channels/adjacency";
 
     // main groups for reference
     hf::Group m_channelsGroup;
@@ -0,0 +1,50 @@
+#ifndef HDF5_MAP_IO__MAP_SPAN_H_
+#define HDF5_MAP_IO__MAP_SPAN_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace hdf5_map_io
+{
+
+/**
+ * @brief Read only view of contiguous values, e.g. a section of a memory mapped map file.
+ */
+template <typename T>
+struct MapSpan
+{
+    const T* data = nullptr;
+    size_t size = 0;
+
+    const T* begin() const
+    {
+        return data;
+    }
+
+    const T* end() const
+    {
+        return data + size;
+    }
+
+    const T& operator[](size_t i) const
+    {
+        return data[i];
+    }
+
+    bool empty() const
+    {
+        return size == 0;
+    }
+
+    /**
+     * @brief Copies the values, e.g. to fill a message
+     */
+    std::vector<T> toVector() const
+    {
+        return std::vector<T>(begin(), end());
+    }
+};
+
+} // namespace hdf5_map_io
+
+#endif // HDF5_MAP_IO__MAP_SPAN_H_
@@ -0,0 +1,147 @@
+#ifndef HDF5_MAP_IO__MESH_ADJACENCY_H_
+#define HDF5_MAP_IO__MESH_ADJACENCY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "hdf5_map_io/map_span.h"
+
+namespace hdf5_map_io
+{
+
+/**
+ * @brief Read only view of an adjacency in compressed sparse row layout, e.g. of a MeshAdjacency.
+ *
+ * The neighbors of element i are neighbors[offsets[i], offsets[i + 1]). The view does not own the arrays, so it can
+ * be passed around by value and refer to vectors, messages or memory mapped files alike.
+ */
+struct AdjacencyView
+{
+    /// Start of the neighbors of each element, one additional entry for the end of the last element
+    const uint64_t* offsets = nullptr;
+    /// Neighbors of all elements
+    const uint32_t* neighbors = nullptr;
+    /// Number of elements
+    size_t size = 0;
+
+    /**
+     * @brief Returns the neighbors of an element
+     */
+    MapSpan<uint32_t> operator[](size_t element) const
+    {
+        MapSpan<uint32_t> span;
+        span.data = neighbors + offsets[element];
+        span.size = offsets[element + 1] - offsets[element];
+        return span;
+    }
+
+    /**
+     * @brief Returns the number of neighbors of an element
+     */
+    size_t degree(size_t element) const
+    {
+        return offsets[element + 1] - offsets[element];
+    }
+
+    bool empty() const
+    {
+        return size == 0;
+    }
+};
+
+/**
+ * @brief Adjacency of the vertices or faces of a mesh in compressed sparse row layout.
+ *
+ * The neighbors of all elements are stored in a single array, which keeps the structure compact and makes it cheap
+ * to store in the map file, see HDF5MapIO::addVertexAdjacency. Use view() to pass it to algorithms.
+ */
+class MeshAdjacency
+{
+public:
+    /**
+     * @brief Creates an empty adjacency
+     */
+    MeshAdjacency();
+
+    /**
+     * @brief Takes over the arrays of an adjacency
+     *
+     * @param offsets Start of the neighbors of each element, one additional entry for the end of the last element
+     * @param neighbors Neighbors of all elements
+     */
+    MeshAdjacency(std::vector<uint64_t> offsets, std::vector<uint32_t> neighbors);
+
+    /**
+     * @brief Returns the number of elements
+     */
+    size_t size() const
+    {
+        return m_offsets.empty() ? 0 : m_offsets.size() - 1;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    /**
+     * @brief Returns the neighbors of an element
+     */
+    MapSpan<uint32_t> operator[](size_t element) const
+    {
+        return view()[element];
+    }
+
+    /**
+     * @brief Returns a view of the adjacency, valid as long as the adjacency exists
+     */
+    AdjacencyView view() const;
+
+    const std::vector<uint64_t>& getOffsets() const
+    {
+        return m_offsets;
+    }
+
+    const std::vector<uint32_t>& getNeighbors() const
+    {
+        return m_neighbors;
+    }
+
+private:
+    std::vector<uint64_t> m_offsets;
+    std::vector<uint32_t> m_neighbors;
+};
+
+/**
+ * @brief Builds the faces of each vertex, in ascending order.
+ *
+ * @param faceIds Vertex indices, three per face
+ * @param numFaces Number of faces
+ * @param numVertices Number of vertices
+ */
+MeshAdjacency buildVertexFaceAdjacency(const uint32_t* faceIds, size_t numFaces, size_t numVertices);
+
+/**
+ * @brief Builds the neighbors of each vertex, i.e. the vertices connected to it by an edge, in ascending order.
+ * The vertices are processed in parallel.
+ *
+ * @param faceIds Vertex indices, three per face
+ * @param numFaces Number of faces
+ * @param numVertices Number of vertices
+ */
+MeshAdjacency buildVertexAdjacency(const uint32_t* faceIds, size_t numFaces, size_t numVertices);
+
+/**
+ * @brief Builds the neighbors of each face, i.e. the faces sharing an edge with it. Non manifold edges simply give
+ * a face more than three neighbors. The faces are processed in parallel.
+ *
+ * @param faceIds Vertex indices, three per face
+ * @param numFaces Number of faces
+ * @param numVertices Number of vertices
+ */
+MeshAdjacency buildFaceAdjacency(const uint32_t* faceIds, size_t numFaces, size_t numVertices);
+
+} // namespace hdf5_map_io
+
+#endif // HDF5_MAP_IO__MESH_ADJACENCY_H_
@@ -0,0 +1,114 @@
+#ifndef HDF5_MAP_IO__MESH_REORDERING_H_
+#define HDF5_MAP_IO__MESH_REORDERING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hdf5_map_io
+{
+
+class HDF5MapIO;
+
+/**
+ * @brief New order of the faces and vertices of a mesh, as computed by computeMeshOrder.
+ */
+struct MeshOrder
+{
+    /// Index of each face in the input mesh, in the new order
+    std::vector<uint32_t> faceOrder;
+    /// Index of each vertex in the input mesh, in the new order
+    std::vector<uint32_t> vertexOrder;
+};
+
+/**
+ * @brief Orders the faces along a Morton curve over their centroids.
+ *
+ * The curve runs through cubic cells, which keeps consecutive faces spatially compact on flat maps as well, whose
+ * vertical extent is small.
+ *
+ * @param vertices Vertex positions, three floats per vertex
+ * @param numVertices Number of vertices
+ * @param faceIds Vertex indices, three per face
+ * @param numFaces Number of faces
+ * @return Index of each face in the input mesh, in the new order
+ */
+std::vector<uint32_t> mortonFaceOrder(
+    const float* vertices,
+    size_t numVertices,
+    const uint32_t* faceIds,
+    size_t numFaces
+);
+
+/**
+ * @brief Orders the faces for the post transform vertex cache of the GPU, following Tom Forsyth's linear speed
+ * vertex cache optimisation.
+ *
+ * Each step emits the face with the highest score, which prefers faces whose vertices were used recently and
+ * vertices with few remaining faces, so that no isolated faces are left behind. Only the faces of vertices in the
+ * simulated cache are scored. If none of them is left, the order continues with the first remaining face of the
+ * given order, e.g. a Morton order, which keeps the result spatially coherent.
+ *
+ * @param faceIds Vertex indices, three per face
+ * @param numFaces Number of faces
+ * @param numVertices Number of vertices
+ * @param faceOrder Order to continue with if the cache has no faces left, must contain every face once
+ * @param cacheSize Number of vertices in the simulated cache
+ * @return Index of each face in the input mesh, in the new order
+ */
+std::vector<uint32_t> optimizeVertexCache(
+    const uint32_t* faceIds,
+    size_t numFaces,
+    size_t numVertices,
+    const std::vector<uint32_t>& faceOrder,
+    size_t cacheSize = 32
+);
+
+/**
+ * @brief Computes a cache friendly order of the faces and vertices of a mesh.
+ *
+ * The faces are ordered along a Morton curve first and then for the vertex cache by optimizeVertexCache. The
+ * vertices are numbered in the order they are first used by the faces, vertices without faces are moved to the end.
+ * Thus faces and vertices close to each other in space are also close to each other in memory and in the chunks of
+ * the map file.
+ *
+ * @param vertices Vertex positions, three floats per vertex
+ * @param numVertices Number of vertices
+ * @param faceIds Vertex indices, three per face
+ * @param numFaces Number of faces
+ * @param cacheSize Number of vertices in the simulated cache
+ * @return The new order
+ */
+MeshOrder computeMeshOrder(
+    const float* vertices,
+    size_t numVertices,
+    const uint32_t* faceIds,
+    size_t numFaces,
+    size_t cacheSize = 32
+);
+
+/**
+ * @brief Returns the average number of vertex cache misses per face of a FIFO cache, the average cache miss ratio.
+ *
+ * The value lies between 0.5 for an ideal order of a large regular mesh and 3 if no vertex is ever reused.
+ */
+float averageCacheMissRatio(const uint32_t* faceIds, size_t numFaces, size_t numVertices, size_t cacheSize = 32);
+
+/**
+ * @brief Writes the map with the order of computeMeshOrder into a new HDF5 map file.
+ *
+ * Vertex normals, colors, texture coordinates and cost layers are reordered with the vertices, the material of each
+ * face with the faces. Labels and levels of detail refer to the new face and vertex indices, outdated levels of
+ * detail are dropped and stored adjacencies are built again. Textures, materials and texture features are copied as
+ * they are.
+ *
+ * @param map The map to reorder
+ * @param filename The file to write the reordered map to
+ * @param cacheSize Number of vertices in the simulated cache
+ */
+void writeReorderedMap(HDF5MapIO& map, std::string filename, size_t cacheSize = 32);
+
+} // namespace hdf5_map_io
+
+#endif // HDF5_MAP_IO__MESH_REORDERING_H_
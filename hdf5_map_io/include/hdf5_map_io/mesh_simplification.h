@@ -0,0 +1,105 @@
+#ifndef HDF5_MAP_IO__MESH_SIMPLIFICATION_H_
+#define HDF5_MAP_IO__MESH_SIMPLIFICATION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace hdf5_map_io
+{
+
+/**
+ * @brief Parameters of simplifyMesh. The simplification stops as soon as one of the limits is reached.
+ */
+struct SimplificationOptions
+{
+    /// Stop when the mesh has at most this many faces, zero to only limit the error
+    size_t targetFaces = 0;
+    /// Stop when the cheapest collapse has a larger error than this
+    float maxError = std::numeric_limits<float>::infinity();
+    /// Keep the vertices on the boundary of the mesh, so that adjacent parts of a larger mesh still fit together
+    bool lockBoundary = false;
+    /// Optional per vertex attributes, e.g. colors, costs or texture coordinates, attributeDim floats per vertex
+    const float* attributes = nullptr;
+    /// Number of floats per vertex in attributes
+    size_t attributeDim = 0;
+    /// Weight of the squared attribute difference in the collapse error
+    float attributeWeight = 1.0f;
+    /// Optional flags, one per vertex, vertices with a non zero flag are never removed
+    const uint8_t* lockedVertices = nullptr;
+};
+
+/**
+ * @brief Result of simplifyMesh.
+ */
+struct SimplificationResult
+{
+    /// Vertex indices of the remaining faces, three per face, referring to the vertices of the input mesh
+    std::vector<uint32_t> faceIds;
+    /// Index of each remaining face in the input mesh, e.g. to carry over face attributes and labels
+    std::vector<uint32_t> faceMap;
+    /// Largest error of all applied collapses
+    float error = 0.0f;
+};
+
+/**
+ * @brief Simplifies a triangle mesh by half edge collapses ordered by their quadric error.
+ *
+ * Every collapse moves a vertex onto one of its neighbours, so the remaining faces reference a subset of the
+ * input vertices and per vertex attributes stay valid without interpolation. The error of a collapse is the sum of
+ * squared distances of the target position to the planes of all faces merged into the removed vertex, plus the
+ * weighted squared difference of the attributes of both vertices. The latter keeps color, cost and texture seams
+ * in place. Collapses that would flip a face or make the mesh non manifold are skipped. Boundary vertices are
+ * either locked or only moved along the boundary.
+ *
+ * The function runs sequentially, large meshes are best split into parts that are simplified in parallel with
+ * locked boundaries.
+ *
+ * Throws if a face references a vertex that does not exist.
+ *
+ * @param vertices Vertex positions, three floats per vertex
+ * @param numVertices Number of vertices
+ * @param faceIds Vertex indices, three per face
+ * @param numFaces Number of faces
+ * @param options Limits and attributes of the simplification
+ * @return The remaining faces
+ */
+SimplificationResult simplifyMesh(
+    const float* vertices,
+    size_t numVertices,
+    const uint32_t* faceIds,
+    size_t numFaces,
+    const SimplificationOptions& options
+);
+
+/**
+ * @brief Simplifies a large triangle mesh in parallel, with the same options and result as simplifyMesh.
+ *
+ * The faces are split into parts of consecutive faces along a Morton curve over their centroids, which keeps the
+ * parts spatially compact. The parts are simplified concurrently with the vertices they share with other parts
+ * locked, each part aiming at its share of the target face count. A final sequential pass over the merged and
+ * already reduced mesh removes the dense seams between the parts and reaches the exact target.
+ *
+ * Throws if a face references a vertex that does not exist.
+ *
+ * @param vertices Vertex positions, three floats per vertex
+ * @param numVertices Number of vertices
+ * @param faceIds Vertex indices, three per face
+ * @param numFaces Number of faces
+ * @param options Limits and attributes of the simplification
+ * @param partFaces Number of faces per part
+ * @return The remaining faces
+ */
+SimplificationResult simplifyMeshParallel(
+    const float* vertices,
+    size_t numVertices,
+    const uint32_t* faceIds,
+    size_t numFaces,
+    const SimplificationOptions& options,
+    size_t partFaces = 1 << 16
+);
+
+} // namespace hdf5_map_io
+
+#endif // HDF5_MAP_IO__MESH_SIMPLIFICATION_H_
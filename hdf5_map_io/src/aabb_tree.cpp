@@ -0,0 +1,628 @@
+#include "hdf5_map_io/aabb_tree.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace hdf5_map_io
+{
+
+namespace
+{
+
+/// Subtrees with more faces than this are built in a separate OpenMP task
+const uint32_t PARALLEL_BUILD_THRESHOLD = 1 << 14;
+
+/// Maximum depth of the tree, the median split halves the faces on every level
+const size_t MAX_DEPTH = 64;
+
+const float EPSILON = 1e-7f;
+
+inline void cross(const float a[3], const float b[3], float out[3])
+{
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+inline float dot(const float a[3], const float b[3])
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+/**
+ * Closest point on the triangle abc to p, see Ericson, Real-Time Collision Detection, section 5.1.5. The point is
+ * a + v * (b - a) + w * (c - a).
+ */
+void closestPointOnTriangle(
+    const float p[3],
+    const float a[3],
+    const float b[3],
+    const float c[3],
+    float out[3],
+    float& v,
+    float& w
+)
+{
+    float ab[3], ac[3], ap[3];
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        ab[axis] = b[axis] - a[axis];
+        ac[axis] = c[axis] - a[axis];
+        ap[axis] = p[axis] - a[axis];
+    }
+
+    auto combine = [&](float bWeight, float cWeight)
+    {
+        v = bWeight;
+        w = cWeight;
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            out[axis] = a[axis] + v * ab[axis] + w * ac[axis];
+        }
+    };
+
+    float d1 = dot(ab, ap);
+    float d2 = dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f)
+    {
+        return combine(0.0f, 0.0f);
+    }
+
+    float bp[3];
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        bp[axis] = p[axis] - b[axis];
+    }
+    float d3 = dot(ab, bp);
+    float d4 = dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3)
+    {
+        return combine(1.0f, 0.0f);
+    }
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+    {
+        return combine(d1 / (d1 - d3), 0.0f);
+    }
+
+    float cp[3];
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        cp[axis] = p[axis] - c[axis];
+    }
+    float d5 = dot(ab, cp);
+    float d6 = dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6)
+    {
+        return combine(0.0f, 1.0f);
+    }
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+    {
+        return combine(0.0f, d2 / (d2 - d6));
+    }
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+    {
+        float weight = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        return combine(1.0f - weight, weight);
+    }
+
+    float denominator = 1.0f / (va + vb + vc);
+    combine(vb * denominator, vc * denominator);
+}
+
+} // namespace
+
+AABBTree::AABBTree(const std::vector<float>& vertices, const std::vector<uint32_t>& faceIds, size_t maxLeafSize)
+    : m_vertices(vertices)
+    , m_faceIds(faceIds)
+{
+    build(maxLeafSize);
+}
+
+AABBTree::AABBTree(
+    const float* vertices,
+    size_t numVertices,
+    const uint32_t* faceIds,
+    size_t numFaces,
+    size_t maxLeafSize
+)
+    : m_vertices(vertices, vertices + numVertices * 3)
+    , m_faceIds(faceIds, faceIds + numFaces * 3)
+{
+    build(maxLeafSize);
+}
+
+void AABBTree::build(size_t maxLeafSize)
+{
+    maxLeafSize = std::max<size_t>(maxLeafSize, 1);
+    const uint32_t faceCount = numFaces();
+
+    m_nodes.clear();
+    m_faceOrder.resize(faceCount);
+    if (faceCount == 0)
+    {
+        return;
+    }
+
+    std::vector<float> centroids(faceCount * 3);
+
+    #pragma omp parallel for
+    for (int64_t face = 0; face < faceCount; face++)
+    {
+        m_faceOrder[face] = face;
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            centroids[face * 3 + axis] = (m_vertices[m_faceIds[face * 3 + 0] * 3 + axis]
+                                        + m_vertices[m_faceIds[face * 3 + 1] * 3 + axis]
+                                        + m_vertices[m_faceIds[face * 3 + 2] * 3 + axis]) / 3.0f;
+        }
+    }
+
+    // every split creates children with at least half of maxLeafSize + 1 faces, which bounds the number of leaves
+    size_t minLeafSize = std::max<size_t>((maxLeafSize + 1) / 2, 1);
+    m_nodes.resize(2 * (faceCount / minLeafSize) + 1);
+
+    std::atomic<uint32_t> nextNode(1);
+
+    #pragma omp parallel
+    #pragma omp single
+    buildNode(0, 0, faceCount, maxLeafSize, centroids, nextNode);
+
+    m_nodes.resize(nextNode);
+    m_nodes.shrink_to_fit();
+}
+
+void AABBTree::buildNode(
+    uint32_t nodeIndex,
+    uint32_t begin,
+    uint32_t end,
+    size_t maxLeafSize,
+    const std::vector<float>& centroids,
+    std::atomic<uint32_t>& nextNode
+)
+{
+    Node& node = m_nodes[nodeIndex];
+
+    float centroidMin[3];
+    float centroidMax[3];
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        node.min[axis] = std::numeric_limits<float>::max();
+        node.max[axis] = std::numeric_limits<float>::lowest();
+        centroidMin[axis] = std::numeric_limits<float>::max();
+        centroidMax[axis] = std::numeric_limits<float>::lowest();
+    }
+
+    for (uint32_t i = begin; i < end; i++)
+    {
+        uint32_t face = m_faceOrder[i];
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                float value = m_vertices[m_faceIds[face * 3 + corner] * 3 + axis];
+                node.min[axis] = std::min(node.min[axis], value);
+                node.max[axis] = std::max(node.max[axis], value);
+            }
+            centroidMin[axis] = std::min(centroidMin[axis], centroids[face * 3 + axis]);
+            centroidMax[axis] = std::max(centroidMax[axis], centroids[face * 3 + axis]);
+        }
+    }
+
+    uint32_t count = end - begin;
+    if (count <= maxLeafSize)
+    {
+        node.offset = begin;
+        node.count = count;
+        return;
+    }
+
+    // split at the median of the centroids along the axis with the largest extent
+    size_t splitAxis = 0;
+    for (size_t axis = 1; axis < 3; axis++)
+    {
+        if (centroidMax[axis] - centroidMin[axis] > centroidMax[splitAxis] - centroidMin[splitAxis])
+        {
+            splitAxis = axis;
+        }
+    }
+
+    uint32_t middle = begin + count / 2;
+    std::nth_element(
+        m_faceOrder.begin() + begin,
+        m_faceOrder.begin() + middle,
+        m_faceOrder.begin() + end,
+        [&](uint32_t a, uint32_t b) {
+            return centroids[a * 3 + splitAxis] < centroids[b * 3 + splitAxis];
+        }
+    );
+
+    uint32_t children = nextNode.fetch_add(2);
+    node.offset = children;
+    node.count = 0;
+
+    if (count > PARALLEL_BUILD_THRESHOLD)
+    {
+        #pragma omp task shared(centroids, nextNode)
+        buildNode(children, begin, middle, maxLeafSize, centroids, nextNode);
+        buildNode(children + 1, middle, end, maxLeafSize, centroids, nextNode);
+        #pragma omp taskwait
+    }
+    else
+    {
+        buildNode(children, begin, middle, maxLeafSize, centroids, nextNode);
+        buildNode(children + 1, middle, end, maxLeafSize, centroids, nextNode);
+    }
+}
+
+bool AABBTree::intersectRay(
+    const float origin[3],
+    const float direction[3],
+    RayHit& hit,
+    float maxDistance
+) const
+{
+    if (m_nodes.empty())
+    {
+        return false;
+    }
+
+    float invDirection[3];
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        invDirection[axis] = 1.0f / direction[axis];
+    }
+
+    bool found = false;
+    float entryDistance;
+    uint32_t stack[MAX_DEPTH];
+    size_t stackSize = 0;
+
+    if (intersectBox(m_nodes[0], origin, invDirection, maxDistance, entryDistance))
+    {
+        stack[stackSize++] = 0;
+    }
+
+    while (stackSize > 0)
+    {
+        const Node& node = m_nodes[stack[--stackSize]];
+
+        // the box might be farther away than a hit found in the meantime
+        if (!intersectBox(node, origin, invDirection, maxDistance, entryDistance))
+        {
+            continue;
+        }
+
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+            {
+                if (intersectFace(m_faceOrder[i], origin, direction, maxDistance, hit))
+                {
+                    maxDistance = hit.distance;
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // visit the nearer child first by pushing it last
+        float leftDistance, rightDistance;
+        bool leftHit = intersectBox(m_nodes[node.offset], origin, invDirection, maxDistance, leftDistance);
+        bool rightHit = intersectBox(m_nodes[node.offset + 1], origin, invDirection, maxDistance, rightDistance);
+
+        if (leftHit && rightHit)
+        {
+            if (leftDistance < rightDistance)
+            {
+                stack[stackSize++] = node.offset + 1;
+                stack[stackSize++] = node.offset;
+            }
+            else
+            {
+                stack[stackSize++] = node.offset;
+                stack[stackSize++] = node.offset + 1;
+            }
+        }
+        else if (leftHit)
+        {
+            stack[stackSize++] = node.offset;
+        }
+        else if (rightHit)
+        {
+            stack[stackSize++] = node.offset + 1;
+        }
+    }
+
+    return found;
+}
+
+void AABBTree::facesInBox(const float min[3], const float max[3], std::vector<uint32_t>& faces) const
+{
+    if (m_nodes.empty())
+    {
+        return;
+    }
+
+    size_t first = faces.size();
+    uint32_t stack[MAX_DEPTH];
+    size_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Node& node = m_nodes[stack[--stackSize]];
+
+        bool overlaps = true;
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            overlaps = overlaps && node.min[axis] <= max[axis] && node.max[axis] >= min[axis];
+        }
+        if (!overlaps)
+        {
+            continue;
+        }
+
+        if (node.count == 0)
+        {
+            stack[stackSize++] = node.offset;
+            stack[stackSize++] = node.offset + 1;
+            continue;
+        }
+
+        for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+        {
+            uint32_t face = m_faceOrder[i];
+            float a[3], b[3], c[3];
+            getFaceVertices(face, a, b, c);
+
+            bool faceOverlaps = true;
+            for (size_t axis = 0; axis < 3; axis++)
+            {
+                faceOverlaps = faceOverlaps
+                    && std::min({ a[axis], b[axis], c[axis] }) <= max[axis]
+                    && std::max({ a[axis], b[axis], c[axis] }) >= min[axis];
+            }
+            if (faceOverlaps)
+            {
+                faces.push_back(face);
+            }
+        }
+    }
+
+    std::sort(faces.begin() + first, faces.end());
+}
+
+void AABBTree::facesInSphere(const float center[3], float radius, std::vector<uint32_t>& faces) const
+{
+    if (m_nodes.empty() || radius < 0.0f)
+    {
+        return;
+    }
+
+    const float radiusSquared = radius * radius;
+    size_t first = faces.size();
+    uint32_t stack[MAX_DEPTH];
+    size_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Node& node = m_nodes[stack[--stackSize]];
+        if (boxDistanceSquared(node, center) > radiusSquared)
+        {
+            continue;
+        }
+
+        if (node.count == 0)
+        {
+            stack[stackSize++] = node.offset;
+            stack[stackSize++] = node.offset + 1;
+            continue;
+        }
+
+        for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+        {
+            uint32_t face = m_faceOrder[i];
+            float a[3], b[3], c[3], closest[3], v, w;
+            getFaceVertices(face, a, b, c);
+            closestPointOnTriangle(center, a, b, c, closest, v, w);
+
+            float distanceSquared = 0.0f;
+            for (size_t axis = 0; axis < 3; axis++)
+            {
+                distanceSquared += (closest[axis] - center[axis]) * (closest[axis] - center[axis]);
+            }
+            if (distanceSquared <= radiusSquared)
+            {
+                faces.push_back(face);
+            }
+        }
+    }
+
+    std::sort(faces.begin() + first, faces.end());
+}
+
+bool AABBTree::closestPoint(const float point[3], PointHit& hit, float maxDistance) const
+{
+    if (m_nodes.empty())
+    {
+        return false;
+    }
+
+    bool found = false;
+    float bestSquared = maxDistance * maxDistance;
+    uint32_t stack[MAX_DEPTH];
+    size_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Node& node = m_nodes[stack[--stackSize]];
+
+        // the box might be farther away than a face found in the meantime
+        if (boxDistanceSquared(node, point) > bestSquared)
+        {
+            continue;
+        }
+
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+            {
+                uint32_t face = m_faceOrder[i];
+                float a[3], b[3], c[3], closest[3], u, v;
+                getFaceVertices(face, a, b, c);
+                closestPointOnTriangle(point, a, b, c, closest, u, v);
+
+                float distanceSquared = 0.0f;
+                for (size_t axis = 0; axis < 3; axis++)
+                {
+                    distanceSquared += (closest[axis] - point[axis]) * (closest[axis] - point[axis]);
+                }
+                if (distanceSquared <= bestSquared)
+                {
+                    bestSquared = distanceSquared;
+                    hit.face = face;
+                    hit.u = u;
+                    hit.v = v;
+                    std::copy_n(closest, 3, hit.point);
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // visit the nearer child first by pushing it last
+        float leftDistance = boxDistanceSquared(m_nodes[node.offset], point);
+        float rightDistance = boxDistanceSquared(m_nodes[node.offset + 1], point);
+        if (leftDistance < rightDistance)
+        {
+            stack[stackSize++] = node.offset + 1;
+            stack[stackSize++] = node.offset;
+        }
+        else
+        {
+            stack[stackSize++] = node.offset;
+            stack[stackSize++] = node.offset + 1;
+        }
+    }
+
+    if (found)
+    {
+        hit.distance = std::sqrt(bestSquared);
+    }
+    return found;
+}
+
+void AABBTree::getFaceVertices(uint32_t face, float a[3], float b[3], float c[3]) const
+{
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        a[axis] = m_vertices[m_faceIds[face * 3 + 0] * 3 + axis];
+        b[axis] = m_vertices[m_faceIds[face * 3 + 1] * 3 + axis];
+        c[axis] = m_vertices[m_faceIds[face * 3 + 2] * 3 + axis];
+    }
+}
+
+bool AABBTree::intersectFace(
+    uint32_t face,
+    const float origin[3],
+    const float direction[3],
+    float maxDistance,
+    RayHit& hit
+) const
+{
+    // Möller–Trumbore intersection, accepting hits on both sides of the face
+    float v0[3], v1[3], v2[3];
+    getFaceVertices(face, v0, v1, v2);
+
+    float edge1[3], edge2[3], s[3], h[3], q[3];
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        edge1[axis] = v1[axis] - v0[axis];
+        edge2[axis] = v2[axis] - v0[axis];
+        s[axis] = origin[axis] - v0[axis];
+    }
+
+    cross(direction, edge2, h);
+    float a = dot(edge1, h);
+    if (a > -EPSILON && a < EPSILON)
+    {
+        return false;
+    }
+
+    float f = 1.0f / a;
+    float u = f * dot(s, h);
+    if (u < 0.0f || u > 1.0f)
+    {
+        return false;
+    }
+
+    cross(s, edge1, q);
+    float v = f * dot(direction, q);
+    if (v < 0.0f || u + v > 1.0f)
+    {
+        return false;
+    }
+
+    float t = f * dot(edge2, q);
+    if (t <= EPSILON || t >= maxDistance)
+    {
+        return false;
+    }
+
+    hit.face = face;
+    hit.distance = t;
+    hit.u = u;
+    hit.v = v;
+    return true;
+}
+
+float AABBTree::boxDistanceSquared(const Node& node, const float point[3])
+{
+    float distanceSquared = 0.0f;
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        float d = std::max({ node.min[axis] - point[axis], 0.0f, point[axis] - node.max[axis] });
+        distanceSquared += d * d;
+    }
+    return distanceSquared;
+}
+
+bool AABBTree::intersectBox(
+    const Node& node,
+    const float origin[3],
+    const float invDirection[3],
+    float maxDistance,
+    float& entryDistance
+)
+{
+    float tMin = 0.0f;
+    float tMax = maxDistance;
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        float t0 = (node.min[axis] - origin[axis]) * invDirection[axis];
+        float t1 = (node.max[axis] - origin[axis]) * invDirection[axis];
+        if (t0 > t1)
+        {
+            std::swap(t0, t1);
+        }
+        // written such that NaNs from rays parallel to a slab do not reject the box
+        tMin = t0 > tMin ? t0 : tMin;
+        tMax = t1 < tMax ? t1 : tMax;
+        if (tMin > tMax)
+        {
+            return false;
+        }
+    }
+    entryDistance = tMin;
+    return true;
+}
+
+} // namespace hdf5_map_io
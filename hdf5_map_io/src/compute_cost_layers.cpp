@@ -0,0 +1,51 @@
+/*
+ * compute_cost_layers.cpp
+ *
+ * Computes the geometric cost layers roughness, height_diff, slope and step_height of an HDF5 map and writes them
+ * into the map, see computeGeometricCostLayers.
+ *
+ * usage: compute_cost_layers <map> [radius] [height range]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "hdf5_map_io/cost_layers.h"
+#include "hdf5_map_io/hdf5_map_io.h"
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc > 4)
+    {
+        std::cerr << "usage: " << argv[0] << " <map> [radius] [height range]" << std::endl
+                  << "  computes the roughness, height_diff, slope and step_height cost layers of the map" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const std::string filename = argv[1];
+    hdf5_map_io::CostLayerOptions options;
+    if (argc > 2)
+        options.radius = std::stof(argv[2]);
+    if (argc > 3)
+        options.heightRange = std::stof(argv[3]);
+    auto start = std::chrono::steady_clock::now();
+
+    try
+    {
+        hdf5_map_io::HDF5MapIO map(filename);
+        hdf5_map_io::writeGeometricCostLayers(map, options);
+    }
+    catch (const char* error)
+    {
+        std::cerr << error << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "Computed the cost layers of " << filename << " with a radius of " << options.radius << " in "
+              << std::chrono::duration<double>(end - start).count() << " s." << std::endl;
+
+    return EXIT_SUCCESS;
+}
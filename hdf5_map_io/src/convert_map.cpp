@@ -0,0 +1,68 @@
+/*
+ * convert_map.cpp
+ *
+ * Converts a map between the HDF5 format of HDF5MapIO and the memory mapped flat format of FlatMapIO. The direction
+ * is chosen by the file extension of the input, .h5 files are converted to flat maps and all other files back to
+ * HDF5.
+ *
+ * usage: convert_map <input> <output>
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "hdf5_map_io/flat_map_io.h"
+#include "hdf5_map_io/hdf5_map_io.h"
+
+namespace
+{
+
+bool isHDF5File(const std::string& filename)
+{
+    const std::string extension = ".h5";
+    return filename.size() > extension.size()
+        && filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        std::cerr << "usage: " << argv[0] << " <input> <output>" << std::endl
+                  << "  converts .h5 maps to flat maps and flat maps to .h5 maps" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const std::string input = argv[1];
+    const std::string output = argv[2];
+    auto start = std::chrono::steady_clock::now();
+
+    try
+    {
+        if (isHDF5File(input))
+        {
+            hdf5_map_io::HDF5MapIO map(input);
+            hdf5_map_io::writeFlatMap(map, output);
+        }
+        else
+        {
+            hdf5_map_io::FlatMapIO map(input);
+            hdf5_map_io::writeHDF5Map(map, output);
+        }
+    }
+    catch (const char* error)
+    {
+        std::cerr << error << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "Converted " << input << " to " << output << " in "
+              << std::chrono::duration<double>(end - start).count() << " s." << std::endl;
+
+    return EXIT_SUCCESS;
+}
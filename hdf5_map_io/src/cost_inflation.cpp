@@ -0,0 +1,346 @@
+#include "hdf5_map_io/cost_inflation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+
+namespace hdf5_map_io
+{
+
+namespace
+{
+
+const float INFINITE_DISTANCE = std::numeric_limits<float>::infinity();
+
+/// Number of buckets of the bucket queue between zero and the inflation radius
+const size_t NUM_BUCKETS = 256;
+
+/// Number of seeds per region of propagate, each region is processed by a single thread
+const size_t REGION_SIZE = 1024;
+
+/// Lowers the target to the value if it is smaller, returns whether it did
+inline bool atomicMin(std::atomic<float>& target, float value)
+{
+    float current = target.load(std::memory_order_relaxed);
+    while (value < current)
+    {
+        if (target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Priority queue of Dial's algorithm, the distances are rounded down to buckets of equal width. Vertices in the same
+ * bucket are processed in any order, a vertex whose distance is lowered again within its bucket is simply pushed
+ * again.
+ */
+class BucketQueue
+{
+public:
+    BucketQueue(float maxDistance)
+        : m_buckets(NUM_BUCKETS)
+        , m_scale(NUM_BUCKETS / maxDistance)
+    {
+    }
+
+    size_t getBucket(float distance) const
+    {
+        return std::min(size_t(distance * m_scale), NUM_BUCKETS - 1);
+    }
+
+    void push(uint32_t vertex, float distance)
+    {
+        m_buckets[getBucket(distance)].push_back(vertex);
+    }
+
+    /**
+     * Calls visit(vertex, bucket) for the queued vertices in the order of their buckets until the queue is empty.
+     * visit may push vertices into the current or later buckets.
+     */
+    template <typename Visit>
+    void run(Visit visit)
+    {
+        for (size_t bucket = 0; bucket < NUM_BUCKETS; bucket++)
+        {
+            while (!m_buckets[bucket].empty())
+            {
+                m_current.clear();
+                m_current.swap(m_buckets[bucket]);
+                for (uint32_t vertex : m_current)
+                {
+                    visit(vertex, bucket);
+                }
+            }
+        }
+    }
+
+private:
+    std::vector<std::vector<uint32_t>> m_buckets;
+    std::vector<uint32_t> m_current;
+    float m_scale;
+};
+
+} // namespace
+
+CostInflation::CostInflation(const float* vertices, AdjacencyView vertexAdjacency, const InflationOptions& options)
+    : m_vertices(vertices)
+    , m_adjacency(vertexAdjacency)
+    , m_options(options)
+    , m_distances(vertexAdjacency.size)
+    , m_scratch(vertexAdjacency.size, INFINITE_DISTANCE)
+{
+    if (!(options.inflationRadius > 0) || options.inscribedRadius > options.inflationRadius)
+      throw "The inflation radius must be positive and at least as large as the inscribed radius.";
+
+    for (std::atomic<float>& distance : m_distances)
+    {
+        distance.store(INFINITE_DISTANCE, std::memory_order_relaxed);
+    }
+}
+
+float CostInflation::inflatedCost(float cost, float distance) const
+{
+    float inflated = 0.0f;
+    if (distance <= m_options.inscribedRadius)
+    {
+        inflated = m_options.lethalCost;
+    }
+    else if (distance <= m_options.inflationRadius)
+    {
+        inflated = m_options.lethalCost
+            * std::exp(-m_options.costScalingFactor * (distance - m_options.inscribedRadius));
+    }
+    return std::max(cost, inflated);
+}
+
+float CostInflation::edgeLength(uint32_t a, uint32_t b) const
+{
+    const float* p = m_vertices + size_t(a) * 3;
+    const float* q = m_vertices + size_t(b) * 3;
+    return std::sqrt((q[0] - p[0]) * (q[0] - p[0]) + (q[1] - p[1]) * (q[1] - p[1]) + (q[2] - p[2]) * (q[2] - p[2]));
+}
+
+void CostInflation::propagate(const std::vector<uint32_t>& seeds, std::vector<uint32_t>* lowered)
+{
+    const float radius = m_options.inflationRadius;
+    const size_t numRegions = (seeds.size() + REGION_SIZE - 1) / REGION_SIZE;
+
+    #pragma omp parallel
+    {
+        BucketQueue queue(radius);
+        std::vector<uint32_t> threadLowered;
+
+        #pragma omp for schedule(dynamic, 1)
+        for (int64_t region = 0; region < numRegions; region++)
+        {
+            const size_t end = std::min(seeds.size(), size_t(region + 1) * REGION_SIZE);
+            for (size_t i = region * REGION_SIZE; i < end; i++)
+            {
+                queue.push(seeds[i], getDistance(seeds[i]));
+            }
+
+            queue.run([&](uint32_t vertex, size_t bucket)
+            {
+                // a vertex lowered to an earlier bucket by another thread is propagated by that thread
+                const float distance = getDistance(vertex);
+                if (queue.getBucket(distance) != bucket)
+                {
+                    return;
+                }
+
+                for (uint32_t neighbor : m_adjacency[vertex])
+                {
+                    const float neighborDistance = distance + edgeLength(vertex, neighbor);
+                    if (neighborDistance <= radius && atomicMin(m_distances[neighbor], neighborDistance))
+                    {
+                        queue.push(neighbor, neighborDistance);
+                        if (lowered)
+                        {
+                            threadLowered.push_back(neighbor);
+                        }
+                    }
+                }
+            });
+        }
+
+        if (lowered)
+        {
+            #pragma omp critical
+            lowered->insert(lowered->end(), threadLowered.begin(), threadLowered.end());
+        }
+    }
+}
+
+std::vector<uint32_t> CostInflation::collectNeighborhood(const std::vector<uint32_t>& sources)
+{
+    std::vector<uint32_t> neighborhood;
+    BucketQueue queue(m_options.inflationRadius);
+    for (uint32_t source : sources)
+    {
+        if (m_scratch[source] > 0)
+        {
+            m_scratch[source] = 0;
+            neighborhood.push_back(source);
+            queue.push(source, 0);
+        }
+    }
+
+    queue.run([&](uint32_t vertex, size_t bucket)
+    {
+        const float distance = m_scratch[vertex];
+        if (queue.getBucket(distance) != bucket)
+        {
+            return;
+        }
+
+        for (uint32_t neighbor : m_adjacency[vertex])
+        {
+            const float neighborDistance = distance + edgeLength(vertex, neighbor);
+            if (neighborDistance <= m_options.inflationRadius && neighborDistance < m_scratch[neighbor])
+            {
+                if (m_scratch[neighbor] == INFINITE_DISTANCE)
+                {
+                    neighborhood.push_back(neighbor);
+                }
+                m_scratch[neighbor] = neighborDistance;
+                queue.push(neighbor, neighborDistance);
+            }
+        }
+    });
+
+    for (uint32_t vertex : neighborhood)
+    {
+        m_scratch[vertex] = INFINITE_DISTANCE;
+    }
+
+    return neighborhood;
+}
+
+void CostInflation::inflate(const std::vector<float>& costs)
+{
+    if (costs.size() != m_distances.size())
+      throw "The number of costs does not match the number of vertices.";
+
+    m_costs = costs;
+
+    std::vector<uint32_t> seeds;
+    for (size_t vertex = 0; vertex < m_costs.size(); vertex++)
+    {
+        const bool lethal = isLethal(m_costs[vertex]);
+        m_distances[vertex].store(lethal ? 0.0f : INFINITE_DISTANCE, std::memory_order_relaxed);
+        if (lethal)
+        {
+            seeds.push_back(vertex);
+        }
+    }
+
+    propagate(seeds, nullptr);
+
+    m_inflatedCosts.resize(m_costs.size());
+    #pragma omp parallel for schedule(static)
+    for (int64_t vertex = 0; vertex < m_costs.size(); vertex++)
+    {
+        m_inflatedCosts[vertex] = inflatedCost(m_costs[vertex], getDistance(vertex));
+    }
+}
+
+std::vector<uint32_t> CostInflation::update(const std::vector<uint32_t>& vertexIds, const std::vector<float>& costs)
+{
+    if (vertexIds.size() != costs.size())
+      throw "The number of vertex ids and costs differ.";
+    if (m_costs.size() != m_distances.size())
+      throw "The costs have to be inflated before they can be updated.";
+
+    for (uint32_t vertex : vertexIds)
+    {
+        if (vertex >= m_costs.size())
+          throw "The vertex id of a cost update is out of range.";
+    }
+
+    // a vertex may be updated more than once, only its state before and after all updates matters
+    std::vector<uint32_t> updated(vertexIds);
+    std::sort(updated.begin(), updated.end());
+    updated.erase(std::unique(updated.begin(), updated.end()), updated.end());
+    std::vector<bool> wasLethal(updated.size());
+    for (size_t i = 0; i < updated.size(); i++)
+    {
+        wasLethal[i] = isLethal(m_costs[updated[i]]);
+    }
+
+    for (size_t i = 0; i < vertexIds.size(); i++)
+    {
+        m_costs[vertexIds[i]] = costs[i];
+    }
+
+    std::vector<uint32_t> removed;
+    std::vector<uint32_t> added;
+    for (size_t i = 0; i < updated.size(); i++)
+    {
+        const bool lethal = isLethal(m_costs[updated[i]]);
+        if (wasLethal[i] && !lethal)
+        {
+            removed.push_back(updated[i]);
+        }
+        else if (!wasLethal[i] && lethal)
+        {
+            added.push_back(updated[i]);
+        }
+    }
+
+    std::vector<uint32_t> candidates(updated);
+    std::vector<uint32_t> seeds;
+
+    // only vertices within the inflation radius of a removed lethal vertex may have their distance from it, their
+    // distances are computed again from the lethal vertices among them and from the vertices around them
+    std::vector<uint32_t> region = collectNeighborhood(removed);
+    for (uint32_t vertex : region)
+    {
+        m_distances[vertex].store(isLethal(m_costs[vertex]) ? 0.0f : INFINITE_DISTANCE, std::memory_order_relaxed);
+    }
+    for (uint32_t vertex : region)
+    {
+        for (uint32_t neighbor : m_adjacency[vertex])
+        {
+            const float distance = getDistance(neighbor) + edgeLength(vertex, neighbor);
+            if (distance <= m_options.inflationRadius)
+            {
+                atomicMin(m_distances[vertex], distance);
+            }
+        }
+        if (getDistance(vertex) != INFINITE_DISTANCE)
+        {
+            seeds.push_back(vertex);
+        }
+    }
+    candidates.insert(candidates.end(), region.begin(), region.end());
+
+    for (uint32_t vertex : added)
+    {
+        m_distances[vertex].store(0.0f, std::memory_order_relaxed);
+        seeds.push_back(vertex);
+    }
+
+    propagate(seeds, &candidates);
+
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    std::vector<uint32_t> changed;
+    for (uint32_t vertex : candidates)
+    {
+        const float inflated = inflatedCost(m_costs[vertex], getDistance(vertex));
+        if (inflated != m_inflatedCosts[vertex])
+        {
+            m_inflatedCosts[vertex] = inflated;
+            changed.push_back(vertex);
+        }
+    }
+
+    return changed;
+}
+
+} // namespace hdf5_map_io
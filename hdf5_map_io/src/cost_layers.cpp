@@ -0,0 +1,342 @@
+#include "hdf5_map_io/cost_layers.h"
+#include "hdf5_map_io/hdf5_map_io.h"
+#include "hdf5_map_io/mesh_adjacency.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace hdf5_map_io
+{
+
+namespace
+{
+
+/// Factor between the size of the grid cells and the neighborhood
+const float CELL_MARGIN = 1.001f;
+
+/**
+ * Grid over the vertices of a mesh for cylinder queries, whose cells are as large as the cylinder. The cells are
+ * numbered column by column, so the cells of a column with adjacent z indices have adjacent numbers. The vertices are
+ * sorted by their cell and their positions and normals are copied in that order, which keeps the vertices of a query
+ * close together in memory.
+ */
+class VertexGrid
+{
+public:
+    VertexGrid(const float* vertices, const float* normals, size_t numVertices, float radius, float heightRange)
+        : m_radius(radius)
+        , m_heightRange(heightRange)
+    {
+        // slightly larger cells, so that rounding never puts a neighbor at the border two cells away
+        m_cellSize[0] = radius * CELL_MARGIN;
+        m_cellSize[1] = radius * CELL_MARGIN;
+        m_cellSize[2] = heightRange * CELL_MARGIN;
+
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            m_min[axis] = std::numeric_limits<float>::max();
+            float max = std::numeric_limits<float>::lowest();
+            for (size_t vertex = 0; vertex < numVertices; vertex++)
+            {
+                m_min[axis] = std::min(m_min[axis], vertices[vertex * 3 + axis]);
+                max = std::max(max, vertices[vertex * 3 + axis]);
+            }
+            m_dims[axis] = numVertices == 0 ? 1 : uint64_t((max - m_min[axis]) / m_cellSize[axis]) + 1;
+        }
+
+        if (double(m_dims[0]) * m_dims[1] * m_dims[2] > double(std::numeric_limits<uint64_t>::max() / 2))
+          throw "The neighborhood is too small for the extent of the mesh.";
+
+        std::vector<std::pair<uint64_t, uint32_t>> cells(numVertices);
+        #pragma omp parallel for schedule(static)
+        for (int64_t vertex = 0; vertex < numVertices; vertex++)
+        {
+            uint64_t cell[3];
+            getCell(vertices + vertex * 3, cell);
+            cells[vertex] = std::make_pair(getKey(cell), uint32_t(vertex));
+        }
+        std::sort(cells.begin(), cells.end());
+
+        m_keys.resize(numVertices);
+        m_ids.resize(numVertices);
+        m_positions.resize(numVertices * 3);
+        m_normals.resize(numVertices * 3);
+        #pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < numVertices; i++)
+        {
+            const size_t vertex = cells[i].second;
+            m_keys[i] = cells[i].first;
+            m_ids[i] = vertex;
+
+            const float* normal = normals + vertex * 3;
+            const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            for (size_t axis = 0; axis < 3; axis++)
+            {
+                m_positions[i * 3 + axis] = vertices[vertex * 3 + axis];
+                // vertices without a valid normal are treated as flat ground
+                m_normals[i * 3 + axis] = length > 0 ? normal[axis] / length : (axis == 2 ? 1.0f : 0.0f);
+            }
+        }
+
+        for (size_t i = 0; i < numVertices; i++)
+        {
+            if (i == 0 || m_keys[i] != m_keys[i - 1])
+            {
+                m_cellStarts.push_back(i);
+            }
+        }
+        m_cellStarts.push_back(numVertices);
+    }
+
+    size_t size() const
+    {
+        return m_ids.size();
+    }
+
+    /// Returns the index of the i-th vertex of the grid in the mesh
+    uint32_t getId(size_t i) const
+    {
+        return m_ids[i];
+    }
+
+    const float* getPosition(size_t i) const
+    {
+        return m_positions.data() + i * 3;
+    }
+
+    const float* getNormal(size_t i) const
+    {
+        return m_normals.data() + i * 3;
+    }
+
+    /// Returns the number of non empty cells
+    size_t numCells() const
+    {
+        return m_cellStarts.size() - 1;
+    }
+
+    /// Returns the range of the grid vertices of a non empty cell
+    std::pair<size_t, size_t> getCellRange(size_t cell) const
+    {
+        return std::make_pair(m_cellStarts[cell], m_cellStarts[cell + 1]);
+    }
+
+    /**
+     * Collects the ranges of the grid vertices in the cells around a non empty cell, which contain the neighborhoods
+     * of all vertices of the cell. The vertices of the cells in the same column are a single range.
+     *
+     * @return The number of ranges, at most nine
+     */
+    size_t getCandidates(size_t cell, std::pair<size_t, size_t>* ranges) const
+    {
+        uint64_t index[3];
+        getCell(getPosition(m_cellStarts[cell]), index);
+
+        const uint64_t zBegin = index[2] > 0 ? index[2] - 1 : 0;
+        const uint64_t zEnd = std::min(index[2] + 1, m_dims[2] - 1);
+        size_t count = 0;
+        for (uint64_t x = index[0] > 0 ? index[0] - 1 : 0; x <= std::min(index[0] + 1, m_dims[0] - 1); x++)
+        {
+            for (uint64_t y = index[1] > 0 ? index[1] - 1 : 0; y <= std::min(index[1] + 1, m_dims[1] - 1); y++)
+            {
+                const uint64_t first[3] = {x, y, zBegin};
+                const uint64_t last[3] = {x, y, zEnd};
+                auto begin = std::lower_bound(m_keys.begin(), m_keys.end(), getKey(first));
+                auto end = std::upper_bound(begin, m_keys.end(), getKey(last));
+                if (begin != end)
+                {
+                    ranges[count++] = std::make_pair(begin - m_keys.begin(), end - m_keys.begin());
+                }
+            }
+        }
+        return count;
+    }
+
+    /// Returns whether the j-th vertex of the grid lies in the cylinder around the i-th one
+    bool isNeighbor(size_t i, size_t j) const
+    {
+        const float* position = getPosition(i);
+        const float* other = getPosition(j);
+        const float dx = other[0] - position[0];
+        const float dy = other[1] - position[1];
+        return dx * dx + dy * dy <= m_radius * m_radius && std::abs(other[2] - position[2]) <= m_heightRange;
+    }
+
+private:
+    void getCell(const float* position, uint64_t* cell) const
+    {
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            const float offset = std::max(0.0f, (position[axis] - m_min[axis]) / m_cellSize[axis]);
+            cell[axis] = std::min(uint64_t(offset), m_dims[axis] - 1);
+        }
+    }
+
+    uint64_t getKey(const uint64_t* cell) const
+    {
+        return (cell[0] * m_dims[1] + cell[1]) * m_dims[2] + cell[2];
+    }
+
+    float m_radius;
+    float m_heightRange;
+    float m_cellSize[3];
+    float m_min[3];
+    uint64_t m_dims[3];
+
+    std::vector<uint64_t> m_keys;
+    std::vector<size_t> m_cellStarts;
+    std::vector<uint32_t> m_ids;
+    std::vector<float> m_positions;
+    std::vector<float> m_normals;
+};
+
+} // namespace
+
+std::vector<float> computeVertexNormals(
+    const float* vertices,
+    size_t numVertices,
+    const uint32_t* faceIds,
+    size_t numFaces
+)
+{
+    // the cross product of two edges is a normal scaled by twice the area of the face
+    std::vector<float> faceNormals(numFaces * 3);
+    #pragma omp parallel for schedule(static)
+    for (int64_t face = 0; face < numFaces; face++)
+    {
+        const float* a = vertices + size_t(faceIds[face * 3]) * 3;
+        const float* b = vertices + size_t(faceIds[face * 3 + 1]) * 3;
+        const float* c = vertices + size_t(faceIds[face * 3 + 2]) * 3;
+        const float u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        const float v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        faceNormals[face * 3] = u[1] * v[2] - u[2] * v[1];
+        faceNormals[face * 3 + 1] = u[2] * v[0] - u[0] * v[2];
+        faceNormals[face * 3 + 2] = u[0] * v[1] - u[1] * v[0];
+    }
+
+    // summing up the faces of each vertex instead of scattering the faces to their vertices avoids atomics
+    const MeshAdjacency vertexFaces = buildVertexFaceAdjacency(faceIds, numFaces, numVertices);
+    const AdjacencyView view = vertexFaces.view();
+
+    std::vector<float> normals(numVertices * 3);
+    #pragma omp parallel for schedule(static)
+    for (int64_t vertex = 0; vertex < numVertices; vertex++)
+    {
+        float normal[3] = {0, 0, 0};
+        for (uint32_t face : view[vertex])
+        {
+            for (size_t axis = 0; axis < 3; axis++)
+            {
+                normal[axis] += faceNormals[size_t(face) * 3 + axis];
+            }
+        }
+
+        const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            normals[vertex * 3 + axis] = length > 0 ? normal[axis] / length : (axis == 2 ? 1.0f : 0.0f);
+        }
+    }
+
+    return normals;
+}
+
+GeometricCostLayers computeGeometricCostLayers(
+    const float* vertices,
+    const float* normals,
+    size_t numVertices,
+    const CostLayerOptions& options
+)
+{
+    if (!(options.radius > 0) || !(options.heightRange > 0))
+      throw "The radius and the height range of the cost layers must be positive.";
+
+    const VertexGrid grid(vertices, normals, numVertices, options.radius, options.heightRange);
+
+    GeometricCostLayers layers;
+    layers.roughness.resize(numVertices);
+    layers.heightDifference.resize(numVertices);
+    layers.slope.resize(numVertices);
+    layers.stepHeight.resize(numVertices);
+
+    // the vertices of a cell share their candidate neighbors, which are only searched once per cell
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int64_t cell = 0; cell < grid.numCells(); cell++)
+    {
+        std::pair<size_t, size_t> candidates[9];
+        const size_t numCandidates = grid.getCandidates(cell, candidates);
+
+        const std::pair<size_t, size_t> range = grid.getCellRange(cell);
+        for (size_t i = range.first; i < range.second; i++)
+        {
+            const float* position = grid.getPosition(i);
+            const float* normal = grid.getNormal(i);
+
+            float angleSum = 0;
+            size_t count = 0;
+            float minHeight = position[2];
+            float maxHeight = position[2];
+            float stepHeight = 0;
+
+            for (size_t candidate = 0; candidate < numCandidates; candidate++)
+            {
+                for (size_t j = candidates[candidate].first; j < candidates[candidate].second; j++)
+                {
+                    if (!grid.isNeighbor(i, j))
+                    {
+                        continue;
+                    }
+
+                    const float* otherPosition = grid.getPosition(j);
+                    const float* otherNormal = grid.getNormal(j);
+
+                    const float cosine = normal[0] * otherNormal[0] + normal[1] * otherNormal[1]
+                        + normal[2] * otherNormal[2];
+                    angleSum += std::acos(std::max(-1.0f, std::min(1.0f, cosine)));
+                    count++;
+
+                    minHeight = std::min(minHeight, otherPosition[2]);
+                    maxHeight = std::max(maxHeight, otherPosition[2]);
+
+                    const float distance = normal[0] * (otherPosition[0] - position[0])
+                        + normal[1] * (otherPosition[1] - position[1])
+                        + normal[2] * (otherPosition[2] - position[2]);
+                    stepHeight = std::max(stepHeight, std::abs(distance));
+                }
+            }
+
+            const uint32_t vertex = grid.getId(i);
+            layers.roughness[vertex] = angleSum / count;
+            layers.heightDifference[vertex] = maxHeight - minHeight;
+            // normals pointing down give slopes above 90 degrees, e.g. for ceilings
+            layers.slope[vertex] = std::acos(std::max(-1.0f, std::min(1.0f, normal[2])));
+            layers.stepHeight[vertex] = stepHeight;
+        }
+    }
+
+    return layers;
+}
+
+void writeGeometricCostLayers(HDF5MapIO& map, const CostLayerOptions& options)
+{
+    const std::vector<float> vertices = map.getVertices();
+    const size_t numVertices = vertices.size() / 3;
+
+    std::vector<float> normals = map.getVertexNormals();
+    if (normals.size() != vertices.size())
+    {
+        const std::vector<uint32_t> faceIds = map.getFaceIds();
+        normals = computeVertexNormals(vertices.data(), numVertices, faceIds.data(), faceIds.size() / 3);
+    }
+
+    const GeometricCostLayers layers = computeGeometricCostLayers(vertices.data(), normals.data(), numVertices, options);
+
+    map.writeVertexCosts("roughness", layers.roughness);
+    map.writeVertexCosts("height_diff", layers.heightDifference);
+    map.writeVertexCosts("slope", layers.slope);
+    map.writeVertexCosts("step_height", layers.stepHeight);
+}
+
+} // namespace hdf5_map_io
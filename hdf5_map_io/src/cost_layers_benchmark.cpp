@@ -0,0 +1,180 @@
+/*
+ * cost_layers_benchmark.cpp
+ *
+ * Times computeVertexNormals and computeGeometricCostLayers on a synthetic heightfield mesh, 5M vertices by default.
+ * The vertices of the heightfield are jittered in the xy plane, so the neighborhoods are not aligned with the grid
+ * of the spatial index. The height difference of a sample of vertices is checked against a search over the
+ * surrounding rows and columns of the heightfield.
+ *
+ * usage: cost_layers_benchmark [vertices] [radius] [height range]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "hdf5_map_io/cost_layers.h"
+
+namespace
+{
+
+/// Distance of the rows and columns of the heightfield
+const float CELL_SIZE = 0.05f;
+
+/// Largest offset of a vertex from its grid position in the xy plane, relative to the cell size
+const float JITTER = 0.3f;
+
+/// Number of vertices whose height difference is checked
+const size_t NUM_SAMPLES = 1000;
+
+/**
+ * @brief Height of the terrain: rolling hills, a few steps and some noise
+ */
+float terrainHeight(float x, float y, float noise)
+{
+    float height = 0.5f * std::sin(0.3f * x) * std::cos(0.2f * y) + 0.05f * std::sin(3.0f * x + 2.0f * y);
+    height += 0.15f * std::floor(std::max(0.0f, std::sin(0.5f * y)) * 3);
+    return height + noise;
+}
+
+/**
+ * @brief Creates a jittered size x size heightfield with two faces per cell
+ */
+void createHeightfield(size_t size, std::vector<float>& vertices, std::vector<uint32_t>& faceIds)
+{
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> jitter(-JITTER * CELL_SIZE, JITTER * CELL_SIZE);
+    std::normal_distribution<float> noise(0.0f, 0.005f);
+
+    vertices.clear();
+    vertices.reserve(size * size * 3);
+    for (size_t row = 0; row < size; row++)
+    {
+        for (size_t column = 0; column < size; column++)
+        {
+            const float x = column * CELL_SIZE + jitter(generator);
+            const float y = row * CELL_SIZE + jitter(generator);
+            vertices.push_back(x);
+            vertices.push_back(y);
+            vertices.push_back(terrainHeight(x, y, noise(generator)));
+        }
+    }
+
+    faceIds.clear();
+    faceIds.reserve((size - 1) * (size - 1) * 6);
+    for (uint32_t row = 0; row + 1 < size; row++)
+    {
+        for (uint32_t column = 0; column + 1 < size; column++)
+        {
+            const uint32_t a = row * size + column;
+            const uint32_t b = a + size;
+            faceIds.insert(faceIds.end(), {a, a + 1, b + 1});
+            faceIds.insert(faceIds.end(), {a, b + 1, b});
+        }
+    }
+}
+
+/**
+ * @brief Returns the height difference of the neighborhood of a vertex, searching the rows and columns around it
+ */
+float referenceHeightDifference(
+    const std::vector<float>& vertices,
+    size_t size,
+    size_t vertex,
+    const hdf5_map_io::CostLayerOptions& options
+)
+{
+    const float* position = &vertices[vertex * 3];
+    const long reach = std::ceil(options.radius / CELL_SIZE + 2 * JITTER) + 1;
+    const long row = vertex / size;
+    const long column = vertex % size;
+
+    float minHeight = position[2];
+    float maxHeight = position[2];
+    for (long r = std::max(0L, row - reach); r <= std::min<long>(size - 1, row + reach); r++)
+    {
+        for (long c = std::max(0L, column - reach); c <= std::min<long>(size - 1, column + reach); c++)
+        {
+            const float* other = &vertices[(r * size + c) * 3];
+            const float dx = other[0] - position[0];
+            const float dy = other[1] - position[1];
+            if (dx * dx + dy * dy <= options.radius * options.radius
+                && std::abs(other[2] - position[2]) <= options.heightRange)
+            {
+                minHeight = std::min(minHeight, other[2]);
+                maxHeight = std::max(maxHeight, other[2]);
+            }
+        }
+    }
+    return maxHeight - minHeight;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc > 4)
+    {
+        std::cerr << "usage: " << argv[0] << " [vertices] [radius] [height range]" << std::endl
+                  << "  times the vertex normals and the geometric cost layers of a jittered heightfield" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const size_t numVertices = argc > 1 ? std::stoul(argv[1]) : 5000000;
+    hdf5_map_io::CostLayerOptions options;
+    if (argc > 2)
+        options.radius = std::stof(argv[2]);
+    if (argc > 3)
+        options.heightRange = std::stof(argv[3]);
+
+    const size_t size = std::max<size_t>(2, std::ceil(std::sqrt(double(numVertices))));
+    std::vector<float> vertices;
+    std::vector<uint32_t> faceIds;
+    createHeightfield(size, vertices, faceIds);
+    const size_t numFaces = faceIds.size() / 3;
+    std::cout << "Heightfield with " << size * size << " vertices and " << numFaces << " faces, radius "
+              << options.radius << ", height range " << options.heightRange << std::endl;
+
+    try
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<float> normals =
+            hdf5_map_io::computeVertexNormals(vertices.data(), size * size, faceIds.data(), numFaces);
+        std::cout << "Vertex normals: " << secondsSince(start) << " s" << std::endl;
+
+        start = std::chrono::steady_clock::now();
+        hdf5_map_io::GeometricCostLayers layers =
+            hdf5_map_io::computeGeometricCostLayers(vertices.data(), normals.data(), size * size, options);
+        const double seconds = secondsSince(start);
+        std::cout << "Cost layers: " << seconds << " s, " << size * size / seconds / 1e6 << " M vertices/s"
+                  << std::endl;
+
+        std::mt19937 generator(7);
+        std::uniform_int_distribution<size_t> sample(0, size * size - 1);
+        size_t mismatches = 0;
+        for (size_t i = 0; i < NUM_SAMPLES; i++)
+        {
+            const size_t vertex = sample(generator);
+            const float expected = referenceHeightDifference(vertices, size, vertex, options);
+            mismatches += std::abs(layers.heightDifference[vertex] - expected) > 1e-5f;
+        }
+        std::cout << "Height differences differing from the reference: " << mismatches << " of " << NUM_SAMPLES
+                  << std::endl;
+
+        return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    catch (const char* error)
+    {
+        std::cerr << error << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,361 @@
+#include "hdf5_map_io/flat_map_io.h"
+#include "hdf5_map_io/hdf5_map_io.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <set>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace hdf5_map_io
+{
+
+namespace
+{
+
+constexpr char MAGIC[8] = {'M', 'E', 'S', 'H', 'M', 'A', 'P', '\0'};
+constexpr uint32_t VERSION = 1;
+
+// alignment of the header, the table of contents and all sections
+constexpr size_t ALIGNMENT = 64;
+
+constexpr const char* COSTS_PREFIX = "costs/";
+constexpr const char* LABELS_PREFIX = "labels/";
+
+struct FlatMapHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t numSections;
+    uint64_t tocOffset;
+};
+
+// the structs are written as they are, their layout must not depend on the compiler
+static_assert(sizeof(FlatMapHeader) == 24, "unexpected padding of the flat map header");
+static_assert(sizeof(FlatMapSection) == 88, "unexpected padding of the flat map sections");
+
+size_t align(size_t offset)
+{
+    return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+size_t valueSize(uint32_t type)
+{
+    switch (type)
+    {
+        case FlatMapIO::Float32:
+            return sizeof(float);
+        case FlatMapIO::UInt32:
+            return sizeof(uint32_t);
+        case FlatMapIO::UInt8:
+            return sizeof(uint8_t);
+        default:
+            return 0;
+    }
+}
+
+// a section to write, the values are referenced until the file is written
+struct SectionData
+{
+    std::string name;
+    FlatMapIO::ValueType type;
+    uint32_t width;
+    const void* data;
+    size_t size;
+};
+
+template <typename T>
+SectionData section(const std::string& name, FlatMapIO::ValueType type, uint32_t width, const std::vector<T>& values)
+{
+    return {name, type, width, values.data(), values.size()};
+}
+
+} // namespace
+
+FlatMapIO::FlatMapIO(std::string filename)
+    : m_data(nullptr)
+    , m_size(0)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw "Could not open file.";
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) < 0 || static_cast<size_t>(fileStat.st_size) < sizeof(FlatMapHeader))
+    {
+        close(fd);
+        throw "The file is not a flat map.";
+    }
+
+    m_size = fileStat.st_size;
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping stays valid after closing the file
+    close(fd);
+
+    if (data == MAP_FAILED)
+      throw "Could not map file.";
+
+    m_data = static_cast<const uint8_t*>(data);
+
+    FlatMapHeader header;
+    std::memcpy(&header, m_data, sizeof(header));
+    const size_t tocEnd = header.tocOffset + header.numSections * sizeof(FlatMapSection);
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || tocEnd > m_size)
+    {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+        throw "The file is not a flat map or has an unsupported version.";
+    }
+
+    const FlatMapSection* toc = reinterpret_cast<const FlatMapSection*>(m_data + header.tocOffset);
+    for (uint32_t i = 0; i < header.numSections; i++)
+    {
+        FlatMapSection entry = toc[i];
+        entry.name[sizeof(entry.name) - 1] = '\0';
+
+        const size_t bytes = entry.size * valueSize(entry.type);
+        if (valueSize(entry.type) == 0 || entry.offset % ALIGNMENT != 0 || entry.offset + bytes > m_size)
+        {
+            munmap(const_cast<uint8_t*>(m_data), m_size);
+            throw "The flat map contains an invalid section.";
+        }
+
+        m_sections[entry.name] = entry;
+    }
+}
+
+FlatMapIO::~FlatMapIO()
+{
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+}
+
+template <typename T>
+MapSpan<T> FlatMapIO::getSection(const std::string& name, ValueType type) const
+{
+    MapSpan<T> span;
+    auto it = m_sections.find(name);
+    if (it == m_sections.end() || it->second.type != type)
+    {
+        return span;
+    }
+
+    span.data = reinterpret_cast<const T*>(m_data + it->second.offset);
+    span.size = it->second.size;
+    return span;
+}
+
+std::vector<std::string> FlatMapIO::listSections(const std::string& prefix) const
+{
+    // names below the prefix up to the next separator, i.e. the children of a group
+    std::set<std::string> names;
+    for (const auto& entry : m_sections)
+    {
+        const std::string& name = entry.first;
+        if (name.compare(0, prefix.size(), prefix) == 0)
+        {
+            names.insert(name.substr(prefix.size(), name.find('/', prefix.size()) - prefix.size()));
+        }
+    }
+
+    return std::vector<std::string>(names.begin(), names.end());
+}
+
+size_t FlatMapIO::getNumVertices() const
+{
+    return getVertices().size / 3;
+}
+
+size_t FlatMapIO::getNumFaces() const
+{
+    return getFaceIds().size / 3;
+}
+
+MapSpan<float> FlatMapIO::getVertices() const
+{
+    return getSection<float>("vertices", Float32);
+}
+
+MapSpan<uint32_t> FlatMapIO::getFaceIds() const
+{
+    return getSection<uint32_t>("face_indices", UInt32);
+}
+
+MapSpan<float> FlatMapIO::getVertexNormals() const
+{
+    return getSection<float>("vertex_normals", Float32);
+}
+
+MapSpan<uint8_t> FlatMapIO::getVertexColors() const
+{
+    return getSection<uint8_t>("vertex_colors", UInt8);
+}
+
+MapSpan<float> FlatMapIO::getVertexCosts(std::string costlayer) const
+{
+    return getSection<float>(COSTS_PREFIX + costlayer, Float32);
+}
+
+std::vector<std::string> FlatMapIO::getCostLayers() const
+{
+    return listSections(COSTS_PREFIX);
+}
+
+std::vector<std::string> FlatMapIO::getLabelGroups() const
+{
+    return listSections(LABELS_PREFIX);
+}
+
+std::vector<std::string> FlatMapIO::getAllLabelsOfGroup(std::string groupName) const
+{
+    return listSections(LABELS_PREFIX + groupName + "/");
+}
+
+MapSpan<uint32_t> FlatMapIO::getFaceIdsOfLabel(std::string groupName, std::string labelName) const
+{
+    return getSection<uint32_t>(LABELS_PREFIX + groupName + "/" + labelName, UInt32);
+}
+
+void writeFlatMap(HDF5MapIO& map, std::string filename)
+{
+    std::vector<float> vertices = map.getVertices();
+    std::vector<uint32_t> faceIds = map.getFaceIds();
+    std::vector<float> normals = map.getVertexNormals();
+    std::vector<uint8_t> colors = map.getVertexColors();
+    const size_t numVertices = vertices.size() / 3;
+
+    std::vector<SectionData> sections;
+    sections.push_back(section("vertices", FlatMapIO::Float32, 3, vertices));
+    sections.push_back(section("face_indices", FlatMapIO::UInt32, 3, faceIds));
+    if (normals.size() == numVertices * 3)
+    {
+        sections.push_back(section("vertex_normals", FlatMapIO::Float32, 3, normals));
+    }
+    if (colors.size() == numVertices * 3)
+    {
+        sections.push_back(section("vertex_colors", FlatMapIO::UInt8, 3, colors));
+    }
+
+    // all other vertex channels with one value per vertex are cost layers
+    std::vector<std::vector<float>> costs;
+    std::vector<std::string> costLayers;
+    for (const std::string& layer : map.getCostLayers())
+    {
+        if (layer == "vertices" || layer == "face_indices" || layer == "vertex_normals"
+            || layer == "vertex_colors" || layer == "texture_features")
+        {
+            continue;
+        }
+
+        std::vector<float> layerCosts = map.getVertexCosts(layer);
+        if (layerCosts.size() == numVertices)
+        {
+            costs.push_back(std::move(layerCosts));
+            costLayers.push_back(layer);
+        }
+    }
+    for (size_t i = 0; i < costs.size(); i++)
+    {
+        sections.push_back(section(COSTS_PREFIX + costLayers[i], FlatMapIO::Float32, 1, costs[i]));
+    }
+
+    std::vector<std::vector<uint32_t>> labels;
+    std::vector<std::string> labelNames;
+    for (const std::string& group : map.getLabelGroups())
+    {
+        for (const std::string& label : map.getAllLabelsOfGroup(group))
+        {
+            labels.push_back(map.getFaceIdsOfLabel(group, label));
+            labelNames.push_back(LABELS_PREFIX + group + "/" + label);
+        }
+    }
+    for (size_t i = 0; i < labels.size(); i++)
+    {
+        sections.push_back(section(labelNames[i], FlatMapIO::UInt32, 1, labels[i]));
+    }
+
+    // lay out the header, the table of contents and the sections
+    FlatMapHeader header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.numSections = sections.size();
+    header.tocOffset = align(sizeof(FlatMapHeader));
+
+    std::vector<FlatMapSection> toc(sections.size());
+    size_t offset = align(header.tocOffset + toc.size() * sizeof(FlatMapSection));
+    for (size_t i = 0; i < sections.size(); i++)
+    {
+        if (sections[i].name.size() >= sizeof(toc[i].name))
+          throw "The name of a section is too long for a flat map.";
+
+        std::memset(toc[i].name, 0, sizeof(toc[i].name));
+        std::memcpy(toc[i].name, sections[i].name.data(), sections[i].name.size());
+        toc[i].type = sections[i].type;
+        toc[i].width = sections[i].width;
+        toc[i].offset = offset;
+        toc[i].size = sections[i].size;
+        offset = align(offset + sections[i].size * valueSize(sections[i].type));
+    }
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file)
+      throw "Could not open file.";
+
+    // the gaps between the sections are filled with zeros
+    const char padding[ALIGNMENT] = {};
+    size_t position = 0;
+    auto writeAt = [&](size_t sectionOffset, const void* data, size_t bytes)
+    {
+        file.write(padding, sectionOffset - position);
+        file.write(static_cast<const char*>(data), bytes);
+        position = sectionOffset + bytes;
+    };
+
+    writeAt(0, &header, sizeof(header));
+    writeAt(header.tocOffset, toc.data(), toc.size() * sizeof(FlatMapSection));
+    for (size_t i = 0; i < sections.size(); i++)
+    {
+        writeAt(toc[i].offset, sections[i].data, sections[i].size * valueSize(sections[i].type));
+    }
+    writeAt(offset, nullptr, 0);
+
+    if (!file)
+      throw "Could not write file.";
+}
+
+void writeHDF5Map(const FlatMapIO& map, std::string filename)
+{
+    HDF5MapIO output(filename, map.getVertices().toVector(), map.getFaceIds().toVector());
+
+    std::vector<float> normals = map.getVertexNormals().toVector();
+    if (!normals.empty())
+    {
+        output.addVertexNormals(normals);
+    }
+
+    std::vector<uint8_t> colors = map.getVertexColors().toVector();
+    if (!colors.empty())
+    {
+        output.addVertexColors(colors);
+    }
+
+    for (const std::string& layer : map.getCostLayers())
+    {
+        output.writeVertexCosts(layer, map.getVertexCosts(layer).toVector());
+    }
+
+    for (const std::string& group : map.getLabelGroups())
+    {
+        for (const std::string& label : map.getAllLabelsOfGroup(group))
+        {
+            std::vector<uint32_t> faceIds = map.getFaceIdsOfLabel(group, label).toVector();
+            output.addLabel(group, label, faceIds);
+        }
+    }
+
+    output.flush();
+}
+
+} // namespace hdf5_map_io
@@ -1,12 +1,312 @@
 #include "hdf5_map_io/hdf5_map_io.h"
+#include <algorithm>
 #include <hdf5_hl.h>
 #include <unistd.h>
 
 namespace hdf5_map_io
 {
 
+namespace
+{
+
+// HighFive can not pass the SWMR read flag. The file is opened for SWMR reading with the C API first, opening it
+// again with HighFive then shares the open file including its access flags.
+hid_t openSwmrRead(const std::string& filename, HDF5MapIO::AccessMode mode)
+{
+    if (mode != HDF5MapIO::SwmrRead)
+    {
+        return -1;
+    }
+
+    hid_t fileId = H5Fopen(filename.c_str(), H5F_ACC_RDONLY | H5F_ACC_SWMR_READ, H5P_DEFAULT);
+    if (fileId < 0)
+      throw "Could not open file for SWMR reading. The map has to be created with SwmrWrite.";
+
+    return fileId;
+}
+
+unsigned openFlags(HDF5MapIO::AccessMode mode)
+{
+    return mode == HDF5MapIO::SwmrRead ? hf::File::ReadOnly : hf::File::ReadWrite;
+}
+
+// SWMR needs the HDF5 1.10 file format which HighFive does not select. In that case the file is created with the
+// C API and only opened by HighFive afterwards.
+unsigned createFile(const std::string& filename, HDF5MapIO::AccessMode mode)
+{
+    if (mode == HDF5MapIO::ReadWrite)
+    {
+        return hf::File::ReadWrite | hf::File::Create | hf::File::Truncate;
+    }
+
+    if (mode == HDF5MapIO::SwmrRead)
+      throw "Can not create a file for SWMR reading.";
+
+    hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+    H5Pset_libver_bounds(fapl, H5F_LIBVER_LATEST, H5F_LIBVER_LATEST);
+    hid_t fileId = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, fapl);
+    H5Pclose(fapl);
+
+    if (fileId < 0)
+      throw "Could not create file.";
+
+    H5Fclose(fileId);
+    return hf::File::ReadWrite;
+}
+
+// number of rows per chunk of the extensible data sets
+constexpr hsize_t CHUNK_ROWS = 4096;
+
+// Creates a chunked data set with an unlimited first dimension, storing rows of the given width. Single valued
+// channels, i.e. cost layers, are one dimensional.
+hf::DataSet createExtensibleDataSet(
+    const hf::Group& group,
+    const std::string& name,
+    hid_t type,
+    const void* data,
+    hsize_t rows,
+    hsize_t width
+)
+{
+    const int rank = width == 1 ? 1 : 2;
+    hsize_t dims[2] = {rows, width};
+    hsize_t maxDims[2] = {H5S_UNLIMITED, width};
+    hsize_t chunk[2] = {CHUNK_ROWS, width};
+
+    hid_t space = H5Screate_simple(rank, dims, maxDims);
+    hid_t props = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(props, rank, chunk);
+    hid_t dataset = H5Dcreate2(group.getId(), name.c_str(), type, space, H5P_DEFAULT, props, H5P_DEFAULT);
+    H5Pclose(props);
+    H5Sclose(space);
+
+    if (dataset < 0)
+      throw "Could not create data set.";
+
+    herr_t status = rows > 0 ? H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, data) : 0;
+    H5Dclose(dataset);
+
+    if (status < 0)
+      throw "Could not write data set.";
+
+    return group.getDataSet(name);
+}
+
+template <typename T>
+hf::DataSet createExtensibleDataSet(
+    const hf::Group& group,
+    const std::string& name,
+    const std::vector<T>& values,
+    hsize_t width
+)
+{
+    return createExtensibleDataSet(
+        group, name, hf::AtomicType<T>().getId(), values.data(), values.size() / width, width
+    );
+}
+
+// returns the number of rows and the width of a one or two dimensional data set
+std::pair<hsize_t, hsize_t> getShape(hid_t dataset)
+{
+    hid_t space = H5Dget_space(dataset);
+    hsize_t dims[2] = {0, 1};
+    int rank = H5Sget_simple_extent_ndims(space);
+    if (rank > 0 && rank <= 2)
+    {
+        H5Sget_simple_extent_dims(space, dims, nullptr);
+    }
+    H5Sclose(space);
+
+    return std::make_pair(dims[0], dims[1]);
+}
+
+bool isExtensible(hid_t dataset)
+{
+    hid_t props = H5Dget_create_plist(dataset);
+    bool chunked = H5Pget_layout(props) == H5D_CHUNKED;
+    H5Pclose(props);
+
+    hid_t space = H5Dget_space(dataset);
+    hsize_t maxDims[2] = {0, 0};
+    int rank = H5Sget_simple_extent_ndims(space);
+    if (rank > 0 && rank <= 2)
+    {
+        H5Sget_simple_extent_dims(space, nullptr, maxDims);
+    }
+    H5Sclose(space);
+
+    return chunked && maxDims[0] == H5S_UNLIMITED;
+}
+
+// Converts a contiguous data set into an extensible one. HDF5 can not change the layout of a data set, so it is
+// read, unlinked and written again.
+void makeExtensible(const hf::Group& group, const std::string& name)
+{
+    auto dataset = group.getDataSet(name);
+    if (isExtensible(dataset.getId()))
+    {
+        return;
+    }
+
+    auto shape = getShape(dataset.getId());
+    hid_t fileType = H5Dget_type(dataset.getId());
+    hid_t type = H5Tget_native_type(fileType, H5T_DIR_ASCEND);
+    H5Tclose(fileType);
+
+    std::vector<uint8_t> buffer(shape.first * shape.second * H5Tget_size(type));
+    H5Dread(dataset.getId(), type, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer.data());
+    H5Ldelete(group.getId(), name.c_str(), H5P_DEFAULT);
+
+    createExtensibleDataSet(group, name, type, buffer.data(), shape.first, shape.second);
+    H5Tclose(type);
+}
+
+// writes whole rows of a one or two dimensional data set, starting at the given row
+void writeRows(hid_t dataset, hid_t type, const void* data, hsize_t firstRow, hsize_t rows, hsize_t width)
+{
+    if (rows == 0)
+    {
+        return;
+    }
+
+    const int rank = width == 1 ? 1 : 2;
+    hsize_t offset[2] = {firstRow, 0};
+    hsize_t count[2] = {rows, width};
+
+    hid_t fileSpace = H5Dget_space(dataset);
+    if (H5Sget_simple_extent_ndims(fileSpace) == 2)
+    {
+        // single valued channels of other tools have a second dimension of one
+        H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, offset, nullptr, count, nullptr);
+    }
+    else
+    {
+        hsize_t flatOffset = firstRow * width;
+        hsize_t flatCount = rows * width;
+        H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, &flatOffset, nullptr, &flatCount, nullptr);
+    }
+    hid_t memSpace = H5Screate_simple(rank, count, nullptr);
+    herr_t status = H5Dwrite(dataset, type, memSpace, fileSpace, H5P_DEFAULT, data);
+    H5Sclose(memSpace);
+    H5Sclose(fileSpace);
+
+    if (status < 0)
+      throw "Could not write to data set.";
+}
+
+// writes the values behind the last row of an extensible data set
+void appendToDataSet(const hf::Group& group, const std::string& name, hid_t type, const void* data, size_t size)
+{
+    auto dataset = group.getDataSet(name);
+    hid_t id = dataset.getId();
+    auto shape = getShape(id);
+
+    hsize_t rows = size / shape.second;
+    hsize_t dims[2] = {shape.first + rows, shape.second};
+
+    if (H5Dset_extent(id, dims) < 0)
+      throw "Could not extend data set.";
+
+    writeRows(id, type, data, shape.first, rows, shape.second);
+}
+
+// tells data sets apart from groups like the texture features
+bool isDataSet(const hf::Group& group, const std::string& name)
+{
+    hid_t object = H5Oopen(group.getId(), name.c_str(), H5P_DEFAULT);
+    const bool isDataSet = H5Iget_type(object) == H5I_DATASET;
+    H5Oclose(object);
+    return isDataSet;
+}
+
+// reads all values of a data set, converted to the given type
+template <typename T>
+std::vector<T> readAll(hid_t dataset, hid_t type)
+{
+    auto shape = getShape(dataset);
+    std::vector<T> values(shape.first * shape.second);
+    if (!values.empty() && H5Dread(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, values.data()) < 0)
+      throw "Could not read data set.";
+
+    return values;
+}
+
+// reads the given rows of a one or two dimensional data set with a point selection, so only their chunks are read
+template <typename T>
+std::vector<T> readRows(hid_t dataset, hid_t type, const std::vector<uint32_t>& rows, hsize_t width)
+{
+    std::vector<T> values(rows.size() * width);
+    if (values.empty())
+    {
+        return values;
+    }
+
+    hid_t fileSpace = H5Dget_space(dataset);
+    const int rank = H5Sget_simple_extent_ndims(fileSpace);
+    const hsize_t numRows = H5Sget_simple_extent_npoints(fileSpace) / width;
+
+    std::vector<hsize_t> coordinates(values.size() * rank);
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        if (rows[i] >= numRows)
+        {
+            H5Sclose(fileSpace);
+            throw "The requested vertices exceed the channel.";
+        }
+
+        for (hsize_t column = 0; column < width; column++)
+        {
+            const size_t point = i * width + column;
+            if (rank == 2)
+            {
+                coordinates[point * 2] = rows[i];
+                coordinates[point * 2 + 1] = column;
+            }
+            else
+            {
+                // legacy channels store all values of a vertex one after the other
+                coordinates[point] = rows[i] * width + column;
+            }
+        }
+    }
+
+    H5Sselect_elements(fileSpace, H5S_SELECT_SET, values.size(), coordinates.data());
+    hsize_t count = values.size();
+    hid_t memSpace = H5Screate_simple(1, &count, nullptr);
+    herr_t status = H5Dread(dataset, type, memSpace, fileSpace, H5P_DEFAULT, values.data());
+    H5Sclose(memSpace);
+    H5Sclose(fileSpace);
+
+    if (status < 0)
+      throw "Could not read data set.";
+
+    return values;
+}
+
+// a per vertex channel of a patch
+struct PatchChannel
+{
+    std::string name;
+    hid_t type;
+    const void* data;
+    size_t size;
+    hsize_t width;
+};
+
+} // namespace
+
 void HDF5MapIO::creatOrGetGroups()
 {
+  if (m_mode == SwmrRead)
+  {
+    // the file is read only, all groups have been created by the writer
+    m_channelsGroup = m_file.getGroup(CHANNELS_GROUP);
+    m_clusterSetsGroup = m_file.getGroup(CLUSTERSETS_GROUP);
+    m_texturesGroup = m_file.getGroup(TEXTURES_GROUP);
+    m_labelsGroup = m_file.getGroup(LABELS_GROUP);
+    return;
+  }
+
   if (!m_file.exist(CHANNELS_GROUP))
     m_channelsGroup = m_file.createGroup(CHANNELS_GROUP);
   else
@@ -28,8 +328,33 @@ void HDF5MapIO::creatOrGetGroups()
     m_labelsGroup = m_file.getGroup(LABELS_GROUP);
 }
 
-HDF5MapIO::HDF5MapIO(std::string filename)
-    : m_file(filename, hf::File::ReadWrite)
+void HDF5MapIO::startSwmrWrite()
+{
+    if (m_mode != SwmrWrite)
+      throw "SWMR writing can only be started for maps opened with SwmrWrite.";
+    if (m_swmrWriting)
+      return;
+
+    // make everything written so far visible to the readers before they can attach
+    m_file.flush();
+
+    if (H5Fstart_swmr_write(m_file.getId()) < 0)
+      throw "Could not start SWMR writing. The map has to be created with SwmrWrite.";
+
+    m_swmrWriting = true;
+}
+
+void HDF5MapIO::checkStructureChangeable()
+{
+    if (m_swmrWriting)
+      throw "Data sets, groups and attributes can not be added or removed while SWMR readers may be attached.";
+}
+
+HDF5MapIO::HDF5MapIO(std::string filename, AccessMode mode)
+    : m_mode(mode)
+    , m_swmrWriting(false)
+    , m_swmrFileId(openSwmrRead(filename, mode))
+    , m_file(filename, openFlags(mode))
 {
   creatOrGetGroups();
 }
@@ -37,9 +362,13 @@ HDF5MapIO::HDF5MapIO(std::string filename)
 HDF5MapIO::HDF5MapIO(
     std::string filename,
     const std::vector<float>& vertices,
-    const std::vector<uint32_t>& face_ids
+    const std::vector<uint32_t>& face_ids,
+    AccessMode mode
 )
-    : m_file(filename, hf::File::ReadWrite | hf::File::Create | hf::File::Truncate)
+    : m_mode(mode)
+    , m_swmrWriting(false)
+    , m_swmrFileId(-1)
+    , m_file(filename, createFile(filename, mode))
 {
 
     if (!m_file.isValid())
@@ -48,12 +377,8 @@ HDF5MapIO::HDF5MapIO(
     creatOrGetGroups();
 
     // Create geometry data sets
-    m_channelsGroup
-        .createDataSet<float>("vertices", hf::DataSpace::From(vertices))
-        .write(vertices);
-    m_channelsGroup
-        .createDataSet<uint32_t>("face_indices", hf::DataSpace::From(face_ids))
-        .write(face_ids);
+    createExtensibleDataSet(m_channelsGroup, "vertices", vertices, 3);
+    createExtensibleDataSet(m_channelsGroup, "face_indices", face_ids, 3);
 }
 
 HDF5MapIO::~HDF5MapIO()
@@ -69,12 +394,44 @@ HDF5MapIO::~HDF5MapIO()
     H5Gclose(m_texturesGroup.getId());
     H5Gclose(m_labelsGroup.getId());
     H5Fclose(m_file.getId());
+
+    if (m_swmrFileId >= 0)
+    {
+        H5Fclose(m_swmrFileId);
+    }
+}
+
+hf::DataSet HDF5MapIO::getDataSet(const hf::Group& group, const std::string& name)
+{
+    auto dataset = group.getDataSet(name);
+    if (m_mode == SwmrRead)
+    {
+        // the metadata cache of a reader is not updated by the writer
+        H5Drefresh(dataset.getId());
+    }
+    return dataset;
 }
 
 size_t HDF5MapIO::getSize(hf::DataSet& data_set)
 {
-  auto dimensions = data_set.getSpace().getDimensions();
-  return dimensions[0] * dimensions[1];
+  // maps written by this class and by other tools differ in the rank of the data sets
+  return data_set.getSpace().getElementCount();
+}
+
+size_t HDF5MapIO::getNumVertices()
+{
+    if (!m_channelsGroup.exist("vertices"))
+        return 0;
+    auto dataset = getDataSet(m_channelsGroup, "vertices");
+    return getSize(dataset) / 3;
+}
+
+size_t HDF5MapIO::getNumFaces()
+{
+    if (!m_channelsGroup.exist("face_indices"))
+        return 0;
+    auto dataset = getDataSet(m_channelsGroup, "face_indices");
+    return getSize(dataset) / 3;
 }
 
 std::vector<float> HDF5MapIO::getVertices()
@@ -82,7 +439,7 @@ std::vector<float> HDF5MapIO::getVertices()
     std::vector<float> vertices;
     if (!m_channelsGroup.exist("vertices"))
         return vertices;
-    auto dataset = m_channelsGroup.getDataSet("vertices");
+    auto dataset = getDataSet(m_channelsGroup, "vertices");
     vertices.resize(getSize(dataset));
     dataset.read(vertices.data());
     return vertices;
@@ -93,7 +450,7 @@ std::vector<uint32_t> HDF5MapIO::getFaceIds()
     std::vector<uint32_t> indices;
     if (!m_channelsGroup.exist("face_indices"))
         return indices;
-    auto dataset = m_channelsGroup.getDataSet("face_indices");
+    auto dataset = getDataSet(m_channelsGroup, "face_indices");
     indices.resize(getSize(dataset));
     dataset.read(indices.data());
     return indices;
@@ -104,7 +461,7 @@ std::vector<float> HDF5MapIO::getVertexNormals()
     std::vector<float> normals;
     if (!m_channelsGroup.exist("vertex_normals"))
         return normals;
-    auto dataset = m_channelsGroup.getDataSet("vertex_normals");
+    auto dataset = getDataSet(m_channelsGroup, "vertex_normals");
     normals.resize(getSize(dataset));
     dataset.read(normals.data());
     return normals;
@@ -116,12 +473,28 @@ std::vector<uint8_t> HDF5MapIO::getVertexColors()
     if (!m_channelsGroup.exist("vertex_colors"))
         return colors;
 
-    auto dataset = m_channelsGroup.getDataSet("vertex_colors");
+    auto dataset = getDataSet(m_channelsGroup, "vertex_colors");
     colors.resize(getSize(dataset));
     dataset.read(colors.data());
     return colors;
 }
 
+std::vector<float> HDF5MapIO::getVertexNormals(const std::vector<uint32_t>& vertexIds)
+{
+    if (!m_channelsGroup.exist("vertex_normals"))
+        return std::vector<float>();
+
+    return readRows<float>(getDataSet(m_channelsGroup, "vertex_normals").getId(), H5T_NATIVE_FLOAT, vertexIds, 3);
+}
+
+std::vector<uint8_t> HDF5MapIO::getVertexColors(const std::vector<uint32_t>& vertexIds)
+{
+    if (!m_channelsGroup.exist("vertex_colors"))
+        return std::vector<uint8_t>();
+
+    return readRows<uint8_t>(getDataSet(m_channelsGroup, "vertex_colors").getId(), H5T_NATIVE_UINT8, vertexIds, 3);
+}
+
 std::vector<MapImage> HDF5MapIO::getTextures()
 {
     std::vector<MapImage> textures;
@@ -183,7 +556,7 @@ std::vector<MapMaterial> HDF5MapIO::getMaterials()
         return materials;
     }
 
-    m_texturesGroup.getDataSet("materials")
+    getDataSet(m_texturesGroup, "materials")
         .read(materials);
 
     return materials;
@@ -198,7 +571,7 @@ std::vector<uint32_t> HDF5MapIO::getMaterialFaceIndices()
         return matFaceIndices;
     }
 
-    m_texturesGroup.getDataSet("mat_face_indices")
+    getDataSet(m_texturesGroup, "mat_face_indices")
         .read(matFaceIndices);
 
     return matFaceIndices;
@@ -213,7 +586,7 @@ std::vector<float> HDF5MapIO::getVertexTextureCoords()
         return coords;
     }
 
-    m_texturesGroup.getDataSet("coords")
+    getDataSet(m_texturesGroup, "coords")
         .read(coords);
 
     return coords;
@@ -250,7 +623,7 @@ std::vector<uint32_t> HDF5MapIO::getFaceIdsOfLabel(std::string groupName, std::s
         return faceIds;
     }
 
-    lg.getDataSet(labelName).read(faceIds);
+    getDataSet(lg, labelName).read(faceIds);
 
     return faceIds;
 }
@@ -274,15 +647,132 @@ std::vector<float> HDF5MapIO::getVertexCosts(std::string costlayer)
         return costs;
     }
 
-    m_channelsGroup.getDataSet(costlayer)
+    getDataSet(m_channelsGroup, costlayer)
         .read(costs);
 
     return costs;
 }
 
+std::vector<float> HDF5MapIO::getVertexCosts(std::string costlayer, const std::vector<uint32_t>& vertexIds)
+{
+    if (!m_channelsGroup.exist(costlayer))
+    {
+        return std::vector<float>();
+    }
+
+    return readRows<float>(getDataSet(m_channelsGroup, costlayer).getId(), H5T_NATIVE_FLOAT, vertexIds, 1);
+}
+
 std::vector<std::string> HDF5MapIO::getCostLayers()
 {
-    return m_channelsGroup.listObjectNames();
+    // groups like the texture features and the adjacency are never cost layers
+    std::vector<std::string> layers = m_channelsGroup.listObjectNames();
+    layers.erase(std::remove_if(layers.begin(), layers.end(), [this](const std::string& name)
+    {
+        return !isDataSet(m_channelsGroup, name);
+    }), layers.end());
+
+    return layers;
+}
+
+std::vector<MapLodLevel> HDF5MapIO::getLodLevels()
+{
+    std::vector<MapLodLevel> levels;
+    if (!m_file.exist(LOD_GROUP))
+    {
+        return levels;
+    }
+
+    auto lodGroup = m_file.getGroup(LOD_GROUP);
+    for (auto name : lodGroup.listObjectNames())
+    {
+        auto dataset = getDataSet(lodGroup, name);
+
+        MapLodLevel lod;
+        lod.level = std::stoul(name);
+        lod.numFaces = dataset.getSpace().getElementCount() / 3;
+        dataset.getAttribute("mesh_faces").read(lod.meshFaces);
+        dataset.getAttribute("error").read(lod.error);
+        levels.push_back(lod);
+    }
+
+    std::sort(levels.begin(), levels.end(), [](const MapLodLevel& a, const MapLodLevel& b)
+    {
+        return a.level < b.level;
+    });
+
+    return levels;
+}
+
+std::vector<uint32_t> HDF5MapIO::getLodFaceIds(uint32_t level)
+{
+    std::vector<uint32_t> faceIds;
+    const std::string& name = std::to_string(level);
+
+    if (!m_file.exist(LOD_GROUP) || !m_file.getGroup(LOD_GROUP).exist(name))
+    {
+        return faceIds;
+    }
+
+    getDataSet(m_file.getGroup(LOD_GROUP), name).read(faceIds);
+
+    return faceIds;
+}
+
+MeshAdjacency HDF5MapIO::getVertexAdjacency()
+{
+    return getAdjacency("vertex", getNumVertices());
+}
+
+MeshAdjacency HDF5MapIO::getFaceAdjacency()
+{
+    return getAdjacency("face", getNumFaces());
+}
+
+MeshAdjacency HDF5MapIO::getAdjacency(const std::string& name, size_t size)
+{
+    const std::string offsetsName = name + "_offsets";
+    const std::string neighborsName = name + "_neighbors";
+    if (!m_file.exist(ADJACENCY_GROUP))
+    {
+        return MeshAdjacency();
+    }
+
+    auto group = m_file.getGroup(ADJACENCY_GROUP);
+    if (!group.exist(offsetsName) || !group.exist(neighborsName))
+    {
+        return MeshAdjacency();
+    }
+
+    // an adjacency built before the mesh has been changed, e.g. by appendPatch, is outdated
+    auto offsetsDataSet = getDataSet(group, offsetsName);
+    uint32_t meshVertices = 0;
+    uint32_t meshFaces = 0;
+    offsetsDataSet.getAttribute("mesh_vertices").read(meshVertices);
+    offsetsDataSet.getAttribute("mesh_faces").read(meshFaces);
+    if (meshVertices != getNumVertices() || meshFaces != getNumFaces())
+    {
+        return MeshAdjacency();
+    }
+
+    std::vector<uint64_t> offsets = readAll<uint64_t>(offsetsDataSet.getId(), H5T_NATIVE_UINT64);
+    std::vector<uint32_t> neighbors = readAll<uint32_t>(getDataSet(group, neighborsName).getId(), H5T_NATIVE_UINT32);
+
+    // neighbors are used as indices without further checks, so a damaged adjacency must not be returned
+    bool valid = offsets.size() == size + 1 && offsets.front() == 0 && offsets.back() == neighbors.size();
+    for (size_t i = 0; valid && i < size; i++)
+    {
+        valid = offsets[i] <= offsets[i + 1];
+    }
+    valid = valid && std::all_of(neighbors.begin(), neighbors.end(), [size](uint32_t neighbor)
+    {
+        return neighbor < size;
+    });
+
+    if (!valid)
+      throw "The stored adjacency is damaged.";
+
+    return MeshAdjacency(std::move(offsets), std::move(neighbors));
 }
 
 MapImage HDF5MapIO::getImage(hf::Group group, std::string name)
@@ -318,23 +808,23 @@ MapImage HDF5MapIO::getImage(hf::Group group, std::string name)
 
 hf::DataSet HDF5MapIO::addVertexNormals(std::vector<float>& normals)
 {
-    // TODO make more versatile to add and/or overwrite normals in file
-    auto dataSet = m_channelsGroup.createDataSet<float>("vertex_normals", hf::DataSpace::From(normals));
-    dataSet.write(normals);
+    checkStructureChangeable();
 
-    return dataSet;
+    // TODO make more versatile to add and/or overwrite normals in file
+    return createExtensibleDataSet(m_channelsGroup, "vertex_normals", normals, 3);
 }
 
 hf::DataSet HDF5MapIO::addVertexColors(std::vector<uint8_t>& colors)
 {
-    auto dataSet = m_channelsGroup.createDataSet<uint8_t>("vertex_colors", hf::DataSpace::From(colors));
-    dataSet.write(colors);
+    checkStructureChangeable();
 
-    return dataSet;
+    return createExtensibleDataSet(m_channelsGroup, "vertex_colors", colors, 3);
 }
 
 void HDF5MapIO::addTexture(int index, uint32_t width, uint32_t height, uint8_t *data)
 {
+    checkStructureChangeable();
+
     if (!m_texturesGroup.exist("images"))
     {
         m_texturesGroup.createGroup("images");
@@ -353,6 +843,8 @@ void HDF5MapIO::addTexture(int index, uint32_t width, uint32_t height, uint8_t *
 
 void HDF5MapIO::addMaterials(std::vector<MapMaterial>& materials, std::vector<uint32_t>& matFaceIndices)
 {
+    checkStructureChangeable();
+
     m_texturesGroup
         .createDataSet<MapMaterial>("materials", hf::DataSpace::From(materials))
         .write(materials);
@@ -364,6 +856,8 @@ void HDF5MapIO::addMaterials(std::vector<MapMaterial>& materials, std::vector<ui
 
 void HDF5MapIO::addVertexTextureCoords(std::vector<float>& coords)
 {
+    checkStructureChangeable();
+
     m_texturesGroup
         .createDataSet<float>("coords", hf::DataSpace::From(coords))
         .write(coords);
@@ -374,6 +868,7 @@ void HDF5MapIO::addOrUpdateLabel(std::string groupName, std::string labelName, s
     std::cout << "Add or update label" << std::endl;
     if (!m_labelsGroup.exist(groupName))
     {
+        checkStructureChangeable();
         m_labelsGroup.createGroup(groupName);
     }
 
@@ -387,6 +882,7 @@ void HDF5MapIO::addOrUpdateLabel(std::string groupName, std::string labelName, s
     else
     {
       std::cout << "write to new label" << std::endl;
+      checkStructureChangeable();
       auto dataset = group.createDataSet<uint32_t>(labelName, hf::DataSpace::From(faceIds));
       dataset.write(faceIds);
     }
@@ -394,6 +890,8 @@ void HDF5MapIO::addOrUpdateLabel(std::string groupName, std::string labelName, s
 
 void HDF5MapIO::addLabel(std::string groupName, std::string labelName, std::vector<uint32_t>& faceIds)
 {
+    checkStructureChangeable();
+
     if (!m_labelsGroup.exist(groupName))
     {
         m_labelsGroup.createGroup(groupName);
@@ -406,6 +904,8 @@ void HDF5MapIO::addLabel(std::string groupName, std::string labelName, std::vect
 
 void HDF5MapIO::addTextureKeypointsMap(std::unordered_map<MapVertex, std::vector<float>>& keypoints_map)
 {
+    checkStructureChangeable();
+
     if (!m_channelsGroup.exist("texture_features"))
     {
         m_channelsGroup.createGroup("texture_features");
@@ -429,24 +929,351 @@ void HDF5MapIO::addTextureKeypointsMap(std::unordered_map<MapVertex, std::vector
 
 void HDF5MapIO::addRoughness(std::vector<float>& roughness)
 {
-    m_channelsGroup.createDataSet<float>("roughness", hf::DataSpace::From(roughness))
-        .write(roughness);
+    writeVertexCosts("roughness", roughness);
 }
 
 void HDF5MapIO::addHeightDifference(std::vector<float>& diff)
 {
-    m_channelsGroup.createDataSet<float>("height_diff", hf::DataSpace::From(diff))
-        .write(diff);
+    writeVertexCosts("height_diff", diff);
+}
+
+void HDF5MapIO::addVertexCosts(std::string costlayer, std::vector<float>& costs)
+{
+    writeVertexCosts(costlayer, costs);
+}
+
+bool HDF5MapIO::canWriteVertexCosts(const std::string& costlayer)
+{
+    if (costlayer.empty() || costlayer == "vertices" || costlayer == "face_indices"
+        || costlayer == "vertex_normals" || costlayer == "vertex_colors")
+    {
+        return false;
+    }
+
+    if (!m_channelsGroup.exist(costlayer))
+    {
+        return true;
+    }
+
+    if (!isDataSet(m_channelsGroup, costlayer))
+    {
+        return false;
+    }
+
+    auto dataset = m_channelsGroup.getDataSet(costlayer);
+    hid_t space = H5Dget_space(dataset.getId());
+    const bool flat = H5Sget_simple_extent_ndims(space) == 1;
+    H5Sclose(space);
+
+    hid_t type = H5Dget_type(dataset.getId());
+    const bool isFloat = H5Tequal(type, H5T_NATIVE_FLOAT) > 0;
+    H5Tclose(type);
+
+    return flat && isFloat;
+}
+
+void HDF5MapIO::writeVertexCosts(std::string costlayer, const std::vector<float>& costs)
+{
+    if (m_channelsGroup.exist(costlayer))
+    {
+        auto dataset = getDataSet(m_channelsGroup, costlayer);
+        if (getSize(dataset) == costs.size())
+        {
+            writeRows(dataset.getId(), H5T_NATIVE_FLOAT, costs.data(), 0, costs.size(), 1);
+            return;
+        }
+
+        checkStructureChangeable();
+
+        // the space of the old layer is not freed, see removeAllLabels
+        H5Ldelete(m_channelsGroup.getId(), costlayer.c_str(), H5P_DEFAULT);
+    }
+    else
+    {
+        checkStructureChangeable();
+    }
+
+    createExtensibleDataSet(m_channelsGroup, costlayer, costs, 1);
+}
+
+void HDF5MapIO::updateVertexCosts(std::string costlayer, size_t firstVertex, const std::vector<float>& costs)
+{
+    if (!m_channelsGroup.exist(costlayer))
+      throw "The cost layer to update does not exist.";
+
+    auto dataset = getDataSet(m_channelsGroup, costlayer);
+    if (firstVertex + costs.size() > getSize(dataset))
+      throw "The updated costs exceed the cost layer.";
+
+    writeRows(dataset.getId(), H5T_NATIVE_FLOAT, costs.data(), firstVertex, costs.size(), 1);
+}
+
+void HDF5MapIO::updateVertexCosts(
+    std::string costlayer,
+    const std::vector<uint32_t>& vertexIds,
+    const std::vector<float>& costs
+)
+{
+    if (vertexIds.size() != costs.size())
+      throw "The number of vertex ids and costs of the update differ.";
+
+    if (!m_channelsGroup.exist(costlayer))
+      throw "The cost layer to update does not exist.";
+
+    auto dataset = getDataSet(m_channelsGroup, costlayer);
+    const size_t numCosts = getSize(dataset);
+
+    // sort the updates by vertex, so that neighboring vertices are written as one hyperslab
+    std::vector<size_t> order(vertexIds.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+    {
+        return vertexIds[a] < vertexIds[b];
+    });
+
+    std::vector<float> run;
+    size_t runStart = 0;
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        const uint32_t vertex = vertexIds[order[i]];
+        if (vertex >= numCosts)
+          throw "The updated costs exceed the cost layer.";
+
+        if (!run.empty() && vertex == runStart + run.size() - 1)
+        {
+            // the same vertex is updated more than once, the last update wins
+            run.back() = costs[order[i]];
+            continue;
+        }
+
+        if (!run.empty() && vertex != runStart + run.size())
+        {
+            writeRows(dataset.getId(), H5T_NATIVE_FLOAT, run.data(), runStart, run.size(), 1);
+            run.clear();
+        }
+
+        if (run.empty())
+        {
+            runStart = vertex;
+        }
+        run.push_back(costs[order[i]]);
+    }
+
+    writeRows(dataset.getId(), H5T_NATIVE_FLOAT, run.data(), runStart, run.size(), 1);
+}
+
+size_t HDF5MapIO::appendPatch(const MapPatch& patch)
+{
+    const size_t numVertices = getNumVertices();
+    const size_t patchVertices = patch.vertices.size() / 3;
+
+    if (patch.vertices.size() % 3 != 0 || patch.faceIds.size() % 3 != 0)
+      throw "The patch contains incomplete vertices or faces.";
+
+    for (uint32_t id : patch.faceIds)
+    {
+        if (id >= numVertices + patchVertices)
+          throw "A face of the patch references a vertex which does not exist.";
+    }
+
+    // texture coordinates and the materials of the faces would no longer match the mesh
+    if ((patchVertices > 0 || !patch.faceIds.empty())
+        && (m_texturesGroup.exist("coords") || m_texturesGroup.exist("mat_face_indices")))
+      throw "Patches can not be appended to a map with texture coordinates or materials.";
+
+    std::vector<PatchChannel> channels;
+    if (!patch.normals.empty())
+    {
+        channels.push_back({"vertex_normals", H5T_NATIVE_FLOAT, patch.normals.data(), patch.normals.size(), 3});
+    }
+    if (!patch.colors.empty())
+    {
+        channels.push_back({"vertex_colors", H5T_NATIVE_UCHAR, patch.colors.data(), patch.colors.size(), 3});
+    }
+    for (const auto& layer : patch.costs)
+    {
+        channels.push_back({layer.first, H5T_NATIVE_FLOAT, layer.second.data(), layer.second.size(), 1});
+    }
+
+    // check everything before writing, a failed append must not leave channels of different sizes behind
+    for (const auto& channel : channels)
+    {
+        if (channel.size != patchVertices * channel.width)
+          throw "A channel of the patch does not have a value for each vertex.";
+
+        if (!m_channelsGroup.exist(channel.name))
+        {
+            if (numVertices > 0)
+              throw "A channel of the patch does not exist in the map, it can only be added to an empty map.";
+            checkStructureChangeable();
+        }
+        else
+        {
+            auto dataset = m_channelsGroup.getDataSet(channel.name);
+            if (getSize(dataset) != numVertices * channel.width)
+              throw "A channel of the patch does not match the vertices of the map.";
+        }
+    }
+
+    // converting data sets of other tools replaces them, which is not possible while readers may be attached
+    if (m_swmrWriting)
+    {
+        std::vector<std::string> names = {"vertices", "face_indices"};
+        for (const auto& channel : channels)
+        {
+            names.push_back(channel.name);
+        }
+        for (const auto& name : names)
+        {
+            if (!m_channelsGroup.exist(name) || !isExtensible(m_channelsGroup.getDataSet(name).getId()))
+              throw "The map can only be extended while SWMR writing if it has been created by HDF5MapIO.";
+        }
+    }
+
+    for (const auto& name : m_channelsGroup.listObjectNames())
+    {
+        if (name == "vertices" || name == "face_indices")
+        {
+            continue;
+        }
+
+        // skip groups like the texture features
+        if (!isDataSet(m_channelsGroup, name))
+        {
+            continue;
+        }
+
+        // per vertex channels have one row per vertex, legacy maps store them flat, e.g. vertex_normals as 3n floats
+        auto dataset = m_channelsGroup.getDataSet(name);
+        const size_t size = getSize(dataset);
+        const bool perVertex = size == numVertices * 3 || size == numVertices;
+        const bool given = std::any_of(channels.begin(), channels.end(), [&](const PatchChannel& channel)
+        {
+            return channel.name == name;
+        });
+
+        if (perVertex && !given && patchVertices > 0)
+          throw "The patch misses a per vertex channel of the map.";
+    }
+
+    // the channels are written before the vertices and the faces last, so that SWMR readers never see faces
+    // referencing vertices which are not in the file yet
+    channels.push_back({"vertices", H5T_NATIVE_FLOAT, patch.vertices.data(), patch.vertices.size(), 3});
+    channels.push_back({"face_indices", H5T_NATIVE_UINT32, patch.faceIds.data(), patch.faceIds.size(), 3});
+    for (const auto& channel : channels)
+    {
+        if (m_channelsGroup.exist(channel.name))
+        {
+            makeExtensible(m_channelsGroup, channel.name);
+            appendToDataSet(m_channelsGroup, channel.name, channel.type, channel.data, channel.size);
+        }
+        else
+        {
+            createExtensibleDataSet(
+                m_channelsGroup, channel.name, channel.type, channel.data, channel.size / channel.width, channel.width
+            );
+        }
+    }
+
+    return numVertices;
+}
+
+void HDF5MapIO::addLodLevel(uint32_t level, std::vector<uint32_t>& faceIds, float error)
+{
+    checkStructureChangeable();
+
+    if (!m_file.exist(LOD_GROUP))
+    {
+        m_file.createGroup(LOD_GROUP);
+    }
+
+    auto dataset = m_file.getGroup(LOD_GROUP)
+        .createDataSet<uint32_t>(std::to_string(level), hf::DataSpace::From(faceIds));
+    dataset.write(faceIds);
+
+    uint32_t meshFaces = m_channelsGroup.getDataSet("face_indices").getSpace().getElementCount() / 3;
+    dataset.createAttribute<uint32_t>("mesh_faces", hf::DataSpace::From(meshFaces))
+        .write(meshFaces);
+    dataset.createAttribute<float>("error", hf::DataSpace::From(error))
+        .write(error);
+}
+
+bool HDF5MapIO::removeLodLevels()
+{
+    checkStructureChangeable();
+
+    if (!m_file.exist(LOD_GROUP))
+    {
+        return true;
+    }
+
+    return H5Ldelete(m_file.getId(), LOD_GROUP, H5P_DEFAULT) >= 0;
+}
+
+void HDF5MapIO::addVertexAdjacency(const MeshAdjacency& adjacency)
+{
+    addAdjacency("vertex", adjacency, getNumVertices());
+}
+
+void HDF5MapIO::addFaceAdjacency(const MeshAdjacency& adjacency)
+{
+    addAdjacency("face", adjacency, getNumFaces());
+}
+
+void HDF5MapIO::addAdjacency(const std::string& name, const MeshAdjacency& adjacency, size_t size)
+{
+    checkStructureChangeable();
+
+    if (adjacency.size() != size)
+      throw "The adjacency does not match the mesh.";
+
+    if (!m_file.exist(ADJACENCY_GROUP))
+    {
+        m_file.createGroup(ADJACENCY_GROUP);
+    }
+
+    auto group = m_file.getGroup(ADJACENCY_GROUP);
+    const std::string offsetsName = name + "_offsets";
+    const std::string neighborsName = name + "_neighbors";
+    for (const std::string& dataSetName : {offsetsName, neighborsName})
+    {
+        if (group.exist(dataSetName))
+        {
+            // the space of the old adjacency is not freed, see removeAllLabels
+            H5Ldelete(group.getId(), dataSetName.c_str(), H5P_DEFAULT);
+        }
+    }
+
+    // the neighbors are written first, so the offsets only exist along with complete neighbors
+    const auto& neighbors = adjacency.getNeighbors();
+    createExtensibleDataSet(group, neighborsName, H5T_NATIVE_UINT32, neighbors.data(), neighbors.size(), 1);
+
+    const auto& offsets = adjacency.getOffsets();
+    auto dataset = createExtensibleDataSet(group, offsetsName, H5T_NATIVE_UINT64, offsets.data(), offsets.size(), 1);
+
+    uint32_t meshVertices = getNumVertices();
+    uint32_t meshFaces = getNumFaces();
+    dataset.createAttribute<uint32_t>("mesh_vertices", hf::DataSpace::From(meshVertices))
+        .write(meshVertices);
+    dataset.createAttribute<uint32_t>("mesh_faces", hf::DataSpace::From(meshFaces))
+        .write(meshFaces);
 }
 
 void HDF5MapIO::addImage(hf::Group group, std::string name, const uint32_t width, const uint32_t height,
                                  const uint8_t *pixelBuffer)
 {
+    checkStructureChangeable();
+
     H5IMmake_image_24bit(group.getId(), name.c_str(), width, height, "INTERLACE_PIXEL", pixelBuffer);
 }
 
 bool HDF5MapIO::removeAllLabels()
 {
+    checkStructureChangeable();
+
     bool result = true;
     for (std::string name : m_labelsGroup.listObjectNames())
     {
@@ -462,5 +1289,10 @@ void HDF5MapIO::flush()
     m_file.flush();
 }
 
+HDF5MapIO::AccessMode HDF5MapIO::getAccessMode() const
+{
+    return m_mode;
+}
+
 } // namespace hdf5_map_io
 
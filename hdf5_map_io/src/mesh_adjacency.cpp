@@ -0,0 +1,153 @@
+#include "hdf5_map_io/mesh_adjacency.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace hdf5_map_io
+{
+
+namespace
+{
+
+/**
+ * Builds an adjacency in two parallel passes, the first one counts the neighbors of each element and the second one
+ * writes them. neighbors(element, out) appends the neighbors of an element to out, a buffer reused by each thread.
+ */
+template <typename NeighborFunc>
+MeshAdjacency buildAdjacency(size_t numElements, NeighborFunc neighbors)
+{
+    std::vector<uint64_t> offsets(numElements + 1, 0);
+
+    #pragma omp parallel
+    {
+        std::vector<uint32_t> buffer;
+        #pragma omp for schedule(static)
+        for (int64_t element = 0; element < numElements; element++)
+        {
+            buffer.clear();
+            neighbors(element, buffer);
+            offsets[element + 1] = buffer.size();
+        }
+    }
+
+    for (size_t element = 0; element < numElements; element++)
+    {
+        offsets[element + 1] += offsets[element];
+    }
+
+    std::vector<uint32_t> adjacent(offsets[numElements]);
+
+    #pragma omp parallel
+    {
+        std::vector<uint32_t> buffer;
+        #pragma omp for schedule(static)
+        for (int64_t element = 0; element < numElements; element++)
+        {
+            buffer.clear();
+            neighbors(element, buffer);
+            std::copy(buffer.begin(), buffer.end(), adjacent.begin() + offsets[element]);
+        }
+    }
+
+    return MeshAdjacency(std::move(offsets), std::move(adjacent));
+}
+
+} // namespace
+
+MeshAdjacency::MeshAdjacency()
+{
+}
+
+MeshAdjacency::MeshAdjacency(std::vector<uint64_t> offsets, std::vector<uint32_t> neighbors)
+    : m_offsets(std::move(offsets))
+    , m_neighbors(std::move(neighbors))
+{
+}
+
+AdjacencyView MeshAdjacency::view() const
+{
+    AdjacencyView view;
+    view.offsets = m_offsets.data();
+    view.neighbors = m_neighbors.data();
+    view.size = size();
+    return view;
+}
+
+MeshAdjacency buildVertexFaceAdjacency(const uint32_t* faceIds, size_t numFaces, size_t numVertices)
+{
+    // a counting sort of the face corners by vertex, which keeps the faces of each vertex in ascending order
+    std::vector<uint64_t> offsets(numVertices + 1, 0);
+    for (size_t i = 0; i < numFaces * 3; i++)
+    {
+        offsets[faceIds[i] + 1]++;
+    }
+
+    for (size_t vertex = 0; vertex < numVertices; vertex++)
+    {
+        offsets[vertex + 1] += offsets[vertex];
+    }
+
+    std::vector<uint32_t> faces(numFaces * 3);
+    std::vector<uint64_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t face = 0; face < numFaces; face++)
+    {
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            faces[fill[faceIds[face * 3 + corner]]++] = face;
+        }
+    }
+
+    return MeshAdjacency(std::move(offsets), std::move(faces));
+}
+
+MeshAdjacency buildVertexAdjacency(const uint32_t* faceIds, size_t numFaces, size_t numVertices)
+{
+    const MeshAdjacency vertexFaces = buildVertexFaceAdjacency(faceIds, numFaces, numVertices);
+    const AdjacencyView view = vertexFaces.view();
+
+    return buildAdjacency(numVertices, [&](uint32_t vertex, std::vector<uint32_t>& neighbors)
+    {
+        for (uint32_t face : view[vertex])
+        {
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                const uint32_t other = faceIds[size_t(face) * 3 + corner];
+                if (other != vertex)
+                {
+                    neighbors.push_back(other);
+                }
+            }
+        }
+
+        // every edge is shared by two faces of a manifold mesh
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+    });
+}
+
+MeshAdjacency buildFaceAdjacency(const uint32_t* faceIds, size_t numFaces, size_t numVertices)
+{
+    const MeshAdjacency vertexFaces = buildVertexFaceAdjacency(faceIds, numFaces, numVertices);
+    const AdjacencyView view = vertexFaces.view();
+
+    return buildAdjacency(numFaces, [&](uint32_t face, std::vector<uint32_t>& neighbors)
+    {
+        const uint32_t* ids = faceIds + size_t(face) * 3;
+        for (size_t edge = 0; edge < 3; edge++)
+        {
+            // the faces of the first vertex of the edge which contain the second one as well
+            const uint32_t a = ids[edge];
+            const uint32_t b = ids[(edge + 1) % 3];
+            for (uint32_t other : view[a])
+            {
+                const uint32_t* otherIds = faceIds + size_t(other) * 3;
+                if (other != face && (otherIds[0] == b || otherIds[1] == b || otherIds[2] == b))
+                {
+                    neighbors.push_back(other);
+                }
+            }
+        }
+    });
+}
+
+} // namespace hdf5_map_io
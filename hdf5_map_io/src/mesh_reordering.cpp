@@ -0,0 +1,552 @@
+#include "hdf5_map_io/mesh_reordering.h"
+#include "hdf5_map_io/hdf5_map_io.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <tuple>
+#include <utility>
+
+namespace hdf5_map_io
+{
+
+namespace
+{
+
+const uint32_t INVALID = std::numeric_limits<uint32_t>::max();
+
+/// Bits of the Morton code per axis
+const uint32_t MORTON_BITS = 21;
+
+// parameters of the vertex score, as proposed by Forsyth
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_FACE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+/// Spreads the lower 21 bits of the value to every third bit
+inline uint64_t spreadBits(uint64_t value)
+{
+    value &= 0x1fffff;
+    value = (value | (value << 32)) & 0x001f00000000ffff;
+    value = (value | (value << 16)) & 0x001f0000ff0000ff;
+    value = (value | (value << 8)) & 0x100f00f00f00f00f;
+    value = (value | (value << 4)) & 0x10c30c30c30c30c3;
+    value = (value | (value << 2)) & 0x1249249249249249;
+    return value;
+}
+
+/**
+ * Score of a vertex, higher scores are emitted first. The terms are tabulated, since they are evaluated for every
+ * face around the cache after each step.
+ */
+class VertexScore
+{
+public:
+    VertexScore(size_t cacheSize)
+        : m_cacheScores(cacheSize)
+        , m_valenceScores(MAX_VALENCE + 1)
+    {
+        for (size_t position = 0; position < cacheSize; position++)
+        {
+            // the vertices of the last face get a fixed score, otherwise the next face would always share an edge
+            // with the last one, which is not optimal
+            m_cacheScores[position] = position < 3 ? LAST_FACE_SCORE
+                : std::pow(1.0f - float(position - 3) / (cacheSize - 3), CACHE_DECAY_POWER);
+        }
+
+        for (uint32_t valence = 1; valence <= MAX_VALENCE; valence++)
+        {
+            m_valenceScores[valence] = valenceScore(valence);
+        }
+    }
+
+    /**
+     * @param cachePosition Position in the cache, the most recent vertex is at zero, negative if not in the cache
+     * @param remainingFaces Number of faces of the vertex which have not been emitted yet
+     */
+    float operator()(int64_t cachePosition, uint32_t remainingFaces) const
+    {
+        if (remainingFaces == 0)
+        {
+            // the vertex is not used anymore
+            return -1.0f;
+        }
+
+        const float score = cachePosition >= 0 ? m_cacheScores[cachePosition] : 0.0f;
+        return score + (remainingFaces <= MAX_VALENCE ? m_valenceScores[remainingFaces] : valenceScore(remainingFaces));
+    }
+
+private:
+    static const uint32_t MAX_VALENCE = 32;
+
+    // vertices with few remaining faces are preferred, so that they are finished and not left alone
+    static float valenceScore(uint32_t remainingFaces)
+    {
+        return VALENCE_BOOST_SCALE * std::pow(float(remainingFaces), -VALENCE_BOOST_POWER);
+    }
+
+    std::vector<float> m_cacheScores;
+    std::vector<float> m_valenceScores;
+};
+
+template <typename T>
+std::vector<T> permuteRows(const std::vector<T>& values, const std::vector<uint32_t>& order, size_t width)
+{
+    std::vector<T> result(values.size());
+    #pragma omp parallel for
+    for (int64_t i = 0; i < order.size(); i++)
+    {
+        std::copy_n(values.begin() + size_t(order[i]) * width, width, result.begin() + i * width);
+    }
+    return result;
+}
+
+/**
+ * Names of the vertex channels which are reordered as cost layers, i.e. all channels with one value per vertex
+ * except the geometry, normals and colors.
+ */
+std::vector<std::string> getReorderedCostLayers(HDF5MapIO& map, size_t numVertices)
+{
+    std::vector<std::string> layers;
+    for (const std::string& layer : map.getCostLayers())
+    {
+        if (layer == "vertices" || layer == "face_indices" || layer == "vertex_normals" || layer == "vertex_colors")
+        {
+            continue;
+        }
+
+        if (map.getVertexCosts(layer).size() != numVertices)
+          throw "The map contains a channel that can not be reordered with the vertices.";
+
+        layers.push_back(layer);
+    }
+    return layers;
+}
+
+} // namespace
+
+std::vector<uint32_t> mortonFaceOrder(
+    const float* vertices,
+    size_t numVertices,
+    const uint32_t* faceIds,
+    size_t numFaces
+)
+{
+    float min[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                     std::numeric_limits<float>::max() };
+    float max[3] = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(),
+                     std::numeric_limits<float>::lowest() };
+    for (size_t vertex = 0; vertex < numVertices; vertex++)
+    {
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            min[axis] = std::min(min[axis], vertices[vertex * 3 + axis]);
+            max[axis] = std::max(max[axis], vertices[vertex * 3 + axis]);
+        }
+    }
+
+    const float extent = std::max({ max[0] - min[0], max[1] - min[1], max[2] - min[2] });
+    const uint32_t cells = 1u << MORTON_BITS;
+
+    std::vector<std::pair<uint64_t, uint32_t>> codes(numFaces);
+    #pragma omp parallel for
+    for (int64_t face = 0; face < numFaces; face++)
+    {
+        uint64_t code = 0;
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            float centroid = (vertices[faceIds[face * 3 + 0] * 3 + axis]
+                            + vertices[faceIds[face * 3 + 1] * 3 + axis]
+                            + vertices[faceIds[face * 3 + 2] * 3 + axis]) / 3.0f;
+            uint32_t cell = extent > 0 ? std::min(uint32_t((centroid - min[axis]) / extent * cells), cells - 1) : 0;
+            code |= spreadBits(cell) << axis;
+        }
+        codes[face] = { code, uint32_t(face) };
+    }
+    std::sort(codes.begin(), codes.end());
+
+    std::vector<uint32_t> order(numFaces);
+    for (size_t i = 0; i < numFaces; i++)
+    {
+        order[i] = codes[i].second;
+    }
+    return order;
+}
+
+std::vector<uint32_t> optimizeVertexCache(
+    const uint32_t* faceIds,
+    size_t numFaces,
+    size_t numVertices,
+    const std::vector<uint32_t>& faceOrder,
+    size_t cacheSize
+)
+{
+    cacheSize = std::max<size_t>(cacheSize, 4);
+
+    // the not yet emitted faces of each vertex, the first remainingFaces[vertex] entries of its range are valid
+    std::vector<uint32_t> remainingFaces(numVertices, 0);
+    for (size_t i = 0; i < numFaces * 3; i++)
+    {
+        remainingFaces[faceIds[i]]++;
+    }
+
+    std::vector<size_t> offsets(numVertices + 1, 0);
+    for (size_t vertex = 0; vertex < numVertices; vertex++)
+    {
+        offsets[vertex + 1] = offsets[vertex] + remainingFaces[vertex];
+    }
+
+    std::vector<uint32_t> vertexFaces(numFaces * 3);
+    std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t face = 0; face < numFaces; face++)
+    {
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            vertexFaces[fill[faceIds[face * 3 + corner]]++] = face;
+        }
+    }
+    std::vector<size_t>().swap(fill);
+
+    const VertexScore vertexScore(cacheSize);
+    std::vector<int64_t> cachePosition(numVertices, -1);
+    std::vector<float> vertexScores(numVertices);
+    for (size_t vertex = 0; vertex < numVertices; vertex++)
+    {
+        vertexScores[vertex] = vertexScore(-1, remainingFaces[vertex]);
+    }
+
+    std::vector<uint8_t> emitted(numFaces, 0);
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> nextCache;
+    cache.reserve(cacheSize + 3);
+    nextCache.reserve(cacheSize + 3);
+
+    std::vector<uint32_t> order;
+    order.reserve(numFaces);
+    size_t nextInOrder = 0;
+    uint32_t bestFace = INVALID;
+
+    while (order.size() < numFaces)
+    {
+        if (bestFace == INVALID)
+        {
+            // the cache has no faces left, continue with the given order
+            while (emitted[faceOrder[nextInOrder]])
+            {
+                nextInOrder++;
+            }
+            bestFace = faceOrder[nextInOrder];
+        }
+
+        const uint32_t* ids = faceIds + size_t(bestFace) * 3;
+        emitted[bestFace] = 1;
+        order.push_back(bestFace);
+
+        // remove the face from its vertices
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            const uint32_t vertex = ids[corner];
+            uint32_t* faces = vertexFaces.data() + offsets[vertex];
+            uint32_t* last = faces + remainingFaces[vertex] - 1;
+            *std::find(faces, last + 1, bestFace) = *last;
+            remainingFaces[vertex]--;
+        }
+
+        // the vertices of the face move to the front of the cache, the others move back
+        nextCache.clear();
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            if (std::find(nextCache.begin(), nextCache.end(), ids[corner]) == nextCache.end())
+            {
+                nextCache.push_back(ids[corner]);
+            }
+        }
+        for (uint32_t vertex : cache)
+        {
+            if (vertex != ids[0] && vertex != ids[1] && vertex != ids[2])
+            {
+                nextCache.push_back(vertex);
+            }
+        }
+        std::swap(cache, nextCache);
+
+        // update the scores of all vertices whose cache position changed, including the ones dropped from the cache
+        for (size_t position = 0; position < cache.size(); position++)
+        {
+            const uint32_t vertex = cache[position];
+            cachePosition[vertex] = position < cacheSize ? int64_t(position) : -1;
+            vertexScores[vertex] = vertexScore(cachePosition[vertex], remainingFaces[vertex]);
+        }
+
+        // score the faces of these vertices and pick the best one
+        float bestScore = -std::numeric_limits<float>::max();
+        bestFace = INVALID;
+        for (uint32_t vertex : cache)
+        {
+            const uint32_t* faces = vertexFaces.data() + offsets[vertex];
+            for (size_t i = 0; i < remainingFaces[vertex]; i++)
+            {
+                const uint32_t* faceVertices = faceIds + size_t(faces[i]) * 3;
+                float score = vertexScores[faceVertices[0]] + vertexScores[faceVertices[1]]
+                            + vertexScores[faceVertices[2]];
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    bestFace = faces[i];
+                }
+            }
+        }
+
+        if (cache.size() > cacheSize)
+        {
+            cache.resize(cacheSize);
+        }
+    }
+
+    return order;
+}
+
+MeshOrder computeMeshOrder(
+    const float* vertices,
+    size_t numVertices,
+    const uint32_t* faceIds,
+    size_t numFaces,
+    size_t cacheSize
+)
+{
+    const std::vector<uint32_t> mortonOrder = mortonFaceOrder(vertices, numVertices, faceIds, numFaces);
+
+    // the faces are passed to the optimization in Morton order, which keeps its memory accesses local
+    std::vector<uint32_t> mortonFaceIds(numFaces * 3);
+    std::vector<uint32_t> identity(numFaces);
+    #pragma omp parallel for
+    for (int64_t i = 0; i < numFaces; i++)
+    {
+        std::copy_n(faceIds + size_t(mortonOrder[i]) * 3, 3, mortonFaceIds.begin() + i * 3);
+        identity[i] = i;
+    }
+
+    MeshOrder order;
+    order.faceOrder = optimizeVertexCache(mortonFaceIds.data(), numFaces, numVertices, identity, cacheSize);
+    for (uint32_t& face : order.faceOrder)
+    {
+        face = mortonOrder[face];
+    }
+
+    // number the vertices in the order of their first use
+    std::vector<uint8_t> used(numVertices, 0);
+    order.vertexOrder.reserve(numVertices);
+    for (uint32_t face : order.faceOrder)
+    {
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            const uint32_t vertex = faceIds[size_t(face) * 3 + corner];
+            if (!used[vertex])
+            {
+                used[vertex] = 1;
+                order.vertexOrder.push_back(vertex);
+            }
+        }
+    }
+
+    for (size_t vertex = 0; vertex < numVertices; vertex++)
+    {
+        if (!used[vertex])
+        {
+            order.vertexOrder.push_back(vertex);
+        }
+    }
+
+    return order;
+}
+
+float averageCacheMissRatio(const uint32_t* faceIds, size_t numFaces, size_t numVertices, size_t cacheSize)
+{
+    if (numFaces == 0)
+    {
+        return 0.0f;
+    }
+
+    // a FIFO cache as in most GPUs, a vertex stays in the cache for cacheSize misses
+    std::vector<size_t> insertedAt(numVertices, 0);
+    size_t misses = 0;
+    for (size_t i = 0; i < numFaces * 3; i++)
+    {
+        const uint32_t vertex = faceIds[i];
+        if (insertedAt[vertex] == 0 || misses - insertedAt[vertex] >= cacheSize)
+        {
+            misses++;
+            insertedAt[vertex] = misses;
+        }
+    }
+
+    return float(misses) / numFaces;
+}
+
+void writeReorderedMap(HDF5MapIO& map, std::string filename, size_t cacheSize)
+{
+    std::vector<float> vertices = map.getVertices();
+    std::vector<uint32_t> faceIds = map.getFaceIds();
+    const size_t numVertices = vertices.size() / 3;
+    const size_t numFaces = faceIds.size() / 3;
+
+    // check all channels before anything is written
+    std::vector<float> normals = map.getVertexNormals();
+    std::vector<uint8_t> colors = map.getVertexColors();
+    std::vector<float> texCoords = map.getVertexTextureCoords();
+    std::vector<MapMaterial> materials = map.getMaterials();
+    std::vector<uint32_t> materialFaceIds = map.getMaterialFaceIndices();
+    const std::vector<std::string> costLayers = getReorderedCostLayers(map, numVertices);
+
+    if (!normals.empty() && normals.size() != numVertices * 3)
+      throw "The vertex normals do not match the vertices of the map.";
+
+    if (!colors.empty() && colors.size() != numVertices * 3)
+      throw "The vertex colors do not match the vertices of the map.";
+
+    if (!texCoords.empty() && (numVertices == 0 || texCoords.size() % numVertices != 0))
+      throw "The texture coordinates do not match the vertices of the map.";
+
+    if (!materialFaceIds.empty() && materialFaceIds.size() != numFaces)
+      throw "The material face indices do not match the faces of the map.";
+
+    // labels and levels of detail are remapped below, they must not reference faces or vertices outside of the map
+    std::vector<std::tuple<std::string, std::string, std::vector<uint32_t>>> labels;
+    for (const std::string& group : map.getLabelGroups())
+    {
+        for (const std::string& label : map.getAllLabelsOfGroup(group))
+        {
+            std::vector<uint32_t> labelFaceIds = map.getFaceIdsOfLabel(group, label);
+            if (std::any_of(labelFaceIds.begin(), labelFaceIds.end(), [numFaces](uint32_t face)
+                {
+                    return face >= numFaces;
+                }))
+              throw "A label references a face which is not part of the map.";
+
+            labels.emplace_back(group, label, std::move(labelFaceIds));
+        }
+    }
+
+    // levels built before the mesh has been changed, e.g. by appendPatch, are outdated and not copied
+    std::vector<std::pair<MapLodLevel, std::vector<uint32_t>>> lods;
+    for (const MapLodLevel& lod : map.getLodLevels())
+    {
+        if (lod.meshFaces != numFaces)
+        {
+            continue;
+        }
+
+        std::vector<uint32_t> lodFaceIds = map.getLodFaceIds(lod.level);
+        if (std::any_of(lodFaceIds.begin(), lodFaceIds.end(), [numVertices](uint32_t vertex)
+            {
+                return vertex >= numVertices;
+            }))
+          throw "A level of detail references a vertex which is not part of the map.";
+
+        lods.emplace_back(lod, std::move(lodFaceIds));
+    }
+
+    const MeshOrder order = computeMeshOrder(vertices.data(), numVertices, faceIds.data(), numFaces, cacheSize);
+
+    std::vector<uint32_t> vertexRemap(numVertices);
+    for (size_t i = 0; i < numVertices; i++)
+    {
+        vertexRemap[order.vertexOrder[i]] = i;
+    }
+
+    std::vector<uint32_t> faceRemap(numFaces);
+    for (size_t i = 0; i < numFaces; i++)
+    {
+        faceRemap[order.faceOrder[i]] = i;
+    }
+
+    std::vector<uint32_t> newFaceIds(faceIds.size());
+    #pragma omp parallel for
+    for (int64_t i = 0; i < numFaces; i++)
+    {
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            newFaceIds[i * 3 + corner] = vertexRemap[faceIds[size_t(order.faceOrder[i]) * 3 + corner]];
+        }
+    }
+    std::vector<uint32_t>().swap(faceIds);
+
+    HDF5MapIO output(filename, permuteRows(vertices, order.vertexOrder, 3), newFaceIds);
+    std::vector<float>().swap(vertices);
+
+    if (!normals.empty())
+    {
+        std::vector<float> reordered = permuteRows(normals, order.vertexOrder, 3);
+        output.addVertexNormals(reordered);
+    }
+
+    if (!colors.empty())
+    {
+        std::vector<uint8_t> reordered = permuteRows(colors, order.vertexOrder, 3);
+        output.addVertexColors(reordered);
+    }
+
+    if (!texCoords.empty())
+    {
+        std::vector<float> reordered = permuteRows(texCoords, order.vertexOrder, texCoords.size() / numVertices);
+        output.addVertexTextureCoords(reordered);
+    }
+
+    for (const std::string& layer : costLayers)
+    {
+        output.writeVertexCosts(layer, permuteRows(map.getVertexCosts(layer), order.vertexOrder, 1));
+    }
+
+    for (MapImage& texture : map.getTextures())
+    {
+        output.addTexture(std::stoi(texture.name), texture.width, texture.height, texture.data.data());
+    }
+
+    if (!materials.empty() || !materialFaceIds.empty())
+    {
+        std::vector<uint32_t> reordered = permuteRows(materialFaceIds, order.faceOrder, 1);
+        output.addMaterials(materials, reordered);
+    }
+
+    std::unordered_map<MapVertex, std::vector<float>> features = map.getFeatures();
+    if (!features.empty())
+    {
+        output.addTextureKeypointsMap(features);
+    }
+
+    for (auto& label : labels)
+    {
+        std::vector<uint32_t>& labelFaceIds = std::get<2>(label);
+        for (uint32_t& face : labelFaceIds)
+        {
+            face = faceRemap[face];
+        }
+        std::sort(labelFaceIds.begin(), labelFaceIds.end());
+        output.addLabel(std::get<0>(label), std::get<1>(label), labelFaceIds);
+    }
+
+    for (auto& lod : lods)
+    {
+        for (uint32_t& vertex : lod.second)
+        {
+            vertex = vertexRemap[vertex];
+        }
+        output.addLodLevel(lod.first.level, lod.second, lod.first.error);
+    }
+
+    // stored adjacencies refer to the old indices and are built again
+    if (!map.getVertexAdjacency().empty())
+    {
+        output.addVertexAdjacency(buildVertexAdjacency(newFaceIds.data(), numFaces, numVertices));
+    }
+
+    if (!map.getFaceAdjacency().empty())
+    {
+        output.addFaceAdjacency(buildFaceAdjacency(newFaceIds.data(), numFaces, numVertices));
+    }
+
+    output.flush();
+}
+
+} // namespace hdf5_map_io
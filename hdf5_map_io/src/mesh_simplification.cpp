@@ -0,0 +1,741 @@
+#include "hdf5_map_io/mesh_simplification.h"
+#include "hdf5_map_io/mesh_reordering.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <queue>
+#include <utility>
+
+namespace hdf5_map_io
+{
+
+namespace
+{
+
+/// Weight of the planes perpendicular to boundary edges, which keep unlocked boundaries in place
+const double BOUNDARY_WEIGHT = 10.0;
+
+const uint32_t INVALID = std::numeric_limits<uint32_t>::max();
+
+/**
+ * Symmetric 4x4 matrix of the squared distance to a set of planes, stored as its upper triangle.
+ */
+struct Quadric
+{
+    double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+    void addPlane(double a, double b, double c, double d, double weight)
+    {
+        a2 += weight * a * a;
+        ab += weight * a * b;
+        ac += weight * a * c;
+        ad += weight * a * d;
+        b2 += weight * b * b;
+        bc += weight * b * c;
+        bd += weight * b * d;
+        c2 += weight * c * c;
+        cd += weight * c * d;
+        d2 += weight * d * d;
+    }
+
+    Quadric& operator+=(const Quadric& other)
+    {
+        a2 += other.a2;
+        ab += other.ab;
+        ac += other.ac;
+        ad += other.ad;
+        b2 += other.b2;
+        bc += other.bc;
+        bd += other.bd;
+        c2 += other.c2;
+        cd += other.cd;
+        d2 += other.d2;
+        return *this;
+    }
+
+    double evaluate(const float p[3]) const
+    {
+        double x = p[0], y = p[1], z = p[2];
+        return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+             + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+             + c2 * z * z + 2 * cd * z
+             + d2;
+    }
+};
+
+struct Collapse
+{
+    float error;
+    uint32_t from;
+    uint32_t to;
+    uint32_t version;
+
+    bool operator>(const Collapse& other) const
+    {
+        return error > other.error;
+    }
+};
+
+inline void sub(const float a[3], const float b[3], double out[3])
+{
+    out[0] = double(a[0]) - b[0];
+    out[1] = double(a[1]) - b[1];
+    out[2] = double(a[2]) - b[2];
+}
+
+inline void cross(const double a[3], const double b[3], double out[3])
+{
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+inline double dot(const double a[3], const double b[3])
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+/**
+ * Working state of one simplification run.
+ */
+class Simplifier
+{
+public:
+    Simplifier(
+        const float* vertices,
+        size_t numVertices,
+        const uint32_t* faceIds,
+        size_t numFaces,
+        const SimplificationOptions& options
+    )
+        : m_vertices(vertices)
+        , m_faceIds(faceIds, faceIds + numFaces * 3)
+        , m_options(options)
+        , m_faceRemoved(numFaces, false)
+        , m_vertexFaces(numVertices)
+        , m_quadrics(numVertices)
+        , m_boundary(numVertices, false)
+        , m_locked(numVertices, false)
+        , m_removed(numVertices, false)
+        , m_version(numVertices, 0)
+        , m_numFaces(numFaces)
+    {
+    }
+
+    SimplificationResult run()
+    {
+        SimplificationResult result;
+
+        initialize();
+
+        for (uint32_t vertex = 0; vertex < m_vertexFaces.size(); vertex++)
+        {
+            pushCollapse(vertex);
+        }
+
+        while (!m_queue.empty() && m_numFaces > m_options.targetFaces)
+        {
+            Collapse collapse = m_queue.top();
+            m_queue.pop();
+
+            if (m_removed[collapse.from] || collapse.version != m_version[collapse.from])
+            {
+                continue;
+            }
+            if (collapse.error > m_options.maxError)
+            {
+                break;
+            }
+
+            // the neighbourhood of the target may have changed without touching the removed vertex
+            if (m_removed[collapse.to] || !isValid(collapse.from, collapse.to))
+            {
+                m_version[collapse.from]++;
+                pushCollapse(collapse.from);
+                continue;
+            }
+
+            apply(collapse.from, collapse.to);
+            result.error = std::max(result.error, collapse.error);
+        }
+
+        result.faceIds.reserve(m_numFaces * 3);
+        result.faceMap.reserve(m_numFaces);
+        for (size_t face = 0; face < m_faceRemoved.size(); face++)
+        {
+            if (!m_faceRemoved[face])
+            {
+                result.faceIds.insert(
+                    result.faceIds.end(),
+                    m_faceIds.begin() + face * 3,
+                    m_faceIds.begin() + face * 3 + 3
+                );
+                result.faceMap.push_back(face);
+            }
+        }
+        return result;
+    }
+
+private:
+    const float* position(uint32_t vertex) const
+    {
+        return m_vertices + vertex * 3;
+    }
+
+    void initialize()
+    {
+        const size_t numFaces = m_faceRemoved.size();
+
+        // collect the faces of each vertex and sort out degenerated faces
+        for (uint32_t face = 0; face < numFaces; face++)
+        {
+            const uint32_t* ids = &m_faceIds[face * 3];
+            if (ids[0] == ids[1] || ids[1] == ids[2] || ids[0] == ids[2])
+            {
+                m_faceRemoved[face] = true;
+                m_numFaces--;
+                continue;
+            }
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                m_vertexFaces[ids[corner]].push_back(face);
+            }
+        }
+
+        // face plane quadrics
+        for (uint32_t face = 0; face < numFaces; face++)
+        {
+            if (m_faceRemoved[face])
+            {
+                continue;
+            }
+            const uint32_t* ids = &m_faceIds[face * 3];
+            double e1[3], e2[3], normal[3];
+            sub(position(ids[1]), position(ids[0]), e1);
+            sub(position(ids[2]), position(ids[0]), e2);
+            cross(e1, e2, normal);
+            double length = std::sqrt(dot(normal, normal));
+            if (length == 0)
+            {
+                continue;
+            }
+            for (size_t axis = 0; axis < 3; axis++)
+            {
+                normal[axis] /= length;
+            }
+            const float* p = position(ids[0]);
+            double d = -(normal[0] * p[0] + normal[1] * p[1] + normal[2] * p[2]);
+
+            Quadric quadric;
+            quadric.addPlane(normal[0], normal[1], normal[2], d, 1.0);
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                m_quadrics[ids[corner]] += quadric;
+            }
+        }
+
+        // boundary edges are the edges with a single face
+        std::vector<std::array<uint32_t, 3>> edges;
+        edges.reserve(m_numFaces * 3);
+        for (uint32_t face = 0; face < numFaces; face++)
+        {
+            if (m_faceRemoved[face])
+            {
+                continue;
+            }
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                uint32_t a = m_faceIds[face * 3 + corner];
+                uint32_t b = m_faceIds[face * 3 + (corner + 1) % 3];
+                edges.push_back({ std::min(a, b), std::max(a, b), face });
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+
+        for (size_t begin = 0, end; begin < edges.size(); begin = end)
+        {
+            end = begin + 1;
+            while (end < edges.size() && edges[end][0] == edges[begin][0] && edges[end][1] == edges[begin][1])
+            {
+                end++;
+            }
+            if (end - begin != 1)
+            {
+                continue;
+            }
+
+            uint32_t a = edges[begin][0];
+            uint32_t b = edges[begin][1];
+            m_boundary[a] = true;
+            m_boundary[b] = true;
+
+            // a plane through the edge perpendicular to its face
+            const uint32_t* ids = &m_faceIds[edges[begin][2] * 3];
+            double e1[3], e2[3], faceNormal[3], edge[3], normal[3];
+            sub(position(ids[1]), position(ids[0]), e1);
+            sub(position(ids[2]), position(ids[0]), e2);
+            cross(e1, e2, faceNormal);
+            sub(position(b), position(a), edge);
+            cross(edge, faceNormal, normal);
+            double length = std::sqrt(dot(normal, normal));
+            if (length == 0)
+            {
+                continue;
+            }
+            for (size_t axis = 0; axis < 3; axis++)
+            {
+                normal[axis] /= length;
+            }
+            const float* p = position(a);
+            double d = -(normal[0] * p[0] + normal[1] * p[1] + normal[2] * p[2]);
+
+            Quadric quadric;
+            quadric.addPlane(normal[0], normal[1], normal[2], d, BOUNDARY_WEIGHT);
+            m_quadrics[a] += quadric;
+            m_quadrics[b] += quadric;
+        }
+
+        for (size_t vertex = 0; vertex < m_locked.size(); vertex++)
+        {
+            m_locked[vertex] = (m_options.lockBoundary && m_boundary[vertex])
+                || (m_options.lockedVertices && m_options.lockedVertices[vertex]);
+        }
+    }
+
+    /**
+     * Collects the vertices sharing a face with the given vertex.
+     */
+    void getNeighbours(uint32_t vertex, std::vector<uint32_t>& neighbours) const
+    {
+        neighbours.clear();
+        for (uint32_t face : m_vertexFaces[vertex])
+        {
+            if (m_faceRemoved[face])
+            {
+                continue;
+            }
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                uint32_t other = m_faceIds[face * 3 + corner];
+                if (other != vertex)
+                {
+                    neighbours.push_back(other);
+                }
+            }
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+    }
+
+    /**
+     * Number of faces containing both vertices.
+     */
+    size_t countSharedFaces(uint32_t a, uint32_t b) const
+    {
+        size_t count = 0;
+        for (uint32_t face : m_vertexFaces[a])
+        {
+            if (!m_faceRemoved[face]
+                && (m_faceIds[face * 3] == b || m_faceIds[face * 3 + 1] == b || m_faceIds[face * 3 + 2] == b))
+            {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    float error(uint32_t from, uint32_t to) const
+    {
+        Quadric quadric = m_quadrics[from];
+        quadric += m_quadrics[to];
+        double error = std::max(0.0, quadric.evaluate(position(to)));
+
+        if (m_options.attributes)
+        {
+            const float* a = m_options.attributes + from * m_options.attributeDim;
+            const float* b = m_options.attributes + to * m_options.attributeDim;
+            double difference = 0;
+            for (size_t i = 0; i < m_options.attributeDim; i++)
+            {
+                difference += (double(a[i]) - b[i]) * (double(a[i]) - b[i]);
+            }
+            error += m_options.attributeWeight * difference;
+        }
+        return error;
+    }
+
+    /**
+     * Checks whether moving the vertex from onto its neighbour to keeps the mesh manifold and does not flip faces.
+     */
+    bool isValid(uint32_t from, uint32_t to)
+    {
+        size_t sharedFaces = countSharedFaces(from, to);
+        if (sharedFaces == 0)
+        {
+            return false;
+        }
+
+        // boundary vertices may only slide along the boundary
+        if (m_boundary[from] && sharedFaces != 1)
+        {
+            return false;
+        }
+
+        // link condition, the only common neighbours are the opposite vertices of the shared faces
+        getNeighbours(from, m_fromNeighbours);
+        getNeighbours(to, m_toNeighbours);
+        size_t common = 0;
+        for (size_t i = 0, j = 0; i < m_fromNeighbours.size() && j < m_toNeighbours.size();)
+        {
+            if (m_fromNeighbours[i] < m_toNeighbours[j])
+            {
+                i++;
+            }
+            else if (m_fromNeighbours[i] > m_toNeighbours[j])
+            {
+                j++;
+            }
+            else
+            {
+                common++;
+                i++;
+                j++;
+            }
+        }
+        if (common != sharedFaces)
+        {
+            return false;
+        }
+
+        // the faces that remain must not flip or degenerate
+        for (uint32_t face : m_vertexFaces[from])
+        {
+            if (m_faceRemoved[face])
+            {
+                continue;
+            }
+            const uint32_t* ids = &m_faceIds[face * 3];
+            if (ids[0] == to || ids[1] == to || ids[2] == to)
+            {
+                continue;
+            }
+
+            const float* before[3];
+            const float* after[3];
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                before[corner] = position(ids[corner]);
+                after[corner] = ids[corner] == from ? position(to) : before[corner];
+            }
+
+            double e1[3], e2[3], normalBefore[3], normalAfter[3];
+            sub(before[1], before[0], e1);
+            sub(before[2], before[0], e2);
+            cross(e1, e2, normalBefore);
+            sub(after[1], after[0], e1);
+            sub(after[2], after[0], e2);
+            cross(e1, e2, normalAfter);
+
+            if (dot(normalBefore, normalAfter) <= 0 || dot(normalAfter, normalAfter) == 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Queues the cheapest valid collapse of the given vertex, if there is one.
+     */
+    void pushCollapse(uint32_t vertex)
+    {
+        if (m_removed[vertex] || m_locked[vertex])
+        {
+            return;
+        }
+
+        getNeighbours(vertex, m_candidates);
+        m_candidateErrors.clear();
+        for (uint32_t neighbour : m_candidates)
+        {
+            m_candidateErrors.emplace_back(error(vertex, neighbour), neighbour);
+        }
+        std::sort(m_candidateErrors.begin(), m_candidateErrors.end());
+
+        // the topology checks are costly, so only the cheapest candidates are checked until one is valid
+        for (const auto& candidate : m_candidateErrors)
+        {
+            if (isValid(vertex, candidate.second))
+            {
+                m_queue.push(Collapse{ candidate.first, vertex, candidate.second, m_version[vertex] });
+                return;
+            }
+        }
+    }
+
+    void apply(uint32_t from, uint32_t to)
+    {
+        std::vector<uint32_t>& toFaces = m_vertexFaces[to];
+        toFaces.erase(
+            std::remove_if(toFaces.begin(), toFaces.end(), [&](uint32_t face) { return m_faceRemoved[face]; }),
+            toFaces.end()
+        );
+
+        for (uint32_t face : m_vertexFaces[from])
+        {
+            if (m_faceRemoved[face])
+            {
+                continue;
+            }
+            uint32_t* ids = &m_faceIds[face * 3];
+            if (ids[0] == to || ids[1] == to || ids[2] == to)
+            {
+                m_faceRemoved[face] = true;
+                m_numFaces--;
+                continue;
+            }
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                if (ids[corner] == from)
+                {
+                    ids[corner] = to;
+                }
+            }
+            toFaces.push_back(face);
+        }
+        m_vertexFaces[from].clear();
+        m_vertexFaces[from].shrink_to_fit();
+
+        m_quadrics[to] += m_quadrics[from];
+        m_removed[from] = true;
+
+        // the collapses of the target and all of its neighbours may have changed
+        std::vector<uint32_t> neighbours;
+        getNeighbours(to, neighbours);
+        m_version[to]++;
+        pushCollapse(to);
+        for (uint32_t neighbour : neighbours)
+        {
+            m_version[neighbour]++;
+            pushCollapse(neighbour);
+        }
+    }
+
+    const float* m_vertices;
+    std::vector<uint32_t> m_faceIds;
+    const SimplificationOptions& m_options;
+
+    std::vector<bool> m_faceRemoved;
+    std::vector<std::vector<uint32_t>> m_vertexFaces;
+    std::vector<Quadric> m_quadrics;
+    std::vector<bool> m_boundary;
+    std::vector<bool> m_locked;
+    std::vector<bool> m_removed;
+    std::vector<uint32_t> m_version;
+    size_t m_numFaces;
+
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> m_queue;
+
+    /// Buffers of isValid and pushCollapse, kept to avoid allocations
+    std::vector<uint32_t> m_fromNeighbours;
+    std::vector<uint32_t> m_toNeighbours;
+    std::vector<uint32_t> m_candidates;
+    std::vector<std::pair<float, uint32_t>> m_candidateErrors;
+};
+
+/**
+ * Throws if a face references a vertex beyond the given number of vertices, which would make the simplification
+ * read and write outside of its per vertex arrays.
+ */
+void checkFaceIds(const uint32_t* faceIds, size_t numFaces, size_t numVertices)
+{
+    for (size_t i = 0; i < numFaces * 3; i++)
+    {
+        if (faceIds[i] >= numVertices)
+          throw "A face of the mesh references a vertex that does not exist.";
+    }
+}
+
+/**
+ * Simplifies the given faces on a compact copy of the vertices they use, which keeps the memory of the simplifier
+ * proportional to the faces instead of the whole mesh. The locked flags replace the ones of the options.
+ */
+SimplificationResult simplifyCompact(
+    const float* vertices,
+    const std::vector<uint32_t>& faceIds,
+    const SimplificationOptions& options,
+    const uint8_t* locked
+)
+{
+    std::vector<uint32_t> localToGlobal(faceIds);
+    std::sort(localToGlobal.begin(), localToGlobal.end());
+    localToGlobal.erase(std::unique(localToGlobal.begin(), localToGlobal.end()), localToGlobal.end());
+
+    std::vector<uint32_t> localFaceIds(faceIds.size());
+    for (size_t i = 0; i < faceIds.size(); i++)
+    {
+        localFaceIds[i] = std::lower_bound(localToGlobal.begin(), localToGlobal.end(), faceIds[i])
+            - localToGlobal.begin();
+    }
+
+    const size_t dim = options.attributes ? options.attributeDim : 0;
+    std::vector<float> localVertices(localToGlobal.size() * 3);
+    std::vector<float> localAttributes(localToGlobal.size() * dim);
+    std::vector<uint8_t> localLocked(localToGlobal.size());
+    for (size_t local = 0; local < localToGlobal.size(); local++)
+    {
+        uint32_t vertex = localToGlobal[local];
+        std::copy_n(vertices + vertex * 3, 3, localVertices.begin() + local * 3);
+        std::copy_n(options.attributes + vertex * dim, dim, localAttributes.begin() + local * dim);
+        localLocked[local] = locked[vertex];
+    }
+
+    SimplificationOptions localOptions = options;
+    localOptions.attributes = dim ? localAttributes.data() : nullptr;
+    localOptions.lockedVertices = localLocked.data();
+
+    Simplifier simplifier(
+        localVertices.data(),
+        localToGlobal.size(),
+        localFaceIds.data(),
+        localFaceIds.size() / 3,
+        localOptions
+    );
+    SimplificationResult result = simplifier.run();
+    for (uint32_t& vertex : result.faceIds)
+    {
+        vertex = localToGlobal[vertex];
+    }
+    return result;
+}
+
+} // namespace
+
+SimplificationResult simplifyMesh(
+    const float* vertices,
+    size_t numVertices,
+    const uint32_t* faceIds,
+    size_t numFaces,
+    const SimplificationOptions& options
+)
+{
+    checkFaceIds(faceIds, numFaces, numVertices);
+
+    Simplifier simplifier(vertices, numVertices, faceIds, numFaces, options);
+    return simplifier.run();
+}
+
+SimplificationResult simplifyMeshParallel(
+    const float* vertices,
+    size_t numVertices,
+    const uint32_t* faceIds,
+    size_t numFaces,
+    const SimplificationOptions& options,
+    size_t partFaces
+)
+{
+    checkFaceIds(faceIds, numFaces, numVertices);
+
+    partFaces = std::max<size_t>(partFaces, 1);
+    if (numFaces <= partFaces)
+    {
+        return simplifyMesh(vertices, numVertices, faceIds, numFaces, options);
+    }
+
+    // split the faces along a Morton curve over their centroids
+    std::vector<uint32_t> mortonOrder = mortonFaceOrder(vertices, numVertices, faceIds, numFaces);
+
+    // vertices of faces in different parts are shared and stay in place while the parts are simplified
+    const size_t numParts = (numFaces + partFaces - 1) / partFaces;
+    std::vector<uint32_t> vertexPart(numVertices, INVALID);
+    std::vector<uint8_t> shared(numVertices, 0);
+    for (size_t i = 0; i < numFaces; i++)
+    {
+        uint32_t part = i / partFaces;
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            uint32_t vertex = faceIds[mortonOrder[i] * 3 + corner];
+            if (vertexPart[vertex] == INVALID)
+            {
+                vertexPart[vertex] = part;
+            }
+            else if (vertexPart[vertex] != part)
+            {
+                shared[vertex] = 1;
+            }
+        }
+    }
+    std::vector<uint32_t>().swap(vertexPart);
+
+    // the neighbours of shared vertices are locked as well, a part only sees its own faces and could otherwise
+    // collapse an edge that violates the link condition in the faces of another part
+    std::vector<uint8_t> partLocked(numVertices, 0);
+    for (size_t face = 0; face < numFaces; face++)
+    {
+        const uint32_t* ids = faceIds + face * 3;
+        if (shared[ids[0]] || shared[ids[1]] || shared[ids[2]])
+        {
+            partLocked[ids[0]] = partLocked[ids[1]] = partLocked[ids[2]] = 1;
+        }
+    }
+
+    std::vector<uint8_t> userLocked(numVertices, 0);
+    for (size_t vertex = 0; vertex < numVertices; vertex++)
+    {
+        userLocked[vertex] = options.lockedVertices && options.lockedVertices[vertex];
+        partLocked[vertex] = partLocked[vertex] || userLocked[vertex];
+    }
+
+    std::vector<SimplificationResult> partResults(numParts);
+    #pragma omp parallel for schedule(dynamic)
+    for (int64_t part = 0; part < numParts; part++)
+    {
+        size_t begin = part * partFaces;
+        size_t end = std::min(begin + partFaces, numFaces);
+
+        std::vector<uint32_t> partFaceIds;
+        partFaceIds.reserve((end - begin) * 3);
+        size_t lockedFaces = 0;
+        for (size_t i = begin; i < end; i++)
+        {
+            const uint32_t* ids = faceIds + mortonOrder[i] * 3;
+            partFaceIds.insert(partFaceIds.end(), ids, ids + 3);
+            lockedFaces += partLocked[ids[0]] || partLocked[ids[1]] || partLocked[ids[2]];
+        }
+
+        // the faces around locked vertices are left to the final pass, forcing the interior down to the share of
+        // the whole part would collapse it much further than the rest of the mesh
+        SimplificationOptions partOptions = options;
+        partOptions.targetFaces = options.targetFaces == 0 ? 0
+            : (options.targetFaces * (end - begin) + numFaces - 1) / numFaces + lockedFaces;
+
+        SimplificationResult& result = partResults[part];
+        result = simplifyCompact(vertices, partFaceIds, partOptions, partLocked.data());
+        for (uint32_t& face : result.faceMap)
+        {
+            face = mortonOrder[begin + face];
+        }
+    }
+
+    // merge the parts and simplify the already reduced mesh once more, which removes the dense seams between the
+    // parts and reaches the exact target
+    SimplificationResult merged;
+    for (SimplificationResult& result : partResults)
+    {
+        merged.faceIds.insert(merged.faceIds.end(), result.faceIds.begin(), result.faceIds.end());
+        merged.faceMap.insert(merged.faceMap.end(), result.faceMap.begin(), result.faceMap.end());
+        merged.error = std::max(merged.error, result.error);
+        result = SimplificationResult();
+    }
+
+    SimplificationResult result = simplifyCompact(vertices, merged.faceIds, options, userLocked.data());
+    for (uint32_t& face : result.faceMap)
+    {
+        face = merged.faceMap[face];
+    }
+    result.error = std::max(result.error, merged.error);
+    return result;
+}
+
+} // namespace hdf5_map_io
@@ -0,0 +1,66 @@
+/*
+ * reorder_map.cpp
+ *
+ * Writes a copy of an HDF5 map with its faces and vertices in a cache friendly order, see computeMeshOrder. All
+ * vertex channels, material face indices, labels and levels of detail are remapped accordingly.
+ *
+ * usage: reorder_map <input> <output> [cache size]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "hdf5_map_io/hdf5_map_io.h"
+#include "hdf5_map_io/mesh_reordering.h"
+
+namespace
+{
+
+float averageCacheMissRatio(hdf5_map_io::HDF5MapIO& map, size_t cacheSize)
+{
+    std::vector<uint32_t> faceIds = map.getFaceIds();
+    return hdf5_map_io::averageCacheMissRatio(faceIds.data(), faceIds.size() / 3, map.getNumVertices(), cacheSize);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc != 3 && argc != 4)
+    {
+        std::cerr << "usage: " << argv[0] << " <input> <output> [cache size]" << std::endl
+                  << "  writes the map with its faces and vertices in a cache friendly order" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const std::string input = argv[1];
+    const std::string output = argv[2];
+    const size_t cacheSize = argc == 4 ? std::stoul(argv[3]) : 32;
+    auto start = std::chrono::steady_clock::now();
+
+    try
+    {
+        hdf5_map_io::HDF5MapIO map(input);
+        std::cout << "Average cache miss ratio of " << input << ": " << averageCacheMissRatio(map, cacheSize)
+                  << std::endl;
+
+        hdf5_map_io::writeReorderedMap(map, output, cacheSize);
+
+        hdf5_map_io::HDF5MapIO reordered(output);
+        std::cout << "Average cache miss ratio of " << output << ": " << averageCacheMissRatio(reordered, cacheSize)
+                  << std::endl;
+    }
+    catch (const char* error)
+    {
+        std::cerr << error << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "Reordered " << input << " to " << output << " in "
+              << std::chrono::duration<double>(end - start).count() << " s." << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+/*
+ * simplification_benchmark.cpp
+ *
+ * Times simplifyMeshParallel on a synthetic terrain mesh, 10M faces reduced to 1M faces by default. The result is
+ * checked to be a valid manifold mesh: no face references a missing vertex or a vertex twice, every edge is shared
+ * by at most two faces and each face has its input face in the face map.
+ *
+ * usage: simplification_benchmark [faces] [target faces]
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "hdf5_map_io/mesh_simplification.h"
+
+namespace
+{
+
+/// Distance of the rows and columns of the terrain
+const float CELL_SIZE = 0.05f;
+
+/**
+ * @brief Creates a size x size terrain of rolling hills with some noise, two faces per cell
+ */
+void createTerrain(size_t size, std::vector<float>& vertices, std::vector<uint32_t>& faceIds)
+{
+    std::mt19937 generator(42);
+    std::normal_distribution<float> noise(0.0f, 0.005f);
+
+    vertices.clear();
+    vertices.reserve(size * size * 3);
+    for (size_t row = 0; row < size; row++)
+    {
+        for (size_t column = 0; column < size; column++)
+        {
+            const float x = column * CELL_SIZE;
+            const float y = row * CELL_SIZE;
+            vertices.push_back(x);
+            vertices.push_back(y);
+            vertices.push_back(0.5f * std::sin(0.3f * x) * std::cos(0.2f * y) + noise(generator));
+        }
+    }
+
+    faceIds.clear();
+    faceIds.reserve((size - 1) * (size - 1) * 6);
+    for (uint32_t row = 0; row + 1 < size; row++)
+    {
+        for (uint32_t column = 0; column + 1 < size; column++)
+        {
+            const uint32_t a = row * size + column;
+            const uint32_t b = a + size;
+            faceIds.insert(faceIds.end(), {a, a + 1, b + 1});
+            faceIds.insert(faceIds.end(), {a, b + 1, b});
+        }
+    }
+}
+
+/**
+ * @brief Returns the number of problems of the simplified mesh, see the file comment
+ */
+size_t countProblems(const hdf5_map_io::SimplificationResult& result, size_t numVertices, size_t numFaces)
+{
+    size_t problems = 0;
+    const size_t resultFaces = result.faceIds.size() / 3;
+    if (result.faceMap.size() != resultFaces)
+    {
+        problems++;
+    }
+
+    std::unordered_map<uint64_t, uint32_t> edgeFaces;
+    edgeFaces.reserve(resultFaces * 2);
+    for (size_t face = 0; face < resultFaces; face++)
+    {
+        const uint32_t* ids = &result.faceIds[face * 3];
+        if (ids[0] >= numVertices || ids[1] >= numVertices || ids[2] >= numVertices
+            || ids[0] == ids[1] || ids[1] == ids[2] || ids[0] == ids[2])
+        {
+            problems++;
+            continue;
+        }
+        if (face < result.faceMap.size() && result.faceMap[face] >= numFaces)
+        {
+            problems++;
+        }
+
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            const uint64_t a = std::min(ids[corner], ids[(corner + 1) % 3]);
+            const uint64_t b = std::max(ids[corner], ids[(corner + 1) % 3]);
+            if (++edgeFaces[a << 32 | b] == 3)
+            {
+                problems++;
+            }
+        }
+    }
+    return problems;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc > 3)
+    {
+        std::cerr << "usage: " << argv[0] << " [faces] [target faces]" << std::endl
+                  << "  times the parallel simplification of a synthetic terrain" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const size_t requestedFaces = argc > 1 ? std::stoul(argv[1]) : 10000000;
+    const size_t size = std::max<size_t>(2, std::ceil(std::sqrt(requestedFaces / 2.0)) + 1);
+    std::vector<float> vertices;
+    std::vector<uint32_t> faceIds;
+    createTerrain(size, vertices, faceIds);
+    const size_t numVertices = vertices.size() / 3;
+    const size_t numFaces = faceIds.size() / 3;
+
+    hdf5_map_io::SimplificationOptions options;
+    options.targetFaces = argc > 2 ? std::stoul(argv[2]) : numFaces / 10;
+    std::cout << "Terrain with " << numVertices << " vertices and " << numFaces << " faces, target "
+              << options.targetFaces << " faces" << std::endl;
+
+    try
+    {
+        auto start = std::chrono::steady_clock::now();
+        hdf5_map_io::SimplificationResult result = hdf5_map_io::simplifyMeshParallel(
+            vertices.data(), numVertices, faceIds.data(), numFaces, options);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Simplified to " << result.faceIds.size() / 3 << " faces in " << seconds << " s, "
+                  << numFaces / seconds / 1e3 << " k input faces/s, error " << std::sqrt(result.error)
+                  << std::endl;
+
+        const size_t problems = countProblems(result, numVertices, numFaces);
+        std::cout << "Problems of the simplified mesh: " << problems << std::endl;
+
+        return problems == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    catch (const char* error)
+    {
+        std::cerr << error << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,328 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "hdf5_map_io/aabb_tree.h"
+
+using hdf5_map_io::AABBTree;
+using hdf5_map_io::PointHit;
+using hdf5_map_io::RayHit;
+
+namespace
+{
+
+/// Number of vertices per row and column of the terrain
+const size_t GRID_SIZE = 60;
+const float CELL_SIZE = 0.1f;
+
+/// Number of loose triangles floating above the terrain
+const size_t NUM_LOOSE_FACES = 200;
+
+/// Number of random queries of each kind
+const size_t NUM_QUERIES = 500;
+
+const float TOLERANCE = 1e-4f;
+
+float dot(const float a[3], const float b[3])
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+void cross(const float a[3], const float b[3], float result[3])
+{
+    result[0] = a[1] * b[2] - a[2] * b[1];
+    result[1] = a[2] * b[0] - a[0] * b[2];
+    result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+void subtract(const float a[3], const float b[3], float result[3])
+{
+    result[0] = a[0] - b[0];
+    result[1] = a[1] - b[1];
+    result[2] = a[2] - b[2];
+}
+
+/**
+ * @brief Ray parameter of the hit of a ray with a triangle, hit from both sides, or infinity if it is missed
+ */
+float intersectTriangle(const float origin[3], const float direction[3], const float a[3], const float b[3],
+                        const float c[3])
+{
+    float ab[3], ac[3], p[3], t[3], q[3];
+    subtract(b, a, ab);
+    subtract(c, a, ac);
+    cross(direction, ac, p);
+    const float determinant = dot(ab, p);
+    if (std::abs(determinant) < 1e-12f)
+    {
+        return std::numeric_limits<float>::infinity();
+    }
+
+    subtract(origin, a, t);
+    const float u = dot(t, p) / determinant;
+    cross(t, ab, q);
+    const float v = dot(direction, q) / determinant;
+    const float distance = dot(ac, q) / determinant;
+    if (u < 0 || v < 0 || u + v > 1 || distance < 0)
+    {
+        return std::numeric_limits<float>::infinity();
+    }
+    return distance;
+}
+
+/**
+ * @brief Closest point on a triangle, by projecting onto the plane and clamping to the edges otherwise
+ */
+float pointTriangleDistance(const float point[3], const float a[3], const float b[3], const float c[3])
+{
+    float ab[3], ac[3], normal[3], ap[3];
+    subtract(b, a, ab);
+    subtract(c, a, ac);
+    cross(ab, ac, normal);
+    subtract(point, a, ap);
+
+    // inside the prism over the triangle the distance is the one to the plane
+    const float area = dot(normal, normal);
+    float inner[3];
+    cross(ap, ac, inner);
+    const float u = dot(inner, normal) / area;
+    cross(ab, ap, inner);
+    const float v = dot(inner, normal) / area;
+    if (u >= 0 && v >= 0 && u + v <= 1)
+    {
+        return std::abs(dot(ap, normal)) / std::sqrt(area);
+    }
+
+    // otherwise the closest point lies on one of the edges
+    float closest = std::numeric_limits<float>::infinity();
+    const float* corners[3] = {a, b, c};
+    for (size_t edge = 0; edge < 3; edge++)
+    {
+        const float* start = corners[edge];
+        const float* end = corners[(edge + 1) % 3];
+        float direction[3], offset[3];
+        subtract(end, start, direction);
+        subtract(point, start, offset);
+        const float t = std::max(0.0f, std::min(1.0f, dot(offset, direction) / dot(direction, direction)));
+        float difference[3];
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            difference[axis] = offset[axis] - t * direction[axis];
+        }
+        closest = std::min(closest, std::sqrt(dot(difference, difference)));
+    }
+    return closest;
+}
+
+/**
+ * @brief A bumpy terrain with loose triangles of random size and orientation above it
+ */
+class AABBTreeTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        std::mt19937 generator(11);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for (size_t row = 0; row < GRID_SIZE; row++)
+        {
+            for (size_t column = 0; column < GRID_SIZE; column++)
+            {
+                vertices.push_back(column * CELL_SIZE);
+                vertices.push_back(row * CELL_SIZE);
+                vertices.push_back(0.2f * std::sin(column * 0.3f) * std::cos(row * 0.2f) + 0.02f * unit(generator));
+            }
+        }
+        for (uint32_t row = 0; row + 1 < GRID_SIZE; row++)
+        {
+            for (uint32_t column = 0; column + 1 < GRID_SIZE; column++)
+            {
+                const uint32_t a = row * GRID_SIZE + column;
+                const uint32_t b = a + GRID_SIZE;
+                faceIds.insert(faceIds.end(), {a, a + 1, b + 1, a, b + 1, b});
+            }
+        }
+
+        for (size_t i = 0; i < NUM_LOOSE_FACES; i++)
+        {
+            const float center[3] = {extent() * unit(generator), extent() * unit(generator), 0.3f + unit(generator)};
+            const float size = 0.02f + 0.3f * unit(generator);
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                for (size_t axis = 0; axis < 3; axis++)
+                {
+                    vertices.push_back(center[axis] + size * (unit(generator) - 0.5f));
+                }
+                faceIds.push_back(vertices.size() / 3 - 1);
+            }
+        }
+    }
+
+    float extent() const
+    {
+        return (GRID_SIZE - 1) * CELL_SIZE;
+    }
+
+    size_t numFaces() const
+    {
+        return faceIds.size() / 3;
+    }
+
+    const float* corner(size_t face, size_t corner) const
+    {
+        return &vertices[faceIds[face * 3 + corner] * 3];
+    }
+
+    std::vector<float> vertices;
+    std::vector<uint32_t> faceIds;
+};
+
+} // namespace
+
+TEST_F(AABBTreeTest, RaysMatchBruteForce)
+{
+    AABBTree tree(vertices, faceIds);
+    ASSERT_EQ(numFaces(), tree.numFaces());
+
+    std::mt19937 generator(17);
+    std::uniform_real_distribution<float> position(-0.5f, extent() + 0.5f);
+    std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+    size_t hits = 0;
+    for (size_t query = 0; query < NUM_QUERIES; query++)
+    {
+        // rays from above, mostly downwards, and from within the loose triangles in any direction
+        const float origin[3] = {position(generator), position(generator), query % 2 == 0 ? 2.0f : 0.6f};
+        float direction[3] = {component(generator), component(generator), component(generator)};
+        if (query % 2 == 0)
+        {
+            direction[2] = -1.0f - std::abs(direction[2]);
+        }
+
+        float expected = std::numeric_limits<float>::infinity();
+        for (size_t face = 0; face < numFaces(); face++)
+        {
+            expected = std::min(expected, intersectTriangle(origin, direction, corner(face, 0), corner(face, 1),
+                                                            corner(face, 2)));
+        }
+
+        RayHit hit;
+        const bool found = tree.intersectRay(origin, direction, hit);
+        ASSERT_EQ(std::isfinite(expected), found) << "ray " << query;
+        if (!found)
+        {
+            continue;
+        }
+        hits++;
+
+        EXPECT_NEAR(expected, hit.distance, TOLERANCE) << "ray " << query;
+        ASSERT_LT(hit.face, numFaces());
+        EXPECT_NEAR(hit.distance, intersectTriangle(origin, direction, corner(hit.face, 0), corner(hit.face, 1),
+                                                    corner(hit.face, 2)), TOLERANCE);
+
+        // the barycentric coordinates give the hit point
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            const float point = (1 - hit.u - hit.v) * corner(hit.face, 0)[axis] + hit.u * corner(hit.face, 1)[axis]
+                + hit.v * corner(hit.face, 2)[axis];
+            EXPECT_NEAR(origin[axis] + hit.distance * direction[axis], point, TOLERANCE);
+        }
+
+        // hits beyond the maximum distance are ignored
+        RayHit limited;
+        EXPECT_FALSE(tree.intersectRay(origin, direction, limited, hit.distance * 0.99f));
+    }
+
+    // most of the rays from above hit the terrain
+    EXPECT_GT(hits, NUM_QUERIES / 3);
+}
+
+TEST_F(AABBTreeTest, ClosestPointsMatchBruteForce)
+{
+    AABBTree tree(vertices, faceIds);
+
+    std::mt19937 generator(19);
+    std::uniform_real_distribution<float> position(-0.5f, extent() + 0.5f);
+    std::uniform_real_distribution<float> height(-0.5f, 1.5f);
+    for (size_t query = 0; query < NUM_QUERIES; query++)
+    {
+        const float point[3] = {position(generator), position(generator), height(generator)};
+
+        float expected = std::numeric_limits<float>::infinity();
+        for (size_t face = 0; face < numFaces(); face++)
+        {
+            expected = std::min(expected, pointTriangleDistance(point, corner(face, 0), corner(face, 1),
+                                                                corner(face, 2)));
+        }
+
+        PointHit hit;
+        ASSERT_TRUE(tree.closestPoint(point, hit));
+        EXPECT_NEAR(expected, hit.distance, TOLERANCE) << "point " << query;
+        ASSERT_LT(hit.face, numFaces());
+
+        float offset[3];
+        subtract(point, hit.point, offset);
+        EXPECT_NEAR(hit.distance, std::sqrt(dot(offset, offset)), TOLERANCE);
+
+        PointHit limited;
+        EXPECT_FALSE(tree.closestPoint(point, limited, expected * 0.99f));
+    }
+}
+
+TEST_F(AABBTreeTest, RegionsMatchBruteForce)
+{
+    AABBTree tree(vertices, faceIds);
+
+    std::mt19937 generator(23);
+    std::uniform_real_distribution<float> position(-0.5f, extent() + 0.5f);
+    std::uniform_real_distribution<float> size(0.0f, 1.0f);
+    for (size_t query = 0; query < NUM_QUERIES / 10; query++)
+    {
+        const float center[3] = {position(generator), position(generator), size(generator)};
+        const float radius = size(generator);
+        const float min[3] = {center[0] - radius, center[1] - radius, center[2] - radius};
+        const float max[3] = {center[0] + radius, center[1] + radius, center[2] + radius};
+
+        std::vector<uint32_t> expectedInBox;
+        std::vector<uint32_t> expectedInSphere;
+        for (uint32_t face = 0; face < numFaces(); face++)
+        {
+            bool overlaps = true;
+            for (size_t axis = 0; axis < 3; axis++)
+            {
+                const float low = std::min({corner(face, 0)[axis], corner(face, 1)[axis], corner(face, 2)[axis]});
+                const float high = std::max({corner(face, 0)[axis], corner(face, 1)[axis], corner(face, 2)[axis]});
+                overlaps = overlaps && low <= max[axis] && high >= min[axis];
+            }
+            if (overlaps)
+            {
+                expectedInBox.push_back(face);
+            }
+
+            // faces right at the border may be decided either way by rounding
+            const float distance = pointTriangleDistance(center, corner(face, 0), corner(face, 1), corner(face, 2));
+            if (std::abs(distance - radius) > TOLERANCE && distance < radius)
+            {
+                expectedInSphere.push_back(face);
+            }
+        }
+
+        std::vector<uint32_t> inBox;
+        tree.facesInBox(min, max, inBox);
+        EXPECT_EQ(expectedInBox, inBox) << "box " << query;
+
+        std::vector<uint32_t> inSphere;
+        tree.facesInSphere(center, radius, inSphere);
+        EXPECT_TRUE(std::is_sorted(inSphere.begin(), inSphere.end()));
+        EXPECT_TRUE(std::includes(inSphere.begin(), inSphere.end(), expectedInSphere.begin(), expectedInSphere.end()))
+            << "sphere " << query;
+        for (uint32_t face : inSphere)
+        {
+            EXPECT_LE(pointTriangleDistance(center, corner(face, 0), corner(face, 1), corner(face, 2)),
+                      radius + TOLERANCE) << "sphere " << query << ", face " << face;
+        }
+    }
+}
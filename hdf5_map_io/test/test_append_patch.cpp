@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "hdf5_map_io/hdf5_map_io.h"
+
+using hdf5_map_io::HDF5MapIO;
+using hdf5_map_io::MapMaterial;
+using hdf5_map_io::MapPatch;
+
+namespace
+{
+
+/**
+ * @brief A map of a single face, patches add a second face next to it
+ */
+class AppendPatchTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        char name[] = "/tmp/hdf5_map_io_test_append_patch_XXXXXX";
+        int fd = mkstemp(name);
+        ASSERT_GE(fd, 0);
+        close(fd);
+        filename = name;
+    }
+
+    void TearDown() override
+    {
+        remove(filename.c_str());
+    }
+
+    MapPatch nextFace() const
+    {
+        MapPatch patch;
+        patch.vertices = {1, 1, 0};
+        patch.faceIds = {1, 3, 2};
+        return patch;
+    }
+
+    std::vector<float> vertices = {0, 0, 0, 1, 0, 0, 0, 1, 0};
+    std::vector<uint32_t> faceIds = {0, 1, 2};
+    std::string filename;
+};
+
+} // namespace
+
+TEST_F(AppendPatchTest, ExtendsAllChannels)
+{
+    HDF5MapIO map(filename, vertices, faceIds);
+    std::vector<float> normals = {0, 0, 1, 0, 0, 1, 0, 0, 1};
+    std::vector<uint8_t> colors = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+    map.addVertexNormals(normals);
+    map.addVertexColors(colors);
+    map.writeVertexCosts("cost", {0.1f, 0.2f, 0.3f});
+
+    MapPatch patch = nextFace();
+    patch.normals = {0, 1, 0};
+    patch.colors = {10, 11, 12};
+    patch.costs["cost"] = {0.4f};
+    EXPECT_EQ(3u, map.appendPatch(patch));
+
+    EXPECT_EQ(4u, map.getNumVertices());
+    EXPECT_EQ(2u, map.getNumFaces());
+    EXPECT_EQ(std::vector<uint32_t>({0, 1, 2, 1, 3, 2}), map.getFaceIds());
+    EXPECT_EQ(std::vector<float>({0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 1, 0}), map.getVertexNormals());
+    EXPECT_EQ(std::vector<uint8_t>({1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12}), map.getVertexColors());
+    EXPECT_EQ(std::vector<float>({0.1f, 0.2f, 0.3f, 0.4f}), map.getVertexCosts("cost"));
+}
+
+TEST_F(AppendPatchTest, RejectsIncompletePatches)
+{
+    HDF5MapIO map(filename, vertices, faceIds);
+    map.writeVertexCosts("cost", {0.1f, 0.2f, 0.3f});
+
+    // the cost layer of the map is missing
+    EXPECT_ANY_THROW(map.appendPatch(nextFace()));
+
+    // a face references a vertex which does not exist
+    MapPatch patch = nextFace();
+    patch.costs["cost"] = {0.4f};
+    patch.faceIds = {1, 4, 2};
+    EXPECT_ANY_THROW(map.appendPatch(patch));
+
+    // a channel which the map does not have
+    patch = nextFace();
+    patch.costs["cost"] = {0.4f};
+    patch.costs["other"] = {0.4f};
+    EXPECT_ANY_THROW(map.appendPatch(patch));
+
+    // nothing has been written by the failed patches
+    EXPECT_EQ(3u, map.getNumVertices());
+    EXPECT_EQ(1u, map.getNumFaces());
+    EXPECT_EQ(3u, map.getVertexCosts("cost").size());
+}
+
+TEST_F(AppendPatchTest, RejectsMapsWithTextureCoordinates)
+{
+    HDF5MapIO map(filename, vertices, faceIds);
+    std::vector<float> coords = {0, 0, 1, 0, 0, 1};
+    map.addVertexTextureCoords(coords);
+
+    EXPECT_ANY_THROW(map.appendPatch(nextFace()));
+    EXPECT_EQ(3u, map.getNumVertices());
+}
+
+TEST_F(AppendPatchTest, RejectsMapsWithMaterials)
+{
+    HDF5MapIO map(filename, vertices, faceIds);
+    std::vector<MapMaterial> materials = {{-1, 255, 0, 0}};
+    std::vector<uint32_t> materialFaceIds = {0};
+    map.addMaterials(materials, materialFaceIds);
+
+    EXPECT_ANY_THROW(map.appendPatch(nextFace()));
+    EXPECT_EQ(1u, map.getNumFaces());
+}
@@ -0,0 +1,270 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "hdf5_map_io/cost_inflation.h"
+#include "hdf5_map_io/mesh_adjacency.h"
+
+using hdf5_map_io::CostInflation;
+using hdf5_map_io::InflationOptions;
+using hdf5_map_io::MeshAdjacency;
+
+namespace
+{
+
+const float INFINITE_DISTANCE = std::numeric_limits<float>::infinity();
+
+/// Tolerance of the distances and costs, the edge lengths may be summed in a different order
+const float TOLERANCE = 1e-4f;
+
+/// Number of vertices per row and column of the test mesh
+const size_t GRID_SIZE = 80;
+const float CELL_SIZE = 0.05f;
+
+/**
+ * @brief A jittered, bumpy grid mesh with random costs, a few percent of the vertices are lethal
+ */
+class CostInflationTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+#ifdef _OPENMP
+        // the regions of propagate only meet concurrently with several threads
+        omp_set_num_threads(4);
+#endif
+
+        std::mt19937 generator(13);
+        std::uniform_real_distribution<float> jitter(-0.3f * CELL_SIZE, 0.3f * CELL_SIZE);
+        std::uniform_real_distribution<float> height(0.0f, 0.05f);
+        for (size_t row = 0; row < GRID_SIZE; row++)
+        {
+            for (size_t column = 0; column < GRID_SIZE; column++)
+            {
+                vertices.push_back(column * CELL_SIZE + jitter(generator));
+                vertices.push_back(row * CELL_SIZE + jitter(generator));
+                vertices.push_back(height(generator));
+            }
+        }
+
+        std::vector<uint32_t> faceIds;
+        for (uint32_t row = 0; row + 1 < GRID_SIZE; row++)
+        {
+            for (uint32_t column = 0; column + 1 < GRID_SIZE; column++)
+            {
+                const uint32_t a = row * GRID_SIZE + column;
+                const uint32_t b = a + GRID_SIZE;
+                faceIds.insert(faceIds.end(), {a, a + 1, b + 1});
+                faceIds.insert(faceIds.end(), {a, b + 1, b});
+            }
+        }
+        adjacency = hdf5_map_io::buildVertexAdjacency(faceIds.data(), faceIds.size() / 3, numVertices());
+
+        costs = randomCosts(generator, numVertices());
+    }
+
+    size_t numVertices() const
+    {
+        return vertices.size() / 3;
+    }
+
+    std::vector<float> randomCosts(std::mt19937& generator, size_t count) const
+    {
+        std::uniform_real_distribution<float> cost(0.0f, 0.5f);
+        std::bernoulli_distribution lethal(0.02);
+        std::vector<float> result(count);
+        for (float& value : result)
+        {
+            value = lethal(generator) ? options.lethalCost : cost(generator);
+        }
+        return result;
+    }
+
+    float edgeLength(uint32_t a, uint32_t b) const
+    {
+        const float dx = vertices[b * 3] - vertices[a * 3];
+        const float dy = vertices[b * 3 + 1] - vertices[a * 3 + 1];
+        const float dz = vertices[b * 3 + 2] - vertices[a * 3 + 2];
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    /**
+     * @brief Multi source Dijkstra with a binary heap, bounded by the inflation radius
+     */
+    std::vector<float> referenceDistances(const std::vector<float>& layer) const
+    {
+        typedef std::pair<float, uint32_t> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+        std::vector<float> distances(layer.size(), INFINITE_DISTANCE);
+        for (uint32_t vertex = 0; vertex < layer.size(); vertex++)
+        {
+            if (layer[vertex] >= options.lethalCost)
+            {
+                distances[vertex] = 0;
+                queue.push(Entry(0.0f, vertex));
+            }
+        }
+
+        while (!queue.empty())
+        {
+            const Entry entry = queue.top();
+            queue.pop();
+            if (entry.first > distances[entry.second])
+            {
+                continue;
+            }
+            for (uint32_t neighbor : adjacency[entry.second])
+            {
+                const float distance = entry.first + edgeLength(entry.second, neighbor);
+                if (distance <= options.inflationRadius && distance < distances[neighbor])
+                {
+                    distances[neighbor] = distance;
+                    queue.push(Entry(distance, neighbor));
+                }
+            }
+        }
+        return distances;
+    }
+
+    float referenceInflatedCost(float cost, float distance) const
+    {
+        float inflated = 0.0f;
+        if (distance <= options.inscribedRadius)
+        {
+            inflated = options.lethalCost;
+        }
+        else if (distance <= options.inflationRadius)
+        {
+            inflated = options.lethalCost * std::exp(-options.costScalingFactor * (distance - options.inscribedRadius));
+        }
+        return std::max(cost, inflated);
+    }
+
+    void expectNear(const std::vector<float>& expected, const std::vector<float>& actual) const
+    {
+        ASSERT_EQ(expected.size(), actual.size());
+        for (size_t i = 0; i < expected.size(); i++)
+        {
+            if (std::isinf(expected[i]))
+            {
+                EXPECT_TRUE(std::isinf(actual[i])) << "vertex " << i;
+            }
+            else
+            {
+                EXPECT_NEAR(expected[i], actual[i], TOLERANCE) << "vertex " << i;
+            }
+        }
+    }
+
+    std::vector<float> distancesOf(const CostInflation& inflation) const
+    {
+        std::vector<float> distances(numVertices());
+        for (size_t vertex = 0; vertex < distances.size(); vertex++)
+        {
+            distances[vertex] = inflation.getDistance(vertex);
+        }
+        return distances;
+    }
+
+    std::vector<float> vertices;
+    MeshAdjacency adjacency;
+    std::vector<float> costs;
+    InflationOptions options;
+};
+
+} // namespace
+
+TEST_F(CostInflationTest, InflateMatchesDijkstra)
+{
+    CostInflation inflation(vertices.data(), adjacency.view(), options);
+    inflation.inflate(costs);
+
+    std::vector<float> distances = referenceDistances(costs);
+    expectNear(distances, distancesOf(inflation));
+
+    std::vector<float> inflated(costs.size());
+    for (size_t vertex = 0; vertex < costs.size(); vertex++)
+    {
+        inflated[vertex] = referenceInflatedCost(costs[vertex], distances[vertex]);
+    }
+    expectNear(inflated, inflation.getInflatedCosts());
+    EXPECT_EQ(costs, inflation.getCosts());
+}
+
+TEST_F(CostInflationTest, UpdateMatchesInflatingAgain)
+{
+    CostInflation inflation(vertices.data(), adjacency.view(), options);
+    inflation.inflate(costs);
+
+    std::mt19937 generator(21);
+    std::uniform_int_distribution<uint32_t> vertex(0, numVertices() - 1);
+    std::uniform_int_distribution<size_t> updateSize(1, 50);
+    for (size_t round = 0; round < 30; round++)
+    {
+        // single vertices all over the mesh and a few clustered ones, which add and remove lethal vertices
+        std::vector<uint32_t> vertexIds;
+        const size_t count = updateSize(generator);
+        const uint32_t center = vertex(generator);
+        for (size_t i = 0; i < count; i++)
+        {
+            vertexIds.push_back(i % 2 == 0 ? vertex(generator) : std::min<uint32_t>(center + i, numVertices() - 1));
+        }
+        std::vector<float> updatedCosts = randomCosts(generator, count);
+        std::bernoulli_distribution lethal(0.3);
+        for (float& cost : updatedCosts)
+        {
+            cost = lethal(generator) ? options.lethalCost : cost;
+        }
+
+        const std::vector<float> before = inflation.getInflatedCosts();
+        std::vector<uint32_t> changed = inflation.update(vertexIds, updatedCosts);
+        for (size_t i = 0; i < count; i++)
+        {
+            costs[vertexIds[i]] = updatedCosts[i];
+        }
+
+        CostInflation reference(vertices.data(), adjacency.view(), options);
+        reference.inflate(costs);
+        expectNear(distancesOf(reference), distancesOf(inflation));
+        expectNear(reference.getInflatedCosts(), inflation.getInflatedCosts());
+        EXPECT_EQ(costs, inflation.getCosts());
+
+        // exactly the vertices whose inflated cost changed are reported, in ascending order
+        EXPECT_TRUE(std::is_sorted(changed.begin(), changed.end()));
+        std::vector<uint32_t> expectedChanged;
+        for (uint32_t i = 0; i < numVertices(); i++)
+        {
+            if (before[i] != inflation.getInflatedCosts()[i])
+            {
+                expectedChanged.push_back(i);
+            }
+        }
+        EXPECT_EQ(expectedChanged, changed);
+    }
+}
+
+TEST_F(CostInflationTest, RejectsInvalidInput)
+{
+    InflationOptions invalid = options;
+    invalid.inscribedRadius = invalid.inflationRadius * 2;
+    EXPECT_ANY_THROW(CostInflation(vertices.data(), adjacency.view(), invalid));
+
+    CostInflation inflation(vertices.data(), adjacency.view(), options);
+    EXPECT_ANY_THROW(inflation.update({0}, {1.0f}));
+    EXPECT_ANY_THROW(inflation.inflate(std::vector<float>(numVertices() - 1)));
+
+    inflation.inflate(costs);
+    EXPECT_ANY_THROW(inflation.update({uint32_t(numVertices())}, {1.0f}));
+    EXPECT_ANY_THROW(inflation.update({0, 1}, {1.0f}));
+}
@@ -0,0 +1,229 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "hdf5_map_io/hdf5_map_io.h"
+#include "hdf5_map_io/mesh_adjacency.h"
+
+using hdf5_map_io::HDF5MapIO;
+using hdf5_map_io::MapPatch;
+using hdf5_map_io::MeshAdjacency;
+
+namespace
+{
+
+/// Number of vertices per row and column of the test mesh
+const size_t GRID_SIZE = 40;
+
+std::vector<uint32_t> neighborsOf(const MeshAdjacency& adjacency, size_t element)
+{
+    return std::vector<uint32_t>(adjacency[element].begin(), adjacency[element].end());
+}
+
+/**
+ * @brief A grid mesh with randomly flipped diagonals, a few unused vertices and non manifold fins
+ */
+class MeshAdjacencyTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        std::mt19937 generator(3);
+        std::bernoulli_distribution flip(0.5);
+        for (uint32_t row = 0; row + 1 < GRID_SIZE; row++)
+        {
+            for (uint32_t column = 0; column + 1 < GRID_SIZE; column++)
+            {
+                const uint32_t a = row * GRID_SIZE + column;
+                const uint32_t b = a + GRID_SIZE;
+                if (flip(generator))
+                {
+                    faceIds.insert(faceIds.end(), {a, a + 1, b + 1, a, b + 1, b});
+                }
+                else
+                {
+                    faceIds.insert(faceIds.end(), {a, a + 1, b, a + 1, b + 1, b});
+                }
+            }
+        }
+
+        // every fin adds a third face to an edge along the second row, the last vertices stay unused
+        numVertices = GRID_SIZE * GRID_SIZE + 10;
+        for (uint32_t column = 0; column < 5; column++)
+        {
+            const uint32_t a = GRID_SIZE + column;
+            faceIds.insert(faceIds.end(), {a, a + 1, uint32_t(GRID_SIZE * GRID_SIZE + column)});
+        }
+    }
+
+    size_t numFaces() const
+    {
+        return faceIds.size() / 3;
+    }
+
+    /**
+     * @brief The vertices sharing an edge with each vertex, found by looking at every face
+     */
+    std::vector<std::set<uint32_t>> referenceVertexNeighbors() const
+    {
+        std::vector<std::set<uint32_t>> neighbors(numVertices);
+        for (size_t face = 0; face < numFaces(); face++)
+        {
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                const uint32_t vertex = faceIds[face * 3 + corner];
+                neighbors[vertex].insert(faceIds[face * 3 + (corner + 1) % 3]);
+                neighbors[vertex].insert(faceIds[face * 3 + (corner + 2) % 3]);
+            }
+        }
+        return neighbors;
+    }
+
+    /**
+     * @brief The faces sharing two vertices with each face, found by comparing all pairs of faces
+     */
+    std::vector<std::set<uint32_t>> referenceFaceNeighbors() const
+    {
+        std::vector<std::set<uint32_t>> neighbors(numFaces());
+        for (uint32_t face = 0; face < numFaces(); face++)
+        {
+            for (uint32_t other = 0; other < numFaces(); other++)
+            {
+                size_t shared = 0;
+                for (size_t i = 0; i < 3; i++)
+                {
+                    for (size_t j = 0; j < 3; j++)
+                    {
+                        shared += faceIds[face * 3 + i] == faceIds[other * 3 + j];
+                    }
+                }
+                if (other != face && shared == 2)
+                {
+                    neighbors[face].insert(other);
+                }
+            }
+        }
+        return neighbors;
+    }
+
+    std::vector<uint32_t> faceIds;
+    size_t numVertices;
+};
+
+} // namespace
+
+TEST_F(MeshAdjacencyTest, VertexAdjacencyMatchesBruteForce)
+{
+    MeshAdjacency adjacency = hdf5_map_io::buildVertexAdjacency(faceIds.data(), numFaces(), numVertices);
+    ASSERT_EQ(numVertices, adjacency.size());
+
+    std::vector<std::set<uint32_t>> reference = referenceVertexNeighbors();
+    for (uint32_t vertex = 0; vertex < numVertices; vertex++)
+    {
+        // ascending and without duplicates
+        std::vector<uint32_t> neighbors = neighborsOf(adjacency, vertex);
+        EXPECT_EQ(std::vector<uint32_t>(reference[vertex].begin(), reference[vertex].end()), neighbors);
+
+        for (uint32_t neighbor : neighbors)
+        {
+            std::vector<uint32_t> back = neighborsOf(adjacency, neighbor);
+            EXPECT_TRUE(std::binary_search(back.begin(), back.end(), vertex)) << vertex << " " << neighbor;
+        }
+    }
+}
+
+TEST_F(MeshAdjacencyTest, VertexFaceAdjacencyMatchesBruteForce)
+{
+    MeshAdjacency adjacency = hdf5_map_io::buildVertexFaceAdjacency(faceIds.data(), numFaces(), numVertices);
+    ASSERT_EQ(numVertices, adjacency.size());
+
+    std::vector<std::vector<uint32_t>> reference(numVertices);
+    for (uint32_t face = 0; face < numFaces(); face++)
+    {
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            reference[faceIds[face * 3 + corner]].push_back(face);
+        }
+    }
+
+    for (uint32_t vertex = 0; vertex < numVertices; vertex++)
+    {
+        EXPECT_EQ(reference[vertex], neighborsOf(adjacency, vertex));
+    }
+}
+
+TEST_F(MeshAdjacencyTest, FaceAdjacencyMatchesBruteForce)
+{
+    MeshAdjacency adjacency = hdf5_map_io::buildFaceAdjacency(faceIds.data(), numFaces(), numVertices);
+    ASSERT_EQ(numFaces(), adjacency.size());
+
+    std::vector<std::set<uint32_t>> reference = referenceFaceNeighbors();
+    for (uint32_t face = 0; face < numFaces(); face++)
+    {
+        std::vector<uint32_t> neighbors = neighborsOf(adjacency, face);
+        std::sort(neighbors.begin(), neighbors.end());
+        EXPECT_EQ(std::vector<uint32_t>(reference[face].begin(), reference[face].end()), neighbors);
+
+        for (uint32_t neighbor : neighbors)
+        {
+            std::vector<uint32_t> back = neighborsOf(adjacency, neighbor);
+            EXPECT_NE(back.end(), std::find(back.begin(), back.end(), face)) << face << " " << neighbor;
+        }
+    }
+
+    // a fin shares its edge with two faces of the grid, which thus have more than three neighbors
+    const uint32_t fin = numFaces() - 1;
+    ASSERT_EQ(2u, adjacency[fin].size);
+    EXPECT_EQ(4u, adjacency[adjacency[fin][0]].size);
+}
+
+TEST_F(MeshAdjacencyTest, StoredAdjacencyRoundTrip)
+{
+    char name[] = "/tmp/hdf5_map_io_test_adjacency_XXXXXX";
+    int fd = mkstemp(name);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    const std::string filename = name;
+
+    MeshAdjacency vertexAdjacency = hdf5_map_io::buildVertexAdjacency(faceIds.data(), numFaces(), numVertices);
+    MeshAdjacency faceAdjacency = hdf5_map_io::buildFaceAdjacency(faceIds.data(), numFaces(), numVertices);
+    {
+        std::vector<float> vertices(numVertices * 3);
+        for (size_t vertex = 0; vertex < numVertices; vertex++)
+        {
+            vertices[vertex * 3] = vertex % GRID_SIZE;
+            vertices[vertex * 3 + 1] = vertex / GRID_SIZE;
+        }
+
+        HDF5MapIO map(filename, vertices, faceIds);
+        map.addVertexAdjacency(vertexAdjacency);
+        map.addFaceAdjacency(faceAdjacency);
+    }
+
+    {
+        HDF5MapIO map(filename);
+        MeshAdjacency storedVertexAdjacency = map.getVertexAdjacency();
+        MeshAdjacency storedFaceAdjacency = map.getFaceAdjacency();
+        EXPECT_EQ(vertexAdjacency.getOffsets(), storedVertexAdjacency.getOffsets());
+        EXPECT_EQ(vertexAdjacency.getNeighbors(), storedVertexAdjacency.getNeighbors());
+        EXPECT_EQ(faceAdjacency.getOffsets(), storedFaceAdjacency.getOffsets());
+        EXPECT_EQ(faceAdjacency.getNeighbors(), storedFaceAdjacency.getNeighbors());
+
+        // a patch changes the mesh, the stored adjacencies are outdated afterwards
+        MapPatch patch;
+        patch.vertices = {0, 0, 1, 1, 0, 1, 0, 1, 1};
+        patch.faceIds = {uint32_t(numVertices), uint32_t(numVertices + 1), uint32_t(numVertices + 2)};
+        map.appendPatch(patch);
+        EXPECT_TRUE(map.getVertexAdjacency().empty());
+        EXPECT_TRUE(map.getFaceAdjacency().empty());
+    }
+
+    remove(filename.c_str());
+}
@@ -0,0 +1,309 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "hdf5_map_io/hdf5_map_io.h"
+#include "hdf5_map_io/mesh_reordering.h"
+
+using hdf5_map_io::HDF5MapIO;
+using hdf5_map_io::MapPatch;
+using hdf5_map_io::MeshOrder;
+
+namespace
+{
+
+/// Number of vertices per row and column of the test mesh
+const size_t GRID_SIZE = 60;
+
+typedef std::array<uint32_t, 3> Face;
+
+bool isPermutation(const std::vector<uint32_t>& order, size_t size)
+{
+    std::vector<uint32_t> sorted = order;
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<uint32_t> identity(size);
+    std::iota(identity.begin(), identity.end(), 0);
+    return sorted == identity;
+}
+
+/**
+ * @brief A grid mesh whose faces and vertices are shuffled, so there is something to reorder
+ */
+class MeshReorderingTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        std::mt19937 generator(5);
+        std::vector<uint32_t> shuffled(GRID_SIZE * GRID_SIZE);
+        std::iota(shuffled.begin(), shuffled.end(), 0);
+        std::shuffle(shuffled.begin(), shuffled.end(), generator);
+
+        vertices.resize(shuffled.size() * 3);
+        for (size_t gridVertex = 0; gridVertex < shuffled.size(); gridVertex++)
+        {
+            vertices[shuffled[gridVertex] * 3] = gridVertex % GRID_SIZE;
+            vertices[shuffled[gridVertex] * 3 + 1] = gridVertex / GRID_SIZE;
+            vertices[shuffled[gridVertex] * 3 + 2] = 0.1f * (gridVertex % 7);
+        }
+
+        std::vector<Face> faces;
+        for (uint32_t row = 0; row + 1 < GRID_SIZE; row++)
+        {
+            for (uint32_t column = 0; column + 1 < GRID_SIZE; column++)
+            {
+                const uint32_t a = row * GRID_SIZE + column;
+                const uint32_t b = a + GRID_SIZE;
+                faces.push_back({shuffled[a], shuffled[a + 1], shuffled[b + 1]});
+                faces.push_back({shuffled[a], shuffled[b + 1], shuffled[b]});
+            }
+        }
+        std::shuffle(faces.begin(), faces.end(), generator);
+        for (const Face& face : faces)
+        {
+            faceIds.insert(faceIds.end(), face.begin(), face.end());
+        }
+
+        char name[] = "/tmp/hdf5_map_io_test_reordering_XXXXXX";
+        int fd = mkstemp(name);
+        ASSERT_GE(fd, 0);
+        close(fd);
+        filename = name;
+        reorderedFilename = filename + "_reordered";
+    }
+
+    void TearDown() override
+    {
+        remove(filename.c_str());
+        remove(reorderedFilename.c_str());
+    }
+
+    size_t numVertices() const
+    {
+        return vertices.size() / 3;
+    }
+
+    size_t numFaces() const
+    {
+        return faceIds.size() / 3;
+    }
+
+    std::vector<float> vertices;
+    std::vector<uint32_t> faceIds;
+    std::string filename;
+    std::string reorderedFilename;
+};
+
+} // namespace
+
+TEST_F(MeshReorderingTest, OrderIsPermutation)
+{
+    MeshOrder order = hdf5_map_io::computeMeshOrder(vertices.data(), numVertices(), faceIds.data(), numFaces());
+    EXPECT_TRUE(isPermutation(order.faceOrder, numFaces()));
+    EXPECT_TRUE(isPermutation(order.vertexOrder, numVertices()));
+
+    std::vector<uint32_t> morton =
+        hdf5_map_io::mortonFaceOrder(vertices.data(), numVertices(), faceIds.data(), numFaces());
+    EXPECT_TRUE(isPermutation(morton, numFaces()));
+
+    // the faces of the new order, numbered with the new vertex indices
+    std::vector<uint32_t> vertexRemap(numVertices());
+    for (size_t i = 0; i < numVertices(); i++)
+    {
+        vertexRemap[order.vertexOrder[i]] = i;
+    }
+    std::vector<uint32_t> reordered;
+    for (uint32_t face : order.faceOrder)
+    {
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            reordered.push_back(vertexRemap[faceIds[size_t(face) * 3 + corner]]);
+        }
+    }
+
+    // vertices are numbered in the order of their first use
+    uint32_t next = 0;
+    for (uint32_t vertex : reordered)
+    {
+        ASSERT_LE(vertex, next);
+        next = std::max(next, vertex + 1);
+    }
+
+    const float before = hdf5_map_io::averageCacheMissRatio(faceIds.data(), numFaces(), numVertices());
+    const float after = hdf5_map_io::averageCacheMissRatio(reordered.data(), numFaces(), numVertices());
+    EXPECT_GT(before, 2.5f);
+    EXPECT_LT(after, 0.8f);
+}
+
+TEST_F(MeshReorderingTest, ReorderedMapKeepsChannelsAndLabels)
+{
+    // every channel holds the index of its vertex, so the reordered map can be mapped back
+    std::vector<float> normals(vertices.size());
+    std::vector<uint8_t> colors(vertices.size());
+    std::vector<float> costs(numVertices());
+    for (size_t vertex = 0; vertex < numVertices(); vertex++)
+    {
+        normals[vertex * 3] = vertex;
+        normals[vertex * 3 + 2] = 1;
+        colors[vertex * 3] = vertex % 256;
+        colors[vertex * 3 + 1] = vertex / 256;
+        costs[vertex] = vertex;
+    }
+
+    std::vector<uint32_t> labelFaces = {0, 7, 42, uint32_t(numFaces() - 1)};
+    std::vector<uint32_t> lodFaceIds(faceIds.begin(), faceIds.begin() + 300);
+    {
+        HDF5MapIO map(filename, vertices, faceIds);
+        map.addVertexNormals(normals);
+        map.addVertexColors(colors);
+        map.writeVertexCosts("cost", costs);
+        map.addLabel("tree", "1", labelFaces);
+        map.addLodLevel(1, lodFaceIds, 0.5f);
+        map.addVertexAdjacency(hdf5_map_io::buildVertexAdjacency(faceIds.data(), numFaces(), numVertices()));
+    }
+
+    {
+        HDF5MapIO map(filename);
+        hdf5_map_io::writeReorderedMap(map, reorderedFilename);
+    }
+
+    HDF5MapIO reordered(reorderedFilename);
+    std::vector<float> newCosts = reordered.getVertexCosts("cost");
+    ASSERT_EQ(numVertices(), newCosts.size());
+
+    std::vector<uint32_t> oldVertex(numVertices());
+    for (size_t vertex = 0; vertex < numVertices(); vertex++)
+    {
+        oldVertex[vertex] = newCosts[vertex];
+    }
+    ASSERT_TRUE(isPermutation(oldVertex, numVertices()));
+
+    std::vector<float> newVertices = reordered.getVertices();
+    std::vector<float> newNormals = reordered.getVertexNormals();
+    std::vector<uint8_t> newColors = reordered.getVertexColors();
+    ASSERT_EQ(vertices.size(), newVertices.size());
+    ASSERT_EQ(vertices.size(), newNormals.size());
+    ASSERT_EQ(vertices.size(), newColors.size());
+    for (size_t vertex = 0; vertex < numVertices(); vertex++)
+    {
+        const uint32_t old = oldVertex[vertex];
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            EXPECT_EQ(vertices[old * 3 + axis], newVertices[vertex * 3 + axis]);
+            EXPECT_EQ(normals[old * 3 + axis], newNormals[vertex * 3 + axis]);
+            EXPECT_EQ(colors[old * 3 + axis], newColors[vertex * 3 + axis]);
+        }
+    }
+
+    // mapped back to the old vertices, the faces are the same with the same orientation
+    auto oldFaces = [&oldVertex](const std::vector<uint32_t>& ids)
+    {
+        std::vector<std::vector<uint32_t>> faces;
+        for (size_t i = 0; i < ids.size(); i += 3)
+        {
+            std::vector<uint32_t> face = {oldVertex[ids[i]], oldVertex[ids[i + 1]], oldVertex[ids[i + 2]]};
+            std::rotate(face.begin(), std::min_element(face.begin(), face.end()), face.end());
+            faces.push_back(face);
+        }
+        return faces;
+    };
+    auto normalizedFaces = [](const std::vector<uint32_t>& ids)
+    {
+        std::vector<std::vector<uint32_t>> faces;
+        for (size_t i = 0; i < ids.size(); i += 3)
+        {
+            std::vector<uint32_t> face(ids.begin() + i, ids.begin() + i + 3);
+            std::rotate(face.begin(), std::min_element(face.begin(), face.end()), face.end());
+            faces.push_back(face);
+        }
+        return faces;
+    };
+
+    std::vector<uint32_t> newFaceIds = reordered.getFaceIds();
+    std::vector<std::vector<uint32_t>> faces = oldFaces(newFaceIds);
+    std::vector<std::vector<uint32_t>> expected = normalizedFaces(faceIds);
+    std::vector<std::vector<uint32_t>> sortedFaces = faces;
+    std::sort(sortedFaces.begin(), sortedFaces.end());
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(expected, sortedFaces);
+
+    // the label holds the same faces
+    std::vector<uint32_t> newLabelFaces = reordered.getFaceIdsOfLabel("tree", "1");
+    ASSERT_EQ(labelFaces.size(), newLabelFaces.size());
+    std::vector<std::vector<uint32_t>> labelled;
+    for (uint32_t face : newLabelFaces)
+    {
+        ASSERT_LT(face, numFaces());
+        labelled.push_back(faces[face]);
+    }
+    std::vector<uint32_t> labelFaceIds;
+    for (uint32_t face : labelFaces)
+    {
+        labelFaceIds.insert(labelFaceIds.end(), faceIds.begin() + face * 3, faceIds.begin() + face * 3 + 3);
+    }
+    std::vector<std::vector<uint32_t>> expectedLabelled = normalizedFaces(labelFaceIds);
+    std::sort(labelled.begin(), labelled.end());
+    std::sort(expectedLabelled.begin(), expectedLabelled.end());
+    EXPECT_EQ(expectedLabelled, labelled);
+
+    // the level of detail and the adjacency refer to the new vertex indices
+    ASSERT_EQ(1u, reordered.getLodLevels().size());
+    std::vector<uint32_t> newLodFaceIds = reordered.getLodFaceIds(1);
+    EXPECT_EQ(normalizedFaces(lodFaceIds), oldFaces(newLodFaceIds));
+    EXPECT_EQ(0.5f, reordered.getLodLevels()[0].error);
+
+    hdf5_map_io::MeshAdjacency adjacency = reordered.getVertexAdjacency();
+    ASSERT_EQ(numVertices(), adjacency.size());
+    hdf5_map_io::MeshAdjacency expectedAdjacency =
+        hdf5_map_io::buildVertexAdjacency(newFaceIds.data(), numFaces(), numVertices());
+    for (uint32_t vertex = 0; vertex < numVertices(); vertex++)
+    {
+        std::vector<uint32_t> neighbors(adjacency[vertex].begin(), adjacency[vertex].end());
+        std::vector<uint32_t> expectedNeighbors(expectedAdjacency[vertex].begin(), expectedAdjacency[vertex].end());
+        EXPECT_EQ(expectedNeighbors, neighbors);
+    }
+}
+
+TEST_F(MeshReorderingTest, DropsOutdatedLevelsOfDetail)
+{
+    {
+        HDF5MapIO map(filename, vertices, faceIds);
+        std::vector<uint32_t> lodFaceIds(faceIds.begin(), faceIds.begin() + 30);
+        map.addLodLevel(1, lodFaceIds, 0.5f);
+
+        // the patch makes the level outdated and its face ids would reference the wrong vertices
+        MapPatch patch;
+        patch.vertices = {0, 0, 1, 1, 0, 1, 0, 1, 1};
+        patch.faceIds = {uint32_t(numVertices()), uint32_t(numVertices() + 1), uint32_t(numVertices() + 2)};
+        map.appendPatch(patch);
+    }
+
+    {
+        HDF5MapIO map(filename);
+        hdf5_map_io::writeReorderedMap(map, reorderedFilename);
+    }
+
+    HDF5MapIO reordered(reorderedFilename);
+    EXPECT_EQ(numVertices() + 3, reordered.getNumVertices());
+    EXPECT_TRUE(reordered.getLodLevels().empty());
+}
+
+TEST_F(MeshReorderingTest, RejectsLabelsOutsideOfTheMap)
+{
+    {
+        HDF5MapIO map(filename, vertices, faceIds);
+        std::vector<uint32_t> labelFaces = {uint32_t(numFaces())};
+        map.addLabel("tree", "1", labelFaces);
+    }
+
+    HDF5MapIO map(filename);
+    EXPECT_ANY_THROW(hdf5_map_io::writeReorderedMap(map, reorderedFilename));
+}
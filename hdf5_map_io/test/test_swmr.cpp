@@ -0,0 +1,226 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "hdf5_map_io/hdf5_map_io.h"
+
+using hdf5_map_io::HDF5MapIO;
+using hdf5_map_io::MapPatch;
+
+namespace
+{
+
+/// Number of vertices of a row of the grid, every patch adds one row
+const size_t ROW_SIZE = 64;
+/// Number of faces between two rows
+const size_t ROW_FACES = 2 * (ROW_SIZE - 1);
+/// Number of rows of the map before the readers attach
+const size_t INITIAL_ROWS = 2;
+/// Number of patches appended by the writer
+const size_t NUM_ROUNDS = 50;
+const size_t NUM_READERS = 3;
+const size_t FINAL_VERTICES = (INITIAL_ROWS + NUM_ROUNDS) * ROW_SIZE;
+
+/**
+ * @brief Returns the vertices of a row of the grid
+ */
+std::vector<float> gridRow(size_t row)
+{
+    std::vector<float> vertices;
+    for (size_t column = 0; column < ROW_SIZE; column++)
+    {
+        vertices.push_back(column);
+        vertices.push_back(row);
+        vertices.push_back(0);
+    }
+    return vertices;
+}
+
+/**
+ * @brief Returns the faces between a row of the grid and the one before it
+ */
+std::vector<uint32_t> gridFaces(size_t row)
+{
+    std::vector<uint32_t> faceIds;
+    const uint32_t first = (row - 1) * ROW_SIZE;
+    for (uint32_t column = 0; column + 1 < ROW_SIZE; column++)
+    {
+        const uint32_t a = first + column;
+        const uint32_t b = a + ROW_SIZE;
+        faceIds.insert(faceIds.end(), {a, a + 1, b});
+        faceIds.insert(faceIds.end(), {a + 1, b + 1, b});
+    }
+    return faceIds;
+}
+
+/**
+ * @brief Reads the map until the writer has appended all patches and checks that every state it sees is consistent.
+ *
+ * The faces are read before the vertices and the vertices before the costs, the writer appends them in the opposite
+ * order. So the faces may never reference a vertex the reader has not seen and the costs must cover all vertices.
+ *
+ * @return An error message, empty if all states were consistent
+ */
+std::string readConcurrently(const std::string& filename)
+{
+    HDF5MapIO map(filename, HDF5MapIO::SwmrRead);
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    size_t lastVertices = 0;
+    size_t lastFaces = 0;
+    while (lastVertices < FINAL_VERTICES)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+            return "timed out before the writer appended all patches";
+
+        std::vector<uint32_t> faceIds = map.getFaceIds();
+        std::vector<float> vertices = map.getVertices();
+        std::vector<float> costs = map.getVertexCosts("cost");
+
+        const size_t numVertices = vertices.size() / 3;
+        const size_t numFaces = faceIds.size() / 3;
+        if (vertices.size() % 3 != 0 || faceIds.size() % 3 != 0)
+            return "a geometry data set has an incomplete entry";
+        if (numVertices % ROW_SIZE != 0 || numFaces % ROW_FACES != 0)
+            return "a patch is only visible in parts";
+        if (numVertices < lastVertices || numFaces < lastFaces)
+            return "the map shrank";
+        for (uint32_t id : faceIds)
+        {
+            if (id >= numVertices)
+                return "a face references a vertex which is not visible yet";
+        }
+        if (costs.size() < numVertices)
+            return "the cost layer does not cover all vertices";
+        for (float cost : costs)
+        {
+            if (!std::isfinite(cost) || cost < 0 || cost > NUM_ROUNDS)
+                return "the cost layer contains a value which has never been written";
+        }
+
+        lastVertices = numVertices;
+        lastFaces = numFaces;
+    }
+
+    if (map.getNumFaces() != (INITIAL_ROWS + NUM_ROUNDS - 1) * ROW_FACES)
+        return "the number of faces does not match the number of vertices";
+
+    return "";
+}
+
+} // namespace
+
+TEST(SwmrTest, ReadersSeeConsistentPatches)
+{
+    char filename[] = "/tmp/hdf5_map_io_test_swmr_XXXXXX";
+    int fd = mkstemp(filename);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    // the readers are forked before the HDF5 library is used and wait until the writer has created the map
+    int pipeFds[2];
+    ASSERT_EQ(0, pipe(pipeFds));
+
+    std::vector<pid_t> readers;
+    for (size_t i = 0; i < NUM_READERS; i++)
+    {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0)
+        {
+            close(pipeFds[1]);
+            char started;
+            if (read(pipeFds[0], &started, 1) != 1)
+                _exit(2);
+
+            std::string error;
+            try
+            {
+                error = readConcurrently(filename);
+            }
+            catch (const char* message)
+            {
+                error = message;
+            }
+            catch (const std::exception& exception)
+            {
+                error = exception.what();
+            }
+
+            if (!error.empty())
+            {
+                fprintf(stderr, "reader %zu: %s\n", i, error.c_str());
+                _exit(1);
+            }
+            _exit(0);
+        }
+        readers.push_back(pid);
+    }
+    close(pipeFds[0]);
+
+    {
+        std::vector<float> vertices;
+        std::vector<uint32_t> faceIds;
+        for (size_t row = 0; row < INITIAL_ROWS; row++)
+        {
+            std::vector<float> rowVertices = gridRow(row);
+            vertices.insert(vertices.end(), rowVertices.begin(), rowVertices.end());
+            if (row > 0)
+            {
+                std::vector<uint32_t> rowFaces = gridFaces(row);
+                faceIds.insert(faceIds.end(), rowFaces.begin(), rowFaces.end());
+            }
+        }
+
+        // all data sets have to exist before the readers may attach
+        HDF5MapIO map(filename, vertices, faceIds, HDF5MapIO::SwmrWrite);
+        map.writeVertexCosts("cost", std::vector<float>(vertices.size() / 3, 0));
+        map.startSwmrWrite();
+
+        const char started[NUM_READERS] = {};
+        ASSERT_EQ(NUM_READERS, write(pipeFds[1], started, NUM_READERS));
+        close(pipeFds[1]);
+
+        for (size_t round = 1; round <= NUM_ROUNDS; round++)
+        {
+            const size_t row = INITIAL_ROWS + round - 1;
+
+            MapPatch patch;
+            patch.vertices = gridRow(row);
+            patch.faceIds = gridFaces(row);
+            patch.costs["cost"] = std::vector<float>(ROW_SIZE, round);
+
+            EXPECT_EQ(row * ROW_SIZE, map.appendPatch(patch));
+            map.updateVertexCosts("cost", 0, std::vector<float>(row * ROW_SIZE, round));
+            map.flush();
+
+            usleep(2000);
+        }
+
+        EXPECT_EQ(FINAL_VERTICES, map.getNumVertices());
+
+        // HDF5 does not allow new objects while SWMR writing
+        std::vector<uint32_t> labelFaces = {0};
+        EXPECT_ANY_THROW(map.writeVertexCosts("other", std::vector<float>(FINAL_VERTICES, 0)));
+        EXPECT_ANY_THROW(map.addLabel("tree", "1", labelFaces));
+        EXPECT_ANY_THROW(map.addLodLevel(1, labelFaces, 0));
+    }
+
+    for (pid_t pid : readers)
+    {
+        int status = 0;
+        ASSERT_EQ(pid, waitpid(pid, &status, 0));
+        EXPECT_TRUE(WIFEXITED(status));
+        EXPECT_EQ(0, WEXITSTATUS(status));
+    }
+
+    remove(filename);
+}
@@ -0,0 +1,136 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * decimation.h
+ *
+ */
+
+#ifndef MESH_MSGS_CONVERSIONS_DECIMATION_H_
+#define MESH_MSGS_CONVERSIONS_DECIMATION_H_
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include <lvr2/io/MeshBuffer.hpp>
+
+#include <mesh_msgs/MeshGeometry.h>
+#include <mesh_msgs/MeshVertexColors.h>
+#include <mesh_msgs/MeshVertexCosts.h>
+
+namespace mesh_msgs_conversions
+{
+
+/**
+ * @brief Parameters of the mesh decimation. The decimation stops as soon as one of the limits is reached.
+ */
+struct DecimationOptions
+{
+    /// Stop when the mesh has at most this many faces, zero to only limit the error
+    size_t target_faces = 0;
+
+    /// Stop when the cheapest edge collapse has a larger quadric error than this
+    float max_error = std::numeric_limits<float>::infinity();
+
+    /// Keep the vertices on the boundary of the mesh, e.g. to decimate tiles of a larger map independently
+    bool lock_boundary = false;
+
+    /// Weight of color and cost differences in the collapse error, zero to decimate by the geometry only
+    float attribute_weight = 1.0f;
+
+    /// Include the vertex colors, scaled to [0, 1], in the collapse error
+    bool use_vertex_colors = true;
+
+    /// Names of the vertex cost channels included in the collapse error, all single valued float vertex channels
+    /// of a mesh buffer if empty. The costs are normalized to [0, 1] per layer, infinite costs map to one.
+    std::vector<std::string> cost_layers;
+
+    /// Number of faces simplified together by one thread, see hdf5_map_io::simplifyMeshParallel
+    size_t part_faces = 1 << 16;
+};
+
+/**
+ * @brief Decimates a mesh buffer by quadric error edge collapses, running in parallel on large meshes.
+ *
+ * The remaining vertices are a subset of the input vertices. All vertex channels, e.g. normals, colors, texture
+ * coordinates and costs, are copied for the remaining vertices, face channels like face materials for the remaining
+ * faces. Materials and textures are shared with the input buffer.
+ *
+ * @param buffer The mesh to decimate
+ * @param decimated The decimated mesh, created if empty
+ * @param options Limits and attributes of the decimation
+ * @param vertex_map Optionally returns the input vertex index of each remaining vertex
+ * @param face_map Optionally returns the input face index of each remaining face, e.g. to carry over labels
+ * @return false if the buffer has no faces or a face references a vertex that does not exist
+ */
+bool decimateMeshBuffer(
+    const lvr2::MeshBufferPtr& buffer,
+    lvr2::MeshBufferPtr& decimated,
+    const DecimationOptions& options,
+    boost::optional<std::vector<uint32_t>&> vertex_map = boost::none,
+    boost::optional<std::vector<uint32_t>&> face_map = boost::none
+);
+
+/**
+ * @brief Decimates a mesh geometry message, see decimateMeshBuffer.
+ *
+ * Colors and costs of the mesh are passed separately as they are separate messages. They are used in the collapse
+ * error only, use remapVertexColors and remapVertexCosts with the returned vertex map to decimate them as well.
+ * The cost_layers of the options are ignored, all given costs are used.
+ *
+ * @param mesh_geometry The mesh to decimate
+ * @param decimated The decimated mesh
+ * @param options Limits and attributes of the decimation
+ * @param vertex_colors Optional colors of the mesh vertices
+ * @param vertex_costs Optional cost layers of the mesh vertices
+ * @param vertex_map Optionally returns the input vertex index of each remaining vertex
+ * @param face_map Optionally returns the input face index of each remaining face
+ * @return false if the mesh has no faces, a face references a vertex that does not exist or the colors or costs do
+ *         not match the vertices
+ */
+bool decimateMeshGeometry(
+    const mesh_msgs::MeshGeometry& mesh_geometry,
+    mesh_msgs::MeshGeometry& decimated,
+    const DecimationOptions& options,
+    boost::optional<const mesh_msgs::MeshVertexColors&> vertex_colors = boost::none,
+    const std::vector<mesh_msgs::MeshVertexCosts>& vertex_costs = std::vector<mesh_msgs::MeshVertexCosts>(),
+    boost::optional<std::vector<uint32_t>&> vertex_map = boost::none,
+    boost::optional<std::vector<uint32_t>&> face_map = boost::none
+);
+
+/**
+ * @brief Returns the colors of the vertices remaining after a decimation.
+ */
+mesh_msgs::MeshVertexColors remapVertexColors(
+    const mesh_msgs::MeshVertexColors& vertex_colors,
+    const std::vector<uint32_t>& vertex_map
+);
+
+/**
+ * @brief Returns the costs of the vertices remaining after a decimation.
+ */
+mesh_msgs::MeshVertexCosts remapVertexCosts(
+    const mesh_msgs::MeshVertexCosts& vertex_costs,
+    const std::vector<uint32_t>& vertex_map
+);
+
+} // end namespace
+
+#endif /* MESH_MSGS_CONVERSIONS_DECIMATION_H_ */
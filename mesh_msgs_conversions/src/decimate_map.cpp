@@ -0,0 +1,323 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * decimate_map.cpp
+ *
+ * Decimates a map written by hdf5_map_io::HDF5MapIO into a new map file with all vertex channels, cost layers,
+ * materials and labels carried over.
+ *
+ * usage: decimate_map <input.h5> <output.h5> [--faces N] [--error E] [--lock-boundary] [--attribute-weight W]
+ *                     [--no-colors] [--part-faces N]
+ *
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include <ros/console.h>
+
+#include <hdf5_map_io/hdf5_map_io.h>
+
+#include "mesh_msgs_conversions/decimation.h"
+
+namespace
+{
+
+void printUsage(const char* name)
+{
+    std::cerr << "usage: " << name << " <input.h5> <output.h5> [options]" << std::endl
+              << "  --faces N              target number of faces" << std::endl
+              << "  --error E              maximum quadric error of a collapse" << std::endl
+              << "  --lock-boundary        keep the boundary vertices of the map" << std::endl
+              << "  --attribute-weight W   weight of color and cost differences, default 1" << std::endl
+              << "  --no-colors            ignore the vertex colors in the collapse error" << std::endl
+              << "  --part-faces N         faces simplified together by one thread, default 65536" << std::endl;
+}
+
+bool isVertexChannel(const std::string& name)
+{
+    return name == "vertices" || name == "face_indices" || name == "vertex_normals" || name == "vertex_colors";
+}
+
+/**
+ * @brief Decimates the input map into the output map, throws on errors of the map files
+ */
+int decimateMap(
+    const std::string& input_file,
+    const std::string& output_file,
+    mesh_msgs_conversions::DecimationOptions options
+)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    hdf5_map_io::HDF5MapIO input(input_file);
+
+    std::vector<float> vertices = input.getVertices();
+    std::vector<uint32_t> face_ids = input.getFaceIds();
+    const size_t n_vertices = vertices.size() / 3;
+    const size_t n_faces = face_ids.size() / 3;
+    ROS_INFO("Loaded map %s with %lu vertices and %lu faces.", input_file.c_str(), n_vertices, n_faces);
+
+    lvr2::MeshBufferPtr buffer(new lvr2::MeshBuffer);
+
+    lvr2::floatArr vertex_array(new float[vertices.size()]);
+    std::copy(vertices.begin(), vertices.end(), vertex_array.get());
+    buffer->setVertices(vertex_array, n_vertices);
+    std::vector<float>().swap(vertices);
+
+    lvr2::indexArray face_array(new unsigned int[face_ids.size()]);
+    std::copy(face_ids.begin(), face_ids.end(), face_array.get());
+    buffer->setFaceIndices(face_array, n_faces);
+    std::vector<uint32_t>().swap(face_ids);
+
+    std::vector<float> normals = input.getVertexNormals();
+    if (normals.size() == n_vertices * 3)
+    {
+        lvr2::floatArr normal_array(new float[normals.size()]);
+        std::copy(normals.begin(), normals.end(), normal_array.get());
+        buffer->addFloatChannel(normal_array, "vertex_normals", n_vertices, 3);
+    }
+
+    std::vector<uint8_t> colors = input.getVertexColors();
+    if (colors.size() == n_vertices * 3)
+    {
+        lvr2::ucharArr color_array(new unsigned char[colors.size()]);
+        std::copy(colors.begin(), colors.end(), color_array.get());
+        buffer->addUCharChannel(color_array, "vertex_colors", n_vertices, 3);
+    }
+
+    // every other vertex channel of the map is a cost layer, e.g. roughness or height_diff
+    std::vector<std::string> cost_layers;
+    for (const std::string& layer : input.getCostLayers())
+    {
+        if (isVertexChannel(layer))
+        {
+            continue;
+        }
+        std::vector<float> costs = input.getVertexCosts(layer);
+        if (costs.size() != n_vertices)
+        {
+            ROS_WARN("Skipping the channel %s, it has no value per vertex.", layer.c_str());
+            continue;
+        }
+        lvr2::floatArr cost_array(new float[n_vertices]);
+        std::copy(costs.begin(), costs.end(), cost_array.get());
+        buffer->addFloatChannel(cost_array, layer, n_vertices, 1);
+        cost_layers.push_back(layer);
+    }
+    options.cost_layers = cost_layers;
+
+    std::vector<float> tex_coords = input.getVertexTextureCoords();
+    if (tex_coords.size() == n_vertices * 3)
+    {
+        lvr2::floatArr tex_coord_array(new float[tex_coords.size()]);
+        std::copy(tex_coords.begin(), tex_coords.end(), tex_coord_array.get());
+        buffer->addFloatChannel(tex_coord_array, "tex_coords", n_vertices, 3);
+    }
+
+    std::vector<uint32_t> material_face_indices = input.getMaterialFaceIndices();
+    if (material_face_indices.size() == n_faces)
+    {
+        lvr2::indexArray material_array(new unsigned int[n_faces]);
+        std::copy(material_face_indices.begin(), material_face_indices.end(), material_array.get());
+        buffer->addIndexChannel(material_array, "face_materials", n_faces, 1);
+    }
+
+    lvr2::MeshBufferPtr decimated;
+    std::vector<uint32_t> face_map;
+    if (!mesh_msgs_conversions::decimateMeshBuffer(buffer, decimated, options, boost::none, face_map))
+    {
+        return EXIT_FAILURE;
+    }
+    const size_t n_decimated_vertices = decimated->numVertices();
+    const size_t n_decimated_faces = decimated->numFaces();
+
+    // write the decimated map
+    std::vector<float> decimated_vertices(
+        decimated->getVertices().get(),
+        decimated->getVertices().get() + n_decimated_vertices * 3
+    );
+    std::vector<uint32_t> decimated_face_ids(
+        decimated->getFaceIndices().get(),
+        decimated->getFaceIndices().get() + n_decimated_faces * 3
+    );
+    hdf5_map_io::HDF5MapIO output(output_file, decimated_vertices, decimated_face_ids);
+
+    auto float_channel = [&](const std::string& name)
+    {
+        std::vector<float> values;
+        auto channel = decimated->getChannel<float>(name);
+        if (channel)
+        {
+            const float* data = channel->dataPtr().get();
+            values.assign(data, data + channel->numElements() * channel->width());
+        }
+        return values;
+    };
+
+    std::vector<float> decimated_normals = float_channel("vertex_normals");
+    if (!decimated_normals.empty())
+    {
+        output.addVertexNormals(decimated_normals);
+    }
+
+    auto color_channel = decimated->getChannel<unsigned char>("vertex_colors");
+    if (color_channel)
+    {
+        std::vector<uint8_t> decimated_colors(
+            color_channel->dataPtr().get(),
+            color_channel->dataPtr().get() + n_decimated_vertices * 3
+        );
+        output.addVertexColors(decimated_colors);
+    }
+
+    for (const std::string& layer : cost_layers)
+    {
+        std::vector<float> decimated_costs = float_channel(layer);
+        output.addVertexCosts(layer, decimated_costs);
+    }
+
+    std::vector<float> decimated_tex_coords = float_channel("tex_coords");
+    if (!decimated_tex_coords.empty())
+    {
+        output.addVertexTextureCoords(decimated_tex_coords);
+    }
+
+    for (const hdf5_map_io::MapImage& texture : input.getTextures())
+    {
+        output.addTexture(std::stoi(texture.name), texture.width, texture.height,
+                          const_cast<uint8_t*>(texture.data.data()));
+    }
+
+    std::vector<hdf5_map_io::MapMaterial> materials = input.getMaterials();
+    auto material_channel = decimated->getChannel<unsigned int>("face_materials");
+    if (!materials.empty() && material_channel)
+    {
+        std::vector<uint32_t> decimated_material_indices(
+            material_channel->dataPtr().get(),
+            material_channel->dataPtr().get() + n_decimated_faces
+        );
+        output.addMaterials(materials, decimated_material_indices);
+    }
+
+    // labels reference faces, keep the labeled faces that remain
+    std::vector<uint32_t> new_face_ids(n_faces, std::numeric_limits<uint32_t>::max());
+    for (size_t i = 0; i < face_map.size(); i++)
+    {
+        new_face_ids[face_map[i]] = i;
+    }
+    for (const std::string& group : input.getLabelGroups())
+    {
+        for (const std::string& label : input.getAllLabelsOfGroup(group))
+        {
+            std::vector<uint32_t> label_faces;
+            for (uint32_t face : input.getFaceIdsOfLabel(group, label))
+            {
+                if (face < n_faces && new_face_ids[face] != std::numeric_limits<uint32_t>::max())
+                {
+                    label_faces.push_back(new_face_ids[face]);
+                }
+            }
+            output.addLabel(group, label, label_faces);
+        }
+    }
+
+    output.flush();
+
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    ROS_INFO("Wrote map %s with %lu vertices and %lu faces, %.2f s in total (%.0f faces/s including I/O).",
+             output_file.c_str(), n_decimated_vertices, n_decimated_faces, seconds, n_faces / seconds);
+
+    return EXIT_SUCCESS;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const std::string input_file = argv[1];
+    const std::string output_file = argv[2];
+    if (input_file == output_file)
+    {
+        ROS_ERROR("The decimated map has to be written to a new file!");
+        return EXIT_FAILURE;
+    }
+
+    mesh_msgs_conversions::DecimationOptions options;
+    for (int i = 3; i < argc; i++)
+    {
+        const bool has_value = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--faces") && has_value)
+        {
+            options.target_faces = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (!std::strcmp(argv[i], "--error") && has_value)
+        {
+            options.max_error = std::strtof(argv[++i], nullptr);
+        }
+        else if (!std::strcmp(argv[i], "--lock-boundary"))
+        {
+            options.lock_boundary = true;
+        }
+        else if (!std::strcmp(argv[i], "--attribute-weight") && has_value)
+        {
+            options.attribute_weight = std::strtof(argv[++i], nullptr);
+        }
+        else if (!std::strcmp(argv[i], "--no-colors"))
+        {
+            options.use_vertex_colors = false;
+        }
+        else if (!std::strcmp(argv[i], "--part-faces") && has_value)
+        {
+            options.part_faces = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (options.target_faces == 0 && !std::isfinite(options.max_error))
+    {
+        ROS_ERROR("Either a target number of faces or a maximum error is required!");
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        return decimateMap(input_file, output_file, options);
+    }
+    catch (const char* error)
+    {
+        ROS_ERROR("%s", error);
+        return EXIT_FAILURE;
+    }
+}
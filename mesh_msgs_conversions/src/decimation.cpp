@@ -0,0 +1,405 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * decimation.cpp
+ *
+ */
+
+#include "mesh_msgs_conversions/decimation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+
+#include <ros/console.h>
+
+#include <hdf5_map_io/mesh_simplification.h>
+
+namespace mesh_msgs_conversions
+{
+
+namespace
+{
+
+/**
+ * @brief Appends a cost layer normalized to [0, 1] to the interleaved attributes, infinite costs map to one.
+ */
+void appendCosts(
+    const float* costs,
+    size_t n_vertices,
+    std::vector<float>& attributes,
+    size_t& dim
+)
+{
+    float min = std::numeric_limits<float>::max();
+    float max = std::numeric_limits<float>::lowest();
+    for (size_t i = 0; i < n_vertices; i++)
+    {
+        if (std::isfinite(costs[i]))
+        {
+            min = std::min(min, costs[i]);
+            max = std::max(max, costs[i]);
+        }
+    }
+    const float range = max > min ? max - min : 1.0f;
+
+    std::vector<float> interleaved(n_vertices * (dim + 1));
+    #pragma omp parallel for
+    for (int64_t i = 0; i < n_vertices; i++)
+    {
+        std::copy_n(attributes.begin() + i * dim, dim, interleaved.begin() + i * (dim + 1));
+        interleaved[i * (dim + 1) + dim] = std::isfinite(costs[i]) ? (costs[i] - min) / range : 1.0f;
+    }
+    attributes.swap(interleaved);
+    dim++;
+}
+
+/**
+ * @brief Runs the simplification and compacts the vertices of the remaining faces.
+ */
+bool decimate(
+    const float* vertices,
+    size_t n_vertices,
+    const uint32_t* faces,
+    size_t n_faces,
+    const std::vector<float>& attributes,
+    size_t dim,
+    const DecimationOptions& options,
+    std::vector<uint32_t>& vertex_map,
+    std::vector<uint32_t>& decimated_faces,
+    std::vector<uint32_t>& face_map
+)
+{
+    if (n_faces == 0)
+    {
+        ROS_WARN("Cannot decimate a mesh without faces!");
+        return false;
+    }
+
+    // the faces come from messages or files, an index out of range would make the simplification write anywhere
+    for (size_t i = 0; i < n_faces * 3; i++)
+    {
+        if (faces[i] >= n_vertices)
+        {
+            ROS_ERROR("Cannot decimate the mesh, face %lu references the vertex %u of only %lu vertices!",
+                      i / 3, faces[i], n_vertices);
+            return false;
+        }
+    }
+
+    hdf5_map_io::SimplificationOptions simplification;
+    simplification.targetFaces = options.target_faces;
+    simplification.maxError = options.max_error;
+    simplification.lockBoundary = options.lock_boundary;
+    if (dim > 0 && options.attribute_weight > 0)
+    {
+        simplification.attributes = attributes.data();
+        simplification.attributeDim = dim;
+        simplification.attributeWeight = options.attribute_weight;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    hdf5_map_io::SimplificationResult result = hdf5_map_io::simplifyMeshParallel(
+        vertices,
+        n_vertices,
+        faces,
+        n_faces,
+        simplification,
+        options.part_faces
+    );
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    ROS_INFO("Decimated %lu to %lu faces with an error of %f in %.2f s (%.0f faces/s)",
+             n_faces, result.faceMap.size(), result.error, seconds, seconds > 0 ? n_faces / seconds : 0.0);
+
+    vertex_map = result.faceIds;
+    std::sort(vertex_map.begin(), vertex_map.end());
+    vertex_map.erase(std::unique(vertex_map.begin(), vertex_map.end()), vertex_map.end());
+
+    std::vector<uint32_t> new_indices(n_vertices);
+    for (size_t i = 0; i < vertex_map.size(); i++)
+    {
+        new_indices[vertex_map[i]] = i;
+    }
+    for (uint32_t& index : result.faceIds)
+    {
+        index = new_indices[index];
+    }
+
+    decimated_faces.swap(result.faceIds);
+    face_map.swap(result.faceMap);
+    return true;
+}
+
+/**
+ * @brief Copies all channels of one type for the remaining vertices and faces, except the geometry itself.
+ */
+template<typename T>
+void remapChannels(
+    const lvr2::MeshBufferPtr& buffer,
+    lvr2::MeshBufferPtr& decimated,
+    const std::vector<uint32_t>& vertex_map,
+    const std::vector<uint32_t>& face_map
+)
+{
+    std::map<std::string, lvr2::Channel<T>> channels;
+    buffer->getAllChannelsOfType<T>(channels);
+
+    const size_t n_vertices = buffer->numVertices();
+    const size_t n_faces = buffer->numFaces();
+    for (auto& channelPair : channels)
+    {
+        if (channelPair.first == "vertices" || channelPair.first == "face_indices")
+        {
+            continue;
+        }
+
+        const std::vector<uint32_t>* map;
+        if (channelPair.second.numElements() == n_vertices)
+        {
+            map = &vertex_map;
+        }
+        else if (channelPair.second.numElements() == n_faces)
+        {
+            map = &face_map;
+        }
+        else
+        {
+            ROS_WARN("Skipping channel %s, it is neither a vertex nor a face channel.", channelPair.first.c_str());
+            continue;
+        }
+
+        const size_t width = channelPair.second.width();
+        const T* data = channelPair.second.dataPtr().get();
+        boost::shared_array<T> remapped(new T[map->size() * width]);
+        for (size_t i = 0; i < map->size(); i++)
+        {
+            std::copy_n(data + (*map)[i] * width, width, remapped.get() + i * width);
+        }
+        decimated->addChannel<T>(
+            typename lvr2::Channel<T>::Ptr(new lvr2::Channel<T>(map->size(), width, remapped)),
+            channelPair.first
+        );
+    }
+}
+
+} // namespace
+
+bool decimateMeshBuffer(
+    const lvr2::MeshBufferPtr& buffer,
+    lvr2::MeshBufferPtr& decimated,
+    const DecimationOptions& options,
+    boost::optional<std::vector<uint32_t>&> vertex_map,
+    boost::optional<std::vector<uint32_t>&> face_map
+)
+{
+    const size_t n_vertices = buffer->numVertices();
+    const size_t n_faces = buffer->numFaces();
+
+    std::vector<float> attributes;
+    size_t dim = 0;
+    if (options.use_vertex_colors && buffer->hasVertexColors())
+    {
+        size_t color_channels = 3;
+        auto colors = buffer->getVertexColors(color_channels);
+        dim = std::min<size_t>(color_channels, 3);
+        attributes.resize(n_vertices * dim);
+        for (size_t i = 0; i < n_vertices; i++)
+        {
+            for (size_t j = 0; j < dim; j++)
+            {
+                attributes[i * dim + j] = colors[i * color_channels + j] / 255.0f;
+            }
+        }
+    }
+
+    std::map<std::string, lvr2::Channel<float>> float_channels;
+    buffer->getAllChannelsOfType<float>(float_channels);
+    for (auto& channelPair : float_channels)
+    {
+        const bool is_cost_layer = options.cost_layers.empty()
+            ? channelPair.second.width() == 1 && channelPair.second.numElements() == n_vertices
+            : std::find(options.cost_layers.begin(), options.cost_layers.end(), channelPair.first)
+                != options.cost_layers.end();
+        if (!is_cost_layer)
+        {
+            continue;
+        }
+        if (channelPair.second.width() != 1 || channelPair.second.numElements() != n_vertices)
+        {
+            ROS_WARN("The channel %s is no vertex cost layer, ignoring it.", channelPair.first.c_str());
+            continue;
+        }
+        appendCosts(channelPair.second.dataPtr().get(), n_vertices, attributes, dim);
+    }
+
+    std::vector<uint32_t> vertex_indices, faces, face_indices;
+    if (!decimate(buffer->getVertices().get(), n_vertices, buffer->getFaceIndices().get(), n_faces,
+                  attributes, dim, options, vertex_indices, faces, face_indices))
+    {
+        return false;
+    }
+
+    if (!decimated) decimated = lvr2::MeshBufferPtr(new lvr2::MeshBuffer);
+
+    auto buffer_vertices = buffer->getVertices();
+    lvr2::floatArr vertices(new float[vertex_indices.size() * 3]);
+    for (size_t i = 0; i < vertex_indices.size(); i++)
+    {
+        std::copy_n(buffer_vertices.get() + vertex_indices[i] * 3, 3, vertices.get() + i * 3);
+    }
+    decimated->setVertices(vertices, vertex_indices.size());
+
+    lvr2::indexArray face_array(new unsigned int[faces.size()]);
+    std::copy(faces.begin(), faces.end(), face_array.get());
+    decimated->setFaceIndices(face_array, faces.size() / 3);
+
+    remapChannels<float>(buffer, decimated, vertex_indices, face_indices);
+    remapChannels<unsigned char>(buffer, decimated, vertex_indices, face_indices);
+    remapChannels<unsigned int>(buffer, decimated, vertex_indices, face_indices);
+
+    decimated->setMaterials(buffer->getMaterials());
+    decimated->setTextures(buffer->getTextures());
+
+    if (vertex_map) vertex_map.get().swap(vertex_indices);
+    if (face_map) face_map.get().swap(face_indices);
+    return true;
+}
+
+bool decimateMeshGeometry(
+    const mesh_msgs::MeshGeometry& mesh_geometry,
+    mesh_msgs::MeshGeometry& decimated,
+    const DecimationOptions& options,
+    boost::optional<const mesh_msgs::MeshVertexColors&> vertex_colors,
+    const std::vector<mesh_msgs::MeshVertexCosts>& vertex_costs,
+    boost::optional<std::vector<uint32_t>&> vertex_map,
+    boost::optional<std::vector<uint32_t>&> face_map
+)
+{
+    const size_t n_vertices = mesh_geometry.vertices.size();
+    const size_t n_faces = mesh_geometry.faces.size();
+
+    std::vector<float> vertices(n_vertices * 3);
+    for (size_t i = 0; i < n_vertices; i++)
+    {
+        vertices[i * 3 + 0] = static_cast<float>(mesh_geometry.vertices[i].x);
+        vertices[i * 3 + 1] = static_cast<float>(mesh_geometry.vertices[i].y);
+        vertices[i * 3 + 2] = static_cast<float>(mesh_geometry.vertices[i].z);
+    }
+
+    std::vector<uint32_t> faces(n_faces * 3);
+    for (size_t i = 0; i < n_faces; i++)
+    {
+        std::copy_n(mesh_geometry.faces[i].vertex_indices.begin(), 3, faces.begin() + i * 3);
+    }
+
+    std::vector<float> attributes;
+    size_t dim = 0;
+    if (options.use_vertex_colors && vertex_colors)
+    {
+        const auto& colors = vertex_colors.get().vertex_colors;
+        if (colors.size() != n_vertices)
+        {
+            ROS_ERROR("The number of vertex colors does not match the number of vertices!");
+            return false;
+        }
+        dim = 3;
+        attributes.resize(n_vertices * dim);
+        for (size_t i = 0; i < n_vertices; i++)
+        {
+            attributes[i * 3 + 0] = colors[i].r;
+            attributes[i * 3 + 1] = colors[i].g;
+            attributes[i * 3 + 2] = colors[i].b;
+        }
+    }
+
+    for (const mesh_msgs::MeshVertexCosts& costs : vertex_costs)
+    {
+        if (costs.costs.size() != n_vertices)
+        {
+            ROS_ERROR("The number of vertex costs does not match the number of vertices!");
+            return false;
+        }
+        appendCosts(costs.costs.data(), n_vertices, attributes, dim);
+    }
+
+    std::vector<uint32_t> vertex_indices, decimated_faces, face_indices;
+    if (!decimate(vertices.data(), n_vertices, faces.data(), n_faces, attributes, dim, options,
+                  vertex_indices, decimated_faces, face_indices))
+    {
+        return false;
+    }
+
+    decimated.vertices.resize(vertex_indices.size());
+    for (size_t i = 0; i < vertex_indices.size(); i++)
+    {
+        decimated.vertices[i] = mesh_geometry.vertices[vertex_indices[i]];
+    }
+
+    decimated.faces.resize(face_indices.size());
+    for (size_t i = 0; i < face_indices.size(); i++)
+    {
+        std::copy_n(decimated_faces.begin() + i * 3, 3, decimated.faces[i].vertex_indices.begin());
+    }
+
+    decimated.vertex_normals.clear();
+    if (mesh_geometry.vertex_normals.size() == n_vertices)
+    {
+        decimated.vertex_normals.resize(vertex_indices.size());
+        for (size_t i = 0; i < vertex_indices.size(); i++)
+        {
+            decimated.vertex_normals[i] = mesh_geometry.vertex_normals[vertex_indices[i]];
+        }
+    }
+
+    if (vertex_map) vertex_map.get().swap(vertex_indices);
+    if (face_map) face_map.get().swap(face_indices);
+    return true;
+}
+
+mesh_msgs::MeshVertexColors remapVertexColors(
+    const mesh_msgs::MeshVertexColors& vertex_colors,
+    const std::vector<uint32_t>& vertex_map
+)
+{
+    mesh_msgs::MeshVertexColors remapped;
+    remapped.vertex_colors.resize(vertex_map.size());
+    for (size_t i = 0; i < vertex_map.size(); i++)
+    {
+        remapped.vertex_colors[i] = vertex_colors.vertex_colors[vertex_map[i]];
+    }
+    return remapped;
+}
+
+mesh_msgs::MeshVertexCosts remapVertexCosts(
+    const mesh_msgs::MeshVertexCosts& vertex_costs,
+    const std::vector<uint32_t>& vertex_map
+)
+{
+    mesh_msgs::MeshVertexCosts remapped;
+    remapped.costs.resize(vertex_map.size());
+    for (size_t i = 0; i < vertex_map.size(); i++)
+    {
+        remapped.costs[i] = vertex_costs.costs[vertex_map[i]];
+    }
+    return remapped;
+}
+
+} // end namespace
@@ -5,10 +5,17 @@
 #include <actionlib/server/simple_action_server.h>
 
 #include <hdf5_map_io/hdf5_map_io.h>
+#include <hdf5_map_io/aabb_tree.h>
+#include <hdf5_map_io/cost_inflation.h>
 
 #include <mesh_msgs/MeshFaceClusterStamped.h>
+#include <mesh_msgs/GetClosestPoints.h>
+#include <mesh_msgs/GetDecimatedGeometry.h>
 #include <mesh_msgs/GetGeometry.h>
+#include <mesh_msgs/GetGeometryInBox.h>
+#include <mesh_msgs/GetGeometryInRadius.h>
 #include <mesh_msgs/GetMaterials.h>
+#include <mesh_msgs/GetRayIntersections.h>
 #include <mesh_msgs/GetTexture.h>
 #include <mesh_msgs/GetUUIDs.h>
 #include <mesh_msgs/GetVertexColors.h>
@@ -22,6 +29,9 @@
 #include <sensor_msgs/fill_image.h>
 
 #include <boost/algorithm/string.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -37,12 +47,40 @@ class hdf5_to_msg
  protected:
   void loadAndPublishGeometry();
 
+  /**
+   * @brief Loads the levels of detail stored in the map, or builds them if they are missing or outdated. Built levels
+   *        are only stored in the map if the cache_lods parameter is set, otherwise they are kept in memory.
+   */
+  void loadOrBuildLods();
+
+  /**
+   * @brief Builds the spatial index over the faces of the map for the region of interest services
+   */
+  void buildSpatialIndex();
+
+  /**
+   * @brief Inflates the given cost layers and publishes each one as the new layer <layer>_inflated
+   */
+  void inflateCostLayers(const std::vector<std::string>& layers, const hdf5_map_io::InflationOptions& options);
+
+  /**
+   * @brief Fills the submesh of the given faces with compacted vertex indices, plus the requested costs and colors
+   */
+  bool getRegion(
+      const std::vector<uint32_t>& faces,
+      const std::vector<std::string>& costLayers,
+      bool withColors,
+      mesh_msgs::MeshGeometryStamped& geometryMsg,
+      std::vector<uint32_t>& vertexIndices,
+      mesh_msgs::MeshVertexColors& vertexColorsMsg,
+      std::vector<mesh_msgs::MeshVertexCosts>& vertexCostsMsgs);
+
   bool getVertices(std::vector<float>& vertices, mesh_msgs::MeshGeometryStamped& geometryMsg);
   bool getFaces(std::vector<uint32_t>& faceIds, mesh_msgs::MeshGeometryStamped& geometryMsg);
   bool getVertexNormals(std::vector<float>& vertexNormals, mesh_msgs::MeshGeometryStamped& geometryMsg);
 
   bool getVertexColors(std::vector<uint8_t>& vertexColors, mesh_msgs::MeshVertexColorsStamped& vertexColorsMsg);
-  bool getVertexCosts(std::vector<float>& vertexCosts, std::string layer, mesh_msgs::MeshVertexCostsStamped& vertexCostsMsg);
+  bool getVertexCosts(const std::vector<float>& vertexCosts, std::string layer, mesh_msgs::MeshVertexCostsStamped& vertexCostsMsg);
 
   // Mesh services
   bool service_getUUIDs(
@@ -60,6 +98,21 @@ class hdf5_to_msg
   bool service_getGeometryVertexNormals(
       mesh_msgs::GetGeometry::Request &req,
       mesh_msgs::GetGeometry::Response &res);
+  bool service_getDecimatedGeometry(
+      mesh_msgs::GetDecimatedGeometry::Request &req,
+      mesh_msgs::GetDecimatedGeometry::Response &res);
+  bool service_getGeometryInBox(
+      mesh_msgs::GetGeometryInBox::Request &req,
+      mesh_msgs::GetGeometryInBox::Response &res);
+  bool service_getGeometryInRadius(
+      mesh_msgs::GetGeometryInRadius::Request &req,
+      mesh_msgs::GetGeometryInRadius::Response &res);
+  bool service_getClosestPoints(
+      mesh_msgs::GetClosestPoints::Request &req,
+      mesh_msgs::GetClosestPoints::Response &res);
+  bool service_getRayIntersections(
+      mesh_msgs::GetRayIntersections::Request &req,
+      mesh_msgs::GetRayIntersections::Response &res);
 
   bool service_getMaterials(
       mesh_msgs::GetMaterials::Request &req,
@@ -84,6 +137,11 @@ class hdf5_to_msg
 
   void callback_clusterLabel(const mesh_msgs::MeshFaceClusterStamped::ConstPtr &msg);
 
+  /**
+   * @brief Stores the changed costs of a layer in the map and updates its inflation, if it is inflated
+   */
+  void callback_vertexCosts(const mesh_msgs::MeshVertexCostsStamped::ConstPtr &msg);
+
  private:
 
   // Mesh message service servers
@@ -92,6 +150,11 @@ class hdf5_to_msg
   ros::ServiceServer srv_get_geometry_vertices_;
   ros::ServiceServer srv_get_geometry_faces_;
   ros::ServiceServer srv_get_geometry_vertex_normals_;
+  ros::ServiceServer srv_get_decimated_geometry_;
+  ros::ServiceServer srv_get_geometry_in_box_;
+  ros::ServiceServer srv_get_geometry_in_radius_;
+  ros::ServiceServer srv_get_closest_points_;
+  ros::ServiceServer srv_get_ray_intersections_;
   ros::ServiceServer srv_get_materials_;
   ros::ServiceServer srv_get_texture_;
   ros::ServiceServer srv_get_vertex_colors_;
@@ -107,14 +170,50 @@ class hdf5_to_msg
   ros::ServiceServer srv_get_labeled_clusters_;
   ros::Subscriber sub_cluster_label_;
 
+  // Cost updates
+  ros::Subscriber sub_vertex_costs_;
+
   // ROS
   ros::NodeHandle node_handle;
 
   // ROS parameter
   std::string inputFile;
 
+  // Whether levels of detail built at startup are written to the map, which changes the input file
+  bool cache_lods_ = false;
+
+  // Whether a vertex adjacency built for the inflation is written to the map, which changes the input file
+  bool store_adjacency_ = false;
+
   std::string mesh_uuid = "mesh";
 
+  // Spatial index over the faces of the map, holds the geometry for the region of interest and query services
+  std::unique_ptr<hdf5_map_io::AABBTree> aabb_tree_;
+
+  // Vertex normals of the map, they do not change while the node runs
+  std::vector<float> vertex_normals_;
+
+  // Vertex adjacency of the map, the graph over which the cost layers are inflated
+  hdf5_map_io::MeshAdjacency vertex_adjacency_;
+
+  // Inflation of each cost layer of the inflation_layers parameter, by the name of the layer
+  std::map<std::string, std::unique_ptr<hdf5_map_io::CostInflation>> inflations_;
+
+  // Guards the inflations, as the callbacks are run by several threads, and serializes the cost updates
+  std::mutex inflation_mutex_;
+
+  // Levels of detail, the full mesh first, then with decreasing number of faces
+  std::vector<hdf5_map_io::MapLodLevel> lod_levels_;
+
+  // Face ids of each level of detail that is not read from the map, empty for the others
+  std::vector<std::vector<uint32_t>> lod_face_ids_;
+
+  // Each level of detail has this many times fewer faces than the previous one
+  static constexpr size_t LOD_REDUCTION = 4;
+
+  // No further levels of detail are built below this number of faces
+  static constexpr size_t LOD_MIN_FACES = 1000;
+
 };
 
 } // end namespace
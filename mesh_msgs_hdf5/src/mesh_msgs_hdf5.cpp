@@ -1,8 +1,55 @@
 #include <mesh_msgs_hdf5/mesh_msgs_hdf5.h>
 #include <hdf5_map_io/hdf5_map_io.h>
+#include <hdf5_map_io/mesh_adjacency.h>
+#include <hdf5_map_io/mesh_simplification.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
 
 namespace mesh_msgs_hdf5 {
 
+namespace
+{
+
+// Suffix of the names of the inflated cost layers
+const std::string INFLATED_SUFFIX = "_inflated";
+
+/**
+ * Returns the values of the given vertices from a channel with width values per vertex.
+ */
+template<typename T>
+std::vector<T> sliceVertices(const std::vector<T>& values, const std::vector<uint32_t>& vertexIndices, size_t width)
+{
+    std::vector<T> sliced(vertexIndices.size() * width);
+    for (size_t i = 0; i < vertexIndices.size(); i++)
+    {
+        std::copy_n(values.begin() + vertexIndices[i] * width, width, sliced.begin() + i * width);
+    }
+    return sliced;
+}
+
+/**
+ * Converts a point on a face, given by the barycentric coordinates of the second and the third vertex.
+ */
+mesh_msgs::MeshFaceHit toFaceHit(uint32_t face, float distance, float u, float v, const float point[3])
+{
+    mesh_msgs::MeshFaceHit hit;
+    hit.valid = true;
+    hit.face_index = face;
+    hit.distance = distance;
+    hit.barycentric[0] = 1.0f - u - v;
+    hit.barycentric[1] = u;
+    hit.barycentric[2] = v;
+    hit.point.x = point[0];
+    hit.point.y = point[1];
+    hit.point.z = point[2];
+    return hit;
+}
+
+} // namespace
+
 hdf5_to_msg::hdf5_to_msg()
 {
     ros::NodeHandle nh("~");
@@ -14,6 +61,20 @@ hdf5_to_msg::hdf5_to_msg()
 
     ROS_INFO_STREAM("Using input file: " << inputFile);
 
+    // both are off by default, as writing to the map changes it for every other user, e.g. the cache of rviz
+    nh.param("cache_lods", cache_lods_, cache_lods_);
+    nh.param("store_adjacency", store_adjacency_, store_adjacency_);
+
+    // cost layers to inflate around their lethal vertices, e.g. the layers of obstacles
+    std::vector<std::string> inflationLayers;
+    nh.getParam("inflation_layers", inflationLayers);
+
+    hdf5_map_io::InflationOptions inflationOptions;
+    nh.param("lethal_cost", inflationOptions.lethalCost, inflationOptions.lethalCost);
+    nh.param("inscribed_radius", inflationOptions.inscribedRadius, inflationOptions.inscribedRadius);
+    nh.param("inflation_radius", inflationOptions.inflationRadius, inflationOptions.inflationRadius);
+    nh.param("cost_scaling_factor", inflationOptions.costScalingFactor, inflationOptions.costScalingFactor);
+
     srv_get_geometry_ = node_handle.advertiseService(
         "get_geometry", &hdf5_to_msg::service_getGeometry, this);
     srv_get_geometry_vertices_ = node_handle.advertiseService(
@@ -22,6 +83,16 @@ hdf5_to_msg::hdf5_to_msg()
         "get_geometry_faces", &hdf5_to_msg::service_getGeometryFaces, this);
      srv_get_geometry_vertex_normals_ = node_handle.advertiseService(
         "get_geometry_vertexnormals", &hdf5_to_msg::service_getGeometryVertexNormals, this);
+    srv_get_decimated_geometry_ = node_handle.advertiseService(
+        "get_decimated_geometry", &hdf5_to_msg::service_getDecimatedGeometry, this);
+    srv_get_geometry_in_box_ = node_handle.advertiseService(
+        "get_geometry_in_box", &hdf5_to_msg::service_getGeometryInBox, this);
+    srv_get_geometry_in_radius_ = node_handle.advertiseService(
+        "get_geometry_in_radius", &hdf5_to_msg::service_getGeometryInRadius, this);
+    srv_get_closest_points_ = node_handle.advertiseService(
+        "get_closest_points", &hdf5_to_msg::service_getClosestPoints, this);
+    srv_get_ray_intersections_ = node_handle.advertiseService(
+        "get_ray_intersections", &hdf5_to_msg::service_getRayIntersections, this);
     srv_get_materials_ = node_handle.advertiseService(
         "get_materials", &hdf5_to_msg::service_getMaterials, this);
     srv_get_texture_ = node_handle.advertiseService(
@@ -45,7 +116,13 @@ hdf5_to_msg::hdf5_to_msg()
 
     sub_cluster_label_ = node_handle.subscribe("cluster_label", 10, &hdf5_to_msg::callback_clusterLabel, this);
 
+    sub_vertex_costs_ = node_handle.subscribe(
+        "mesh/vertex_costs_update", 10, &hdf5_to_msg::callback_vertexCosts, this);
+
     loadAndPublishGeometry();
+    loadOrBuildLods();
+    buildSpatialIndex();
+    inflateCostLayers(inflationLayers, inflationOptions);
 }
 
 void hdf5_to_msg::loadAndPublishGeometry()
@@ -57,11 +134,11 @@ void hdf5_to_msg::loadAndPublishGeometry()
 
     auto vertices = io.getVertices();
     auto faceIds = io.getFaceIds();
-    auto vertexNormals = io.getVertexNormals();
+    vertex_normals_ = io.getVertexNormals();
 
     getVertices(vertices, geometryMsg);
     getFaces(faceIds, geometryMsg);
-    getVertexNormals(vertexNormals, geometryMsg);
+    getVertexNormals(vertex_normals_, geometryMsg);
 
     pub_geometry_.publish(geometryMsg);
 
@@ -91,6 +168,247 @@ void hdf5_to_msg::loadAndPublishGeometry()
     }
 }
 
+void hdf5_to_msg::loadOrBuildLods()
+{
+    hdf5_map_io::HDF5MapIO io(inputFile);
+
+    auto faceIds = io.getFaceIds();
+    const uint32_t nFaces = faceIds.size() / 3;
+
+    // the full mesh is the finest level
+    lod_levels_ = { { 0, nFaces, nFaces, 0.0f } };
+    lod_face_ids_.assign(1, std::vector<uint32_t>());
+
+    auto storedLevels = io.getLodLevels();
+    bool upToDate = !storedLevels.empty() && std::all_of(storedLevels.begin(), storedLevels.end(),
+        [nFaces](const hdf5_map_io::MapLodLevel& lod) { return lod.meshFaces == nFaces; });
+    if (upToDate)
+    {
+        lod_levels_.insert(lod_levels_.end(), storedLevels.begin(), storedLevels.end());
+        lod_face_ids_.resize(lod_levels_.size());
+        ROS_INFO_STREAM("Loaded " << storedLevels.size() << " levels of detail");
+        return;
+    }
+
+    if (!storedLevels.empty())
+    {
+        ROS_WARN("The levels of detail do not match the mesh, rebuilding them");
+        if (cache_lods_)
+        {
+            io.removeLodLevels();
+        }
+    }
+
+    if (cache_lods_)
+    {
+        ROS_INFO("Building levels of detail, they are stored in the map");
+    }
+    else
+    {
+        ROS_INFO("Building levels of detail, set ~cache_lods to store them in the map");
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    auto vertices = io.getVertices();
+    float error = 0.0f;
+    try
+    {
+        for (uint32_t level = 1; faceIds.size() / 3 > LOD_MIN_FACES; level++)
+        {
+            hdf5_map_io::SimplificationOptions options;
+            options.targetFaces = faceIds.size() / 3 / LOD_REDUCTION;
+
+            auto result = hdf5_map_io::simplifyMeshParallel(
+                vertices.data(),
+                vertices.size() / 3,
+                faceIds.data(),
+                faceIds.size() / 3,
+                options
+            );
+            if (result.faceIds.size() == faceIds.size())
+            {
+                break;
+            }
+
+            // the errors of consecutive levels add up, as each level is simplified from the previous one
+            error += std::sqrt(result.error);
+            lod_levels_.push_back({ level, uint32_t(result.faceIds.size() / 3), nFaces, error });
+            if (cache_lods_)
+            {
+                io.addLodLevel(level, result.faceIds, error);
+                lod_face_ids_.emplace_back();
+            }
+            else
+            {
+                lod_face_ids_.push_back(result.faceIds);
+            }
+            faceIds.swap(result.faceIds);
+        }
+    }
+    catch (const char* message)
+    {
+        ROS_ERROR_STREAM("Could not build the levels of detail: " << message);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    ROS_INFO("Built %lu levels of detail in %ld ms", lod_levels_.size() - 1,
+             std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+}
+
+void hdf5_to_msg::buildSpatialIndex()
+{
+    hdf5_map_io::HDF5MapIO io(inputFile);
+
+    auto start = std::chrono::steady_clock::now();
+    aabb_tree_.reset(new hdf5_map_io::AABBTree(io.getVertices(), io.getFaceIds()));
+    auto end = std::chrono::steady_clock::now();
+
+    ROS_INFO("Built the spatial index over %lu faces in %ld ms", aabb_tree_->numFaces(),
+             std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+}
+
+void hdf5_to_msg::inflateCostLayers(
+    const std::vector<std::string>& layers,
+    const hdf5_map_io::InflationOptions& options)
+{
+    if (layers.empty())
+    {
+        return;
+    }
+
+    hdf5_map_io::HDF5MapIO io(inputFile);
+
+    vertex_adjacency_ = io.getVertexAdjacency();
+    if (vertex_adjacency_.empty())
+    {
+        ROS_INFO("Building the vertex adjacency");
+        const auto& faceIds = aabb_tree_->getFaceIds();
+        vertex_adjacency_ = hdf5_map_io::buildVertexAdjacency(
+            faceIds.data(), faceIds.size() / 3, aabb_tree_->numVertices());
+        if (store_adjacency_)
+        {
+            io.addVertexAdjacency(vertex_adjacency_);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(inflation_mutex_);
+    for (const std::string& layer : layers)
+    {
+        auto costs = io.getVertexCosts(layer);
+        if (costs.size() != aabb_tree_->numVertices())
+        {
+            ROS_ERROR_STREAM("The map has no cost layer " << layer << " to inflate");
+            continue;
+        }
+
+        try
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            std::unique_ptr<hdf5_map_io::CostInflation> inflation(new hdf5_map_io::CostInflation(
+                aabb_tree_->getVertices().data(), vertex_adjacency_.view(), options));
+            inflation->inflate(costs);
+
+            auto end = std::chrono::steady_clock::now();
+            ROS_INFO("Inflated the cost layer %s in %ld ms", layer.c_str(),
+                     std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+
+            mesh_msgs::MeshVertexCostsStamped vertexCostsMsg;
+            getVertexCosts(inflation->getInflatedCosts(), layer + INFLATED_SUFFIX, vertexCostsMsg);
+            pub_vertex_costs_.publish(vertexCostsMsg);
+
+            inflations_[layer] = std::move(inflation);
+        }
+        catch (const char* error)
+        {
+            ROS_ERROR_STREAM("Could not inflate the cost layer " << layer << ": " << error);
+        }
+    }
+}
+
+bool hdf5_to_msg::getRegion(
+    const std::vector<uint32_t>& faces,
+    const std::vector<std::string>& costLayers,
+    bool withColors,
+    mesh_msgs::MeshGeometryStamped& geometryMsg,
+    std::vector<uint32_t>& vertexIndices,
+    mesh_msgs::MeshVertexColors& vertexColorsMsg,
+    std::vector<mesh_msgs::MeshVertexCosts>& vertexCostsMsgs)
+{
+    const auto& vertices = aabb_tree_->getVertices();
+    const auto& faceIds = aabb_tree_->getFaceIds();
+    const size_t nVertices = aabb_tree_->numVertices();
+
+    vertexIndices.clear();
+    vertexIndices.reserve(faces.size() * 3);
+    for (uint32_t face : faces)
+    {
+        vertexIndices.insert(vertexIndices.end(), faceIds.begin() + face * 3, faceIds.begin() + face * 3 + 3);
+    }
+    std::sort(vertexIndices.begin(), vertexIndices.end());
+    vertexIndices.erase(std::unique(vertexIndices.begin(), vertexIndices.end()), vertexIndices.end());
+
+    std::vector<uint32_t> regionFaceIds(faces.size() * 3);
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        for (size_t corner = 0; corner < 3; corner++)
+        {
+            uint32_t vertex = faceIds[faces[i] * 3 + corner];
+            regionFaceIds[i * 3 + corner] = std::lower_bound(vertexIndices.begin(), vertexIndices.end(), vertex)
+                - vertexIndices.begin();
+        }
+    }
+
+    auto regionVertices = sliceVertices(vertices, vertexIndices, 3);
+    getVertices(regionVertices, geometryMsg);
+    getFaces(regionFaceIds, geometryMsg);
+
+    if (vertex_normals_.size() == nVertices * 3)
+    {
+        auto regionVertexNormals = sliceVertices(vertex_normals_, vertexIndices, 3);
+        getVertexNormals(regionVertexNormals, geometryMsg);
+    }
+
+    // colors and costs are read for the vertices of the region only, the cost layers may be changed by updates
+    hdf5_map_io::HDF5MapIO io(inputFile);
+
+    try
+    {
+        if (withColors)
+        {
+            auto regionVertexColors = io.getVertexColors(vertexIndices);
+            if (regionVertexColors.size() != vertexIndices.size() * 3)
+            {
+                ROS_ERROR("The map has no vertex colors");
+                return false;
+            }
+            mesh_msgs::MeshVertexColorsStamped vertexColorsStampedMsg;
+            getVertexColors(regionVertexColors, vertexColorsStampedMsg);
+            vertexColorsMsg = vertexColorsStampedMsg.mesh_vertex_colors;
+        }
+
+        vertexCostsMsgs.resize(costLayers.size());
+        for (size_t i = 0; i < costLayers.size(); i++)
+        {
+            vertexCostsMsgs[i].costs = io.getVertexCosts(costLayers[i], vertexIndices);
+            if (vertexCostsMsgs[i].costs.size() != vertexIndices.size())
+            {
+                ROS_ERROR_STREAM("The map has no cost layer " << costLayers[i]);
+                return false;
+            }
+        }
+    }
+    catch (const char* error)
+    {
+        ROS_ERROR_STREAM("Could not read the region: " << error);
+        return false;
+    }
+
+    ROS_INFO_STREAM("Sending a region with " << vertexIndices.size() << " vertices and " << faces.size() << " faces");
+
+    return true;
+}
+
 bool hdf5_to_msg::getVertices(std::vector<float>& vertices, mesh_msgs::MeshGeometryStamped& geometryMsg)
 {
     unsigned int nVertices = vertices.size() / 3;
@@ -176,7 +494,7 @@ bool hdf5_to_msg::getVertexColors(std::vector<uint8_t>& vertexColors, mesh_msgs:
     return true;
 }
 
-bool hdf5_to_msg::getVertexCosts(std::vector<float>& costs, std::string layer, mesh_msgs::MeshVertexCostsStamped& vertexCostsMsg)
+bool hdf5_to_msg::getVertexCosts(const std::vector<float>& costs, std::string layer, mesh_msgs::MeshVertexCostsStamped& vertexCostsMsg)
 {
     vertexCostsMsg.mesh_vertex_costs.costs.resize(costs.size());
     for (uint32_t i = 0; i < costs.size(); i++)
@@ -254,6 +572,182 @@ bool hdf5_to_msg::service_getGeometryVertexNormals(
     return getVertexNormals(vertexNormals, res.mesh_geometry_stamped);
 }
 
+bool hdf5_to_msg::service_getDecimatedGeometry(
+    mesh_msgs::GetDecimatedGeometry::Request& req,
+    mesh_msgs::GetDecimatedGeometry::Response& res)
+{
+    // coarsest level within the error tolerance, then coarser until the face budget is met
+    size_t selected = 0;
+    if (req.max_error > 0)
+    {
+        while (selected + 1 < lod_levels_.size() && lod_levels_[selected + 1].error <= req.max_error)
+        {
+            selected++;
+        }
+    }
+    if (req.max_faces > 0)
+    {
+        while (selected + 1 < lod_levels_.size() && lod_levels_[selected].numFaces > req.max_faces)
+        {
+            selected++;
+        }
+        if (lod_levels_[selected].numFaces > req.max_faces)
+        {
+            ROS_WARN_STREAM("The coarsest level of detail has " << lod_levels_[selected].numFaces
+                << " faces, exceeding the budget of " << req.max_faces << " faces");
+        }
+    }
+    const hdf5_map_io::MapLodLevel& lod = lod_levels_[selected];
+
+    // the geometry of the full mesh is held by the spatial index, only stored levels are read from the map
+    std::vector<uint32_t> faceIds;
+    if (lod.level == 0)
+    {
+        faceIds = aabb_tree_->getFaceIds();
+    }
+    else if (!lod_face_ids_[selected].empty())
+    {
+        faceIds = lod_face_ids_[selected];
+    }
+    else
+    {
+        hdf5_map_io::HDF5MapIO io(inputFile);
+        faceIds = io.getLodFaceIds(lod.level);
+    }
+
+    // only send the vertices referenced by the faces of the level
+    std::vector<uint32_t> vertexIndices(faceIds);
+    std::sort(vertexIndices.begin(), vertexIndices.end());
+    vertexIndices.erase(std::unique(vertexIndices.begin(), vertexIndices.end()), vertexIndices.end());
+
+    #pragma omp parallel for
+    for (int64_t i = 0; i < faceIds.size(); i++)
+    {
+        faceIds[i] = std::lower_bound(vertexIndices.begin(), vertexIndices.end(), faceIds[i]) - vertexIndices.begin();
+    }
+
+    auto lodVertices = sliceVertices(aabb_tree_->getVertices(), vertexIndices, 3);
+    std::vector<float> lodVertexNormals;
+    if (vertex_normals_.size() == aabb_tree_->numVertices() * 3)
+    {
+        lodVertexNormals = sliceVertices(vertex_normals_, vertexIndices, 3);
+    }
+
+    ROS_INFO_STREAM("Sending level of detail " << lod.level << " with " << lod.numFaces << " faces and an error of "
+        << lod.error);
+
+    getVertices(lodVertices, res.mesh_geometry_stamped);
+    getFaces(faceIds, res.mesh_geometry_stamped);
+    getVertexNormals(lodVertexNormals, res.mesh_geometry_stamped);
+
+    res.vertex_indices = vertexIndices;
+    res.error = lod.error;
+
+    return true;
+}
+
+bool hdf5_to_msg::service_getGeometryInBox(
+    mesh_msgs::GetGeometryInBox::Request& req,
+    mesh_msgs::GetGeometryInBox::Response& res)
+{
+    float min[3] = { float(req.min.x), float(req.min.y), float(req.min.z) };
+    float max[3] = { float(req.max.x), float(req.max.y), float(req.max.z) };
+    aabb_tree_->facesInBox(min, max, res.face_indices);
+
+    return getRegion(res.face_indices, req.cost_layers, req.vertex_colors, res.mesh_geometry_stamped,
+                     res.vertex_indices, res.vertex_colors, res.vertex_costs);
+}
+
+bool hdf5_to_msg::service_getGeometryInRadius(
+    mesh_msgs::GetGeometryInRadius::Request& req,
+    mesh_msgs::GetGeometryInRadius::Response& res)
+{
+    float center[3] = { float(req.center.x), float(req.center.y), float(req.center.z) };
+    aabb_tree_->facesInSphere(center, req.radius, res.face_indices);
+
+    return getRegion(res.face_indices, req.cost_layers, req.vertex_colors, res.mesh_geometry_stamped,
+                     res.vertex_indices, res.vertex_colors, res.vertex_costs);
+}
+
+bool hdf5_to_msg::service_getClosestPoints(
+    mesh_msgs::GetClosestPoints::Request& req,
+    mesh_msgs::GetClosestPoints::Response& res)
+{
+    const float maxDistance = req.max_distance > 0 ? req.max_distance : std::numeric_limits<float>::infinity();
+    res.hits.resize(req.points.size());
+
+    auto start = std::chrono::steady_clock::now();
+
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int64_t i = 0; i < req.points.size(); i++)
+    {
+        const float point[3] = { float(req.points[i].x), float(req.points[i].y), float(req.points[i].z) };
+        hdf5_map_io::PointHit hit;
+        if (aabb_tree_->closestPoint(point, hit, maxDistance))
+        {
+            res.hits[i] = toFaceHit(hit.face, hit.distance, hit.u, hit.v, hit.point);
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    ROS_DEBUG("Answered %lu closest point queries in %ld ms", req.points.size(),
+              std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+
+    return true;
+}
+
+bool hdf5_to_msg::service_getRayIntersections(
+    mesh_msgs::GetRayIntersections::Request& req,
+    mesh_msgs::GetRayIntersections::Response& res)
+{
+    if (req.origins.size() != req.directions.size())
+    {
+        ROS_ERROR("The number of ray origins and directions differ");
+        return false;
+    }
+
+    const float maxDistance = req.max_distance > 0 ? req.max_distance : std::numeric_limits<float>::infinity();
+    res.hits.resize(req.origins.size());
+
+    auto start = std::chrono::steady_clock::now();
+
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int64_t i = 0; i < req.origins.size(); i++)
+    {
+        const float origin[3] = { float(req.origins[i].x), float(req.origins[i].y), float(req.origins[i].z) };
+        float direction[3] = { float(req.directions[i].x), float(req.directions[i].y), float(req.directions[i].z) };
+
+        // normalized, so the ray parameter of the hit is its distance
+        float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1]
+                                 + direction[2] * direction[2]);
+        if (length == 0.0f)
+        {
+            continue;
+        }
+        for (size_t axis = 0; axis < 3; axis++)
+        {
+            direction[axis] /= length;
+        }
+
+        hdf5_map_io::RayHit hit;
+        if (aabb_tree_->intersectRay(origin, direction, hit, maxDistance))
+        {
+            float point[3];
+            for (size_t axis = 0; axis < 3; axis++)
+            {
+                point[axis] = origin[axis] + hit.distance * direction[axis];
+            }
+            res.hits[i] = toFaceHit(hit.face, hit.distance, hit.u, hit.v, point);
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    ROS_DEBUG("Answered %lu ray casts in %ld ms", req.origins.size(),
+              std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+
+    return true;
+}
+
 bool hdf5_to_msg::service_getMaterials(
     mesh_msgs::GetMaterials::Request& req,
     mesh_msgs::GetMaterials::Response& res)
@@ -389,6 +883,18 @@ bool hdf5_to_msg::service_getVertexCosts(
     mesh_msgs::GetVertexCosts::Request& req,
     mesh_msgs::GetVertexCosts::Response& res)
 {
+    // the inflated layers are only kept in memory
+    const size_t suffixStart = req.layer.size() - std::min(req.layer.size(), INFLATED_SUFFIX.size());
+    if (req.layer.compare(suffixStart, std::string::npos, INFLATED_SUFFIX) == 0)
+    {
+        std::lock_guard<std::mutex> lock(inflation_mutex_);
+        auto inflation = inflations_.find(req.layer.substr(0, suffixStart));
+        if (inflation != inflations_.end())
+        {
+            return getVertexCosts(inflation->second->getInflatedCosts(), req.layer, res.mesh_vertex_costs_stamped);
+        }
+    }
+
     hdf5_map_io::HDF5MapIO io(inputFile);
     
     auto costs = io.getVertexCosts(req.layer);
@@ -402,6 +908,12 @@ bool hdf5_to_msg::service_getVertexCostLayers(
     hdf5_map_io::HDF5MapIO io(inputFile);
 
     res.layers = io.getCostLayers();
+
+    std::lock_guard<std::mutex> lock(inflation_mutex_);
+    for (const auto& inflation : inflations_)
+    {
+        res.layers.push_back(inflation.first + INFLATED_SUFFIX);
+    }
     return true;
 }
 
@@ -473,6 +985,101 @@ void hdf5_to_msg::callback_clusterLabel(const mesh_msgs::MeshFaceClusterStamped:
     io.addLabel(label_group, label_name, indices);
 }
 
+void hdf5_to_msg::callback_vertexCosts(const mesh_msgs::MeshVertexCostsStamped::ConstPtr& msg)
+{
+    if (msg->uuid.compare(mesh_uuid) != 0)
+    {
+        ROS_ERROR("Invalid mesh UUID");
+        return;
+    }
+
+    const std::vector<float>& costs = msg->mesh_vertex_costs.costs;
+    if (costs.size() != aabb_tree_->numVertices())
+    {
+        ROS_ERROR_STREAM("The cost layer " << msg->type << " does not match the number of vertices");
+        return;
+    }
+
+    // concurrent updates of a layer are applied one after the other, so each one is diffed against the costs
+    // written by the previous one and the inflation follows the same order as the map
+    std::lock_guard<std::mutex> lock(inflation_mutex_);
+
+    bool updatable = false;
+    std::vector<uint32_t> vertexIds;
+    std::vector<float> changedCosts;
+    try
+    {
+        hdf5_map_io::HDF5MapIO io(inputFile);
+
+        // the geometry, the normals and the colors must never be overwritten by a cost layer
+        if (!io.canWriteVertexCosts(msg->type))
+        {
+            ROS_ERROR_STREAM("The map channel " << msg->type << " is not a cost layer");
+            return;
+        }
+
+        // only the changed costs are written and inflated again, which is cheap for local changes
+        auto storedCosts = io.getVertexCosts(msg->type);
+        updatable = storedCosts.size() == costs.size();
+        if (updatable)
+        {
+            for (uint32_t i = 0; i < costs.size(); i++)
+            {
+                if (costs[i] != storedCosts[i])
+                {
+                    vertexIds.push_back(i);
+                    changedCosts.push_back(costs[i]);
+                }
+            }
+            if (vertexIds.empty())
+            {
+                return;
+            }
+            io.updateVertexCosts(msg->type, vertexIds, changedCosts);
+        }
+        else
+        {
+            io.writeVertexCosts(msg->type, costs);
+        }
+    }
+    catch (const hf::Exception& e)
+    {
+        ROS_ERROR_STREAM("Could not write the cost layer " << msg->type << ": " << e.what());
+        return;
+    }
+    catch (const char* message)
+    {
+        ROS_ERROR_STREAM("Could not write the cost layer " << msg->type << ": " << message);
+        return;
+    }
+
+    auto inflation = inflations_.find(msg->type);
+    if (inflation == inflations_.end())
+    {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    size_t changedVertices = costs.size();
+    if (updatable)
+    {
+        changedVertices = inflation->second->update(vertexIds, changedCosts).size();
+    }
+    else
+    {
+        inflation->second->inflate(costs);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    ROS_DEBUG("Updated the inflation of %lu vertices of the cost layer %s in %ld ms", changedVertices,
+              msg->type.c_str(), std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+
+    mesh_msgs::MeshVertexCostsStamped vertexCostsMsg;
+    getVertexCosts(inflation->second->getInflatedCosts(), msg->type + INFLATED_SUFFIX, vertexCostsMsg);
+    pub_vertex_costs_.publish(vertexCostsMsg);
+}
+
 } // namespace mesh_msgs_hdf5
 
 int main(int argc, char **args)
@@ -0,0 +1,269 @@
+/*
+ *  Software License Agreement (BSD License)
+ *
+ *  Robot Operating System code by the University of Osnabrück
+ *  Copyright (c) 2015, University of Osnabrück
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ *  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ *  ChunkedMesh.hpp
+ *
+ */
+
+#ifndef CHUNKED_MESH_HPP
+#define CHUNKED_MESH_HPP
+
+#include <Types.hpp>
+
+#include <OGRE/OgreAny.h>
+#include <OGRE/OgreAxisAlignedBox.h>
+#include <OGRE/OgreColourValue.h>
+#include <OGRE/OgreMesh.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Ogre
+{
+// Forward declaration
+class Camera;
+class IndexData;
+class SceneManager;
+class SceneNode;
+class Entity;
+}  // End namespace Ogre
+
+namespace rviz_map_plugin
+{
+/**
+ * @brief A spatially compact part of a mesh with its own vertex list
+ */
+struct MeshChunk
+{
+  /// Global ids of the vertices of the chunk, the local id of a vertex is its index in this list
+  std::vector<uint32_t> vertexIds;
+  /// Global ids of the faces of the chunk
+  std::vector<uint32_t> faceIds;
+  /// Local vertex ids, three per face
+  std::vector<uint32_t> indices;
+  /// Bounding box of the vertices of the chunk
+  Ogre::AxisAlignedBox bounds;
+};
+
+/**
+ * @brief A simplified version of a chunk
+ */
+struct MeshChunkLod
+{
+  /// Local vertex ids, three per face
+  std::vector<uint32_t> indices;
+  /// Geometric error of the simplification in the units of the mesh
+  float error;
+};
+
+/// The simplified versions of each chunk, ordered from fine to coarse
+using MeshChunkLods = std::vector<std::vector<MeshChunkLod>>;
+
+/**
+ * @class ChunkedMesh
+ * @brief Renders a triangle mesh as one Ogre entity per chunk, so that chunks outside of the view are culled
+ *
+ * The chunks are the leaves of an octree over the face centroids. Each chunk has its own vertex and index buffer
+ * and a tight bounding box. Optional vertex colors are kept in a second vertex buffer, so they can be replaced
+ * without rebuilding the positions.
+ *
+ * Simplified versions of the chunks only add index buffers, since the simplification keeps a subset of the
+ * vertices of each chunk. The level of detail is chosen per chunk by the screen space error of its simplification.
+ */
+class ChunkedMesh
+{
+public:
+  /// Default maximum number of faces per chunk
+  static const size_t DEFAULT_MAX_CHUNK_FACES = 1 << 16;
+
+  /**
+   * @brief Splits the faces of a mesh into chunks
+   *
+   * @param geometry The mesh
+   * @param maxChunkFaces The maximum number of faces of a chunk
+   * @return The chunks, every face is in exactly one chunk
+   */
+  static std::shared_ptr<const std::vector<MeshChunk>> buildChunks(const Geometry& geometry,
+                                                                   size_t maxChunkFaces = DEFAULT_MAX_CHUNK_FACES);
+
+  /**
+   * @brief Simplifies every chunk into a sequence of coarser versions, the chunks are simplified in parallel
+   *
+   * The boundary vertices of a chunk are kept, so that adjacent chunks on different levels fit together. The
+   * result is cached on disk, keyed by the geometry, the chunks and the attributes.
+   *
+   * @param geometry The mesh
+   * @param chunks The chunks of the mesh, as created by buildChunks
+   * @param attributes Optional per vertex attributes like colors or costs, whose seams are preserved
+   * @param attributeDim The number of attributes per vertex
+   * @return The simplified versions of each chunk
+   */
+  static std::shared_ptr<const MeshChunkLods> buildLods(const Geometry& geometry, const std::vector<MeshChunk>& chunks,
+                                                        const std::vector<float>& attributes = std::vector<float>(),
+                                                        size_t attributeDim = 0);
+
+  /**
+   * @brief Constructor
+   *
+   * @param sceneManager The scene manager
+   * @param sceneNode The scene node the entities of the chunks are attached to
+   * @param name The name of the mesh, that has to be unique
+   */
+  ChunkedMesh(Ogre::SceneManager* sceneManager, Ogre::SceneNode* sceneNode, const std::string& name);
+
+  /**
+   * @brief Destructor
+   */
+  ~ChunkedMesh();
+
+  /**
+   * @brief Disabling the copy constructor, the chunked mesh owns its Ogre resources
+   */
+  ChunkedMesh(const ChunkedMesh&) = delete;
+
+  /**
+   * @brief Disabling the copy assignment operator
+   */
+  ChunkedMesh& operator=(const ChunkedMesh&) = delete;
+
+  /**
+   * @brief Creates the meshes and entities of all chunks
+   *
+   * @param geometry The mesh
+   * @param chunks The chunks of the mesh, as created by buildChunks
+   */
+  void setGeometry(const Geometry& geometry, std::shared_ptr<const std::vector<MeshChunk>> chunks);
+
+  /**
+   * @brief Sets the simplified versions of the chunks, which replaces the previous ones
+   *
+   * @param lods The simplified chunks, as created by buildLods, or a null pointer to remove them
+   */
+  void setLods(std::shared_ptr<const MeshChunkLods> lods);
+
+  /**
+   * @brief Returns true if simplified versions of the chunks are set
+   */
+  bool hasLods() const
+  {
+    return m_lods != nullptr;
+  }
+
+  /**
+   * @brief Selects the coarsest version of each chunk whose projected error stays within the given budget
+   *
+   * @param camera The camera the mesh is rendered with
+   * @param maxPixelError The maximum screen space error in pixels, zero renders the full resolution
+   */
+  void updateLod(const Ogre::Camera* camera, float maxPixelError);
+
+  /**
+   * @brief Sets the vertex colors
+   *
+   * @param colors One color per vertex of the mesh
+   */
+  void setColors(const std::vector<Ogre::ColourValue>& colors);
+
+  /**
+   * @brief Sets the material of all chunks
+   *
+   * @param materialName The name of the material
+   */
+  void setMaterial(const std::string& materialName);
+
+  /**
+   * @brief Shows or hides all chunks
+   */
+  void setVisible(bool visible);
+
+  /**
+   * @brief Sets a user object binding on the entities of all chunks, including the ones created later on
+   */
+  void setUserAny(const std::string& key, const Ogre::Any& value);
+
+  /**
+   * @brief Destroys the meshes and entities of all chunks
+   */
+  void clear();
+
+  /**
+   * @brief Returns true if no geometry is set
+   */
+  bool empty() const
+  {
+    return m_entities.empty();
+  }
+
+private:
+  /**
+   * @brief Switches the index buffer of a chunk to the given level of detail, zero is the full resolution
+   */
+  void selectLod(size_t chunk, size_t level);
+
+  /**
+   * @brief Deletes the index data of the simplified chunks and switches back to the full resolution
+   */
+  void clearLods();
+
+  Ogre::SceneManager* m_sceneManager;
+  Ogre::SceneNode* m_sceneNode;
+  std::string m_name;
+  std::string m_materialName;
+  bool m_visible = true;
+
+  std::shared_ptr<const std::vector<MeshChunk>> m_chunks;
+  std::shared_ptr<const MeshChunkLods> m_lods;
+  std::vector<Ogre::MeshPtr> m_meshes;
+  std::vector<Ogre::Entity*> m_entities;
+  std::vector<std::pair<std::string, Ogre::Any>> m_userAnys;
+
+  /// The full resolution index data of each chunk, which is owned by its sub mesh
+  std::vector<Ogre::IndexData*> m_baseIndexData;
+  /// The index data of the simplified versions of each chunk
+  std::vector<std::vector<Ogre::IndexData*>> m_lodIndexData;
+  /// The currently rendered level of detail of each chunk
+  std::vector<size_t> m_lodLevels;
+};
+
+}  // End namespace rviz_map_plugin
+
+#endif
@@ -127,6 +127,7 @@ using std::vector;
 
 // Forward declaration
 class ClusterLabelVisual;
+class ClusterLabelPaletteVisual;
 class ClusterLabelTool;
 
 /**
@@ -221,6 +222,12 @@ private Q_SLOTS:
    */
   void changeVisual();
 
+  /**
+   * @brief Rebuilds the palette visual from the faces of the visuals and shows only the visual of the active
+   *        label, or shows all visuals if single pass rendering is disabled
+   */
+  void updatePaletteVisual();
+
 private:
   /**
    * @brief RViz callback on initialize
@@ -247,6 +254,11 @@ private:
    */
   void fillPropertyOptions();
 
+  /**
+   * @brief Passes the colors of all labels to the palette visual at once
+   */
+  void updatePaletteColors();
+
   /// Geometry
   shared_ptr<Geometry> m_geometry;
 
@@ -259,6 +271,9 @@ private:
   /// Additional visual to help with labeling without a TexturedMesh
   unique_ptr<ClusterLabelVisual> m_phantomVisual;
 
+  /// Visual drawing all labels except the active one in a single pass
+  unique_ptr<ClusterLabelPaletteVisual> m_paletteVisual;
+
   /// Cluster data
   vector<Cluster> m_clusterList;
 
@@ -283,6 +298,9 @@ private:
   /// Property to hide or show a phantom visual
   rviz::BoolProperty* m_phantomVisualProperty;
 
+  /// Property to draw all labels in a single pass
+  rviz::BoolProperty* m_singlePassProperty;
+
   /// Index for the visuals
   int m_labelToolVisualIndex = 0;
 
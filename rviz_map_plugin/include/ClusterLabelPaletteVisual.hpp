@@ -0,0 +1,172 @@
+/*
+ *  Software License Agreement (BSD License)
+ *
+ *  Robot Operating System code by the University of Osnabrück
+ *  Copyright (c) 2015, University of Osnabrück
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ *  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ *  ClusterLabelPaletteVisual.hpp
+ *
+ */
+
+#ifndef CLUSTER_LABEL_PALETTE_VISUAL_HPP
+#define CLUSTER_LABEL_PALETTE_VISUAL_HPP
+
+#include <Types.hpp>
+
+#include <rviz/display.h>
+
+#include <OGRE/OgreColourValue.h>
+#include <OGRE/OgrePrerequisites.h>
+#include <OGRE/OgreMesh.h>
+#include <OGRE/OgreSubMesh.h>
+#include <OGRE/OgreTexture.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Ogre
+{
+// Forward declaration
+class SceneNode;
+class Entity;
+}  // End namespace Ogre
+
+namespace rviz_map_plugin
+{
+/**
+ * @class ClusterLabelPaletteVisual
+ * @brief Visual to show the faces of many labeled clusters in a single draw call
+ *
+ * Every corner of a labeled face carries the texture coordinates of its label in a palette texture, which holds
+ * one texel per label. The color of a label is changed by writing its texel, and a label is hidden by setting the
+ * alpha of its texel to zero, so the number of labels does not affect the number of draw calls or material
+ * switches. The faces are not indexed, since every face needs its own label. A face that belongs to several
+ * labels is drawn in the color of the last one.
+ */
+class ClusterLabelPaletteVisual
+{
+public:
+  /**
+   * @brief Constructor
+   *
+   * @param context The context that contains the display information.
+   * @param name The name of the visual (that has to be unique)
+   * @param geometry A shared pointer to the geometry to which the labels belong
+   */
+  ClusterLabelPaletteVisual(rviz::DisplayContext* context, std::string name, std::shared_ptr<Geometry> geometry);
+
+  /**
+   * @brief Destructor
+   */
+  ~ClusterLabelPaletteVisual();
+
+  /**
+   * @brief Disabling the copy constructor, the visual owns its Ogre resources
+   */
+  ClusterLabelPaletteVisual(const ClusterLabelPaletteVisual&) = delete;
+
+  /**
+   * @brief Disabling the copy assignment operator
+   */
+  ClusterLabelPaletteVisual& operator=(const ClusterLabelPaletteVisual&) = delete;
+
+  /**
+   * @brief Sets the faces of all labels and rebuilds the vertex buffer. All labels are visible afterwards.
+   *
+   * @param labelFaces The face ids of each label, the index of a label in this vector is its palette index
+   */
+  void setLabels(const std::vector<std::vector<uint32_t>>& labelFaces);
+
+  /**
+   * @brief Sets the color of a label
+   *
+   * @param label The palette index of the label
+   * @param color The color for the faces
+   * @param alpha The opacity, defaults to 1.0f (fully opaque)
+   */
+  void setColor(size_t label, Ogre::ColourValue color, float alpha = 1.0f);
+
+  /**
+   * @brief Sets the colors of the first labels and writes the palette only once
+   *
+   * @param colors The color of each label, colors beyond the number of labels are ignored
+   * @param alpha The opacity, defaults to 1.0f (fully opaque)
+   */
+  void setColors(const std::vector<Ogre::ColourValue>& colors, float alpha = 1.0f);
+
+  /**
+   * @brief Shows or hides a label
+   *
+   * @param label The palette index of the label
+   * @param visible false to hide the faces of the label
+   */
+  void setLabelVisible(size_t label, bool visible);
+
+private:
+  /**
+   * @brief Creates the palette texture with room for the given number of labels
+   */
+  void createPalette(size_t numLabels);
+
+  /**
+   * @brief Writes the colors of all labels to the palette texture
+   */
+  void writePalette();
+
+  rviz::DisplayContext* m_displayContext;
+  std::string m_name;
+  std::shared_ptr<Geometry> m_geometry;
+
+  Ogre::SceneNode* m_sceneNode;
+  Ogre::MeshPtr m_mesh;
+  Ogre::SubMesh* m_subMesh;
+  Ogre::Entity* m_entity;
+  Ogre::MaterialPtr m_material;
+  Ogre::TexturePtr m_palette;
+
+  /// Color of each label, as set by setColor
+  std::vector<Ogre::ColourValue> m_colors;
+  /// Visibility of each label
+  std::vector<bool> m_visible;
+  /// Width and height of the palette texture in texels
+  size_t m_paletteWidth = 0;
+  size_t m_paletteHeight = 0;
+};
+
+}  // end namespace rviz_map_plugin
+
+#endif
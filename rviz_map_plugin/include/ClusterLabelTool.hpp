@@ -54,10 +54,15 @@
 #define CL_HPP_ENABLE_EXCEPTIONS
 
 #include <Types.hpp>
+#include <FaceSelection.hpp>
+#include <SelectionQueries.hpp>
 
 #include <CL/cl2.hpp>
 
+#include <hdf5_map_io/mesh_adjacency.h>
+
 #include <vector>
+#include <string>
 #include <map>
 #include <memory>
 #include <boost/lexical_cast.hpp>
@@ -103,6 +108,8 @@ namespace rviz
 {
 class RosTopicProperty;
 class ColorProperty;
+class BoolProperty;
+class FloatProperty;
 }  // namespace rviz
 
 // OGRE stuff
@@ -200,9 +207,15 @@ public Q_SLOTS:
    */
   void resetVisual();
 
+private Q_SLOTS:
+
+  /**
+   * @brief Switches between the OpenCL and the CPU implementation of the selection queries
+   */
+  void updateUseOpenCL();
+
 private:
-  std::vector<uint32_t> m_selectedFaces;
-  std::vector<bool> m_faceSelectedArray;
+  FaceSelection m_selection;
   bool m_displayInitialized;
   ClusterLabelDisplay* m_display;
   std::shared_ptr<ClusterLabelVisual> m_visual;
@@ -220,8 +233,6 @@ private:
   bool m_singleSelect = false;
   bool m_singleDeselect = false;
 
-  std::vector<Ogre::Vector3> m_vertexPositions;
-
   void updateSelectionBox();
   void selectionBoxStart(rviz::ViewportMouseEvent& event);
   void selectionBoxMove(rviz::ViewportMouseEvent& event);
@@ -231,16 +242,120 @@ private:
   void selectSingleFaceParallel(Ogre::Ray& ray, bool selectMode);
   void selectSphereFaces(rviz::ViewportMouseEvent& event, bool selectMode);
   void selectSphereFacesParallel(Ogre::Ray& ray, bool selectMode);
+  void selectRegion(rviz::ViewportMouseEvent& event, bool selectMode);
+
+  /**
+   * @brief Grows a region over adjacent faces starting from the seed face and writes it to m_hitFaces. A face is
+   *        added while the angle between its normal and the normal of the seed face and its distance from the seed
+   *        face, measured along the centroids of the faces the region grew over, stay under the thresholds given
+   *        by the tool properties. The region grows in parallel one frontier at a time.
+   * @param seedFace The face to start from
+   */
+  void growRegion(uint32_t seedFace);
+
+  /**
+   * @brief Builds the face adjacency and the face normals and centroids needed for growing regions
+   */
+  void buildRegionGrowingData();
   boost::optional<std::pair<uint32_t, float>> getClosestIntersectedFaceParallel(Ogre::Ray& ray);
 
+  /**
+   * @brief CPU implementation of getClosestIntersectedFaceParallel, used if OpenCL is not available, see castRay
+   * @param ray The ray in world coordinates
+   * @return The closest hit face and the ray parameter of the hit, if any
+   */
+  boost::optional<std::pair<uint32_t, float>> getClosestIntersectedFaceCPU(const Ogre::Ray& ray);
+
+  /**
+   * @brief CPU implementation of the cast_sphere kernel, writes all faces with a vertex inside of the sphere given
+   *        by m_sphereData and m_sphereSize to m_hitFaces
+   */
+  void castSphereCPU();
+
+  /**
+   * @brief CPU implementation of the cast_box kernel, writes all faces with a vertex inside of the volume given by
+   *        the planes in m_boxData to m_hitFaces
+   */
+  void castBoxCPU();
+
+  /**
+   * @brief Returns true if the selection queries are run with OpenCL
+   */
+  bool useOpenCL() const;
+
+  /**
+   * @brief Selects or deselects the given faces and updates the visual if the selection changed
+   * @param faces The faces hit by the current selection
+   * @param selectMode true to select, false to deselect the faces
+   */
+  void updateSelection(const std::vector<uint32_t>& faces, bool selectMode);
+
+  /**
+   * @brief Runs a sphere or box kernel and reads back the compacted list of hit faces into m_hitFaces
+   * @param kernel The kernel to run, its arguments have to be set already
+   */
+  void castSelectionKernel(cl::Kernel& kernel);
+
+  /**
+   * @brief Creates and builds m_clProgram for m_clDevice, preferably from a cached program binary
+   * @param source The kernel source code
+   */
+  void buildProgram(const std::string& source);
+
+  /**
+   * @brief Returns the path of the cached program binary for the given source and the current device. The name
+   *        of the file contains a hash of the device name, the driver version and the source code.
+   * @param source The kernel source code
+   * @return The path of the cache file
+   */
+  std::string getProgramCachePath(const std::string& source);
+
+  /**
+   * @brief Creates and builds m_clProgram from a cached program binary
+   * @param path The path of the cache file
+   * @return true if the binary was found and built successfully
+   */
+  bool loadProgramBinary(const std::string& path);
+
+  /**
+   * @brief Writes the binary of the built m_clProgram for m_clDevice to the cache
+   * @param path The path of the cache file
+   */
+  void saveProgramBinary(const std::string& path);
+
+  /**
+   * @brief Closest hit as written by the reduce_closest kernel, the layout has to match closest_hit_t
+   */
+  struct ClosestHit
+  {
+    cl_uint face;
+    cl_float distance;
+  };
+
   ros::Publisher m_labelPublisher;
 
-  std::vector<float> m_vertexData;
   std::array<float, 6> m_rayData;
   std::array<float, 4> m_sphereData;
-  std::array<float, 3> m_startNormalData;
   std::vector<float> m_boxData;
-  std::vector<float> m_resultDistances;
+  std::vector<uint32_t> m_hitFaces;
+  std::vector<uint32_t> m_changedFaces;
+  /// Per vertex flags of the CPU sphere and box queries
+  std::vector<uint8_t> m_vertexHits;
+
+  rviz::BoolProperty* m_useOpenCLProperty;
+  rviz::FloatProperty* m_regionMaxAngleProperty;
+  rviz::FloatProperty* m_regionMaxDistanceProperty;
+
+  // Region growing, built on the first use for the current geometry
+  std::unique_ptr<hdf5_map_io::MeshAdjacency> m_faceAdjacency;
+  std::vector<Ogre::Vector3> m_faceNormals;
+  std::vector<Ogre::Vector3> m_faceCentroids;
+  /// Distance of the faces of the current region from the seed face
+  std::vector<float> m_regionDistances;
+  /// Flags of the faces of the current region, reset after each query
+  std::vector<uint8_t> m_regionVisited;
+  /// true if a device was found and the program and buffers were set up successfully
+  bool m_clAvailable = false;
 
   // OpenCL
   cl::Device m_clDevice;
@@ -249,15 +364,24 @@ private:
   cl::Program m_clProgram;
   cl::CommandQueue m_clQueue;
   cl::Buffer m_clVertexBuffer;
-  cl::Buffer m_clResultBuffer;
+  cl::Buffer m_clFaceBuffer;
+  cl::Buffer m_clGroupDistanceBuffer;
+  cl::Buffer m_clGroupFaceBuffer;
+  cl::Buffer m_clClosestHitBuffer;
+  cl::Buffer m_clHitFaceBuffer;
+  cl::Buffer m_clHitCountBuffer;
   cl::Buffer m_clRayBuffer;
   cl::Buffer m_clSphereBuffer;
   cl::Buffer m_clBoxBuffer;
-  cl::Buffer m_clStartNormalBuffer;
   cl::Kernel m_clKernelSingleRay;
+  cl::Kernel m_clKernelReduceClosest;
   cl::Kernel m_clKernelSphere;
   cl::Kernel m_clKernelBox;
-  cl::Kernel m_clKernelDirAndDist;
+
+  /// Local work size of all kernels, a power of two
+  size_t m_clWorkGroupSize;
+  /// Number of work groups needed to cover all faces
+  size_t m_clNumGroups;
 };
 }  // end namespace rviz_map_plugin
 
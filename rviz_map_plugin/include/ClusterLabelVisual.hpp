@@ -63,6 +63,7 @@
 
 #include <memory>
 #include <vector>
+#include <unordered_map>
 
 namespace Ogre
 {
@@ -137,6 +138,26 @@ public:
    */
   void setFacesInCluster(const std::vector<uint32_t>& faces);
 
+  /**
+   * @brief Adds faces to the shown cluster
+   *
+   * Only the indices of the new faces are written to the index buffer, which is over-allocated so that
+   * it has to be reallocated only rarely.
+   *
+   * @param faces A vector containing the face ids, faces already in the cluster are ignored
+   */
+  void addFaces(const std::vector<uint32_t>& faces);
+
+  /**
+   * @brief Removes faces from the shown cluster
+   *
+   * Each removed face is replaced by the last face of the index buffer, so only the patched slots are
+   * written. The index buffer is shrunk once it is mostly unused.
+   *
+   * @param faces A vector containing the face ids, faces not in the cluster are ignored
+   */
+  void removeFaces(const std::vector<uint32_t>& faces);
+
   /**
    * @brief Sets the color
    *
@@ -145,6 +166,13 @@ public:
    */
   void setColor(Ogre::ColourValue facesColor, float alpha = 1.0f);
 
+  /**
+   * @brief Shows or hides the cluster, the faces and the index buffer are kept while it is hidden
+   *
+   * @param visible false to hide the cluster
+   */
+  void setVisible(bool visible);
+
   /**
    * @brief Returns the faces
    *
@@ -158,6 +186,26 @@ public:
 private:
   void initMaterial();
 
+  /**
+   * @brief Creates a new index buffer with room for the given number of faces and fills it with all faces
+   */
+  void createIndexBuffer(size_t capacity);
+
+  /**
+   * @brief Writes the indices of the faces in the given range of slots to the index buffer
+   */
+  void writeFaces(size_t firstSlot, size_t count);
+
+  /**
+   * @brief Updates the index count of the submesh and hides the cluster if it is empty
+   */
+  void updateIndexCount();
+
+  /**
+   * @brief Builds the lookup from face ids to index buffer slots, if it is not up to date
+   */
+  void buildFaceSlots();
+
   rviz::DisplayContext* m_displayContext;
   Ogre::SceneNode* m_sceneNode;
   std::string m_labelId;
@@ -169,7 +217,15 @@ private:
   Ogre::ColourValue m_color;
 
   std::shared_ptr<Geometry> m_geometry;
+
+  /// The faces in the order of their slots in the index buffer
   std::vector<uint32_t> m_faces;
+  /// Slot of each face in the index buffer, only built once faces are added or removed
+  std::unordered_map<uint32_t, uint32_t> m_faceSlots;
+  /// Number of faces the current index buffer can hold
+  size_t m_faceCapacity = 0;
+  /// Whether the cluster is drawn
+  bool m_visible = true;
 };
 
 }  // end namespace rviz_map_plugin
@@ -0,0 +1,164 @@
+/*
+ *  Software License Agreement (BSD License)
+ *
+ *  Robot Operating System code by the University of Osnabrück
+ *  Copyright (c) 2015, University of Osnabrück
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ *  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ *  FaceSelection.hpp
+ *
+ */
+
+#ifndef FACE_SELECTION_HPP
+#define FACE_SELECTION_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace rviz_map_plugin
+{
+/**
+ * @class FaceSelection
+ * @brief Set of selected face ids, stored as a bitset over all faces of a mesh
+ *
+ * Besides the bitset a list of the selected faces is kept, so that iterating the selection does not require
+ * scanning the whole mesh. Selecting and deselecting faces costs time proportional to the number of given
+ * faces. Consecutive faces falling into the same word of the bitset are merged with a single mask, which
+ * suits the mostly ascending face lists returned by the selection kernels. Deselected faces are removed
+ * from the list lazily, once they make up half of it or the list is requested.
+ */
+class FaceSelection
+{
+public:
+  /**
+   * @brief Resizes the selection to the given number of faces and deselects all faces
+   * @param numFaces The number of faces of the mesh
+   */
+  void resize(size_t numFaces);
+
+  /**
+   * @brief Replaces the selection with the given faces
+   * @param faceIds The faces to select
+   */
+  void set(const std::vector<uint32_t>& faceIds);
+
+  /**
+   * @brief Deselects all faces
+   */
+  void clear();
+
+  /**
+   * @brief Selects the given faces
+   * @param faceIds The faces to select, may contain duplicates
+   * @param changed If not null, the faces that were not selected before are appended
+   * @return The number of newly selected faces
+   */
+  size_t select(const std::vector<uint32_t>& faceIds, std::vector<uint32_t>* changed = nullptr);
+
+  /**
+   * @brief Deselects the given faces
+   * @param faceIds The faces to deselect, may contain duplicates
+   * @param changed If not null, the faces that were selected before are appended
+   * @return The number of deselected faces
+   */
+  size_t deselect(const std::vector<uint32_t>& faceIds, std::vector<uint32_t>* changed = nullptr);
+
+  /**
+   * @brief Checks whether a face is selected
+   * @param faceId The face id
+   * @return true if the face is selected
+   */
+  inline bool isSelected(uint32_t faceId) const
+  {
+    size_t word = faceId / BITS_PER_WORD;
+    return word < m_words.size() && (m_words[word] & bit(faceId));
+  }
+
+  /**
+   * @brief Returns the number of selected faces
+   */
+  inline size_t getCount() const
+  {
+    return m_count;
+  }
+
+  /**
+   * @brief Counts the selected faces by the population count of the bitset
+   * @return The number of selected faces
+   */
+  size_t countSelected() const;
+
+  /**
+   * @brief Returns the selected faces in the order they were selected
+   * @return List of face ID's
+   */
+  const std::vector<uint32_t>& getFaces();
+
+  /**
+   * @brief Returns the selected faces in ascending order
+   * @return List of face ID's
+   */
+  std::vector<uint32_t> getSortedFaces() const;
+
+private:
+  static constexpr size_t BITS_PER_WORD = 64;
+
+  static inline uint64_t bit(uint32_t faceId)
+  {
+    return uint64_t(1) << (faceId % BITS_PER_WORD);
+  }
+
+  /**
+   * @brief Grows the bitset if it can not hold the given face
+   */
+  void reserveFace(uint32_t faceId);
+
+  /**
+   * @brief Removes deselected and duplicate entries from m_faces
+   */
+  void compact();
+
+  /// One bit per face
+  std::vector<uint64_t> m_words;
+  /// Selected faces, may contain deselected faces and duplicates until the next compaction
+  std::vector<uint32_t> m_faces;
+  /// Number of selected faces
+  size_t m_count = 0;
+};
+
+}  // End namespace rviz_map_plugin
+
+#endif
@@ -0,0 +1,136 @@
+/*
+ *  Software License Agreement (BSD License)
+ *
+ *  Robot Operating System code by the University of Osnabrück
+ *  Copyright (c) 2015, University of Osnabrück
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ *  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ *  MapCache.hpp
+ *
+ */
+
+#ifndef MAP_CACHE_HPP
+#define MAP_CACHE_HPP
+
+#include <ChunkedMesh.hpp>
+#include <Types.hpp>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace rviz_map_plugin
+{
+/**
+ * @brief Everything the MapDisplay reads from a map file, converted into the form it is rendered from
+ */
+struct MapData
+{
+  /// Vertices and faces
+  Geometry geometry;
+  /// The chunks the mesh is rendered in, i.e. the vertex and index streams of the GPU buffers
+  std::vector<MeshChunk> chunks;
+  /// Materials with the faces they are applied to
+  std::vector<Material> materials;
+  /// Textures
+  std::vector<Texture> textures;
+  /// Vertex colors
+  std::vector<Color> colors;
+  /// Vertex normals
+  std::vector<Normal> normals;
+  /// Texture coordinates
+  std::vector<TexCoords> texCoords;
+  /// Labeled clusters
+  std::vector<Cluster> clusters;
+  /// Cost layers
+  std::map<std::string, std::vector<float>> costs;
+};
+
+/**
+ * @class MapCache
+ * @brief Binary file next to a map, that holds the MapData of the map for fast warm starts
+ *
+ * The cache stores the path, the size and the modification time of the map it was created from and is only used
+ * while they still match, so any change to the map invalidates it. All data is stored in the layout it has in
+ * memory, loading it is a sequence of copies out of the memory mapped file.
+ */
+class MapCache
+{
+public:
+  /**
+   * @brief Constructor
+   *
+   * @param mapFile The path of the map file
+   */
+  explicit MapCache(const std::string& mapFile);
+
+  /**
+   * @brief Loads the data of the map from the cache
+   *
+   * @param data The data of the map, only valid if true is returned
+   * @return true if the cache exists, is complete and belongs to the current version of the map
+   */
+  bool load(MapData& data) const;
+
+  /**
+   * @brief Writes the data of the map to the cache, an existing cache is replaced
+   *
+   * @param data The data of the map
+   * @return true if the cache has been written
+   */
+  bool save(const MapData& data) const;
+
+  /**
+   * @brief Returns the path of the cache file
+   */
+  const std::string& getPath() const
+  {
+    return m_path;
+  }
+
+private:
+  /// The map file, which identifies the cache together with its size and modification time
+  std::string m_mapFile;
+  uint64_t m_mapSize;
+  int64_t m_mapModified;
+
+  /// The path of the cache file
+  std::string m_path;
+};
+
+}  // namespace rviz_map_plugin
+
+#endif
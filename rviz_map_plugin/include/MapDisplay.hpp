@@ -110,6 +110,7 @@
 
 #include <ClusterLabelDisplay.hpp>
 #include <MeshDisplay.hpp>
+#include <MapCache.hpp>
 
 namespace rviz
 {
@@ -187,14 +188,29 @@ private:
   void onDisable();
 
   /**
-   * @brief Read all data from the HDF5 file and save it in the member variables
+   * @brief RViz callback on every frame, forwarded to the mesh display which is not updated by rviz as a child
+   */
+  void update(float wall_dt, float ros_dt);
+
+  /**
+   * @brief Read all data from the map cache or the HDF5 file and save it in the member variables
    * @return true, if successful
    */
   bool loadData();
 
+  /**
+   * @brief Read all data from the HDF5 file and convert it for rendering
+   * @param mapFile The path of the map file
+   * @param data The converted data
+   * @return true, if successful
+   */
+  bool loadMapFile(const std::string& mapFile, MapData& data);
+
   // TODO: make more efficient - currently everything is stored in the MapDisplay, the MeshDisplay and the MeshVisual
   /// Geometry
   shared_ptr<Geometry> m_geometry;
+  /// Chunks the geometry is rendered in
+  shared_ptr<const vector<MeshChunk>> m_chunks;
   /// Materials
   vector<Material> m_materials;
   /// Textures
@@ -150,6 +150,13 @@ public:
    */
   void onDisable();
 
+  /**
+   * @brief RViz callback on every frame, selects the level of detail of the mesh
+   * @param wall_dt Wall clock time since the last update
+   * @param ros_dt ROS time since the last update
+   */
+  void update(float wall_dt, float ros_dt);
+
   /**
    * @brief Set the topics to subscribe.
    */
@@ -171,8 +178,9 @@ public:
   /**
    * @brief Set the geometry
    * @param geometry The geometry
+   * @param chunks The chunks of the geometry, built from the geometry if null
    */
-  void setGeometry(shared_ptr<Geometry> geometry);
+  void setGeometry(shared_ptr<Geometry> geometry, shared_ptr<const vector<MeshChunk>> chunks = nullptr);
 
   /**
    * @brief Set the vertex colors
@@ -469,6 +477,9 @@ private:
   /// Property to set wireframe transparency
   rviz::FloatProperty* m_wireframeAlpha;
 
+  /// Property to set the maximum screen space error of the simplified mesh
+  rviz::FloatProperty* m_lodErrorBudget;
+
   /// Cache for received vertex cost messages
   std::map<std::string, std::vector<float>> m_costCache;
 };
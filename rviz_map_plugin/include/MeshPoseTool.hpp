@@ -49,6 +49,9 @@
 #include <OGRE/OgreQuaternion.h>
 #include <OGRE/OgreManualObject.h>
 #include <OGRE/OgreRay.h>
+#include <OGRE/OgreNode.h>
+
+#include <hdf5_map_io/aabb_tree.h>
 
 #include <QCursor>
 #include <ros/ros.h>
@@ -73,11 +76,8 @@ public:
 protected:
   virtual void onPoseSet(const Ogre::Vector3& position, const Ogre::Quaternion& orientation) = 0;
 
-  void getRawManualObjectData(const Ogre::ManualObject* mesh, const size_t sectionNumber, size_t& vertexCount,
-                              Ogre::Vector3*& vertices, size_t& indexCount, unsigned long*& indices);
-
-  bool getPositionAndOrientation(const Ogre::ManualObject* mesh, const Ogre::Ray& ray, Ogre::Vector3& position,
-                                 Ogre::Vector3& orientation);
+  bool getPositionAndOrientation(const hdf5_map_io::AABBTree& aabbTree, const Ogre::Node* node, const Ogre::Ray& ray,
+                                 Ogre::Vector3& position, Ogre::Vector3& orientation);
 
   bool selectTriangle(rviz::ViewportMouseEvent& event, Ogre::Vector3& position, Ogre::Vector3& orientation);
 
@@ -77,13 +77,18 @@
 #include <OGRE/OgreColourValue.h>
 
 #include <Types.hpp>
+#include <ChunkedMesh.hpp>
+#include <hdf5_map_io/aabb_tree.h>
 #include <vector>
+#include <memory>
+#include <future>
 
 namespace Ogre
 {
 // Forward declaration
 class Vector3;
 class Quaternion;
+class Camera;
 class SceneNode;
 class Entity;
 
@@ -121,8 +126,25 @@ public:
    * @brief Extracts data from the ros-messages and creates meshes.
    *
    * @param geometry Geometry containing the mesh
+   * @param chunks The chunks of the geometry, e.g. from a cache, built from the geometry if null
    */
-  bool setGeometry(const Geometry& geometry);
+  bool setGeometry(const Geometry& geometry, std::shared_ptr<const std::vector<MeshChunk>> chunks = nullptr);
+
+  /**
+   * @brief Attaches the AABB tree of the geometry to the meshes of this visual, so that tools can pick the
+   *        meshes without reading back their hardware buffers.
+   *
+   * @param aabbTree The AABB tree built from the geometry of this visual
+   */
+  void setAABBTree(std::shared_ptr<hdf5_map_io::AABBTree> aabbTree);
+
+  /**
+   * @brief Returns the AABB tree attached to the given object by a mesh visual.
+   *
+   * @param object An object found by a scene query
+   * @return The AABB tree or a null pointer if the object does not belong to a mesh visual
+   */
+  static std::shared_ptr<hdf5_map_io::AABBTree> getAABBTree(Ogre::MovableObject* object);
 
   /**
    * @brief Passes the normal data to the mesh visual
@@ -265,7 +287,38 @@ public:
    */
   void updateWireframe(bool showWireframe, Ogre::ColourValue wireframeColor, float wireframeAlpha);
 
+  /**
+   * @brief Selects the level of detail of each mesh chunk. The first call starts building the simplified chunks in
+   *        the background, they are used by the first call after they are ready.
+   *
+   * @param camera            The camera the mesh is rendered with
+   * @param maxPixelError     The maximum screen space error in pixels, zero renders the full resolution
+   */
+  void updateLod(const Ogre::Camera* camera, float maxPixelError);
+
 private:
+  /**
+   * @brief Simplified chunks of a chunked mesh that are built in the background
+   */
+  struct LodBuild
+  {
+    /// The running build, if any
+    std::future<std::shared_ptr<const MeshChunkLods>> lods;
+    /// Incremented whenever the geometry or the attributes change, so that outdated builds are discarded
+    size_t version = 0;
+    /// The version the running build was started for
+    size_t buildVersion = 0;
+  };
+
+  /**
+   * @brief Passes finished simplified chunks to the mesh or starts building them, without waiting for the build
+   * @param mesh The chunked mesh
+   * @param build The build of the mesh
+   * @param attributes The per vertex attributes whose seams are preserved
+   * @param attributeDim The number of attributes per vertex
+   */
+  void updateLodBuild(ChunkedMesh& mesh, LodBuild& build, const std::vector<float>& attributes, size_t attributeDim);
+
   /**
    * @brief Enables the wireframe
    * @param pass Ogre Pass
@@ -333,13 +386,29 @@ private:
   size_t m_random;
 
   /// The mesh-object to display
-  Ogre::ManualObject* m_mesh;
+  std::unique_ptr<ChunkedMesh> m_mesh;
 
   /// The manual object to display normals
   Ogre::ManualObject* m_normals;
 
-  /// The manual object to display the mesh with vertex costs
-  Ogre::ManualObject* m_vertexCostsMesh;
+  /// The chunked mesh to display the mesh with vertex costs
+  std::unique_ptr<ChunkedMesh> m_vertexCostsMesh;
+
+  /// The spatial chunks of the geometry, shared by m_mesh and m_vertexCostsMesh
+  std::shared_ptr<const std::vector<MeshChunk>> m_chunks;
+
+  /// The vertex colors whose seams are preserved by the simplified chunks of m_mesh, four floats per vertex
+  std::vector<float> m_meshLodAttributes;
+
+  /// The normalized vertex costs whose seams are preserved by the simplified chunks of m_vertexCostsMesh
+  std::vector<float> m_vertexCostsLodAttributes;
+
+  /// The background builds of the simplified chunks of m_mesh and m_vertexCostsMesh
+  LodBuild m_meshLodBuild;
+  LodBuild m_vertexCostsLodBuild;
+
+  /// A copy of the geometry for the background builds, which may outlive a change of m_geometry
+  std::shared_ptr<const Geometry> m_lodGeometry;
 
   /// The manual object to display the textured mesh
   Ogre::ManualObject* m_texturedMesh;
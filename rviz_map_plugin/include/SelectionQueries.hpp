@@ -0,0 +1,89 @@
+/*
+ *  Software License Agreement (BSD License)
+ *
+ *  Robot Operating System code by the University of Osnabrück
+ *  Copyright (c) 2015, University of Osnabrück
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ *  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ *  SelectionQueries.hpp
+ *
+ */
+
+#ifndef SELECTION_QUERIES_HPP
+#define SELECTION_QUERIES_HPP
+
+#include <Types.hpp>
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <boost/optional.hpp>
+
+namespace rviz_map_plugin
+{
+/**
+ * @brief Finds the closest face hit by a ray, the CPU counterpart of the cast_rays and reduce_closest kernels
+ * @param geometry The mesh
+ * @param ray Origin and direction of the ray, as x, y and z each
+ * @return The closest hit face and the ray parameter of the hit, if any. Of equally close faces the one with the
+ *         smaller id is returned.
+ */
+boost::optional<std::pair<uint32_t, float>> castRay(const Geometry& geometry, const std::array<float, 6>& ray);
+
+/**
+ * @brief Finds all faces with a vertex inside of a sphere, the CPU counterpart of the cast_sphere kernel
+ * @param geometry The mesh
+ * @param center The center of the sphere
+ * @param radius The radius of the sphere
+ * @param vertexHits Buffer for the per vertex results, reused between calls
+ * @param hitFaces The hit faces, in no particular order
+ */
+void castSphere(const Geometry& geometry, const std::array<float, 3>& center, float radius,
+                std::vector<uint8_t>& vertexHits, std::vector<uint32_t>& hitFaces);
+
+/**
+ * @brief Finds all faces with a vertex inside of a convex volume, the CPU counterpart of the cast_box kernel
+ * @param geometry The mesh
+ * @param planes Six planes as four floats each, normal and distance, a point p is inside if n * p + d > 0 for all
+ * @param vertexHits Buffer for the per vertex results, reused between calls
+ * @param hitFaces The hit faces, in no particular order
+ */
+void castBox(const Geometry& geometry, const float* planes, std::vector<uint8_t>& vertexHits,
+             std::vector<uint32_t>& hitFaces);
+
+}  // End namespace rviz_map_plugin
+
+#endif
@@ -14,6 +14,34 @@ typedef struct {
     float3 vertex2;
 } triangle_t;
 
+/**
+ * Closest hit of a ray cast, written by reduce_closest. Has to match the
+ * layout of ClusterLabelTool::ClosestHit on the host side.
+ */
+typedef struct {
+    uint face;
+    float distance;
+} closest_hit_t;
+
+#define NO_FACE 0xFFFFFFFF
+
+/**
+ * Loads the triangle of a face from the indexed mesh, i.e. three floats per
+ * vertex and three vertex indices per face.
+ */
+triangle_t load_triangle(
+    __global const float* vertices,
+    __global const uint* faces,
+    uint id
+)
+{
+    triangle_t triangle;
+    triangle.vertex0 = vload3(faces[id * 3 + 0], vertices);
+    triangle.vertex1 = vload3(faces[id * 3 + 1], vertices);
+    triangle.vertex2 = vload3(faces[id * 3 + 2], vertices);
+    return triangle;
+}
+
 /**
  * Credits go to: https://en.wikipedia.org/wiki/M%C3%B6ller%E2%80%93Trumbore_intersection_algorithm
  */
@@ -70,98 +98,230 @@ intersection_result ray_intersects_triangle(
 }
 
 
+/**
+ * Reduces the (distance, face) pairs in local memory to the closest one, which
+ * ends up at index 0. Ties are resolved in favour of the smaller face id, so
+ * the result does not depend on the scheduling of the work items.
+ * Requires the local work size to be a power of two.
+ */
+void reduce_closest_local(
+    __local float* distances,
+    __local uint* faces,
+    uint lid
+)
+{
+    for (uint stride = get_local_size(0) / 2; stride > 0; stride >>= 1)
+    {
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if (lid < stride)
+        {
+            float other_distance = distances[lid + stride];
+            uint other_face = faces[lid + stride];
+            if (other_distance < distances[lid] || (other_distance == distances[lid] && other_face < faces[lid]))
+            {
+                distances[lid] = other_distance;
+                faces[lid] = other_face;
+            }
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+/**
+ * Appends the face id to the hit list if hit is set. The slots are reserved
+ * per work group, so there is only one global atomic operation per group.
+ * local_count and local_offset have to be declared at kernel scope.
+ */
+void append_hit(
+    bool hit,
+    uint id,
+    __global uint* hits,
+    __global uint* hit_count,
+    __local uint* local_count,
+    __local uint* local_offset
+)
+{
+    uint lid = get_local_id(0);
+    if (lid == 0)
+    {
+        *local_count = 0;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    uint slot = 0;
+    if (hit)
+    {
+        slot = atomic_inc(local_count);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (lid == 0 && *local_count > 0)
+    {
+        *local_offset = atomic_add(hit_count, *local_count);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (hit)
+    {
+        hits[*local_offset + slot] = id;
+    }
+}
+
+/**
+ * Intersects the ray with every face and writes the closest hit of each work
+ * group to group_distances and group_faces. Faces without a hit have an
+ * infinite distance.
+ */
 __kernel void cast_rays(
-    __global float* vertices,
+    __global const float* vertices,
+    __global const uint* faces,
+    const uint num_faces,
     __global float* ray,
-    __global float* result
+    __global float* group_distances,
+    __global uint* group_faces,
+    __local float* local_distances,
+    __local uint* local_faces
 )
 {
-    int id = get_global_id(0);
+    uint id = get_global_id(0);
+    uint lid = get_local_id(0);
 
     float3 rayOrigin = (float3)(ray[0], ray[1], ray[2]);
     float3 rayDirection = (float3)(ray[3], ray[4], ray[5]);
 
-    // initialize result memory
-    result[id] = -1;
+    float hit_distance = INFINITY;
+    if (id < num_faces)
+    {
+        triangle_t triangle = load_triangle(vertices, faces, id);
+        intersection_result i_result = ray_intersects_triangle(rayDirection, rayOrigin, triangle);
+        if (i_result.intersects)
+        {
+            hit_distance = i_result.intersection;
+        }
+    }
+
+    local_distances[lid] = hit_distance;
+    local_faces[lid] = id;
+    reduce_closest_local(local_distances, local_faces, lid);
 
-    triangle_t triangle;
-    triangle.vertex0 = (float3)(vertices[id * 9 + 0], vertices[id * 9 + 1], vertices[id * 9 + 2]);
-    triangle.vertex1 = (float3)(vertices[id * 9 + 3], vertices[id * 9 + 4], vertices[id * 9 + 5]);
-    triangle.vertex2 = (float3)(vertices[id * 9 + 6], vertices[id * 9 + 7], vertices[id * 9 + 8]);
+    if (lid == 0)
+    {
+        group_distances[get_group_id(0)] = local_distances[0];
+        group_faces[get_group_id(0)] = local_faces[0];
+    }
+}
+
+/**
+ * Reduces the per group results of cast_rays to the single closest hit. Has to
+ * be run with exactly one work group.
+ */
+__kernel void reduce_closest(
+    __global float* group_distances,
+    __global uint* group_faces,
+    const uint num_groups,
+    __global closest_hit_t* closest,
+    __local float* local_distances,
+    __local uint* local_faces
+)
+{
+    uint lid = get_local_id(0);
+
+    float best_distance = INFINITY;
+    uint best_face = NO_FACE;
+    for (uint i = lid; i < num_groups; i += get_local_size(0))
+    {
+        float distance = group_distances[i];
+        uint face = group_faces[i];
+        if (distance < best_distance || (distance == best_distance && face < best_face))
+        {
+            best_distance = distance;
+            best_face = face;
+        }
+    }
+
+    local_distances[lid] = best_distance;
+    local_faces[lid] = best_face;
+    reduce_closest_local(local_distances, local_faces, lid);
 
-    intersection_result i_result = ray_intersects_triangle(rayDirection, rayOrigin, triangle);
-    if (i_result.intersects)
+    if (lid == 0)
     {
-        result[id] = i_result.intersection;
+        closest->distance = local_distances[0];
+        closest->face = isinf(local_distances[0]) ? NO_FACE : local_faces[0];
     }
 }
 
 __kernel void cast_sphere(
-    __global float* vertices,
+    __global const float* vertices,
+    __global const uint* faces,
+    const uint num_faces,
     __global float* sphere,
-    __global float* result,
-    float dist
+    float dist,
+    __global uint* hits,
+    __global uint* hit_count
 )
 {
-    int id = get_global_id(0);
+    __local uint local_count;
+    __local uint local_offset;
 
-    float3 center = (float3)(sphere[0], sphere[1], sphere[2]);
+    uint id = get_global_id(0);
 
-    // initialize result memory
-    result[id] = -1;
+    bool hit = false;
+    if (id < num_faces)
+    {
+        float3 center = (float3)(sphere[0], sphere[1], sphere[2]);
 
-    // store each input vertex in a float4 to simplify access
-    float3 vertex0 = (float3)(vertices[id * 9 + 0], vertices[id * 9 + 1], vertices[id * 9 + 2]);
-    float3 vertex1 = (float3)(vertices[id * 9 + 3], vertices[id * 9 + 4], vertices[id * 9 + 5]);
-    float3 vertex2 = (float3)(vertices[id * 9 + 6], vertices[id * 9 + 7], vertices[id * 9 + 8]);
+        triangle_t triangle = load_triangle(vertices, faces, id);
 
-    // calculate the distance to the center point for each vertex
-    float dist0 = distance(center, vertex0);
-    float dist1 = distance(center, vertex1);
-    float dist2 = distance(center, vertex2);
+        // calculate the distance to the center point for each vertex
+        float dist0 = distance(center, triangle.vertex0);
+        float dist1 = distance(center, triangle.vertex1);
+        float dist2 = distance(center, triangle.vertex2);
 
-    // if one of the vertices is closer to the center than the threshold, the triangle is hit
-    if (dist0 <= dist || dist1 <= dist || dist2 <= dist)
-    {
-        result[id] = 1;
+        // if one of the vertices is closer to the center than the threshold, the triangle is hit
+        hit = dist0 <= dist || dist1 <= dist || dist2 <= dist;
     }
 
+    append_hit(hit, id, hits, hit_count, &local_count, &local_offset);
 }
 
 __kernel void cast_box(
-    __global float* vertices,
+    __global const float* vertices,
+    __global const uint* faces,
+    const uint num_faces,
     __global float4* box,
-    __global float* result
+    __global uint* hits,
+    __global uint* hit_count
 )
 {
-    int id = get_global_id(0);
-
-    // store each input vertex in a float4 to simplify access
-    float4 vertex0 = (float4)(vertices[id * 9 + 0], vertices[id * 9 + 1], vertices[id * 9 + 2], 1.0);
-    float4 vertex1 = (float4)(vertices[id * 9 + 3], vertices[id * 9 + 4], vertices[id * 9 + 5], 1.0);
-    float4 vertex2 = (float4)(vertices[id * 9 + 6], vertices[id * 9 + 7], vertices[id * 9 + 8], 1.0);
-
-    // check for each vertex if it lies within the volume spanned by the box planes
-    bool vertexInVolume0 = true;
-    bool vertexInVolume1 = true;
-    bool vertexInVolume2 = true;
-    for (int planeId = 0; planeId < 6; planeId++)
-    {
-        float4 plane = box[planeId];
-        vertexInVolume0 = vertexInVolume0 && dot(plane, vertex0) > 0;
-        vertexInVolume1 = vertexInVolume1 && dot(plane, vertex1) > 0;
-        vertexInVolume2 = vertexInVolume2 && dot(plane, vertex2) > 0;
-    }
+    __local uint local_count;
+    __local uint local_offset;
 
-    // if one of the vertices was in the volume, set this triangle's result to hit
-    if (vertexInVolume0 || vertexInVolume1 || vertexInVolume2)
-    {
-        result[id] = 1;
-    }
-    else
+    uint id = get_global_id(0);
+
+    bool hit = false;
+    if (id < num_faces)
     {
-        result[id] = -1;
+        // store each input vertex in a float4 to simplify access
+        triangle_t triangle = load_triangle(vertices, faces, id);
+        float4 vertex0 = (float4)(triangle.vertex0, 1.0);
+        float4 vertex1 = (float4)(triangle.vertex1, 1.0);
+        float4 vertex2 = (float4)(triangle.vertex2, 1.0);
+
+        // check for each vertex if it lies within the volume spanned by the box planes
+        bool vertexInVolume0 = true;
+        bool vertexInVolume1 = true;
+        bool vertexInVolume2 = true;
+        for (int planeId = 0; planeId < 6; planeId++)
+        {
+            float4 plane = box[planeId];
+            vertexInVolume0 = vertexInVolume0 && dot(plane, vertex0) > 0;
+            vertexInVolume1 = vertexInVolume1 && dot(plane, vertex1) > 0;
+            vertexInVolume2 = vertexInVolume2 && dot(plane, vertex2) > 0;
+        }
+
+        // if one of the vertices was in the volume, this triangle is hit
+        hit = vertexInVolume0 || vertexInVolume1 || vertexInVolume2;
     }
 
+    append_hit(hit, id, hits, hit_count, &local_count, &local_offset);
 }
-
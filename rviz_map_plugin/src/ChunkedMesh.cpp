@@ -0,0 +1,729 @@
+/*
+ *  Software License Agreement (BSD License)
+ *
+ *  Robot Operating System code by the University of Osnabrück
+ *  Copyright (c) 2015, University of Osnabrück
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ *  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ *  ChunkedMesh.cpp
+ *
+ */
+
+#include <ChunkedMesh.hpp>
+
+#include <hdf5_map_io/mesh_simplification.h>
+
+#include <ros/console.h>
+
+#include <OGRE/OgreCamera.h>
+#include <OGRE/OgreEntity.h>
+#include <OGRE/OgreHardwareBufferManager.h>
+#include <OGRE/OgreMeshManager.h>
+#include <OGRE/OgreSceneManager.h>
+#include <OGRE/OgreSceneNode.h>
+#include <OGRE/OgreSubMesh.h>
+#include <OGRE/OgreViewport.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rviz_map_plugin
+{
+namespace
+{
+/// Cells are not split any further beyond this depth, e.g. if many faces share the same centroid
+const int MAX_OCTREE_DEPTH = 16;
+
+/// Vertex buffer source of the positions
+const unsigned short POSITION_SOURCE = 0;
+/// Vertex buffer source of the optional colors
+const unsigned short COLOR_SOURCE = 1;
+
+/// Each level of detail aims at this fraction of the faces of the previous one
+const size_t LOD_REDUCTION = 4;
+/// Chunks are not simplified below this number of faces
+const size_t MIN_LOD_FACES = 256;
+/// Maximum number of simplified versions per chunk
+const size_t MAX_LOD_LEVELS = 6;
+/// Weight of the squared attribute difference relative to the squared geometric error
+const float LOD_ATTRIBUTE_WEIGHT = 0.01f;
+/// Version of the cache file format and of the simplification parameters above
+const uint32_t LOD_CACHE_VERSION = 1;
+
+/**
+ * @brief 64 bit FNV-1a, which is stable across runs and compilers unlike std::hash
+ */
+void hashBytes(uint64_t& hash, const void* data, size_t size)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+}
+
+std::string getLodCachePath(const Geometry& geometry, const std::vector<MeshChunk>& chunks,
+                            const std::vector<float>& attributes, size_t attributeDim)
+{
+  uint64_t hash = 14695981039346656037ull;
+  hashBytes(hash, &LOD_CACHE_VERSION, sizeof(LOD_CACHE_VERSION));
+  hashBytes(hash, geometry.vertices.data(), geometry.vertices.size() * sizeof(Vertex));
+  hashBytes(hash, geometry.faces.data(), geometry.faces.size() * sizeof(Face));
+  hashBytes(hash, &attributeDim, sizeof(attributeDim));
+  hashBytes(hash, attributes.data(), attributes.size() * sizeof(float));
+  for (const MeshChunk& chunk : chunks)
+  {
+    hashBytes(hash, chunk.faceIds.data(), chunk.faceIds.size() * sizeof(uint32_t));
+  }
+
+  // the same directory is used for the ROS logs
+  std::string directory;
+  if (const char* rosHome = std::getenv("ROS_HOME"))
+  {
+    directory = rosHome;
+  }
+  else if (const char* home = std::getenv("HOME"))
+  {
+    directory = std::string(home) + "/.ros";
+  }
+  else
+  {
+    directory = ".";
+  }
+
+  char name[64];
+  snprintf(name, sizeof(name), "/rviz_map_plugin_lod_%016llx.bin", static_cast<unsigned long long>(hash));
+  return directory + name;
+}
+
+template <typename T>
+bool readValue(std::ifstream& in, T& value)
+{
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+template <typename T>
+void writeValue(std::ofstream& out, const T& value)
+{
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+std::shared_ptr<MeshChunkLods> loadLods(const std::string& path, const std::vector<MeshChunk>& chunks)
+{
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+  {
+    return nullptr;
+  }
+
+  uint32_t version;
+  uint64_t numChunks;
+  if (!readValue(in, version) || version != LOD_CACHE_VERSION || !readValue(in, numChunks) ||
+      numChunks != chunks.size())
+  {
+    return nullptr;
+  }
+
+  auto lods = std::make_shared<MeshChunkLods>(chunks.size());
+  for (size_t i = 0; i < chunks.size(); i++)
+  {
+    uint64_t numLevels;
+    if (!readValue(in, numLevels) || numLevels > MAX_LOD_LEVELS)
+    {
+      return nullptr;
+    }
+    (*lods)[i].resize(numLevels);
+    for (MeshChunkLod& lod : (*lods)[i])
+    {
+      uint64_t numIndices;
+      if (!readValue(in, lod.error) || !readValue(in, numIndices) || numIndices > chunks[i].indices.size())
+      {
+        return nullptr;
+      }
+      lod.indices.resize(numIndices);
+      if (!in.read(reinterpret_cast<char*>(lod.indices.data()), numIndices * sizeof(uint32_t)))
+      {
+        return nullptr;
+      }
+      // a damaged file must not make the renderer read outside of the vertex buffer
+      for (uint32_t index : lod.indices)
+      {
+        if (index >= chunks[i].vertexIds.size())
+        {
+          return nullptr;
+        }
+      }
+    }
+  }
+  return lods;
+}
+
+void saveLods(const std::string& path, const MeshChunkLods& lods)
+{
+  // write to a unique temporary file first, so that concurrent rviz instances neither read a partial file nor
+  // write into the same file
+  std::string tmpPath = path + ".XXXXXX";
+  int fd = mkstemp(&tmpPath[0]);
+  if (fd < 0)
+  {
+    ROS_WARN("Could not write the simplified mesh to %s.", path.c_str());
+    return;
+  }
+  // mkstemp creates the file for its owner only, but the simplified mesh is shared like the map next to it
+  const mode_t mask = umask(0);
+  umask(mask);
+  fchmod(fd, 0644 & ~mask);
+  ::close(fd);
+
+  {
+    std::ofstream out(tmpPath, std::ios::binary);
+    writeValue(out, LOD_CACHE_VERSION);
+    writeValue(out, static_cast<uint64_t>(lods.size()));
+    for (const std::vector<MeshChunkLod>& chunkLods : lods)
+    {
+      writeValue(out, static_cast<uint64_t>(chunkLods.size()));
+      for (const MeshChunkLod& lod : chunkLods)
+      {
+        writeValue(out, lod.error);
+        writeValue(out, static_cast<uint64_t>(lod.indices.size()));
+        out.write(reinterpret_cast<const char*>(lod.indices.data()), lod.indices.size() * sizeof(uint32_t));
+      }
+    }
+    if (!out)
+    {
+      ROS_WARN("Could not write the simplified mesh to %s.", tmpPath.c_str());
+      std::remove(tmpPath.c_str());
+      return;
+    }
+  }
+  if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+  {
+    ROS_WARN("Could not write the simplified mesh to %s.", path.c_str());
+    std::remove(tmpPath.c_str());
+  }
+}
+}  // namespace
+
+std::shared_ptr<const std::vector<MeshChunk>> ChunkedMesh::buildChunks(const Geometry& geometry,
+                                                                       size_t maxChunkFaces)
+{
+  const size_t numFaces = geometry.faces.size();
+
+  std::vector<Ogre::Vector3> centroids(numFaces);
+#pragma omp parallel for schedule(static)
+  for (size_t faceId = 0; faceId < numFaces; faceId++)
+  {
+    Ogre::Vector3 centroid = Ogre::Vector3::ZERO;
+    for (uint32_t vertexId : geometry.faces[faceId].vertexIndices)
+    {
+      const Vertex& vertex = geometry.vertices[vertexId];
+      centroid += Ogre::Vector3(vertex.x, vertex.y, vertex.z);
+    }
+    centroids[faceId] = centroid / 3.0f;
+  }
+
+  // split the octree cells until every leaf holds few enough faces
+  struct Cell
+  {
+    std::vector<uint32_t> faceIds;
+    Ogre::Vector3 min;
+    Ogre::Vector3 max;
+    int depth;
+  };
+
+  Cell root;
+  root.faceIds.resize(numFaces);
+  root.min = Ogre::Vector3(std::numeric_limits<float>::max());
+  root.max = Ogre::Vector3(-std::numeric_limits<float>::max());
+  for (uint32_t faceId = 0; faceId < numFaces; faceId++)
+  {
+    root.faceIds[faceId] = faceId;
+    root.min.makeFloor(centroids[faceId]);
+    root.max.makeCeil(centroids[faceId]);
+  }
+  root.depth = 0;
+
+  std::vector<std::vector<uint32_t>> leaves;
+  std::vector<Cell> stack;
+  if (numFaces > 0)
+  {
+    stack.push_back(std::move(root));
+  }
+  while (!stack.empty())
+  {
+    Cell cell = std::move(stack.back());
+    stack.pop_back();
+
+    if (cell.faceIds.size() <= maxChunkFaces || cell.depth >= MAX_OCTREE_DEPTH)
+    {
+      leaves.push_back(std::move(cell.faceIds));
+      continue;
+    }
+
+    Ogre::Vector3 center = (cell.min + cell.max) * 0.5f;
+    Cell children[8];
+    for (int i = 0; i < 8; i++)
+    {
+      children[i].min = Ogre::Vector3(i & 1 ? center.x : cell.min.x, i & 2 ? center.y : cell.min.y,
+                                      i & 4 ? center.z : cell.min.z);
+      children[i].max = Ogre::Vector3(i & 1 ? cell.max.x : center.x, i & 2 ? cell.max.y : center.y,
+                                      i & 4 ? cell.max.z : center.z);
+      children[i].depth = cell.depth + 1;
+    }
+    for (uint32_t faceId : cell.faceIds)
+    {
+      const Ogre::Vector3& centroid = centroids[faceId];
+      int child = (centroid.x > center.x ? 1 : 0) | (centroid.y > center.y ? 2 : 0) | (centroid.z > center.z ? 4 : 0);
+      children[child].faceIds.push_back(faceId);
+    }
+    for (Cell& child : children)
+    {
+      if (!child.faceIds.empty())
+      {
+        stack.push_back(std::move(child));
+      }
+    }
+  }
+
+  // give every chunk its own vertex list, the chunks are independent of each other
+  auto chunks = std::make_shared<std::vector<MeshChunk>>(leaves.size());
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < leaves.size(); i++)
+  {
+    MeshChunk& chunk = (*chunks)[i];
+    chunk.faceIds = std::move(leaves[i]);
+    std::sort(chunk.faceIds.begin(), chunk.faceIds.end());
+
+    for (uint32_t faceId : chunk.faceIds)
+    {
+      for (uint32_t vertexId : geometry.faces[faceId].vertexIndices)
+      {
+        chunk.vertexIds.push_back(vertexId);
+      }
+    }
+    std::sort(chunk.vertexIds.begin(), chunk.vertexIds.end());
+    chunk.vertexIds.erase(std::unique(chunk.vertexIds.begin(), chunk.vertexIds.end()), chunk.vertexIds.end());
+
+    chunk.indices.reserve(chunk.faceIds.size() * 3);
+    for (uint32_t faceId : chunk.faceIds)
+    {
+      for (uint32_t vertexId : geometry.faces[faceId].vertexIndices)
+      {
+        chunk.indices.push_back(std::lower_bound(chunk.vertexIds.begin(), chunk.vertexIds.end(), vertexId) -
+                                chunk.vertexIds.begin());
+      }
+    }
+
+    for (uint32_t vertexId : chunk.vertexIds)
+    {
+      const Vertex& vertex = geometry.vertices[vertexId];
+      chunk.bounds.merge(Ogre::Vector3(vertex.x, vertex.y, vertex.z));
+    }
+  }
+
+  return chunks;
+}
+
+std::shared_ptr<const MeshChunkLods> ChunkedMesh::buildLods(const Geometry& geometry,
+                                                            const std::vector<MeshChunk>& chunks,
+                                                            const std::vector<float>& attributes, size_t attributeDim)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  std::string cachePath = getLodCachePath(geometry, chunks, attributes, attributeDim);
+  if (std::shared_ptr<MeshChunkLods> lods = loadLods(cachePath, chunks))
+  {
+    auto end = std::chrono::steady_clock::now();
+    ROS_DEBUG("Loaded the simplified mesh from %s in %ld ms.", cachePath.c_str(),
+              std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+    return lods;
+  }
+
+  auto lods = std::make_shared<MeshChunkLods>(chunks.size());
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < chunks.size(); i++)
+  {
+    const MeshChunk& chunk = chunks[i];
+
+    // the simplification works on the local vertices of the chunk
+    std::vector<float> vertices(chunk.vertexIds.size() * 3);
+    std::vector<float> chunkAttributes(attributes.empty() ? 0 : chunk.vertexIds.size() * attributeDim);
+    for (size_t local = 0; local < chunk.vertexIds.size(); local++)
+    {
+      const Vertex& vertex = geometry.vertices[chunk.vertexIds[local]];
+      vertices[local * 3 + 0] = vertex.x;
+      vertices[local * 3 + 1] = vertex.y;
+      vertices[local * 3 + 2] = vertex.z;
+      if (!chunkAttributes.empty())
+      {
+        std::copy_n(attributes.begin() + chunk.vertexIds[local] * attributeDim, attributeDim,
+                    chunkAttributes.begin() + local * attributeDim);
+      }
+    }
+
+    hdf5_map_io::SimplificationOptions options;
+    options.lockBoundary = true;
+    if (!chunkAttributes.empty())
+    {
+      options.attributes = chunkAttributes.data();
+      options.attributeDim = attributeDim;
+      options.attributeWeight = LOD_ATTRIBUTE_WEIGHT;
+    }
+
+    // every level is simplified from the previous one, so the errors add up, the reserve keeps the pointer to the
+    // previous level valid
+    (*lods)[i].reserve(MAX_LOD_LEVELS);
+    const std::vector<uint32_t>* indices = &chunk.indices;
+    float error = 0;
+    while ((*lods)[i].size() < MAX_LOD_LEVELS && indices->size() / 3 > MIN_LOD_FACES)
+    {
+      size_t numFaces = indices->size() / 3;
+      options.targetFaces = std::max(numFaces / LOD_REDUCTION, MIN_LOD_FACES);
+
+      hdf5_map_io::SimplificationResult result =
+          hdf5_map_io::simplifyMesh(vertices.data(), chunk.vertexIds.size(), indices->data(), numFaces, options);
+
+      // stop if the locked boundary or the topology prevent further progress
+      if (result.faceIds.empty() || result.faceIds.size() / 3 > numFaces * 3 / 4)
+      {
+        break;
+      }
+
+      error += std::sqrt(result.error);
+      (*lods)[i].push_back(MeshChunkLod{ std::move(result.faceIds), error });
+      indices = &(*lods)[i].back().indices;
+    }
+  }
+
+  auto end = std::chrono::steady_clock::now();
+  ROS_DEBUG("Simplified %lu chunks in %ld ms.", chunks.size(),
+            std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+
+  saveLods(cachePath, *lods);
+  return lods;
+}
+
+ChunkedMesh::ChunkedMesh(Ogre::SceneManager* sceneManager, Ogre::SceneNode* sceneNode, const std::string& name)
+  : m_sceneManager(sceneManager), m_sceneNode(sceneNode), m_name(name)
+{
+}
+
+ChunkedMesh::~ChunkedMesh()
+{
+  clear();
+}
+
+void ChunkedMesh::setGeometry(const Geometry& geometry, std::shared_ptr<const std::vector<MeshChunk>> chunks)
+{
+  clear();
+  if (!chunks)
+  {
+    return;
+  }
+  m_chunks = chunks;
+
+  for (size_t i = 0; i < m_chunks->size(); i++)
+  {
+    const MeshChunk& chunk = (*m_chunks)[i];
+
+    std::stringstream sstm;
+    sstm << m_name << "_Chunk_" << i;
+
+    Ogre::MeshPtr mesh = Ogre::MeshManager::getSingleton().createManual(sstm.str(), "General");
+    Ogre::SubMesh* subMesh = mesh->createSubMesh();
+    subMesh->useSharedVertices = false;
+    subMesh->operationType = Ogre::RenderOperation::OT_TRIANGLE_LIST;
+
+    // Create the vertex data structure
+    subMesh->vertexData = new Ogre::VertexData;
+    subMesh->vertexData->vertexCount = chunk.vertexIds.size();
+    subMesh->vertexData->vertexDeclaration->addElement(POSITION_SOURCE, 0, Ogre::VET_FLOAT3, Ogre::VES_POSITION);
+
+    Ogre::HardwareVertexBufferSharedPtr vertexBuffer = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
+        Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3), chunk.vertexIds.size(),
+        Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+    float* vertices = static_cast<float*>(vertexBuffer->lock(Ogre::HardwareBuffer::HBL_DISCARD));
+    for (uint32_t vertexId : chunk.vertexIds)
+    {
+      *vertices++ = geometry.vertices[vertexId].x;
+      *vertices++ = geometry.vertices[vertexId].y;
+      *vertices++ = geometry.vertices[vertexId].z;
+    }
+    vertexBuffer->unlock();
+    subMesh->vertexData->vertexBufferBinding->setBinding(POSITION_SOURCE, vertexBuffer);
+
+    // Create the index buffer
+    Ogre::HardwareIndexBufferSharedPtr indexBuffer = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(
+        Ogre::HardwareIndexBuffer::IT_32BIT, chunk.indices.size(), Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+    indexBuffer->writeData(0, chunk.indices.size() * sizeof(uint32_t), chunk.indices.data(), true);
+    subMesh->indexData->indexBuffer = indexBuffer;
+    subMesh->indexData->indexStart = 0;
+    subMesh->indexData->indexCount = chunk.indices.size();
+
+    // The tight bounds allow Ogre to cull the chunk
+    mesh->_setBounds(chunk.bounds);
+    mesh->_setBoundingSphereRadius((chunk.bounds.getMaximum() - chunk.bounds.getMinimum()).length() / 2);
+    mesh->load();
+
+    Ogre::Entity* entity = m_sceneManager->createEntity(sstm.str(), mesh->getName(), "General");
+    if (!m_materialName.empty())
+    {
+      entity->setMaterialName(m_materialName, "General");
+    }
+    entity->setVisible(m_visible);
+    for (const auto& userAny : m_userAnys)
+    {
+      entity->getUserObjectBindings().setUserAny(userAny.first, userAny.second);
+    }
+    m_sceneNode->attachObject(entity);
+
+    m_meshes.push_back(mesh);
+    m_entities.push_back(entity);
+    m_baseIndexData.push_back(subMesh->indexData);
+  }
+}
+
+void ChunkedMesh::setLods(std::shared_ptr<const MeshChunkLods> lods)
+{
+  clearLods();
+  if (!lods || !m_chunks || lods->size() != m_chunks->size())
+  {
+    return;
+  }
+  m_lods = lods;
+
+  m_lodIndexData.resize(m_lods->size());
+  m_lodLevels.assign(m_lods->size(), 0);
+  for (size_t i = 0; i < m_lods->size(); i++)
+  {
+    for (const MeshChunkLod& lod : (*m_lods)[i])
+    {
+      Ogre::HardwareIndexBufferSharedPtr indexBuffer = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(
+          Ogre::HardwareIndexBuffer::IT_32BIT, lod.indices.size(), Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+      indexBuffer->writeData(0, lod.indices.size() * sizeof(uint32_t), lod.indices.data(), true);
+
+      Ogre::IndexData* indexData = new Ogre::IndexData;
+      indexData->indexBuffer = indexBuffer;
+      indexData->indexStart = 0;
+      indexData->indexCount = lod.indices.size();
+      m_lodIndexData[i].push_back(indexData);
+    }
+  }
+}
+
+void ChunkedMesh::updateLod(const Ogre::Camera* camera, float maxPixelError)
+{
+  if (!m_lods)
+  {
+    return;
+  }
+
+  Ogre::Viewport* viewport = camera ? camera->getViewport() : nullptr;
+  if (!viewport || maxPixelError <= 0)
+  {
+    for (size_t i = 0; i < m_lodLevels.size(); i++)
+    {
+      selectLod(i, 0);
+    }
+    return;
+  }
+
+  const Ogre::Vector3 cameraPosition = camera->getDerivedPosition();
+  const float tanHalfFov = std::tan(camera->getFOVy().valueRadians() / 2);
+
+  for (size_t i = 0; i < m_lodLevels.size(); i++)
+  {
+    // pixels per unit of the mesh at the chunk's closest point to the camera
+    float pixelsPerUnit;
+    if (camera->getProjectionType() == Ogre::PT_ORTHOGRAPHIC)
+    {
+      pixelsPerUnit = viewport->getActualHeight() / camera->getOrthoWindowHeight();
+    }
+    else
+    {
+      float distance = m_entities[i]->getWorldBoundingBox(true).distance(cameraPosition);
+      if (distance <= 0)
+      {
+        selectLod(i, 0);
+        continue;
+      }
+      pixelsPerUnit = viewport->getActualHeight() / (2 * distance * tanHalfFov);
+    }
+
+    const std::vector<MeshChunkLod>& lods = (*m_lods)[i];
+    size_t level = 0;
+    while (level < lods.size() && lods[level].error * pixelsPerUnit <= maxPixelError)
+    {
+      level++;
+    }
+    selectLod(i, level);
+  }
+}
+
+void ChunkedMesh::selectLod(size_t chunk, size_t level)
+{
+  if (m_lodLevels[chunk] == level)
+  {
+    return;
+  }
+  m_lodLevels[chunk] = level;
+
+  // the sub entity fetches the index data of its sub mesh whenever it is rendered
+  m_meshes[chunk]->getSubMesh(0)->indexData = level == 0 ? m_baseIndexData[chunk] : m_lodIndexData[chunk][level - 1];
+}
+
+void ChunkedMesh::clearLods()
+{
+  for (size_t i = 0; i < m_lodLevels.size(); i++)
+  {
+    selectLod(i, 0);
+  }
+  for (const std::vector<Ogre::IndexData*>& indexData : m_lodIndexData)
+  {
+    for (Ogre::IndexData* lodIndexData : indexData)
+    {
+      delete lodIndexData;
+    }
+  }
+  m_lodIndexData.clear();
+  m_lodLevels.clear();
+  m_lods.reset();
+}
+
+void ChunkedMesh::setColors(const std::vector<Ogre::ColourValue>& colors)
+{
+  if (!m_chunks)
+  {
+    return;
+  }
+
+  Ogre::VertexElementType colorType = Ogre::VertexElement::getBestColourVertexElementType();
+
+  for (size_t i = 0; i < m_meshes.size(); i++)
+  {
+    const MeshChunk& chunk = (*m_chunks)[i];
+    Ogre::VertexData* vertexData = m_meshes[i]->getSubMesh(0)->vertexData;
+
+    if (!vertexData->vertexDeclaration->findElementBySemantic(Ogre::VES_DIFFUSE))
+    {
+      vertexData->vertexDeclaration->addElement(COLOR_SOURCE, 0, colorType, Ogre::VES_DIFFUSE);
+    }
+
+    Ogre::HardwareVertexBufferSharedPtr colorBuffer;
+    if (vertexData->vertexBufferBinding->isBufferBound(COLOR_SOURCE))
+    {
+      colorBuffer = vertexData->vertexBufferBinding->getBuffer(COLOR_SOURCE);
+    }
+    else
+    {
+      colorBuffer = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
+          Ogre::VertexElement::getTypeSize(colorType), chunk.vertexIds.size(), Ogre::HardwareBuffer::HBU_DYNAMIC);
+      vertexData->vertexBufferBinding->setBinding(COLOR_SOURCE, colorBuffer);
+    }
+
+    uint32_t* packedColors = static_cast<uint32_t*>(colorBuffer->lock(Ogre::HardwareBuffer::HBL_DISCARD));
+    for (uint32_t vertexId : chunk.vertexIds)
+    {
+      *packedColors++ = Ogre::VertexElement::convertColourValue(colors[vertexId], colorType);
+    }
+    colorBuffer->unlock();
+  }
+}
+
+void ChunkedMesh::setMaterial(const std::string& materialName)
+{
+  m_materialName = materialName;
+  for (Ogre::Entity* entity : m_entities)
+  {
+    entity->setMaterialName(m_materialName, "General");
+  }
+}
+
+void ChunkedMesh::setVisible(bool visible)
+{
+  m_visible = visible;
+  for (Ogre::Entity* entity : m_entities)
+  {
+    entity->setVisible(visible);
+  }
+}
+
+void ChunkedMesh::setUserAny(const std::string& key, const Ogre::Any& value)
+{
+  auto it = std::find_if(m_userAnys.begin(), m_userAnys.end(),
+                         [&key](const std::pair<std::string, Ogre::Any>& userAny) { return userAny.first == key; });
+  if (it != m_userAnys.end())
+  {
+    it->second = value;
+  }
+  else
+  {
+    m_userAnys.emplace_back(key, value);
+  }
+
+  for (Ogre::Entity* entity : m_entities)
+  {
+    entity->getUserObjectBindings().setUserAny(key, value);
+  }
+}
+
+void ChunkedMesh::clear()
+{
+  clearLods();
+  for (Ogre::Entity* entity : m_entities)
+  {
+    m_sceneManager->destroyEntity(entity);
+  }
+  for (const Ogre::MeshPtr& mesh : m_meshes)
+  {
+    Ogre::MeshManager::getSingleton().remove(mesh->getName());
+  }
+  m_entities.clear();
+  m_meshes.clear();
+  m_baseIndexData.clear();
+  m_chunks.reset();
+}
+
+}  // End namespace rviz_map_plugin
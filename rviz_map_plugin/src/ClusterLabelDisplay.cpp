@@ -48,6 +48,7 @@
 
 #include <ClusterLabelDisplay.hpp>
 #include <ClusterLabelVisual.hpp>
+#include <ClusterLabelPaletteVisual.hpp>
 #include <ClusterLabelTool.hpp>
 
 #include <rviz/properties/bool_property.h>
@@ -109,6 +110,10 @@ ClusterLabelDisplay::ClusterLabelDisplay()
                                                    "Show a transparent silhouette of the whole mesh to help with "
                                                    "labeling",
                                                    this, SLOT(updatePhantomVisual()), this);
+  m_singlePassProperty = new rviz::BoolProperty("Single Pass Rendering", false,
+                                                "Draw all labels except the active one in a single pass with a "
+                                                "color palette. Speeds up rendering maps with many labels.",
+                                                this, SLOT(updatePaletteVisual()), this);
 
   setStatus(rviz::StatusProperty::Error, "Display", "Cant be used without Map3D plugin");
 }
@@ -168,6 +173,7 @@ void ClusterLabelDisplay::onEnable()
 
 void ClusterLabelDisplay::onDisable()
 {
+  m_paletteVisual.reset();
   m_visuals.clear();
   m_phantomVisual.reset();
   m_tool->resetVisual();
@@ -188,6 +194,9 @@ void ClusterLabelDisplay::changeVisual()
 
   m_activeVisualId = m_activeVisualProperty->getOptionInt();
 
+  // The previously active label is drawn by the palette now, including the changes made with the label tool
+  updatePaletteVisual();
+
   // Active visual has changed, notify label tool that it has to refresh its pointer on the active visual
   notifyLabelTool();
 }
@@ -214,6 +223,9 @@ void ClusterLabelDisplay::updateMap()
   // Create a phantom visual if it is enabled
   updatePhantomVisual();
 
+  // Draw the labels in a single pass if it is enabled
+  updatePaletteVisual();
+
   // Notify label tool for changes. The label tool should now destroy its visual and get a new one from this obj
   notifyLabelTool();
 
@@ -234,6 +246,55 @@ void ClusterLabelDisplay::updateColors()
     auto colorProp = m_colorProperties[i];
     m_visuals[i]->setColor(colorProp->getOgreColor(), m_alphaProperty->getFloat());
   }
+  updatePaletteColors();
+}
+
+void ClusterLabelDisplay::updatePaletteColors()
+{
+  if (!m_paletteVisual)
+  {
+    return;
+  }
+
+  vector<Ogre::ColourValue> colors;
+  for (size_t i = 0; i < m_colorProperties.size() && i < m_visuals.size(); i++)
+  {
+    colors.push_back(m_colorProperties[i]->getOgreColor());
+  }
+  m_paletteVisual->setColors(colors, m_alphaProperty->getFloat());
+}
+
+void ClusterLabelDisplay::updatePaletteVisual()
+{
+  if (!m_singlePassProperty->getBool() || m_visuals.empty())
+  {
+    m_paletteVisual.reset();
+    for (auto& visual : m_visuals)
+    {
+      visual->setVisible(true);
+    }
+    return;
+  }
+
+  if (!m_paletteVisual)
+  {
+    m_paletteVisual.reset(new ClusterLabelPaletteVisual(context_, "ClusterLabelPaletteVisual", m_geometry));
+  }
+
+  // the active label is drawn by its own visual, so that changes of the label tool show up immediately. It has no
+  // faces in the palette visual, so it does not need to be hidden there.
+  vector<vector<uint32_t>> labelFaces(m_visuals.size());
+  for (size_t i = 0; i < m_visuals.size(); i++)
+  {
+    bool active = i == m_activeVisualId;
+    m_visuals[i]->setVisible(active);
+    if (!active)
+    {
+      labelFaces[i] = m_visuals[i]->getFaces();
+    }
+  }
+  m_paletteVisual->setLabels(labelFaces);
+  updatePaletteColors();
 }
 
 void ClusterLabelDisplay::updateSphereSize()
@@ -280,6 +341,7 @@ void ClusterLabelDisplay::fillPropertyOptions()
 void ClusterLabelDisplay::createVisualsFromClusterList()
 {
   // Destroy all current visuals
+  m_paletteVisual.reset();
   if (!m_visuals.empty())
   {
     m_visuals.clear();
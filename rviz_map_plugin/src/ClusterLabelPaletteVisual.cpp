@@ -0,0 +1,273 @@
+/*
+ *  Software License Agreement (BSD License)
+ *
+ *  Robot Operating System code by the University of Osnabrück
+ *  Copyright (c) 2015, University of Osnabrück
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ *  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ *  ClusterLabelPaletteVisual.cpp
+ *
+ */
+
+#include <ClusterLabelPaletteVisual.hpp>
+
+#include <rviz/display_context.h>
+
+#include <OGRE/OgreEntity.h>
+#include <OGRE/OgreHardwarePixelBuffer.h>
+#include <OGRE/OgreMaterialManager.h>
+#include <OGRE/OgreMeshManager.h>
+#include <OGRE/OgrePixelFormat.h>
+#include <OGRE/OgreSceneManager.h>
+#include <OGRE/OgreSceneNode.h>
+#include <OGRE/OgreTechnique.h>
+#include <OGRE/OgreTextureManager.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace rviz_map_plugin
+{
+namespace
+{
+/// Maximum width of the palette texture, more labels continue in the next row
+const size_t MAX_PALETTE_WIDTH = 256;
+}  // namespace
+
+ClusterLabelPaletteVisual::ClusterLabelPaletteVisual(rviz::DisplayContext* context, std::string name,
+                                                     std::shared_ptr<Geometry> geometry)
+  : m_displayContext(context), m_name(name), m_geometry(geometry)
+{
+  Ogre::SceneManager* sceneManager = m_displayContext->getSceneManager();
+  m_sceneNode = sceneManager->getRootSceneNode()->createChildSceneNode();
+
+  m_mesh = Ogre::MeshManager::getSingleton().createManual(m_name + "_Mesh", "General");
+  m_subMesh = m_mesh->createSubMesh();
+  m_subMesh->useSharedVertices = false;
+  m_subMesh->operationType = Ogre::RenderOperation::OT_TRIANGLE_LIST;
+  m_subMesh->vertexData = new Ogre::VertexData;
+  m_subMesh->vertexData->vertexCount = 0;
+
+  // Each corner consists of its position and the texture coordinates of its label in the palette
+  Ogre::VertexDeclaration* decl = m_subMesh->vertexData->vertexDeclaration;
+  size_t offset = 0;
+  decl->addElement(0, offset, Ogre::VET_FLOAT3, Ogre::VES_POSITION);
+  offset += Ogre::VertexElement::getTypeSize(Ogre::VET_FLOAT3);
+  decl->addElement(0, offset, Ogre::VET_FLOAT2, Ogre::VES_TEXTURE_COORDINATES, 0);
+
+  // The labels can only cover the mesh, so its bounding box is used
+  Ogre::AxisAlignedBox bounds;
+  for (const Vertex& vertex : m_geometry->vertices)
+  {
+    bounds.merge(Ogre::Vector3(vertex.x, vertex.y, vertex.z));
+  }
+  m_mesh->_setBounds(bounds);
+  m_mesh->load();
+
+  m_material = Ogre::MaterialManager::getSingleton().create(
+      m_name + "_Material", Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, true);
+  Ogre::Pass* pass = m_material->getTechnique(0)->getPass(0);
+  pass->setLightingEnabled(false);
+  pass->setCullingMode(Ogre::CULL_NONE);
+  pass->setSceneBlending(Ogre::SBT_TRANSPARENT_ALPHA);
+  pass->setDepthWriteEnabled(false);
+  // hidden labels have an alpha of zero and are discarded
+  pass->setAlphaRejectSettings(Ogre::CMPF_GREATER, 0);
+  m_subMesh->setMaterialName(m_material->getName(), Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME);
+
+  m_entity = sceneManager->createEntity(m_name + "_Entity", m_mesh->getName(), "General");
+  m_entity->setVisible(false);
+  m_sceneNode->attachObject(m_entity);
+}
+
+ClusterLabelPaletteVisual::~ClusterLabelPaletteVisual()
+{
+  Ogre::SceneManager* sceneManager = m_displayContext->getSceneManager();
+  sceneManager->destroyEntity(m_entity);
+  sceneManager->destroySceneNode(m_sceneNode);
+
+  Ogre::MeshManager::getSingleton().remove(m_mesh->getName());
+  Ogre::MaterialManager::getSingleton().remove(m_material->getName());
+  if (!m_palette.isNull())
+  {
+    Ogre::TextureManager::getSingleton().remove(m_palette->getName());
+  }
+}
+
+void ClusterLabelPaletteVisual::setLabels(const std::vector<std::vector<uint32_t>>& labelFaces)
+{
+  if (labelFaces.size() != m_colors.size())
+  {
+    m_colors.resize(labelFaces.size(), Ogre::ColourValue::White);
+    m_visible.assign(labelFaces.size(), true);
+    createPalette(labelFaces.size());
+  }
+  else if (std::find(m_visible.begin(), m_visible.end(), false) != m_visible.end())
+  {
+    // labels hidden for the previous faces are shown again
+    m_visible.assign(m_visible.size(), true);
+    writePalette();
+  }
+
+  size_t numFaces = 0;
+  for (const auto& faces : labelFaces)
+  {
+    numFaces += faces.size();
+  }
+
+  m_subMesh->vertexData->vertexBufferBinding->unsetAllBindings();
+  m_subMesh->vertexData->vertexCount = numFaces * 3;
+  m_entity->setVisible(numFaces > 0);
+  if (numFaces == 0)
+  {
+    return;
+  }
+
+  Ogre::HardwareVertexBufferSharedPtr vertexBuffer = Ogre::HardwareBufferManager::getSingleton().createVertexBuffer(
+      m_subMesh->vertexData->vertexDeclaration->getVertexSize(0), numFaces * 3,
+      Ogre::HardwareBuffer::HBU_STATIC_WRITE_ONLY);
+
+  float* vertices = static_cast<float*>(vertexBuffer->lock(Ogre::HardwareBuffer::HBL_DISCARD));
+  for (size_t label = 0; label < labelFaces.size(); label++)
+  {
+    // texel centers of the label in the palette
+    float u = ((label % m_paletteWidth) + 0.5f) / m_paletteWidth;
+    float v = ((label / m_paletteWidth) + 0.5f) / m_paletteHeight;
+
+    for (uint32_t faceId : labelFaces[label])
+    {
+      for (uint32_t vertexId : m_geometry->faces[faceId].vertexIndices)
+      {
+        const Vertex& vertex = m_geometry->vertices[vertexId];
+        *vertices++ = vertex.x;
+        *vertices++ = vertex.y;
+        *vertices++ = vertex.z;
+        *vertices++ = u;
+        *vertices++ = v;
+      }
+    }
+  }
+  vertexBuffer->unlock();
+
+  m_subMesh->vertexData->vertexBufferBinding->setBinding(0, vertexBuffer);
+}
+
+void ClusterLabelPaletteVisual::setColor(size_t label, Ogre::ColourValue color, float alpha)
+{
+  if (label >= m_colors.size())
+  {
+    return;
+  }
+
+  color.a = alpha;
+  m_colors[label] = color;
+  writePalette();
+}
+
+void ClusterLabelPaletteVisual::setColors(const std::vector<Ogre::ColourValue>& colors, float alpha)
+{
+  for (size_t label = 0; label < colors.size() && label < m_colors.size(); label++)
+  {
+    m_colors[label] = colors[label];
+    m_colors[label].a = alpha;
+  }
+  writePalette();
+}
+
+void ClusterLabelPaletteVisual::setLabelVisible(size_t label, bool visible)
+{
+  if (label >= m_visible.size() || m_visible[label] == visible)
+  {
+    return;
+  }
+
+  m_visible[label] = visible;
+  writePalette();
+}
+
+void ClusterLabelPaletteVisual::createPalette(size_t numLabels)
+{
+  m_paletteWidth = std::max<size_t>(1, std::min(numLabels, MAX_PALETTE_WIDTH));
+  m_paletteHeight = std::max<size_t>(1, (numLabels + m_paletteWidth - 1) / m_paletteWidth);
+
+  std::string paletteName = m_name + "_Palette";
+  if (!m_palette.isNull())
+  {
+    Ogre::TextureManager::getSingleton().remove(paletteName);
+  }
+  m_palette = Ogre::TextureManager::getSingleton().createManual(
+      paletteName, Ogre::ResourceGroupManager::DEFAULT_RESOURCE_GROUP_NAME, Ogre::TEX_TYPE_2D, m_paletteWidth,
+      m_paletteHeight, 0, Ogre::PF_BYTE_RGBA, Ogre::TU_DYNAMIC_WRITE_ONLY);
+
+  // every label is a single texel, so the palette must not be filtered
+  Ogre::Pass* pass = m_material->getTechnique(0)->getPass(0);
+  pass->removeAllTextureUnitStates();
+  Ogre::TextureUnitState* textureUnit = pass->createTextureUnitState(paletteName);
+  textureUnit->setTextureFiltering(Ogre::TFO_NONE);
+  textureUnit->setTextureAddressingMode(Ogre::TextureUnitState::TAM_CLAMP);
+
+  writePalette();
+}
+
+void ClusterLabelPaletteVisual::writePalette()
+{
+  if (m_palette.isNull())
+  {
+    return;
+  }
+
+  Ogre::HardwarePixelBufferSharedPtr pixelBuffer = m_palette->getBuffer();
+  pixelBuffer->lock(Ogre::HardwareBuffer::HBL_DISCARD);
+  const Ogre::PixelBox& pixelBox = pixelBuffer->getCurrentLock();
+  uint8_t* data = static_cast<uint8_t*>(pixelBox.data);
+  size_t texelSize = Ogre::PixelUtil::getNumElemBytes(pixelBox.format);
+
+  for (size_t label = 0; label < m_paletteWidth * m_paletteHeight; label++)
+  {
+    Ogre::ColourValue color = Ogre::ColourValue::ZERO;
+    if (label < m_colors.size() && m_visible[label])
+    {
+      color = m_colors[label];
+    }
+
+    size_t x = label % m_paletteWidth;
+    size_t y = label / m_paletteWidth;
+    Ogre::PixelUtil::packColour(color, pixelBox.format, data + (y * pixelBox.rowPitch + x) * texelSize);
+  }
+
+  pixelBuffer->unlock();
+}
+
+}  // End namespace rviz_map_plugin
@@ -54,12 +54,21 @@
 #include <sstream>
 #include <iostream>
 #include <limits>
+#include <algorithm>
+#include <iterator>
 
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
 
+#include <unistd.h>
+
+#include <rviz/properties/bool_property.h>
 #include <rviz/properties/color_property.h>
+#include <rviz/properties/float_property.h>
 
 #include <OGRE/OgreColourValue.h>
+#include <OGRE/OgreMath.h>
 
 #include <pluginlib/class_list_macros.h>
 PLUGINLIB_EXPORT_CLASS(rviz_map_plugin::ClusterLabelTool, rviz::Tool)
@@ -81,7 +90,6 @@ ClusterLabelTool::ClusterLabelTool() : m_displayInitialized(false)
 
 ClusterLabelTool::~ClusterLabelTool()
 {
-  m_selectedFaces.clear();
   context_->getSceneManager()->destroyManualObject(m_selectionBox->getName());
   context_->getSceneManager()->destroyManualObject(m_selectionBoxMaterial->getName());
   context_->getSceneManager()->destroySceneNode(m_sceneNode);
@@ -111,6 +119,24 @@ void ClusterLabelTool::onInitialize()
   m_selectionBoxMaterial->getTechnique(0)->getPass(0)->setPolygonMode(Ogre::PM_SOLID);
   m_selectionBoxMaterial->setCullingMode(Ogre::CULL_NONE);
 
+  m_useOpenCLProperty = new rviz::BoolProperty("Use OpenCL", true,
+                                               "Run the selection queries on an OpenCL device. If disabled or if no "
+                                               "device is available, they are run on the CPU.",
+                                               getPropertyContainer(), SLOT(updateUseOpenCL()), this);
+
+  m_regionMaxAngleProperty = new rviz::FloatProperty("Region Max Angle", 15.0f,
+                                                     "Maximum angle in degrees between the normals of the faces of a "
+                                                     "region (Shift + click) and the normal of the clicked face",
+                                                     getPropertyContainer());
+  m_regionMaxAngleProperty->setMin(0.0f);
+  m_regionMaxAngleProperty->setMax(180.0f);
+
+  m_regionMaxDistanceProperty = new rviz::FloatProperty("Region Max Distance", 10.0f,
+                                                        "Maximum distance of the faces of a region (Shift + click) "
+                                                        "from the clicked face, measured along the surface",
+                                                        getPropertyContainer());
+  m_regionMaxDistanceProperty->setMin(0.0f);
+
   // try-catch block to check for OpenCL errors
   try
   {
@@ -182,9 +208,9 @@ void ClusterLabelTool::onInitialize()
     }
     if (!deviceFound)
     {
-      // Panic if no compatible device was found
-      ROS_ERROR("No device with compatible OpenCL version found (minimum 2.0)");
-      ros::requestShutdown();
+      // Fall back to the CPU if no compatible device was found
+      ROS_WARN("No device with compatible OpenCL version found (minimum 1.2), using the CPU for selecting faces");
+      return;
     }
 
     cl_context_properties properties[] = { CL_CONTEXT_PLATFORM, (cl_context_properties)(platform)(), 0 };
@@ -200,7 +226,33 @@ void ClusterLabelTool::onInitialize()
 
     ROS_DEBUG("Got kernel: %s%s", ros::package::getPath("rviz_map_plugin").c_str(), CL_RAY_CAST_KERNEL_FILE);
 
-    m_clProgramSources = cl::Program::Sources(1, { cast_rays_kernel.c_str(), cast_rays_kernel.length() });
+    buildProgram(cast_rays_kernel);
+
+    // Create queue to which we will push commands for the device.
+    m_clQueue = cl::CommandQueue(m_clContext, m_clDevice, 0);
+    m_clAvailable = true;
+  }
+  catch (cl::Error err)
+  {
+    ROS_ERROR_STREAM(err.what() << ": " << CLUtil::getErrorString(err.err()));
+    ROS_WARN_STREAM("(" << CLUtil::getErrorDescription(err.err()) << ")");
+    ROS_WARN("OpenCL is not available, using the CPU for selecting faces");
+    m_clAvailable = false;
+  }
+}
+
+void ClusterLabelTool::buildProgram(const std::string& source)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  std::string cachePath = getProgramCachePath(source);
+  if (loadProgramBinary(cachePath))
+  {
+    ROS_INFO("Successfully loaded cached program binary %s.", cachePath.c_str());
+  }
+  else
+  {
+    m_clProgramSources = cl::Program::Sources(1, { source.c_str(), source.length() });
 
     m_clProgram = cl::Program(m_clContext, m_clProgramSources);
     try
@@ -211,42 +263,148 @@ void ClusterLabelTool::onInitialize()
     catch (cl::Error& err)
     {
       ROS_ERROR("Error building: %s", m_clProgram.getBuildInfo<CL_PROGRAM_BUILD_LOG>(m_clDevice).c_str());
-
-      ros::shutdown();
-      exit(1);
+      throw;
     }
 
-    // Create queue to which we will push commands for the device.
-    m_clQueue = cl::CommandQueue(m_clContext, m_clDevice, 0);
+    saveProgramBinary(cachePath);
   }
-  catch (cl::Error err)
+
+  auto end = std::chrono::steady_clock::now();
+  ROS_DEBUG("Building the program took %ld ms",
+            std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+}
+
+std::string ClusterLabelTool::getProgramCachePath(const std::string& source)
+{
+  // the binary is only valid for the same device, driver and source, so all of them go into the key
+  std::string key = m_clDevice.getInfo<CL_DEVICE_NAME>() + '\0' + m_clDevice.getInfo<CL_DEVICE_VENDOR>() + '\0' +
+                    m_clDevice.getInfo<CL_DRIVER_VERSION>() + '\0' + m_clDevice.getInfo<CL_DEVICE_VERSION>() + '\0' +
+                    source;
+
+  // 64 bit FNV-1a, which is stable across runs and compilers unlike std::hash
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : key)
   {
-    ROS_ERROR_STREAM(err.what() << ": " << CLUtil::getErrorString(err.err()));
-    ROS_WARN_STREAM("(" << CLUtil::getErrorDescription(err.err()) << ")");
-    ros::requestShutdown();
-    exit(1);
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+
+  // the same directory is used for the ROS logs
+  std::string directory;
+  if (const char* rosHome = std::getenv("ROS_HOME"))
+  {
+    directory = rosHome;
+  }
+  else if (const char* home = std::getenv("HOME"))
+  {
+    directory = std::string(home) + "/.ros";
   }
+  else
+  {
+    directory = ".";
+  }
+
+  char name[64];
+  snprintf(name, sizeof(name), "/rviz_map_plugin_cast_rays_%016llx.bin", static_cast<unsigned long long>(hash));
+  return directory + name;
 }
 
-void ClusterLabelTool::setVisual(std::shared_ptr<ClusterLabelVisual> visual)
+bool ClusterLabelTool::loadProgramBinary(const std::string& path)
 {
-  // set new visual
-  m_visual = visual;
-  m_selectedFaces = visual->getFaces();
-  m_faceSelectedArray.clear();
-  for (auto faceId : m_selectedFaces)
+  ifstream in(path, std::ios::binary);
+  if (!in)
+  {
+    return false;
+  }
+
+  std::vector<unsigned char> binary((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (binary.empty())
+  {
+    return false;
+  }
+  cl::Program::Binaries binaries(1, std::move(binary));
+
+  try
+  {
+    m_clProgram = cl::Program(m_clContext, { m_clDevice }, binaries);
+    m_clProgram.build({ m_clDevice });
+  }
+  catch (cl::Error& err)
+  {
+    // e.g. a truncated file or a binary the driver does not accept anymore, it is replaced after compiling
+    ROS_WARN("Cached program binary %s could not be used, compiling the kernels instead.", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+void ClusterLabelTool::saveProgramBinary(const std::string& path)
+{
+  try
   {
-    if (m_faceSelectedArray.size() <= faceId)
+    // the program may be associated with several devices of the context, only the binary of ours is built
+    std::vector<cl::Device> devices = m_clProgram.getInfo<CL_PROGRAM_DEVICES>();
+    cl::Program::Binaries binaries = m_clProgram.getInfo<CL_PROGRAM_BINARIES>();
+    for (size_t i = 0; i < devices.size() && i < binaries.size(); i++)
     {
-      m_faceSelectedArray.resize(faceId + 1);
+      if (devices[i]() != m_clDevice() || binaries[i].empty())
+      {
+        continue;
+      }
+
+      // write to a unique temporary file first, so that concurrent rviz instances neither read a partial binary
+      // nor write into the same file
+      std::string tmpPath = path + ".XXXXXX";
+      int fd = mkstemp(&tmpPath[0]);
+      if (fd < 0)
+      {
+        ROS_WARN("Could not write program binary to %s.", path.c_str());
+        return;
+      }
+
+      const char* data = reinterpret_cast<const char*>(binaries[i].data());
+      size_t written = 0;
+      while (written < binaries[i].size())
+      {
+        ssize_t result = ::write(fd, data + written, binaries[i].size() - written);
+        if (result <= 0)
+        {
+          break;
+        }
+        written += result;
+      }
+      ::close(fd);
+
+      if (written != binaries[i].size())
+      {
+        ROS_WARN("Could not write program binary to %s.", tmpPath.c_str());
+        std::remove(tmpPath.c_str());
+        return;
+      }
+      if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+      {
+        ROS_WARN("Could not write program binary to %s.", path.c_str());
+        std::remove(tmpPath.c_str());
+      }
+      return;
     }
-    m_faceSelectedArray[faceId] = true;
   }
+  catch (cl::Error& err)
+  {
+    ROS_WARN_STREAM("Could not get program binary: " << err.what() << ": " << CLUtil::getErrorString(err.err()));
+  }
+}
+
+void ClusterLabelTool::setVisual(std::shared_ptr<ClusterLabelVisual> visual)
+{
+  // set new visual
+  m_visual = visual;
+  m_selection.set(visual->getFaces());
 }
 
 void ClusterLabelTool::setSphereSize(float size)
 {
-  m_clKernelSphere.setArg(3, size);
+  // the kernel argument is set before every sphere selection, the kernel does not exist without OpenCL
   m_sphereSize = size;
 }
 
@@ -261,35 +419,70 @@ void ClusterLabelTool::deactivate()
 void ClusterLabelTool::setDisplay(ClusterLabelDisplay* display)
 {
   m_display = display;
-  m_meshGeometry = m_display->getGeometry();
-  m_faceSelectedArray.reserve(m_meshGeometry->faces.size());
+  std::shared_ptr<Geometry> geometry = m_display->getGeometry();
+  if (geometry != m_meshGeometry)
+  {
+    m_faceAdjacency.reset();
+  }
+  m_meshGeometry = geometry;
+  m_selection.resize(m_meshGeometry->faces.size());
+  if (m_visual)
+  {
+    m_selection.set(m_visual->getFaces());
+  }
   m_displayInitialized = true;
 
-  m_vertexData.reserve(m_meshGeometry->faces.size() * 3 * 3);
-
-  for (uint32_t faceId = 0; faceId < m_meshGeometry->faces.size(); faceId++)
+  if (!m_clAvailable)
   {
-    for (uint32_t i = 0; i < 3; i++)
-    {
-      uint32_t vertexId = m_meshGeometry->faces[faceId].vertexIndices[i];
-      Ogre::Vector3 vertexPos(m_meshGeometry->vertices[vertexId].x, m_meshGeometry->vertices[vertexId].y,
-                              m_meshGeometry->vertices[vertexId].z);
-      m_vertexPositions.push_back(vertexPos);
-
-      m_vertexData.push_back(m_meshGeometry->vertices[vertexId].x);
-      m_vertexData.push_back(m_meshGeometry->vertices[vertexId].y);
-      m_vertexData.push_back(m_meshGeometry->vertices[vertexId].z);
-    }
+    return;
   }
 
+  // the kernels work on the indexed mesh, so vertices and faces are uploaded as they are
+  static_assert(sizeof(Vertex) == 3 * sizeof(float), "Vertex has to consist of three floats");
+  static_assert(sizeof(Face) == 3 * sizeof(cl_uint), "Face has to consist of three vertex indices");
+
   // try-catch block to check for OpenCL errors
   try
   {
+    m_clKernelSingleRay = cl::Kernel(m_clProgram, "cast_rays");
+    m_clKernelReduceClosest = cl::Kernel(m_clProgram, "reduce_closest");
+    m_clKernelSphere = cl::Kernel(m_clProgram, "cast_sphere");
+    m_clKernelBox = cl::Kernel(m_clProgram, "cast_box");
+
+    // the reductions in the kernels need a work group size that is a power of two
+    size_t maxWorkGroupSize = std::min<size_t>(256, m_clDevice.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>());
+    for (cl::Kernel* kernel : { &m_clKernelSingleRay, &m_clKernelReduceClosest, &m_clKernelSphere, &m_clKernelBox })
+    {
+      maxWorkGroupSize =
+          std::min(maxWorkGroupSize, kernel->getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(m_clDevice));
+    }
+    m_clWorkGroupSize = 1;
+    while (m_clWorkGroupSize * 2 <= maxWorkGroupSize)
+    {
+      m_clWorkGroupSize *= 2;
+    }
+
+    cl_uint numFaces = m_meshGeometry->faces.size();
+    m_clNumGroups = (numFaces + m_clWorkGroupSize - 1) / m_clWorkGroupSize;
+
     m_clVertexBuffer = cl::Buffer(m_clContext, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY | CL_MEM_COPY_HOST_PTR,
-                                  sizeof(float) * m_vertexData.size(), m_vertexData.data());
+                                  sizeof(Vertex) * m_meshGeometry->vertices.size(), m_meshGeometry->vertices.data());
+
+    m_clFaceBuffer = cl::Buffer(m_clContext, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY | CL_MEM_COPY_HOST_PTR,
+                                sizeof(Face) * numFaces, m_meshGeometry->faces.data());
+
+    m_clGroupDistanceBuffer =
+        cl::Buffer(m_clContext, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, sizeof(float) * m_clNumGroups);
+
+    m_clGroupFaceBuffer =
+        cl::Buffer(m_clContext, CL_MEM_READ_WRITE | CL_MEM_HOST_NO_ACCESS, sizeof(cl_uint) * m_clNumGroups);
 
-    m_clResultBuffer = cl::Buffer(m_clContext, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY,
-                                  sizeof(float) * m_meshGeometry->faces.size());
+    m_clClosestHitBuffer = cl::Buffer(m_clContext, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, sizeof(ClosestHit));
+
+    m_clHitFaceBuffer =
+        cl::Buffer(m_clContext, CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, sizeof(cl_uint) * numFaces);
+
+    m_clHitCountBuffer = cl::Buffer(m_clContext, CL_MEM_READ_WRITE, sizeof(cl_uint));
 
     m_clRayBuffer = cl::Buffer(m_clContext, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, sizeof(float) * 6);
 
@@ -297,31 +490,43 @@ void ClusterLabelTool::setDisplay(ClusterLabelDisplay* display)
 
     m_clBoxBuffer = cl::Buffer(m_clContext, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, sizeof(float) * 4 * 6);
 
-    m_clStartNormalBuffer = cl::Buffer(m_clContext, CL_MEM_READ_ONLY | CL_MEM_HOST_WRITE_ONLY, sizeof(float) * 3);
-
-    m_clKernelSingleRay = cl::Kernel(m_clProgram, "cast_rays");
-    m_clKernelSphere = cl::Kernel(m_clProgram, "cast_sphere");
-    m_clKernelBox = cl::Kernel(m_clProgram, "cast_box");
-
     m_clKernelSingleRay.setArg(0, m_clVertexBuffer);
-    m_clKernelSingleRay.setArg(1, m_clRayBuffer);
-    m_clKernelSingleRay.setArg(2, m_clResultBuffer);
+    m_clKernelSingleRay.setArg(1, m_clFaceBuffer);
+    m_clKernelSingleRay.setArg(2, numFaces);
+    m_clKernelSingleRay.setArg(3, m_clRayBuffer);
+    m_clKernelSingleRay.setArg(4, m_clGroupDistanceBuffer);
+    m_clKernelSingleRay.setArg(5, m_clGroupFaceBuffer);
+    m_clKernelSingleRay.setArg(6, cl::Local(sizeof(float) * m_clWorkGroupSize));
+    m_clKernelSingleRay.setArg(7, cl::Local(sizeof(cl_uint) * m_clWorkGroupSize));
+
+    m_clKernelReduceClosest.setArg(0, m_clGroupDistanceBuffer);
+    m_clKernelReduceClosest.setArg(1, m_clGroupFaceBuffer);
+    m_clKernelReduceClosest.setArg(2, static_cast<cl_uint>(m_clNumGroups));
+    m_clKernelReduceClosest.setArg(3, m_clClosestHitBuffer);
+    m_clKernelReduceClosest.setArg(4, cl::Local(sizeof(float) * m_clWorkGroupSize));
+    m_clKernelReduceClosest.setArg(5, cl::Local(sizeof(cl_uint) * m_clWorkGroupSize));
 
     m_clKernelSphere.setArg(0, m_clVertexBuffer);
-    m_clKernelSphere.setArg(1, m_clSphereBuffer);
-    m_clKernelSphere.setArg(2, m_clResultBuffer);
-    m_clKernelSphere.setArg(3, m_sphereSize);
+    m_clKernelSphere.setArg(1, m_clFaceBuffer);
+    m_clKernelSphere.setArg(2, numFaces);
+    m_clKernelSphere.setArg(3, m_clSphereBuffer);
+    m_clKernelSphere.setArg(4, m_sphereSize);
+    m_clKernelSphere.setArg(5, m_clHitFaceBuffer);
+    m_clKernelSphere.setArg(6, m_clHitCountBuffer);
 
     m_clKernelBox.setArg(0, m_clVertexBuffer);
-    m_clKernelBox.setArg(1, m_clBoxBuffer);
-    m_clKernelBox.setArg(2, m_clResultBuffer);
+    m_clKernelBox.setArg(1, m_clFaceBuffer);
+    m_clKernelBox.setArg(2, numFaces);
+    m_clKernelBox.setArg(3, m_clBoxBuffer);
+    m_clKernelBox.setArg(4, m_clHitFaceBuffer);
+    m_clKernelBox.setArg(5, m_clHitCountBuffer);
   }
   catch (cl::Error err)
   {
     ROS_ERROR_STREAM(err.what() << ": " << CLUtil::getErrorString(err.err()));
     ROS_WARN_STREAM("(" << CLUtil::getErrorDescription(err.err()) << ")");
-    ros::shutdown();
-    exit(1);
+    ROS_WARN("Could not set up the OpenCL buffers, using the CPU for selecting faces");
+    m_clAvailable = false;
   }
 }
 
@@ -407,51 +612,33 @@ void ClusterLabelTool::selectFacesInBoxParallel(Ogre::PlaneBoundedVolume& volume
     m_boxData.push_back(plane.d);
   }
 
-  try
-  {
-    m_clQueue.enqueueWriteBuffer(m_clBoxBuffer, CL_TRUE, 0, sizeof(float) * 4 * 6, m_boxData.data());
-
-    m_clQueue.enqueueNDRangeKernel(m_clKernelBox, cl::NullRange, cl::NDRange(m_meshGeometry->faces.size()),
-                                   cl::NullRange, nullptr);
-    m_clQueue.finish();
-
-    m_resultDistances.resize(m_meshGeometry->faces.size());
-    m_clQueue.enqueueReadBuffer(m_clResultBuffer, CL_TRUE, 0, sizeof(float) * m_meshGeometry->faces.size(),
-                                m_resultDistances.data());
-  }
-  catch (cl::Error err)
-  {
-    ROS_ERROR_STREAM(err.what() << ": " << CLUtil::getErrorString(err.err()));
-    ROS_WARN_STREAM("(" << CLUtil::getErrorDescription(err.err()) << ")");
-  }
+  auto start = std::chrono::steady_clock::now();
 
-  for (int faceId = 0; faceId < m_meshGeometry->faces.size(); faceId++)
+  if (useOpenCL())
   {
-    if (m_resultDistances[faceId] > 0)
+    try
     {
-      if (m_faceSelectedArray.size() <= faceId)
-      {
-        m_faceSelectedArray.resize(faceId + 1);
-      }
-      m_faceSelectedArray[faceId] = selectMode;
+      m_clQueue.enqueueWriteBuffer(m_clBoxBuffer, CL_TRUE, 0, sizeof(float) * 4 * 6, m_boxData.data());
     }
-  }
-
-  std::vector<uint32_t> tmpFaceList;
-
-  for (uint32_t faceId = 0; faceId < m_faceSelectedArray.size(); faceId++)
-  {
-    if (m_faceSelectedArray[faceId])
+    catch (cl::Error err)
     {
-      tmpFaceList.push_back(faceId);
+      ROS_ERROR_STREAM(err.what() << ": " << CLUtil::getErrorString(err.err()));
+      ROS_WARN_STREAM("(" << CLUtil::getErrorDescription(err.err()) << ")");
+      return;
     }
-  }
 
-  if (m_displayInitialized && m_visual)
+    castSelectionKernel(m_clKernelBox);
+  }
+  else
   {
-    m_visual->setFacesInCluster(tmpFaceList);
-    // m_visual->setColor(Ogre::ColourValue(0.0f, 0.0f, 1.0f, 1.0f));
+    castBoxCPU();
   }
+
+  auto end = std::chrono::steady_clock::now();
+  ROS_DEBUG("Box selection on the %s found %lu faces in %ld us", useOpenCL() ? "device" : "CPU", m_hitFaces.size(),
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+
+  updateSelection(m_hitFaces, selectMode);
 }
 
 void ClusterLabelTool::selectSingleFace(rviz::ViewportMouseEvent& event, bool selectMode)
@@ -463,194 +650,343 @@ void ClusterLabelTool::selectSingleFace(rviz::ViewportMouseEvent& event, bool se
 
 void ClusterLabelTool::selectSingleFaceParallel(Ogre::Ray& ray, bool selectMode)
 {
-  m_rayData = { ray.getOrigin().x,    ray.getOrigin().y,    ray.getOrigin().z,
-                ray.getDirection().x, ray.getDirection().y, ray.getDirection().z };
-
-  std::vector<std::pair<uint32_t, float>> intersectedFaceList;
+  auto raycastResult = getClosestIntersectedFaceParallel(ray);
 
-  try
+  if (m_displayInitialized && m_visual && raycastResult)
   {
-    m_clQueue.enqueueWriteBuffer(m_clRayBuffer, CL_TRUE, 0, sizeof(float) * 6, m_rayData.data());
-
-    m_clQueue.enqueueNDRangeKernel(m_clKernelSingleRay, cl::NullRange, cl::NDRange(m_meshGeometry->faces.size()),
-                                   cl::NullRange, nullptr);
-    m_clQueue.finish();
+    updateSelection({ raycastResult->first }, selectMode);
 
-    m_resultDistances.resize(m_meshGeometry->faces.size());
-    m_clQueue.enqueueReadBuffer(m_clResultBuffer, CL_TRUE, 0, sizeof(float) * m_meshGeometry->faces.size(),
-                                m_resultDistances.data());
-  }
-  catch (cl::Error err)
-  {
-    ROS_ERROR_STREAM(err.what() << ": " << CLUtil::getErrorString(err.err()));
-    ROS_WARN_STREAM("(" << CLUtil::getErrorDescription(err.err()) << ")");
+    ROS_DEBUG("selectSingleFaceParallel() found face with id %u", raycastResult->first);
   }
+}
 
-  int closestFaceId = -1;
-  float minDist = std::numeric_limits<float>::max();
+void ClusterLabelTool::selectSphereFaces(rviz::ViewportMouseEvent& event, bool selectMode)
+{
+  Ogre::Ray ray = event.viewport->getCamera()->getCameraToViewportRay(
+      (float)event.x / event.viewport->getActualWidth(), (float)event.y / event.viewport->getActualHeight());
+  selectSphereFacesParallel(ray, selectMode);
+}
 
-  for (int i = 0; i < m_meshGeometry->faces.size(); i++)
-  {
-    if (m_resultDistances[i] > 0 && m_resultDistances[i] < minDist)
-    {
-      closestFaceId = i;
-      minDist = m_resultDistances[i];
-    }
-  }
+void ClusterLabelTool::selectSphereFacesParallel(Ogre::Ray& ray, bool selectMode)
+{
+  auto raycastResult = getClosestIntersectedFaceParallel(ray);
 
-  if (m_displayInitialized && m_visual && closestFaceId != -1)
+  if (raycastResult)
   {
-    std::vector<uint32_t> tmpFaceList;
+    Ogre::Vector3 sphereCenter = ray.getPoint(raycastResult->second);
 
-    if (m_faceSelectedArray.size() <= closestFaceId)
-    {
-      m_faceSelectedArray.resize(closestFaceId + 1);
-    }
-    m_faceSelectedArray[closestFaceId] = selectMode;
+    m_sphereData = { sphereCenter.x, sphereCenter.y, sphereCenter.z, raycastResult->second };
+
+    auto start = std::chrono::steady_clock::now();
 
-    for (int faceId = 0; faceId < m_faceSelectedArray.size(); faceId++)
+    // every face inside the sphere gets selected
+    if (useOpenCL())
     {
-      if (m_faceSelectedArray[faceId])
+      try
+      {
+        m_clQueue.enqueueWriteBuffer(m_clSphereBuffer, CL_TRUE, 0, sizeof(float) * 4, m_sphereData.data());
+        m_clKernelSphere.setArg(4, m_sphereSize);
+      }
+      catch (cl::Error err)
       {
-        tmpFaceList.push_back(faceId);
+        ROS_ERROR_STREAM(err.what() << ": " << CLUtil::getErrorString(err.err()));
+        ROS_WARN_STREAM("(" << CLUtil::getErrorDescription(err.err()) << ")");
+        return;
       }
+
+      castSelectionKernel(m_clKernelSphere);
+    }
+    else
+    {
+      castSphereCPU();
     }
 
-    m_visual->setFacesInCluster(tmpFaceList);
+    auto end = std::chrono::steady_clock::now();
+    ROS_DEBUG("Sphere selection on the %s found %lu faces in %ld us", useOpenCL() ? "device" : "CPU",
+              m_hitFaces.size(), std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
 
-    ROS_DEBUG("selectSingleFaceParallel() found face with id %d", closestFaceId);
+    updateSelection(m_hitFaces, selectMode);
   }
 }
 
-void ClusterLabelTool::selectSphereFaces(rviz::ViewportMouseEvent& event, bool selectMode)
+void ClusterLabelTool::selectRegion(rviz::ViewportMouseEvent& event, bool selectMode)
 {
   Ogre::Ray ray = event.viewport->getCamera()->getCameraToViewportRay(
       (float)event.x / event.viewport->getActualWidth(), (float)event.y / event.viewport->getActualHeight());
-  selectSphereFacesParallel(ray, selectMode);
-}
 
-void ClusterLabelTool::selectSphereFacesParallel(Ogre::Ray& ray, bool selectMode)
-{
   auto raycastResult = getClosestIntersectedFaceParallel(ray);
+  if (m_displayInitialized && m_visual && raycastResult)
+  {
+    auto start = std::chrono::steady_clock::now();
+    growRegion(raycastResult->first);
+    auto end = std::chrono::steady_clock::now();
+    ROS_DEBUG("Region growing from face %u found %lu faces in %ld ms", raycastResult->first, m_hitFaces.size(),
+              std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
 
-  if (raycastResult)
+    updateSelection(m_hitFaces, selectMode);
+  }
+}
+
+void ClusterLabelTool::growRegion(uint32_t seedFace)
+{
+  if (!m_faceAdjacency)
   {
-    Ogre::Vector3 sphereCenter = ray.getPoint(raycastResult->second);
+    buildRegionGrowingData();
+  }
 
-    m_sphereData = { sphereCenter.x, sphereCenter.y, sphereCenter.z, raycastResult->second };
+  const float minCosine = std::cos(Ogre::Degree(m_regionMaxAngleProperty->getFloat()).valueRadians());
+  const float maxDistance = m_regionMaxDistanceProperty->getFloat();
+  const Ogre::Vector3 seedNormal = m_faceNormals[seedFace];
 
-    try
-    {
-      m_clQueue.enqueueWriteBuffer(m_clSphereBuffer, CL_TRUE, 0, sizeof(float) * 4, m_sphereData.data());
+  m_regionVisited[seedFace] = 1;
+  m_regionDistances[seedFace] = 0.0f;
+  m_hitFaces.assign(1, seedFace);
 
-      m_clQueue.enqueueNDRangeKernel(m_clKernelSphere, cl::NullRange, cl::NDRange(m_meshGeometry->faces.size()),
-                                     cl::NullRange, nullptr);
-      m_clQueue.finish();
+  std::vector<uint32_t> frontier(1, seedFace);
+  std::vector<uint32_t> nextFrontier;
+  while (!frontier.empty())
+  {
+    nextFrontier.clear();
 
-      m_resultDistances.resize(m_meshGeometry->faces.size());
-      m_clQueue.enqueueReadBuffer(m_clResultBuffer, CL_TRUE, 0, sizeof(float) * m_meshGeometry->faces.size(),
-                                  m_resultDistances.data());
-    }
-    catch (cl::Error err)
+#pragma omp parallel
     {
-      ROS_ERROR_STREAM(err.what() << ": " << CLUtil::getErrorString(err.err()));
-      ROS_WARN_STREAM("(" << CLUtil::getErrorDescription(err.err()) << ")");
-    }
+      std::vector<uint32_t> threadFrontier;
 
-    for (int faceId = 0; faceId < m_meshGeometry->faces.size(); faceId++)
-    {
-      // if face is inside sphere, select it
-      if (m_resultDistances[faceId] > 0)
+#pragma omp for schedule(dynamic, 256) nowait
+      for (size_t i = 0; i < frontier.size(); i++)
       {
-        if (m_faceSelectedArray.size() <= faceId)
+        uint32_t faceId = frontier[i];
+        for (uint32_t neighbor : (*m_faceAdjacency)[faceId])
         {
-          m_faceSelectedArray.resize(faceId + 1);
+          float distance = m_regionDistances[faceId] + m_faceCentroids[faceId].distance(m_faceCentroids[neighbor]);
+          if (distance > maxDistance || m_faceNormals[neighbor].dotProduct(seedNormal) < minCosine)
+          {
+            continue;
+          }
+
+          // the first thread reaching a face claims it
+          uint8_t visited;
+#pragma omp atomic capture
+          {
+            visited = m_regionVisited[neighbor];
+            m_regionVisited[neighbor] = 1;
+          }
+
+          if (!visited)
+          {
+            m_regionDistances[neighbor] = distance;
+            threadFrontier.push_back(neighbor);
+          }
         }
-        m_faceSelectedArray[faceId] = selectMode;
       }
+
+#pragma omp critical
+      nextFrontier.insert(nextFrontier.end(), threadFrontier.begin(), threadFrontier.end());
     }
 
-    if (m_displayInitialized && m_visual)
-    {
-      std::vector<uint32_t> tmpFaceList;
-      for (int faceId = 0; faceId < m_faceSelectedArray.size(); faceId++)
-      {
-        if (m_faceSelectedArray[faceId])
-        {
-          tmpFaceList.push_back(faceId);
-        }
-      }
+    m_hitFaces.insert(m_hitFaces.end(), nextFrontier.begin(), nextFrontier.end());
+    frontier.swap(nextFrontier);
+  }
 
-      m_visual->setFacesInCluster(tmpFaceList);
-    }
+  // only the faces of the region have been touched
+  for (uint32_t faceId : m_hitFaces)
+  {
+    m_regionVisited[faceId] = 0;
   }
 }
 
+void ClusterLabelTool::buildRegionGrowingData()
+{
+  auto start = std::chrono::steady_clock::now();
+
+  const std::vector<Vertex>& vertices = m_meshGeometry->vertices;
+  const std::vector<Face>& faces = m_meshGeometry->faces;
+
+  // the faces are laid out as the face indices of the map
+  static_assert(sizeof(Face) == 3 * sizeof(uint32_t), "faces must consist of their three vertex indices");
+  m_faceAdjacency.reset(new hdf5_map_io::MeshAdjacency(hdf5_map_io::buildFaceAdjacency(
+      reinterpret_cast<const uint32_t*>(faces.data()), faces.size(), vertices.size())));
+  m_faceNormals.resize(faces.size());
+  m_faceCentroids.resize(faces.size());
+
+#pragma omp parallel for schedule(static)
+  for (size_t faceId = 0; faceId < faces.size(); faceId++)
+  {
+    const Vertex& a = vertices[faces[faceId].vertexIndices[0]];
+    const Vertex& b = vertices[faces[faceId].vertexIndices[1]];
+    const Vertex& c = vertices[faces[faceId].vertexIndices[2]];
+    Ogre::Vector3 va(a.x, a.y, a.z);
+    Ogre::Vector3 vb(b.x, b.y, b.z);
+    Ogre::Vector3 vc(c.x, c.y, c.z);
+
+    m_faceNormals[faceId] = (vb - va).crossProduct(vc - va).normalisedCopy();
+    m_faceCentroids[faceId] = (va + vb + vc) / 3.0f;
+  }
+
+  m_regionDistances.assign(faces.size(), 0.0f);
+  m_regionVisited.assign(faces.size(), 0);
+
+  auto end = std::chrono::steady_clock::now();
+  ROS_INFO("Built the face adjacency for region growing in %ld ms",
+           std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+}
+
 boost::optional<std::pair<uint32_t, float>> ClusterLabelTool::getClosestIntersectedFaceParallel(Ogre::Ray& ray)
 {
+  if (!useOpenCL())
+  {
+    return getClosestIntersectedFaceCPU(ray);
+  }
+
   m_rayData = { ray.getOrigin().x,    ray.getOrigin().y,    ray.getOrigin().z,
                 ray.getDirection().x, ray.getDirection().y, ray.getDirection().z };
 
+  ClosestHit closestHit;
+
   try
   {
     m_clQueue.enqueueWriteBuffer(m_clRayBuffer, CL_TRUE, 0, sizeof(float) * 6, m_rayData.data());
 
-    m_clQueue.enqueueNDRangeKernel(m_clKernelSingleRay, cl::NullRange, cl::NDRange(m_meshGeometry->faces.size()),
-                                   cl::NullRange, nullptr);
-    m_clQueue.finish();
+    // every work group reduces its faces to the closest hit, a single work group reduces those to the result
+    m_clQueue.enqueueNDRangeKernel(m_clKernelSingleRay, cl::NullRange, cl::NDRange(m_clNumGroups * m_clWorkGroupSize),
+                                   cl::NDRange(m_clWorkGroupSize), nullptr);
+    m_clQueue.enqueueNDRangeKernel(m_clKernelReduceClosest, cl::NullRange, cl::NDRange(m_clWorkGroupSize),
+                                   cl::NDRange(m_clWorkGroupSize), nullptr);
 
-    m_resultDistances.resize(m_meshGeometry->faces.size());
-    m_clQueue.enqueueReadBuffer(m_clResultBuffer, CL_TRUE, 0, sizeof(float) * m_meshGeometry->faces.size(),
-                                m_resultDistances.data());
+    m_clQueue.enqueueReadBuffer(m_clClosestHitBuffer, CL_TRUE, 0, sizeof(ClosestHit), &closestHit);
   }
   catch (cl::Error err)
   {
     ROS_ERROR_STREAM(err.what() << ": " << CLUtil::getErrorString(err.err()));
     ROS_WARN_STREAM("(" << CLUtil::getErrorDescription(err.err()) << ")");
+    return {};
   }
 
-  uint32_t closestFaceId;
-  bool faceFound = false;
-  float minDist = std::numeric_limits<float>::max();
+  if (closestHit.face != std::numeric_limits<cl_uint>::max())
+  {
+    return std::make_pair(static_cast<uint32_t>(closestHit.face), static_cast<float>(closestHit.distance));
+  }
+  else
+  {
+    return {};
+  }
+}
 
-  for (uint32_t i = 0; i < m_meshGeometry->faces.size(); i++)
+boost::optional<std::pair<uint32_t, float>> ClusterLabelTool::getClosestIntersectedFaceCPU(const Ogre::Ray& ray)
+{
+  if (!m_meshGeometry)
   {
-    if (m_resultDistances[i] > 0 && m_resultDistances[i] < minDist)
-    {
-      closestFaceId = i;
-      faceFound = true;
-      minDist = m_resultDistances[i];
-    }
+    return {};
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  m_rayData = { ray.getOrigin().x,    ray.getOrigin().y,    ray.getOrigin().z,
+                ray.getDirection().x, ray.getDirection().y, ray.getDirection().z };
+  auto result = castRay(*m_meshGeometry, m_rayData);
+
+  auto end = std::chrono::steady_clock::now();
+  ROS_DEBUG("Ray cast on the CPU took %ld us",
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+
+  return result;
+}
+
+void ClusterLabelTool::castSphereCPU()
+{
+  m_hitFaces.clear();
+  if (!m_meshGeometry)
+  {
+    return;
   }
 
-  if (faceFound)
+  castSphere(*m_meshGeometry, { m_sphereData[0], m_sphereData[1], m_sphereData[2] }, m_sphereSize, m_vertexHits,
+             m_hitFaces);
+}
+
+void ClusterLabelTool::castBoxCPU()
+{
+  m_hitFaces.clear();
+  if (!m_meshGeometry || m_boxData.size() != 4 * 6)
   {
-    return std::make_pair(closestFaceId, minDist);
+    return;
+  }
+
+  castBox(*m_meshGeometry, m_boxData.data(), m_vertexHits, m_hitFaces);
+}
+
+void ClusterLabelTool::updateSelection(const std::vector<uint32_t>& faces, bool selectMode)
+{
+  m_changedFaces.clear();
+  if (selectMode)
+  {
+    m_selection.select(faces, &m_changedFaces);
   }
   else
   {
-    return {};
+    m_selection.deselect(faces, &m_changedFaces);
+  }
+
+  // only the faces whose state changed are passed on to the visual
+  if (!m_changedFaces.empty() && m_displayInitialized && m_visual)
+  {
+    if (selectMode)
+    {
+      m_visual->addFaces(m_changedFaces);
+    }
+    else
+    {
+      m_visual->removeFaces(m_changedFaces);
+    }
   }
 }
 
-void ClusterLabelTool::publishLabel(std::string label)
+void ClusterLabelTool::castSelectionKernel(cl::Kernel& kernel)
 {
-  ROS_DEBUG_STREAM("Label Tool: Publish label '" << label << "'");
+  static const cl_uint zero = 0;
+  cl_uint hitCount = 0;
 
-  vector<uint32_t> faces;
-  for (uint32_t i = 0; i < m_faceSelectedArray.size(); i++)
+  try
   {
-    if (m_faceSelectedArray[i])
-      faces.push_back(i);
+    m_clQueue.enqueueWriteBuffer(m_clHitCountBuffer, CL_FALSE, 0, sizeof(cl_uint), &zero);
+    m_clQueue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(m_clNumGroups * m_clWorkGroupSize),
+                                   cl::NDRange(m_clWorkGroupSize), nullptr);
+
+    // only the ids of the hit faces are copied back
+    m_clQueue.enqueueReadBuffer(m_clHitCountBuffer, CL_TRUE, 0, sizeof(cl_uint), &hitCount);
+    m_hitFaces.resize(hitCount);
+    if (hitCount > 0)
+    {
+      m_clQueue.enqueueReadBuffer(m_clHitFaceBuffer, CL_TRUE, 0, sizeof(cl_uint) * hitCount, m_hitFaces.data());
+    }
   }
+  catch (cl::Error err)
+  {
+    ROS_ERROR_STREAM(err.what() << ": " << CLUtil::getErrorString(err.err()));
+    ROS_WARN_STREAM("(" << CLUtil::getErrorDescription(err.err()) << ")");
+    m_hitFaces.clear();
+  }
+}
 
-  m_display->addLabel(label, faces);
+void ClusterLabelTool::publishLabel(std::string label)
+{
+  ROS_DEBUG_STREAM("Label Tool: Publish label '" << label << "'");
+
+  m_display->addLabel(label, m_selection.getSortedFaces());
 }
 
 // Handling mouse event and mark the clicked faces
 int ClusterLabelTool::processMouseEvent(rviz::ViewportMouseEvent& event)
 {
-  if (event.leftDown() && event.control())
+  if (event.leftDown() && event.shift())
+  {
+    selectRegion(event, true);
+  }
+  else if (event.rightDown() && event.shift())
+  {
+    selectRegion(event, false);
+  }
+  else if (event.leftDown() && event.control())
   {
     m_singleSelect = true;
     selectSphereFaces(event, true);
@@ -708,21 +1044,12 @@ int ClusterLabelTool::processMouseEvent(rviz::ViewportMouseEvent& event)
 
 std::vector<uint32_t> ClusterLabelTool::getSelectedFaces()
 {
-  std::vector<uint32_t> faceList;
-
-  for (int faceId = 0; faceId < m_faceSelectedArray.size(); faceId++)
-  {
-    if (m_faceSelectedArray[faceId])
-    {
-      faceList.push_back(faceId);
-    }
-  }
-  return faceList;
+  return m_selection.getSortedFaces();
 }
 
 void ClusterLabelTool::resetFaces()
 {
-  m_faceSelectedArray.clear();
+  m_selection.clear();
   if (m_visual)
   {
     m_visual->setFacesInCluster(std::vector<uint32_t>());
@@ -57,8 +57,18 @@
 #include <OGRE/OgreSceneNode.h>
 #include <OGRE/OgreSubMesh.h>
 
+#include <algorithm>
+
 namespace rviz_map_plugin
 {
+namespace
+{
+/// Minimal number of faces an index buffer is allocated for
+const size_t MIN_FACE_CAPACITY = 1024;
+/// Dirty slots closer than this are written with a single call
+const size_t MAX_SLOT_GAP = 16;
+}  // namespace
+
 ClusterLabelVisual::ClusterLabelVisual(rviz::DisplayContext* context, std::string labelId)
   : m_displayContext(context), m_labelId(labelId)
 {
@@ -110,12 +120,14 @@ ClusterLabelVisual::ClusterLabelVisual(rviz::DisplayContext* context, std::strin
     // Lock the buffer so we can get exclusive access to its data
     float* vertices = static_cast<float*>(vertexBuffer->lock(Ogre::HardwareBuffer::HBL_NORMAL));
 
-    // Write the mesh data into the buffer
+    // Write the mesh data into the buffer and calculate the bounding box on the way
+    Ogre::AxisAlignedBox bounds;
     for (int i = 0; i < m_mesh->sharedVertexData->vertexCount; i++)
     {
       vertices[(i * 3) + 0] = geometry->vertices[i].x;
       vertices[(i * 3) + 1] = geometry->vertices[i].y;
       vertices[(i * 3) + 2] = geometry->vertices[i].z;
+      bounds.merge(Ogre::Vector3(geometry->vertices[i].x, geometry->vertices[i].y, geometry->vertices[i].z));
     }
 
     // Unlock the buffer
@@ -124,9 +136,9 @@ ClusterLabelVisual::ClusterLabelVisual(rviz::DisplayContext* context, std::strin
     // Attach the vertex buffer to the mesh
     m_mesh->sharedVertexData->vertexBufferBinding->setBinding(0, vertexBuffer);
 
-    // Set the bounds of the mesh
-    // TODO: Calculate the correct bounding box
-    m_mesh->_setBounds(Ogre::AxisAlignedBox::EXTENT_INFINITE);
+    // Set the bounds of the mesh, so that it is culled when it is out of view
+    m_mesh->_setBounds(bounds);
+    m_mesh->_setBoundingSphereRadius((bounds.getMaximum() - bounds.getMinimum()).length() / 2);
 
     // Notify the mesh that we're all ready
     m_mesh->load();
@@ -198,6 +210,7 @@ void ClusterLabelVisual::setGeometry(std::shared_ptr<Geometry> geometry)
 void ClusterLabelVisual::setFacesInCluster(const std::vector<uint32_t>& faces)
 {
   m_faces = faces;
+  m_faceSlots.clear();
 
   if (!m_geometry)
   {
@@ -205,40 +218,132 @@ void ClusterLabelVisual::setFacesInCluster(const std::vector<uint32_t>& faces)
     return;
   }
 
-  // don't draw the cluster if there are no faces in it
-  if (faces.empty())
+  // leave some room for faces added by the label tool
+  createIndexBuffer(m_faces.empty() ? 0 : m_faces.size() + m_faces.size() / 4 + MIN_FACE_CAPACITY);
+  updateIndexCount();
+}
+
+void ClusterLabelVisual::addFaces(const std::vector<uint32_t>& faces)
+{
+  if (!m_geometry)
   {
-    m_subMesh->indexData->indexBuffer.setNull();
-    m_subMesh->indexData->indexCount = 0;
-    m_subMesh->indexData->indexStart = 0;
-    m_material->getTechnique(0)->removeAllPasses();
-    ROS_DEBUG("ClusterLabelVisual::setFacesInCluster: faces empty!");
+    ROS_WARN("ClusterLabelVisual::addFaces: MeshGeometry not set!");
     return;
   }
 
-  // if there are faces and there are no passes, create a pass to draw the cluster
-  if (m_material->getTechnique(0)->getNumPasses() == 0)
+  buildFaceSlots();
+
+  size_t firstNewSlot = m_faces.size();
+  for (uint32_t faceId : faces)
   {
-    m_material->getTechnique(0)->createPass();
-    m_material->setDiffuse(m_color);
-    m_material->setSelfIllumination(m_color);
+    if (m_faceSlots.emplace(faceId, m_faces.size()).second)
+    {
+      m_faces.push_back(faceId);
+    }
+  }
 
-    initMaterial();
+  if (m_faces.size() == firstNewSlot)
+  {
+    return;
+  }
+
+  if (m_faces.size() > m_faceCapacity)
+  {
+    // grow geometrically, so appending n faces costs O(n) amortized
+    createIndexBuffer(std::max(2 * m_faces.size(), MIN_FACE_CAPACITY));
+  }
+  else
+  {
+    writeFaces(firstNewSlot, m_faces.size() - firstNewSlot);
+  }
+  updateIndexCount();
+}
+
+void ClusterLabelVisual::removeFaces(const std::vector<uint32_t>& faces)
+{
+  if (!m_geometry)
+  {
+    ROS_WARN("ClusterLabelVisual::removeFaces: MeshGeometry not set!");
+    return;
+  }
+
+  buildFaceSlots();
+
+  // fill the slot of each removed face with the last face, so the index buffer stays dense
+  std::vector<uint32_t> dirtySlots;
+  size_t oldSize = m_faces.size();
+  for (uint32_t faceId : faces)
+  {
+    auto it = m_faceSlots.find(faceId);
+    if (it == m_faceSlots.end())
+    {
+      continue;
+    }
+
+    uint32_t slot = it->second;
+    m_faceSlots.erase(it);
+
+    uint32_t lastFaceId = m_faces.back();
+    m_faces.pop_back();
+    if (slot < m_faces.size())
+    {
+      m_faces[slot] = lastFaceId;
+      m_faceSlots[lastFaceId] = slot;
+      dirtySlots.push_back(slot);
+    }
+  }
+
+  if (m_faces.size() == oldSize)
+  {
+    return;
+  }
+
+  if (m_faces.size() * 4 < m_faceCapacity && m_faceCapacity > MIN_FACE_CAPACITY)
+  {
+    // compact the index buffer once most of it is unused
+    createIndexBuffer(m_faces.empty() ? 0 : std::max(2 * m_faces.size(), MIN_FACE_CAPACITY));
+  }
+  else
+  {
+    // patch the moved faces, slots beyond the end were removed afterwards and are not drawn anymore
+    std::sort(dirtySlots.begin(), dirtySlots.end());
+    auto end = std::lower_bound(dirtySlots.begin(), dirtySlots.end(), m_faces.size());
+    auto it = dirtySlots.begin();
+    while (it != end)
+    {
+      size_t first = *it;
+      size_t last = first;
+      for (++it; it != end && *it <= last + MAX_SLOT_GAP; ++it)
+      {
+        last = *it;
+      }
+      writeFaces(first, last - first + 1);
+    }
   }
+  updateIndexCount();
+}
+
+void ClusterLabelVisual::createIndexBuffer(size_t capacity)
+{
+  m_faceCapacity = capacity;
 
-  size_t indexCount = faces.size() * 3;
+  if (capacity == 0)
+  {
+    m_subMesh->indexData->indexBuffer.setNull();
+    return;
+  }
 
   // Create the index buffer
   Ogre::HardwareIndexBufferSharedPtr indexBuffer = Ogre::HardwareBufferManager::getSingleton().createIndexBuffer(
-      Ogre::HardwareIndexBuffer::IT_32BIT, indexCount, Ogre::HardwareBuffer::HBU_WRITE_ONLY);
+      Ogre::HardwareIndexBuffer::IT_32BIT, capacity * 3, Ogre::HardwareBuffer::HBU_DYNAMIC_WRITE_ONLY);
 
   // Lock the buffer so we can get exclusive access to its data
-  uint32_t* indices = static_cast<uint32_t*>(indexBuffer->lock(Ogre::HardwareBuffer::HBL_WRITE_ONLY));
+  uint32_t* indices = static_cast<uint32_t*>(indexBuffer->lock(Ogre::HardwareBuffer::HBL_DISCARD));
 
   // Define the triangles
-  for (int i = 0; i < faces.size(); i++)
+  for (size_t i = 0; i < m_faces.size(); i++)
   {
-    uint32_t faceId = faces[i];
+    uint32_t faceId = m_faces[i];
     indices[i * 3 + 0] = m_geometry->faces[faceId].vertexIndices[0];
     indices[i * 3 + 1] = m_geometry->faces[faceId].vertexIndices[1];
     indices[i * 3 + 2] = m_geometry->faces[faceId].vertexIndices[2];
@@ -249,10 +354,76 @@ void ClusterLabelVisual::setFacesInCluster(const std::vector<uint32_t>& faces)
 
   // Attach the index buffer to the submesh
   m_subMesh->indexData->indexBuffer = indexBuffer;
-  m_subMesh->indexData->indexCount = indexCount;
   m_subMesh->indexData->indexStart = 0;
 }
 
+void ClusterLabelVisual::writeFaces(size_t firstSlot, size_t count)
+{
+  std::vector<uint32_t> indices(count * 3);
+  for (size_t i = 0; i < count; i++)
+  {
+    uint32_t faceId = m_faces[firstSlot + i];
+    indices[i * 3 + 0] = m_geometry->faces[faceId].vertexIndices[0];
+    indices[i * 3 + 1] = m_geometry->faces[faceId].vertexIndices[1];
+    indices[i * 3 + 2] = m_geometry->faces[faceId].vertexIndices[2];
+  }
+
+  m_subMesh->indexData->indexBuffer->writeData(firstSlot * 3 * sizeof(uint32_t), indices.size() * sizeof(uint32_t),
+                                               indices.data());
+}
+
+void ClusterLabelVisual::updateIndexCount()
+{
+  m_subMesh->indexData->indexCount = m_faces.size() * 3;
+
+  // don't draw the cluster if there are no faces in it or if it is hidden
+  if (m_faces.empty() || !m_visible)
+  {
+    m_material->getTechnique(0)->removeAllPasses();
+    ROS_DEBUG("ClusterLabelVisual: faces empty!");
+    return;
+  }
+
+  // if there are faces and there are no passes, create a pass to draw the cluster
+  if (m_material->getTechnique(0)->getNumPasses() == 0)
+  {
+    m_material->getTechnique(0)->createPass();
+    m_material->setDiffuse(m_color);
+    m_material->setSelfIllumination(m_color);
+
+    initMaterial();
+  }
+}
+
+void ClusterLabelVisual::buildFaceSlots()
+{
+  if (m_faceSlots.size() == m_faces.size())
+  {
+    return;
+  }
+
+  m_faceSlots.clear();
+  m_faceSlots.reserve(m_faces.size());
+
+  // drop duplicate faces, every face needs a unique slot
+  std::vector<uint32_t> uniqueFaces;
+  uniqueFaces.reserve(m_faces.size());
+  for (uint32_t faceId : m_faces)
+  {
+    if (m_faceSlots.emplace(faceId, uniqueFaces.size()).second)
+    {
+      uniqueFaces.push_back(faceId);
+    }
+  }
+
+  if (uniqueFaces.size() != m_faces.size())
+  {
+    m_faces.swap(uniqueFaces);
+    createIndexBuffer(m_faceCapacity);
+    updateIndexCount();
+  }
+}
+
 void ClusterLabelVisual::setColor(Ogre::ColourValue facesColor, float alpha)
 {
   if (!m_material.isNull())
@@ -264,6 +435,15 @@ void ClusterLabelVisual::setColor(Ogre::ColourValue facesColor, float alpha)
   }
 }
 
+void ClusterLabelVisual::setVisible(bool visible)
+{
+  m_visible = visible;
+  if (!m_mesh.isNull() && !m_material.isNull())
+  {
+    updateIndexCount();
+  }
+}
+
 void ClusterLabelVisual::initMaterial()
 {
   m_material->setCullingMode(Ogre::CULL_NONE);
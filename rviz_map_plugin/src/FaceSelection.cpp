@@ -0,0 +1,217 @@
+/*
+ *  Software License Agreement (BSD License)
+ *
+ *  Robot Operating System code by the University of Osnabrück
+ *  Copyright (c) 2015, University of Osnabrück
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ *  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ *  FaceSelection.cpp
+ *
+ */
+
+#include <FaceSelection.hpp>
+
+#include <algorithm>
+
+namespace rviz_map_plugin
+{
+namespace
+{
+/**
+ * @brief Calls func for the face id of every set bit in the given word
+ */
+template <typename Func>
+inline void forEachBit(uint64_t bits, size_t word, Func func)
+{
+  while (bits)
+  {
+    uint32_t offset = __builtin_ctzll(bits);
+    func(static_cast<uint32_t>(word * 64 + offset));
+    bits &= bits - 1;
+  }
+}
+}  // namespace
+
+void FaceSelection::resize(size_t numFaces)
+{
+  m_words.assign((numFaces + BITS_PER_WORD - 1) / BITS_PER_WORD, 0);
+  m_faces.clear();
+  m_count = 0;
+}
+
+void FaceSelection::set(const std::vector<uint32_t>& faceIds)
+{
+  clear();
+  select(faceIds);
+}
+
+void FaceSelection::clear()
+{
+  // only touch the words that can contain selected faces
+  for (uint32_t faceId : m_faces)
+  {
+    m_words[faceId / BITS_PER_WORD] = 0;
+  }
+  m_faces.clear();
+  m_count = 0;
+}
+
+void FaceSelection::reserveFace(uint32_t faceId)
+{
+  size_t word = faceId / BITS_PER_WORD;
+  if (word >= m_words.size())
+  {
+    m_words.resize(word + 1, 0);
+  }
+}
+
+size_t FaceSelection::select(const std::vector<uint32_t>& faceIds, std::vector<uint32_t>* changed)
+{
+  size_t selected = 0;
+  size_t i = 0;
+  while (i < faceIds.size())
+  {
+    // collect all following faces that share a word into one mask
+    size_t word = faceIds[i] / BITS_PER_WORD;
+    reserveFace(faceIds[i]);
+    uint64_t mask = 0;
+    for (; i < faceIds.size() && faceIds[i] / BITS_PER_WORD == word; i++)
+    {
+      mask |= bit(faceIds[i]);
+    }
+
+    uint64_t added = mask & ~m_words[word];
+    m_words[word] |= mask;
+    selected += __builtin_popcountll(added);
+
+    forEachBit(added, word, [&](uint32_t faceId) {
+      m_faces.push_back(faceId);
+      if (changed)
+      {
+        changed->push_back(faceId);
+      }
+    });
+  }
+  m_count += selected;
+  return selected;
+}
+
+size_t FaceSelection::deselect(const std::vector<uint32_t>& faceIds, std::vector<uint32_t>* changed)
+{
+  size_t deselected = 0;
+  size_t i = 0;
+  while (i < faceIds.size())
+  {
+    size_t word = faceIds[i] / BITS_PER_WORD;
+    uint64_t mask = 0;
+    for (; i < faceIds.size() && faceIds[i] / BITS_PER_WORD == word; i++)
+    {
+      mask |= bit(faceIds[i]);
+    }
+    if (word >= m_words.size())
+    {
+      continue;
+    }
+
+    uint64_t removed = mask & m_words[word];
+    m_words[word] &= ~mask;
+    deselected += __builtin_popcountll(removed);
+
+    if (changed)
+    {
+      forEachBit(removed, word, [&](uint32_t faceId) { changed->push_back(faceId); });
+    }
+  }
+  m_count -= deselected;
+
+  // keep the list of selected faces from growing unbounded
+  if (m_faces.size() > 2 * m_count + BITS_PER_WORD)
+  {
+    compact();
+  }
+  return deselected;
+}
+
+size_t FaceSelection::countSelected() const
+{
+  size_t count = 0;
+  for (uint64_t word : m_words)
+  {
+    count += __builtin_popcountll(word);
+  }
+  return count;
+}
+
+const std::vector<uint32_t>& FaceSelection::getFaces()
+{
+  if (m_faces.size() != m_count)
+  {
+    compact();
+  }
+  return m_faces;
+}
+
+std::vector<uint32_t> FaceSelection::getSortedFaces() const
+{
+  std::vector<uint32_t> faces;
+  faces.reserve(m_count);
+  for (size_t word = 0; word < m_words.size(); word++)
+  {
+    forEachBit(m_words[word], word, [&](uint32_t faceId) { faces.push_back(faceId); });
+  }
+  return faces;
+}
+
+void FaceSelection::compact()
+{
+  // keep the first occurrence of every selected face, its bit is cleared to detect duplicates
+  size_t size = 0;
+  for (uint32_t faceId : m_faces)
+  {
+    if (isSelected(faceId))
+    {
+      m_faces[size++] = faceId;
+      m_words[faceId / BITS_PER_WORD] &= ~bit(faceId);
+    }
+  }
+  m_faces.resize(size);
+
+  for (uint32_t faceId : m_faces)
+  {
+    m_words[faceId / BITS_PER_WORD] |= bit(faceId);
+  }
+}
+
+}  // End namespace rviz_map_plugin
@@ -0,0 +1,450 @@
+/*
+ *  Software License Agreement (BSD License)
+ *
+ *  Robot Operating System code by the University of Osnabrück
+ *  Copyright (c) 2015, University of Osnabrück
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ *  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ *  MapCache.cpp
+ *
+ */
+
+#include <MapCache.hpp>
+
+#include <ros/console.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rviz_map_plugin
+{
+namespace
+{
+/// Identifies cache files, followed by the version of the format
+const char MAP_CACHE_MAGIC[8] = { 'M', 'A', 'P', 'C', 'A', 'C', 'H', 'E' };
+const uint32_t MAP_CACHE_VERSION = 1;
+
+/**
+ * @brief Reads values from a memory mapped cache file, every read fails once the end of the file is reached
+ */
+class CacheReader
+{
+public:
+  CacheReader(const char* data, size_t size) : m_data(data), m_end(data + size)
+  {
+  }
+
+  bool read(void* value, size_t size)
+  {
+    if (size > static_cast<size_t>(m_end - m_data))
+    {
+      return false;
+    }
+    std::memcpy(value, m_data, size);
+    m_data += size;
+    return true;
+  }
+
+  template <typename T>
+  bool read(T& value)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "only plain values can be read");
+    return read(&value, sizeof(T));
+  }
+
+  template <typename T>
+  bool read(std::vector<T>& values)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "only plain values can be read");
+    uint64_t size;
+    if (!read(size) || size > static_cast<size_t>(m_end - m_data) / sizeof(T))
+    {
+      return false;
+    }
+    values.clear();
+    if (size == 0)
+    {
+      return true;
+    }
+    // some types of the map have no default constructor, the vector is filled with copies of the first value before
+    // all values are copied in one go
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type first;
+    std::memcpy(&first, m_data, sizeof(T));
+    values.assign(size, *reinterpret_cast<const T*>(&first));
+    return read(values.data(), size * sizeof(T));
+  }
+
+  bool read(std::string& value)
+  {
+    std::vector<char> chars;
+    if (!read(chars))
+    {
+      return false;
+    }
+    value.assign(chars.begin(), chars.end());
+    return true;
+  }
+
+private:
+  const char* m_data;
+  const char* m_end;
+};
+
+template <typename T>
+void write(std::ofstream& out, const T& value)
+{
+  static_assert(std::is_trivially_copyable<T>::value, "only plain values can be written");
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void write(std::ofstream& out, const std::vector<T>& values)
+{
+  static_assert(std::is_trivially_copyable<T>::value, "only plain values can be written");
+  write(out, static_cast<uint64_t>(values.size()));
+  out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+void write(std::ofstream& out, const std::string& value)
+{
+  write(out, std::vector<char>(value.begin(), value.end()));
+}
+
+/**
+ * @brief Checks the indices of the faces, chunks and clusters and the sizes of the vertex channels, a damaged cache
+ * must not make the renderer read outside of the vertex buffers
+ */
+bool isValid(const MapData& data)
+{
+  const size_t numVertices = data.geometry.vertices.size();
+  const size_t numFaces = data.geometry.faces.size();
+  for (const Face& face : data.geometry.faces)
+  {
+    for (uint32_t vertexId : face.vertexIndices)
+    {
+      if (vertexId >= numVertices)
+      {
+        return false;
+      }
+    }
+  }
+
+  for (const MeshChunk& chunk : data.chunks)
+  {
+    for (uint32_t vertexId : chunk.vertexIds)
+    {
+      if (vertexId >= numVertices)
+      {
+        return false;
+      }
+    }
+    for (uint32_t faceId : chunk.faceIds)
+    {
+      if (faceId >= numFaces)
+      {
+        return false;
+      }
+    }
+    for (uint32_t index : chunk.indices)
+    {
+      if (index >= chunk.vertexIds.size())
+      {
+        return false;
+      }
+    }
+  }
+
+  for (const Material& material : data.materials)
+  {
+    for (uint32_t faceId : material.faceIndices)
+    {
+      if (faceId >= numFaces)
+      {
+        return false;
+      }
+    }
+  }
+
+  for (const Cluster& cluster : data.clusters)
+  {
+    for (uint32_t faceId : cluster.faces)
+    {
+      if (faceId >= numFaces)
+      {
+        return false;
+      }
+    }
+  }
+
+  // the vertex channels are optional, but if present they are read for every vertex
+  auto matchesVertices = [numVertices](size_t size) { return size == 0 || size == numVertices; };
+  if (!matchesVertices(data.colors.size()) || !matchesVertices(data.normals.size()) ||
+      !matchesVertices(data.texCoords.size()))
+  {
+    return false;
+  }
+  for (const auto& costs : data.costs)
+  {
+    if (!matchesVertices(costs.second.size()))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+MapCache::MapCache(const std::string& mapFile) : m_mapFile(mapFile), m_mapSize(0), m_mapModified(0)
+{
+  struct stat mapStat;
+  if (stat(mapFile.c_str(), &mapStat) == 0)
+  {
+    m_mapSize = mapStat.st_size;
+    // the nanoseconds catch changes within the same second
+    m_mapModified = static_cast<int64_t>(mapStat.st_mtim.tv_sec) * 1000000000 + mapStat.st_mtim.tv_nsec;
+  }
+  m_path = mapFile + ".render_cache";
+}
+
+bool MapCache::load(MapData& data) const
+{
+  int fd = open(m_path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  struct stat cacheStat;
+  if (fstat(fd, &cacheStat) != 0 || cacheStat.st_size == 0)
+  {
+    close(fd);
+    return false;
+  }
+  const size_t size = cacheStat.st_size;
+  void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED)
+  {
+    return false;
+  }
+  // the file is read front to back exactly once
+  madvise(mapped, size, MADV_SEQUENTIAL);
+
+  CacheReader in(static_cast<const char*>(mapped), size);
+
+  char magic[sizeof(MAP_CACHE_MAGIC)];
+  uint32_t version;
+  std::string mapFile;
+  uint64_t mapSize;
+  int64_t mapModified;
+  bool valid = in.read(magic, sizeof(magic)) && std::memcmp(magic, MAP_CACHE_MAGIC, sizeof(magic)) == 0 &&
+               in.read(version) && version == MAP_CACHE_VERSION && in.read(mapFile) && mapFile == m_mapFile &&
+               in.read(mapSize) && mapSize == m_mapSize && in.read(mapModified) && mapModified == m_mapModified;
+
+  valid = valid && in.read(data.geometry.vertices) && in.read(data.geometry.faces);
+
+  uint64_t numChunks = 0;
+  valid = valid && in.read(numChunks) && numChunks <= data.geometry.faces.size();
+  if (valid)
+  {
+    data.chunks.resize(numChunks);
+  }
+  for (size_t i = 0; valid && i < numChunks; i++)
+  {
+    MeshChunk& chunk = data.chunks[i];
+    float bounds[6];
+    valid = in.read(chunk.vertexIds) && in.read(chunk.faceIds) && in.read(chunk.indices) && in.read(bounds);
+    if (valid)
+    {
+      chunk.bounds.setExtents(bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5]);
+    }
+  }
+
+  uint64_t numMaterials = 0;
+  valid = valid && in.read(numMaterials) && numMaterials <= size;
+  if (valid)
+  {
+    data.materials.resize(numMaterials);
+  }
+  for (size_t i = 0; valid && i < numMaterials; i++)
+  {
+    Material& material = data.materials[i];
+    int64_t textureIndex;
+    valid = in.read(textureIndex) && in.read(material.color) && in.read(material.faceIndices);
+    if (textureIndex >= 0)
+    {
+      material.textureIndex = static_cast<uint32_t>(textureIndex);
+    }
+  }
+
+  uint64_t numTextures = 0;
+  valid = valid && in.read(numTextures) && numTextures <= size;
+  if (valid)
+  {
+    data.textures.resize(numTextures);
+  }
+  for (size_t i = 0; valid && i < numTextures; i++)
+  {
+    Texture& texture = data.textures[i];
+    valid = in.read(texture.width) && in.read(texture.height) && in.read(texture.channels) &&
+            in.read(texture.pixelFormat) && in.read(texture.data);
+  }
+
+  valid = valid && in.read(data.colors) && in.read(data.normals) && in.read(data.texCoords);
+
+  uint64_t numClusters = 0;
+  valid = valid && in.read(numClusters) && numClusters <= size;
+  for (size_t i = 0; valid && i < numClusters; i++)
+  {
+    std::string name;
+    std::vector<uint32_t> faces;
+    valid = in.read(name) && in.read(faces);
+    data.clusters.push_back(Cluster(name, faces));
+  }
+
+  uint64_t numCosts = 0;
+  valid = valid && in.read(numCosts) && numCosts <= size;
+  for (size_t i = 0; valid && i < numCosts; i++)
+  {
+    std::string name;
+    valid = in.read(name) && in.read(data.costs[name]);
+  }
+
+  munmap(mapped, size);
+
+  return valid && isValid(data);
+}
+
+bool MapCache::save(const MapData& data) const
+{
+  // write to a unique temporary file first, so that concurrent rviz instances neither read a partial file nor
+  // write into the same file
+  std::string tmpPath = m_path + ".XXXXXX";
+  int fd = mkstemp(&tmpPath[0]);
+  if (fd < 0)
+  {
+    ROS_WARN("Could not write the map cache to %s.", m_path.c_str());
+    return false;
+  }
+  // mkstemp creates the file for its owner only, but the cache is shared like the map next to it
+  const mode_t mask = umask(0);
+  umask(mask);
+  fchmod(fd, 0644 & ~mask);
+  ::close(fd);
+
+  {
+    std::ofstream out(tmpPath, std::ios::binary);
+    out.write(MAP_CACHE_MAGIC, sizeof(MAP_CACHE_MAGIC));
+    write(out, MAP_CACHE_VERSION);
+    write(out, m_mapFile);
+    write(out, m_mapSize);
+    write(out, m_mapModified);
+
+    write(out, data.geometry.vertices);
+    write(out, data.geometry.faces);
+
+    write(out, static_cast<uint64_t>(data.chunks.size()));
+    for (const MeshChunk& chunk : data.chunks)
+    {
+      write(out, chunk.vertexIds);
+      write(out, chunk.faceIds);
+      write(out, chunk.indices);
+      const Ogre::Vector3& min = chunk.bounds.getMinimum();
+      const Ogre::Vector3& max = chunk.bounds.getMaximum();
+      const float bounds[6] = { min.x, min.y, min.z, max.x, max.y, max.z };
+      write(out, bounds);
+    }
+
+    write(out, static_cast<uint64_t>(data.materials.size()));
+    for (const Material& material : data.materials)
+    {
+      const int64_t textureIndex = material.textureIndex ? static_cast<int64_t>(*material.textureIndex) : -1;
+      write(out, textureIndex);
+      write(out, material.color);
+      write(out, material.faceIndices);
+    }
+
+    write(out, static_cast<uint64_t>(data.textures.size()));
+    for (const Texture& texture : data.textures)
+    {
+      write(out, texture.width);
+      write(out, texture.height);
+      write(out, texture.channels);
+      write(out, texture.pixelFormat);
+      write(out, texture.data);
+    }
+
+    write(out, data.colors);
+    write(out, data.normals);
+    write(out, data.texCoords);
+
+    write(out, static_cast<uint64_t>(data.clusters.size()));
+    for (const Cluster& cluster : data.clusters)
+    {
+      write(out, cluster.name);
+      write(out, cluster.faces);
+    }
+
+    write(out, static_cast<uint64_t>(data.costs.size()));
+    for (const auto& costs : data.costs)
+    {
+      write(out, costs.first);
+      write(out, costs.second);
+    }
+
+    if (!out)
+    {
+      ROS_WARN("Could not write the map cache to %s.", tmpPath.c_str());
+      std::remove(tmpPath.c_str());
+      return false;
+    }
+  }
+  if (std::rename(tmpPath.c_str(), m_path.c_str()) != 0)
+  {
+    ROS_WARN("Could not write the map cache to %s.", m_path.c_str());
+    std::remove(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace rviz_map_plugin
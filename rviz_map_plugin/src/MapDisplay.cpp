@@ -50,6 +50,8 @@
 #include <ClusterLabelVisual.hpp>
 #include <ClusterLabelTool.hpp>
 
+#include <exception>
+
 #include <rviz/properties/bool_property.h>
 #include <rviz/properties/color_property.h>
 #include <rviz/properties/float_property.h>
@@ -138,6 +140,11 @@ void MapDisplay::onDisable()
   m_meshDisplay->onDisable();
 }
 
+void MapDisplay::update(float wall_dt, float ros_dt)
+{
+  m_meshDisplay->update(wall_dt, ros_dt);
+}
+
 // =====================================================================================================================
 // Callbacks triggered from UI events (mostly)
 
@@ -151,7 +158,7 @@ void MapDisplay::updateMap()
     return;
 
   // Update sub-plugins
-  m_meshDisplay->setGeometry(m_geometry);
+  m_meshDisplay->setGeometry(m_geometry, m_chunks);
   m_meshDisplay->setVertexColors(m_colors);
   m_meshDisplay->setVertexNormals(m_normals);
   m_meshDisplay->clearVertexCosts();
@@ -199,133 +206,283 @@ bool MapDisplay::loadData()
   }
   ROS_INFO_STREAM("Map Display: Loading data for map '" << mapFile << "'");
 
-  try
+  // Warm starts read the converted data from the cache, which is only used while it belongs to the current map file
+  MapCache cache(mapFile);
+  MapData data;
+  ros::WallTime start = ros::WallTime::now();
+  if (cache.load(data))
   {
-    // Open file IO
-    hdf5_map_io::HDF5MapIO map_io(mapFile);
+    ROS_INFO_STREAM("Map Display: Loaded map from cache '" << cache.getPath() << "' in "
+                                                           << (ros::WallTime::now() - start).toSec() * 1000.0 << " ms");
+  }
+  else
+  {
+    // a failed load may have filled parts of the data already
+    data = MapData();
+    if (!loadMapFile(mapFile, data))
+    {
+      return false;
+    }
 
-    ROS_INFO("Map Display: Load geometry");
+    // a missing cache only costs the next start its speed up, failures are logged by the cache
+    cache.save(data);
+    ROS_INFO_STREAM("Map Display: Loaded map from file in " << (ros::WallTime::now() - start).toSec() * 1000.0
+                                                            << " ms");
+  }
 
-    // Read geometry
-    m_geometry = std::make_shared<Geometry>(Geometry(map_io.getVertices(), map_io.getFaceIds()));
+  m_geometry = std::make_shared<Geometry>(std::move(data.geometry));
+  m_chunks = std::make_shared<const vector<MeshChunk>>(std::move(data.chunks));
+  m_materials = std::move(data.materials);
+  m_textures = std::move(data.textures);
+  m_colors = std::move(data.colors);
+  m_normals = std::move(data.normals);
+  m_texCoords = std::move(data.texCoords);
+  m_clusterList = std::move(data.clusters);
+  m_costs = std::move(data.costs);
 
-    ROS_INFO("Map Display: Load textures");
+  setStatus(rviz::StatusProperty::Ok, "IO", "");
 
-    // Read textures
-    vector<hdf5_map_io::MapImage> textures = map_io.getTextures();
-    m_textures.resize(textures.size());
-    for (size_t i = 0; i < textures.size(); i++)
-    {
-      // Find out the texture index because textures are not stored in ascending order
-      int textureIndex = std::stoi(textures[i].name);
-
-      // Copy metadata
-      m_textures[textureIndex].width = textures[i].width;
-      m_textures[textureIndex].height = textures[i].height;
-      m_textures[textureIndex].channels = textures[i].channels;
-      m_textures[textureIndex].data = textures[i].data;
-      m_textures[textureIndex].pixelFormat = "rgb8";
-    }
+  ROS_INFO("Map Display: Successfully loaded map.");
 
-    ROS_INFO("Map Display: Load materials");
+  return true;
+}
 
-    // Read materials
-    vector<hdf5_map_io::MapMaterial> materials = map_io.getMaterials();
-    vector<uint32_t> faceToMaterialIndexArray = map_io.getMaterialFaceIndices();
-    m_materials.resize(materials.size());
-    for (size_t i = 0; i < materials.size(); i++)
+bool MapDisplay::loadMapFile(const std::string& mapFile, MapData& data)
+{
+  // Raw datasets, they are shared by the reading thread and the conversion tasks
+  vector<float> vertices;
+  vector<uint32_t> faceIds;
+  vector<hdf5_map_io::MapImage> textures;
+  vector<hdf5_map_io::MapMaterial> materials;
+  vector<uint32_t> faceToMaterialIndexArray;
+  vector<uint8_t> colors;
+  vector<float> normals;
+  vector<float> texCoords;
+
+  // Read and conversion time of each stage in ms, every slot is written by one thread only
+  enum Stage
+  {
+    GEOMETRY,
+    TEXTURES,
+    MATERIALS,
+    COLORS,
+    NORMALS,
+    TEXCOORDS,
+    CLUSTERS,
+    COSTS,
+    NUM_STAGES
+  };
+  const char* stageNames[NUM_STAGES] = { "geometry", "textures", "materials", "vertex colors",
+                                         "vertex normals", "texture coordinates", "clusters", "cost layers" };
+  double readTime[NUM_STAGES] = {};
+  double convertTime[NUM_STAGES] = {};
+
+  // The datasets are read one after another by a single thread, since the HDF5 library must not be used
+  // concurrently. Each dataset is converted by a task as soon as it has been read, while the next one is read.
+  // Exceptions must not leave the parallel region, the first one is rethrown after all tasks are done.
+  std::exception_ptr error;
+
+#pragma omp parallel
+#pragma omp single
+  {
+    try
     {
-      // Copy material color
-      m_materials[i].color.r = materials[i].r / 255.0f;
-      m_materials[i].color.g = materials[i].g / 255.0f;
-      m_materials[i].color.b = materials[i].b / 255.0f;
-      m_materials[i].color.a = 1.0f;
-
-      // Look for texture index
-      if (materials[i].textureIndex == -1)
+      // Open file IO
+      hdf5_map_io::HDF5MapIO map_io(mapFile);
+      ros::WallTime stageStart = ros::WallTime::now();
+
+      auto finishRead = [&](Stage stage) {
+        ros::WallTime now = ros::WallTime::now();
+        readTime[stage] = (now - stageStart).toSec() * 1000.0;
+        stageStart = now;
+      };
+
+      // Read geometry
+      vertices = map_io.getVertices();
+      faceIds = map_io.getFaceIds();
+      finishRead(GEOMETRY);
+
+#pragma omp task shared(data, vertices, faceIds, convertTime)
       {
-        // texture index -1: no texture
-        m_materials[i].textureIndex = boost::none;
+        ros::WallTime taskStart = ros::WallTime::now();
+        data.geometry.vertices.resize(vertices.size() / 3);
+        data.geometry.faces.resize(faceIds.size() / 3);
+#pragma omp taskloop grainsize(65536)
+        for (size_t i = 0; i < data.geometry.vertices.size(); i++)
+        {
+          data.geometry.vertices[i].x = vertices[i * 3 + 0];
+          data.geometry.vertices[i].y = vertices[i * 3 + 1];
+          data.geometry.vertices[i].z = vertices[i * 3 + 2];
+        }
+#pragma omp taskloop grainsize(65536)
+        for (size_t i = 0; i < data.geometry.faces.size(); i++)
+        {
+          data.geometry.faces[i].vertexIndices[0] = faceIds[i * 3 + 0];
+          data.geometry.faces[i].vertexIndices[1] = faceIds[i * 3 + 1];
+          data.geometry.faces[i].vertexIndices[2] = faceIds[i * 3 + 2];
+        }
+        convertTime[GEOMETRY] = (ros::WallTime::now() - taskStart).toSec() * 1000.0;
       }
-      else
+
+      // Read textures, they are only moved and converted right away
+      textures = map_io.getTextures();
+      data.textures.resize(textures.size());
+      for (size_t i = 0; i < textures.size(); i++)
       {
-        m_materials[i].textureIndex = materials[i].textureIndex;
+        // Find out the texture index because textures are not stored in ascending order
+        int textureIndex = std::stoi(textures[i].name);
+
+        // Copy metadata
+        data.textures[textureIndex].width = textures[i].width;
+        data.textures[textureIndex].height = textures[i].height;
+        data.textures[textureIndex].channels = textures[i].channels;
+        data.textures[textureIndex].data = std::move(textures[i].data);
+        data.textures[textureIndex].pixelFormat = "rgb8";
       }
+      finishRead(TEXTURES);
 
-      m_materials[i].faceIndices.clear();
-    }
-
-    // Copy face indices
-    for (size_t k = 0; k < faceToMaterialIndexArray.size(); k++)
-    {
-      m_materials[faceToMaterialIndexArray[k]].faceIndices.push_back(k);
-    }
+      // Read materials
+      materials = map_io.getMaterials();
+      faceToMaterialIndexArray = map_io.getMaterialFaceIndices();
+      finishRead(MATERIALS);
 
-    ROS_INFO("Map Display: Load vertex colors");
+#pragma omp task shared(data, materials, faceToMaterialIndexArray, convertTime)
+      {
+        ros::WallTime taskStart = ros::WallTime::now();
+        data.materials.resize(materials.size());
+        for (size_t i = 0; i < materials.size(); i++)
+        {
+          // Copy material color
+          data.materials[i].color.r = materials[i].r / 255.0f;
+          data.materials[i].color.g = materials[i].g / 255.0f;
+          data.materials[i].color.b = materials[i].b / 255.0f;
+          data.materials[i].color.a = 1.0f;
+
+          // Look for texture index
+          if (materials[i].textureIndex == -1)
+          {
+            // texture index -1: no texture
+            data.materials[i].textureIndex = boost::none;
+          }
+          else
+          {
+            data.materials[i].textureIndex = materials[i].textureIndex;
+          }
+        }
 
-    // Read vertex colors
-    vector<uint8_t> colors = map_io.getVertexColors();
-    m_colors.clear();
-    m_colors.reserve(colors.size() / 3);
-    for (size_t i = 0; i < colors.size(); i += 3)
-    {
-      // convert from 0-255 (uint8) to 0.0-1.0 (float)
-      m_colors.push_back(Color(colors[i + 0] / 255.0f, colors[i + 1] / 255.0f, colors[i + 2] / 255.0f, 1.0));
-    }
+        // Copy face indices
+        for (size_t k = 0; k < faceToMaterialIndexArray.size(); k++)
+        {
+          data.materials[faceToMaterialIndexArray[k]].faceIndices.push_back(k);
+        }
+        convertTime[MATERIALS] = (ros::WallTime::now() - taskStart).toSec() * 1000.0;
+      }
 
-    ROS_INFO("Map Display: Load vertex normals");
+      // Read vertex colors
+      colors = map_io.getVertexColors();
+      finishRead(COLORS);
 
-    // Read vertex normals
-    vector<float> normals = map_io.getVertexNormals();
-    m_normals.clear();
-    m_normals.reserve(normals.size() / 3);
-    for (size_t i = 0; i < normals.size(); i += 3)
-    {
-      m_normals.push_back(Normal(normals[i + 0], normals[i + 1], normals[i + 2]));
-    }
+#pragma omp task shared(data, colors, convertTime)
+      {
+        ros::WallTime taskStart = ros::WallTime::now();
+        data.colors.resize(colors.size() / 3);
+#pragma omp taskloop grainsize(65536)
+        for (size_t i = 0; i < data.colors.size(); i++)
+        {
+          // convert from 0-255 (uint8) to 0.0-1.0 (float)
+          data.colors[i] =
+              Color(colors[i * 3 + 0] / 255.0f, colors[i * 3 + 1] / 255.0f, colors[i * 3 + 2] / 255.0f, 1.0);
+        }
+        convertTime[COLORS] = (ros::WallTime::now() - taskStart).toSec() * 1000.0;
+      }
 
-    ROS_INFO("Map Display: Load texture coordinates");
+      // Read vertex normals
+      normals = map_io.getVertexNormals();
+      finishRead(NORMALS);
 
-    // Read tex cords
-    vector<float> texCoords = map_io.getVertexTextureCoords();
-    m_texCoords.clear();
-    m_texCoords.reserve(texCoords.size() / 3);
-    for (size_t i = 0; i < texCoords.size(); i += 3)
-    {
-      m_texCoords.push_back(TexCoords(texCoords[i], texCoords[i + 1]));
-    }
+#pragma omp task shared(data, normals, convertTime)
+      {
+        ros::WallTime taskStart = ros::WallTime::now();
+        data.normals.assign(normals.size() / 3, Normal(0.0f, 0.0f, 0.0f));
+#pragma omp taskloop grainsize(65536)
+        for (size_t i = 0; i < data.normals.size(); i++)
+        {
+          data.normals[i] = Normal(normals[i * 3 + 0], normals[i * 3 + 1], normals[i * 3 + 2]);
+        }
+        convertTime[NORMALS] = (ros::WallTime::now() - taskStart).toSec() * 1000.0;
+      }
 
-    ROS_INFO("Map Display: Load clusters");
+      // Read tex cords
+      texCoords = map_io.getVertexTextureCoords();
+      finishRead(TEXCOORDS);
 
-    // Read labels
-    m_clusterList.clear();
-    // m_clusterList.push_back(Cluster("__NEW__", vector<uint32_t>()));
-    for (auto labelGroup : map_io.getLabelGroups())
-    {
-      for (auto labelObj : map_io.getAllLabelsOfGroup(labelGroup))
+#pragma omp task shared(data, texCoords, convertTime)
       {
-        auto faceIds = map_io.getFaceIdsOfLabel(labelGroup, labelObj);
+        ros::WallTime taskStart = ros::WallTime::now();
+        data.texCoords.assign(texCoords.size() / 3, TexCoords(0.0f, 0.0f));
+#pragma omp taskloop grainsize(65536)
+        for (size_t i = 0; i < data.texCoords.size(); i++)
+        {
+          data.texCoords[i] = TexCoords(texCoords[i * 3], texCoords[i * 3 + 1]);
+        }
+        convertTime[TEXCOORDS] = (ros::WallTime::now() - taskStart).toSec() * 1000.0;
+      }
 
-        std::stringstream ss;
-        ss << labelGroup << "_" << labelObj;
-        std::string label = ss.str();
+      // Read labels, they are used as they are
+      // data.clusters.push_back(Cluster("__NEW__", vector<uint32_t>()));
+      for (auto labelGroup : map_io.getLabelGroups())
+      {
+        for (auto labelObj : map_io.getAllLabelsOfGroup(labelGroup))
+        {
+          std::stringstream ss;
+          ss << labelGroup << "_" << labelObj;
+          data.clusters.push_back(Cluster(ss.str(), map_io.getFaceIdsOfLabel(labelGroup, labelObj)));
+        }
+      }
+      finishRead(CLUSTERS);
 
-        m_clusterList.push_back(Cluster(label, faceIds));
+      for (std::string costlayer : map_io.getCostLayers())
+      {
+          try
+          {
+              // channels like the vertices are no cost layers, a cost layer has a value for each vertex
+              std::vector<float> costs = map_io.getVertexCosts(costlayer);
+              if (costs.size() == vertices.size() / 3)
+              {
+                data.costs[costlayer] = std::move(costs);
+              }
+          }
+          catch (const hf::DataSpaceException& e)
+          {
+              ROS_WARN_STREAM("Could not load channel " << costlayer << " as a costlayer!");
+          }
       }
+      finishRead(COSTS);
+    }
+    catch (...)
+    {
+      error = std::current_exception();
     }
+  }
 
-    m_costs.clear();
-    for (std::string costlayer : map_io.getCostLayers())
+  try
+  {
+    if (error)
     {
-        try
-        {
-            m_costs[costlayer] = map_io.getVertexCosts(costlayer);
-        }
-        catch (const hf::DataSpaceException& e)
-        {
-            ROS_WARN_STREAM("Could not load channel " << costlayer << " as a costlayer!");
-        }
+      std::rethrow_exception(error);
     }
+
+    for (int stage = 0; stage < NUM_STAGES; stage++)
+    {
+      ROS_INFO("Map Display: Loaded %s, read %.1f ms, convert %.1f ms", stageNames[stage], readTime[stage],
+               convertTime[stage]);
+    }
+
+    // the chunks are built after the parallel region, so that buildChunks can use all threads
+    ros::WallTime chunkStart = ros::WallTime::now();
+    data.chunks = *ChunkedMesh::buildChunks(data.geometry);
+    ROS_INFO("Map Display: Built %zu chunks in %.1f ms", data.chunks.size(),
+             (ros::WallTime::now() - chunkStart).toSec() * 1000.0);
   }
   catch (...)
   {
@@ -334,10 +491,6 @@ bool MapDisplay::loadData()
     return false;
   }
 
-  setStatus(rviz::StatusProperty::Ok, "IO", "");
-
-  ROS_INFO("Map Display: Successfully loaded map.");
-
   return true;
 }
 
@@ -66,6 +66,8 @@
 #include <rviz/properties/ros_topic_property.h>
 #include <rviz/properties/enum_property.h>
 #include <rviz/properties/string_property.h>
+#include <rviz/view_controller.h>
+#include <rviz/view_manager.h>
 
 namespace rviz_map_plugin
 {
@@ -194,6 +196,15 @@ MeshDisplay::MeshDisplay() : rviz::Display(), m_ignoreMsgs(false)
     m_scalingFactor = new rviz::FloatProperty("Normals Scaling Factor", 0.1, "Scaling factor of the normals",
                                               m_showNormals, SLOT(updateNormalsSize()), this);
   }
+
+  // Level of detail
+  {
+    m_lodErrorBudget = new rviz::FloatProperty("LOD Error Budget", 1.0,
+                                               "Maximum screen space error in pixels of the simplified parts of the "
+                                               "mesh. 0 always shows the full resolution.",
+                                               this);
+    m_lodErrorBudget->setMin(0);
+  }
 }
 
 MeshDisplay::~MeshDisplay()
@@ -255,6 +266,15 @@ void MeshDisplay::onDisable()
   std::queue<std::shared_ptr<MeshVisual>>().swap(m_visuals);
 }
 
+void MeshDisplay::update(float wall_dt, float ros_dt)
+{
+  std::shared_ptr<MeshVisual> visual = getLatestVisual();
+  if (visual)
+  {
+    visual->updateLod(context_->getViewManager()->getCurrent()->getCamera(), m_lodErrorBudget->getFloat());
+  }
+}
+
 void MeshDisplay::subscribe()
 {
   if (!isEnabled() || m_ignoreMsgs)
@@ -333,11 +353,19 @@ void MeshDisplay::ignoreIncomingMessages()
 // =====================================================================================================================
 // Data manipulators
 
-void MeshDisplay::setGeometry(shared_ptr<Geometry> geometry)
+void MeshDisplay::setGeometry(shared_ptr<Geometry> geometry, shared_ptr<const vector<MeshChunk>> chunks)
 {
   // Create the visual
   std::shared_ptr<MeshVisual> visual = addNewVisual();
-  visual->setGeometry(*geometry);
+  visual->setGeometry(*geometry, chunks);
+
+  // Build the AABB tree used by the pose tools for picking
+  static_assert(sizeof(Vertex) == 3 * sizeof(float), "Vertex has to consist of three floats");
+  static_assert(sizeof(Face) == 3 * sizeof(uint32_t), "Face has to consist of three vertex indices");
+  visual->setAABBTree(std::make_shared<hdf5_map_io::AABBTree>(
+      reinterpret_cast<const float*>(geometry->vertices.data()), geometry->vertices.size(),
+      reinterpret_cast<const uint32_t*>(geometry->faces.data()), geometry->faces.size()));
+
   if (isEnabled())
   {
     updateMesh();
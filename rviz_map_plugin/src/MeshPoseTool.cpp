@@ -56,6 +56,7 @@
 #include <rviz/display_context.h>
 
 #include "MeshPoseTool.hpp"
+#include "MeshVisual.hpp"
 
 namespace rviz_map_plugin
 {
@@ -169,129 +170,52 @@ bool MeshPoseTool::selectTriangle(rviz::ViewportMouseEvent& event, Ogre::Vector3
 
   Ogre::RaySceneQueryResult& result = query->execute();
 
-  for (size_t i = 0; i < result.size(); i++)
+  bool found = false;
+  for (size_t i = 0; i < result.size() && !found; i++)
   {
-    if (result[i].movable->getName().find("TriangleMesh") != std::string::npos)
+    // only the meshes of a MeshVisual carry an AABB tree
+    std::shared_ptr<hdf5_map_io::AABBTree> aabbTree = MeshVisual::getAABBTree(result[i].movable);
+    if (aabbTree)
     {
-      Ogre::ManualObject* mesh = static_cast<Ogre::ManualObject*>(result[i].movable);
-      size_t goal_section = -1;
-      size_t goal_index = -1;
-      Ogre::Real dist = -1;
-      if (getPositionAndOrientation(mesh, ray, position, triangle_normal))
-      {
-        return true;
-      }
+      found = getPositionAndOrientation(*aabbTree, result[i].movable->getParentNode(), ray, position, triangle_normal);
     }
   }
-  return false;
-}
-
-bool MeshPoseTool::getPositionAndOrientation(const Ogre::ManualObject* mesh, const Ogre::Ray& ray,
-                                             Ogre::Vector3& position, Ogre::Vector3& orientation)
-{
-  Ogre::Real dist = -1.0f;
-  Ogre::Vector3 a, b, c;
-
-  size_t vertex_count = 0;
-  Ogre::Vector3* vertices;
-  size_t index_count = 0;
-  unsigned long* indices;
-  size_t num_sections = mesh->getNumSections();
 
-  for (size_t i = 0; i < num_sections; i++)
-  {
-    getRawManualObjectData(mesh, i, vertex_count, vertices, index_count, indices);
-    if (index_count != 0)
-    {
-      for (size_t j = 0; j < index_count; j += 3)
-      {
-        std::pair<bool, Ogre::Real> goal = Ogre::Math::intersects(ray, vertices[indices[j]], vertices[indices[j + 1]],
-                                                                  vertices[indices[j + 2]], true, true);
-
-        if (goal.first)
-        {
-          if ((dist < 0.0f) || (goal.second < dist))
-          {
-            dist = goal.second;
-            a = vertices[indices[j]];
-            b = vertices[indices[j + 1]];
-            c = vertices[indices[j + 2]];
-          }
-        }
-      }
-    }
-  }
-
-  delete[] vertices;
-  delete[] indices;
-  if (dist != -1)
-  {
-    position = ray.getPoint(dist);
-    Ogre::Vector3 ab = b - a;
-    Ogre::Vector3 ac = c - a;
-    orientation = ac.crossProduct(ab).normalisedCopy();
-    return true;
-  }
-  else
-  {
-    return false;
-  }
+  context_->getSceneManager()->destroyQuery(query);
+  return found;
 }
 
-void MeshPoseTool::getRawManualObjectData(const Ogre::ManualObject* mesh, const size_t sectionNumber,
-                                          size_t& vertexCount, Ogre::Vector3*& vertices, size_t& indexCount,
-                                          unsigned long*& indices)
+bool MeshPoseTool::getPositionAndOrientation(const hdf5_map_io::AABBTree& aabbTree, const Ogre::Node* node,
+                                             const Ogre::Ray& ray, Ogre::Vector3& position,
+                                             Ogre::Vector3& orientation)
 {
-  Ogre::VertexData* vertexData;
-  const Ogre::VertexElement* vertexElement;
-  Ogre::HardwareVertexBufferSharedPtr vertexBuffer;
-  unsigned char* vertexChar;
-  float* vertexFloat;
+  const Ogre::Quaternion& nodeOrientation = node->_getDerivedOrientation();
+  const Ogre::Vector3& nodePosition = node->_getDerivedPosition();
+  const Ogre::Vector3& nodeScale = node->_getDerivedScale();
 
-  vertexData = mesh->getSection(sectionNumber)->getRenderOperation()->vertexData;
-  vertexElement = vertexData->vertexDeclaration->findElementBySemantic(Ogre::VES_POSITION);
-  vertexBuffer = vertexData->vertexBufferBinding->getBuffer(vertexElement->getSource());
-  vertexChar = static_cast<unsigned char*>(vertexBuffer->lock(Ogre::HardwareBuffer::HBL_READ_ONLY));
+  // transform the ray into the coordinate frame of the mesh, this preserves the ray parameter of the hit
+  Ogre::Quaternion inverseOrientation = nodeOrientation.Inverse();
+  Ogre::Vector3 origin = (inverseOrientation * (ray.getOrigin() - nodePosition)) / nodeScale;
+  Ogre::Vector3 direction = (inverseOrientation * ray.getDirection()) / nodeScale;
 
-  vertexCount = vertexData->vertexCount;
-  vertices = new Ogre::Vector3[vertexCount];
-
-  for (size_t i = 0; i < vertexCount; i++, vertexChar += vertexBuffer->getVertexSize())
+  hdf5_map_io::RayHit hit;
+  if (!aabbTree.intersectRay(origin.ptr(), direction.ptr(), hit))
   {
-    vertexElement->baseVertexPointerToElement(vertexChar, &vertexFloat);
-    vertices[i] =
-        (mesh->getParentNode()->_getDerivedOrientation() *
-         (Ogre::Vector3(vertexFloat[0], vertexFloat[1], vertexFloat[2]) * mesh->getParentNode()->_getDerivedScale())) +
-        mesh->getParentNode()->_getDerivedPosition();
+    return false;
   }
 
-  vertexBuffer->unlock();
-
-  Ogre::IndexData* indexData;
-  Ogre::HardwareIndexBufferSharedPtr indexBuffer;
-  indexData = mesh->getSection(sectionNumber)->getRenderOperation()->indexData;
-  indexCount = indexData->indexCount;
-  indices = new unsigned long[indexCount];
-  indexBuffer = indexData->indexBuffer;
-  unsigned int* pLong = static_cast<unsigned int*>(indexBuffer->lock(Ogre::HardwareBuffer::HBL_READ_ONLY));
-  unsigned short* pShort = reinterpret_cast<unsigned short*>(pLong);
+  position = ray.getPoint(hit.distance);
 
-  for (size_t i = 0; i < indexCount; i++)
-  {
-    unsigned long index;
-    if (indexBuffer->getType() == Ogre::HardwareIndexBuffer::IT_32BIT)
-    {
-      index = static_cast<unsigned long>(pLong[i]);
-    }
+  float vertexA[3], vertexB[3], vertexC[3];
+  aabbTree.getFaceVertices(hit.face, vertexA, vertexB, vertexC);
+  Ogre::Vector3 a = nodeOrientation * (Ogre::Vector3(vertexA) * nodeScale) + nodePosition;
+  Ogre::Vector3 b = nodeOrientation * (Ogre::Vector3(vertexB) * nodeScale) + nodePosition;
+  Ogre::Vector3 c = nodeOrientation * (Ogre::Vector3(vertexC) * nodeScale) + nodePosition;
 
-    else
-    {
-      index = static_cast<unsigned long>(pShort[i]);
-    }
-
-    indices[i] = index;
-  }
-  indexBuffer->unlock();
+  Ogre::Vector3 ab = b - a;
+  Ogre::Vector3 ac = c - a;
+  orientation = ac.crossProduct(ab).normalisedCopy();
+  return true;
 }
 
 }  // namespace rviz_map_plugin
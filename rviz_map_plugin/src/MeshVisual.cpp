@@ -58,11 +58,15 @@
 #include <OGRE/OgreHardwarePixelBuffer.h>
 #include <OGRE/OgrePixelFormat.h>
 
+#include <chrono>
 #include <limits>
 #include <stdint.h>
 
 namespace rviz_map_plugin
 {
+/// Key of the AABB tree in the user object bindings of the meshes
+static const Ogre::String AABB_TREE_BINDING = "AABBTree";
+
 Ogre::ColourValue getRainbowColor1(float value)
 {
   float r = 0.0f;
@@ -127,9 +131,7 @@ MeshVisual::MeshVisual(rviz::DisplayContext* context, size_t displayID, size_t m
   // create manual objects and attach them to the scene node
   std::stringstream sstm;
   sstm << m_prefix << "_TriangleMesh_" << m_postfix << "_" << m_random;
-  m_mesh = sceneManager->createManualObject(sstm.str());
-  m_mesh->setDynamic(false);
-  m_sceneNode->attachObject(m_mesh);
+  m_mesh.reset(new ChunkedMesh(sceneManager, m_sceneNode, sstm.str()));
 
   std::stringstream sstmNormals;
   sstmNormals << m_prefix << "_Normals_" << m_postfix << "_" << m_random;
@@ -151,9 +153,7 @@ MeshVisual::MeshVisual(rviz::DisplayContext* context, size_t displayID, size_t m
 
   std::stringstream sstmVertexCostsMesh;
   sstmVertexCostsMesh << m_prefix << "_VertexCostsMesh_" << m_postfix << "_" << m_random;
-  m_vertexCostsMesh = sceneManager->createManualObject(sstmVertexCostsMesh.str());
-  m_vertexCostsMesh->setDynamic(false);
-  m_sceneNode->attachObject(m_vertexCostsMesh);
+  m_vertexCostsMesh.reset(new ChunkedMesh(sceneManager, m_sceneNode, sstmVertexCostsMesh.str()));
 }
 
 MeshVisual::~MeshVisual()
@@ -162,9 +162,8 @@ MeshVisual::~MeshVisual()
 
   reset();
 
-  std::stringstream sstm;
-  sstm << m_prefix << "_TriangleMesh_" << m_postfix << "_" << m_random;
-  m_displayContext->getSceneManager()->destroyManualObject(sstm.str());
+  m_mesh.reset();
+  m_vertexCostsMesh.reset();
 
   std::stringstream sstmNormals;
   sstmNormals << m_prefix << "_Normals_" << m_postfix << "_" << m_random;
@@ -178,13 +177,7 @@ MeshVisual::~MeshVisual()
   sstmNoTexCluMesh << m_prefix << "_NoTexCluMesh_" << m_postfix << "_" << m_random;
   m_displayContext->getSceneManager()->destroyManualObject(sstmNoTexCluMesh.str());
 
-  std::stringstream sstmVertexCostsMesh;
-  sstmVertexCostsMesh << m_prefix << "_VertexCostsMesh_" << m_postfix << "_" << m_random;
-  m_displayContext->getSceneManager()->destroyManualObject(sstmVertexCostsMesh.str());
-
   m_displayContext->getSceneManager()->destroySceneNode(m_sceneNode);
-  sstm.str("");
-  sstm.flush();
 }
 
 void MeshVisual::reset()
@@ -237,6 +230,12 @@ void MeshVisual::reset()
   m_texturedMesh->clear();
   m_noTexCluMesh->clear();
   m_vertexCostsMesh->clear();
+  m_chunks.reset();
+  m_meshLodAttributes.clear();
+  m_vertexCostsLodAttributes.clear();
+  m_meshLodBuild.version++;
+  m_vertexCostsLodBuild.version++;
+  m_lodGeometry.reset();
   sstm.str("");
   sstm.flush();
 
@@ -472,25 +471,9 @@ void MeshVisual::enteringGeneralTriangleMesh(const Geometry& mesh)
 
   m_meshGeneralMaterial->getTechnique(0)->removeAllPasses();
 
-  // start entering data
-  m_mesh->clear();
-  m_mesh->begin(sstm.str(), Ogre::RenderOperation::OT_TRIANGLE_LIST);
-
-  // write vertices
-  for (size_t i = 0; i < mesh.vertices.size(); i++)
-  {
-    // write vertices
-    m_mesh->position(mesh.vertices[i].x, mesh.vertices[i].y, mesh.vertices[i].z);
-  }
-
-  // write triangles
-  for (size_t i = 0; i < mesh.faces.size(); i++)
-  {
-    m_mesh->triangle(mesh.faces[i].vertexIndices[0], mesh.faces[i].vertexIndices[1], mesh.faces[i].vertexIndices[2]);
-  }
-
-  // finish entering data
-  m_mesh->end();
+  // entering the chunks, each one is culled on its own
+  m_mesh->setMaterial(sstm.str());
+  m_mesh->setGeometry(mesh, m_chunks);
 }
 
 void MeshVisual::enteringColoredTriangleMesh(const Geometry& mesh, const vector<Color>& vertexColors)
@@ -506,29 +489,29 @@ void MeshVisual::enteringColoredTriangleMesh(const Geometry& mesh, const vector<
     m_meshGeneralMaterial->getTechnique(0)->removeAllPasses();
   }
 
-  // start entering data
-  m_mesh->clear();
-  m_mesh->begin(m_meshGeneralMaterial->getName(), Ogre::RenderOperation::OT_TRIANGLE_LIST);
-
-  // write vertices
-  // write vertex colors
-  for (size_t i = 0; i < mesh.vertices.size(); i++)
+  if (m_mesh->empty())
   {
-    // write vertices
-    m_mesh->position(mesh.vertices[i].x, mesh.vertices[i].y, mesh.vertices[i].z);
-
-    // write vertex colors
-    m_mesh->colour(vertexColors[i].r, vertexColors[i].g, vertexColors[i].b, vertexColors[i].a);
+    m_mesh->setMaterial(m_meshGeneralMaterial->getName());
+    m_mesh->setGeometry(mesh, m_chunks);
   }
 
-  // write triangles
-  for (size_t i = 0; i < mesh.faces.size(); i++)
+  // write vertex colors, the positions of the chunks are kept
+  std::vector<Ogre::ColourValue> colors(mesh.vertices.size());
+  m_meshLodAttributes.resize(mesh.vertices.size() * 4);
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < mesh.vertices.size(); i++)
   {
-    m_mesh->triangle(mesh.faces[i].vertexIndices[0], mesh.faces[i].vertexIndices[1], mesh.faces[i].vertexIndices[2]);
+    colors[i] = Ogre::ColourValue(vertexColors[i].r, vertexColors[i].g, vertexColors[i].b, vertexColors[i].a);
+    m_meshLodAttributes[i * 4 + 0] = vertexColors[i].r;
+    m_meshLodAttributes[i * 4 + 1] = vertexColors[i].g;
+    m_meshLodAttributes[i * 4 + 2] = vertexColors[i].b;
+    m_meshLodAttributes[i * 4 + 3] = vertexColors[i].a;
   }
+  m_mesh->setColors(colors);
 
-  // finish entering data
-  m_mesh->end();
+  // the simplified chunks are rebuilt with the color seams on the next update
+  m_mesh->setLods(nullptr);
+  m_meshLodBuild.version++;
 }
 
 void MeshVisual::enteringTriangleMeshWithVertexCosts(const Geometry& mesh, const vector<float>& vertexCosts,
@@ -570,40 +553,32 @@ void MeshVisual::enteringTriangleMeshWithVertexCosts(const Geometry& mesh, const
     pass->setCullingMode(Ogre::CULL_NONE);
     pass->setLightingEnabled(false);
 
-    // start entering data
-    m_vertexCostsMesh->clear();
-    m_vertexCostsMesh->begin(m_vertexCostMaterial->getName(), Ogre::RenderOperation::OT_TRIANGLE_LIST);
+    m_vertexCostsMesh->setMaterial(m_vertexCostMaterial->getName());
   }
-  else
+
+  // the simplified chunks preserve the cost seams of the first costs, updated costs only change the colors
+  bool createMesh = m_vertexCostsMesh->empty();
+  if (createMesh)
   {
-    // start updating data
-    m_vertexCostsMesh->beginUpdate(0);
+    m_vertexCostsMesh->setGeometry(mesh, m_chunks);
+    m_vertexCostsLodAttributes.resize(mesh.vertices.size());
   }
 
-  // write vertices
-  // write vertex colors
-  // write vertex normals(if enabled)
+  // write vertex colors that are calculated from the cost values, the positions of the chunks are kept
+  std::vector<Ogre::ColourValue> colors(mesh.vertices.size());
+#pragma omp parallel for schedule(static)
   for (size_t i = 0; i < mesh.vertices.size(); i++)
   {
-    // write vertices
-    m_vertexCostsMesh->position(mesh.vertices[i].x, mesh.vertices[i].y, mesh.vertices[i].z);
-
-    // write vertex colors that are calculated from the cost values
     float normalizedCost = (vertexCosts[i] - minCost) / range;
     normalizedCost = std::max(0.0f, normalizedCost);
     normalizedCost = std::min(1.0f, normalizedCost);
-    m_vertexCostsMesh->colour(calculateColorFromCost(normalizedCost, costColorType));
-  }
-
-  // write triangles
-  for (size_t i = 0; i < mesh.faces.size(); i++)
-  {
-    m_vertexCostsMesh->triangle(mesh.faces[i].vertexIndices[0], mesh.faces[i].vertexIndices[1],
-                                mesh.faces[i].vertexIndices[2]);
+    colors[i] = calculateColorFromCost(normalizedCost, costColorType);
+    if (createMesh)
+    {
+      m_vertexCostsLodAttributes[i] = normalizedCost;
+    }
   }
-
-  // finish entering data
-  m_vertexCostsMesh->end();
+  m_vertexCostsMesh->setColors(colors);
 }
 
 void MeshVisual::enteringTexturedTriangleMesh(const Geometry& mesh, const vector<Material>& materials,
@@ -758,7 +733,7 @@ void MeshVisual::enteringNormals(const Geometry& mesh, const vector<Normal>& nor
   m_normals->end();
 }
 
-bool MeshVisual::setGeometry(const Geometry& mesh)
+bool MeshVisual::setGeometry(const Geometry& mesh, std::shared_ptr<const std::vector<MeshChunk>> chunks)
 {
   reset();
 
@@ -784,13 +759,9 @@ bool MeshVisual::setGeometry(const Geometry& mesh)
     return false;
   }
 
-  // defines the buffer sizes
-  int vertex_count = mesh.vertices.size();
-  int index_count = mesh.faces.size() * 3;
-
-  // avoid memory reallocation
-  m_mesh->estimateVertexCount(vertex_count);
-  m_mesh->estimateIndexCount(index_count);
+  // split the mesh into spatially compact chunks, that are shared by the plain and the vertex costs mesh
+  m_chunks = chunks ? chunks : ChunkedMesh::buildChunks(mesh);
+  ROS_DEBUG("Split the mesh into %lu chunks.", m_chunks->size());
 
   // entering a general triangle mesh into the internal buffer
   enteringGeneralTriangleMesh(mesh);
@@ -798,6 +769,76 @@ bool MeshVisual::setGeometry(const Geometry& mesh)
   return true;
 }
 
+void MeshVisual::setAABBTree(std::shared_ptr<hdf5_map_io::AABBTree> aabbTree)
+{
+  m_mesh->setUserAny(AABB_TREE_BINDING, Ogre::Any(aabbTree));
+  m_vertexCostsMesh->setUserAny(AABB_TREE_BINDING, Ogre::Any(aabbTree));
+  for (Ogre::ManualObject* mesh : { m_texturedMesh, m_noTexCluMesh })
+  {
+    mesh->getUserObjectBindings().setUserAny(AABB_TREE_BINDING, Ogre::Any(aabbTree));
+  }
+}
+
+void MeshVisual::updateLod(const Ogre::Camera* camera, float maxPixelError)
+{
+  // building the simplified chunks is deferred until they are needed, so that colors and costs set right after
+  // the geometry do not cause several builds
+  if (maxPixelError > 0 && m_chunks)
+  {
+    updateLodBuild(*m_mesh, m_meshLodBuild, m_meshLodAttributes, 4);
+    updateLodBuild(*m_vertexCostsMesh, m_vertexCostsLodBuild, m_vertexCostsLodAttributes, 1);
+  }
+
+  m_mesh->updateLod(camera, maxPixelError);
+  m_vertexCostsMesh->updateLod(camera, maxPixelError);
+}
+
+void MeshVisual::updateLodBuild(ChunkedMesh& mesh, LodBuild& build, const std::vector<float>& attributes,
+                                size_t attributeDim)
+{
+  if (build.lods.valid())
+  {
+    // the render thread never waits for a build, the mesh is drawn in full resolution until it is done
+    if (build.lods.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+      return;
+    }
+    std::shared_ptr<const MeshChunkLods> lods = build.lods.get();
+    if (build.buildVersion == build.version)
+    {
+      mesh.setLods(lods);
+      return;
+    }
+  }
+
+  if (mesh.empty() || mesh.hasLods())
+  {
+    return;
+  }
+
+  // the build works on copies, since the geometry and the attributes may change while it runs
+  if (!m_lodGeometry)
+  {
+    m_lodGeometry = std::make_shared<const Geometry>(m_geometry);
+  }
+  std::shared_ptr<const Geometry> geometry = m_lodGeometry;
+  std::shared_ptr<const std::vector<MeshChunk>> chunks = m_chunks;
+  build.buildVersion = build.version;
+  build.lods = std::async(std::launch::async, [geometry, chunks, attributes, attributeDim]() {
+    return ChunkedMesh::buildLods(*geometry, *chunks, attributes, attributeDim);
+  });
+}
+
+std::shared_ptr<hdf5_map_io::AABBTree> MeshVisual::getAABBTree(Ogre::MovableObject* object)
+{
+  const Ogre::Any& binding = object->getUserObjectBindings().getUserAny(AABB_TREE_BINDING);
+  if (binding.isEmpty())
+  {
+    return nullptr;
+  }
+  return Ogre::any_cast<std::shared_ptr<hdf5_map_io::AABBTree>>(binding);
+}
+
 bool MeshVisual::setNormals(const vector<Normal>& normals)
 {
   // vertex normals
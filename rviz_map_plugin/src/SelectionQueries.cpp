@@ -0,0 +1,225 @@
+/*
+ *  Software License Agreement (BSD License)
+ *
+ *  Robot Operating System code by the University of Osnabrück
+ *  Copyright (c) 2015, University of Osnabrück
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ *  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ *  SelectionQueries.cpp
+ *
+ */
+
+#include <SelectionQueries.hpp>
+
+#include <limits>
+
+namespace rviz_map_plugin
+{
+namespace
+{
+inline void cross(const float* a, const float* b, float* result)
+{
+  result[0] = a[1] * b[2] - a[2] * b[1];
+  result[1] = a[2] * b[0] - a[0] * b[2];
+  result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+inline float dot(const float* a, const float* b)
+{
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+/**
+ * @brief Writes all faces with at least one flagged vertex to hitFaces
+ */
+void collectFacesOfHitVertices(const Geometry& geometry, const std::vector<uint8_t>& vertexHits,
+                               std::vector<uint32_t>& hitFaces)
+{
+  const std::vector<Face>& faces = geometry.faces;
+  const uint8_t* hits = vertexHits.data();
+
+#pragma omp parallel
+  {
+    std::vector<uint32_t> threadHits;
+
+#pragma omp for schedule(static) nowait
+    for (size_t faceId = 0; faceId < faces.size(); faceId++)
+    {
+      const Face& face = faces[faceId];
+      if (hits[face.vertexIndices[0]] | hits[face.vertexIndices[1]] | hits[face.vertexIndices[2]])
+      {
+        threadHits.push_back(faceId);
+      }
+    }
+
+#pragma omp critical
+    hitFaces.insert(hitFaces.end(), threadHits.begin(), threadHits.end());
+  }
+}
+
+}  // namespace
+
+boost::optional<std::pair<uint32_t, float>> castRay(const Geometry& geometry, const std::array<float, 6>& ray)
+{
+  const std::vector<Vertex>& vertices = geometry.vertices;
+  const std::vector<Face>& faces = geometry.faces;
+  const float* origin = ray.data();
+  const float* direction = ray.data() + 3;
+  const float EPSILON = 0.0000001;
+
+  float closestDistance = std::numeric_limits<float>::infinity();
+  uint32_t closestFace = std::numeric_limits<uint32_t>::max();
+
+#pragma omp parallel
+  {
+    float threadDistance = std::numeric_limits<float>::infinity();
+    uint32_t threadFace = std::numeric_limits<uint32_t>::max();
+
+#pragma omp for schedule(static) nowait
+    for (size_t faceId = 0; faceId < faces.size(); faceId++)
+    {
+      // Möller–Trumbore intersection, the same test as in the cast_rays kernel
+      const Vertex& v0 = vertices[faces[faceId].vertexIndices[0]];
+      const Vertex& v1 = vertices[faces[faceId].vertexIndices[1]];
+      const Vertex& v2 = vertices[faces[faceId].vertexIndices[2]];
+
+      float edge1[3] = { v1.x - v0.x, v1.y - v0.y, v1.z - v0.z };
+      float edge2[3] = { v2.x - v0.x, v2.y - v0.y, v2.z - v0.z };
+      float h[3];
+      cross(direction, edge2, h);
+      float a = dot(edge1, h);
+      if (a > -EPSILON && a < EPSILON)
+      {
+        continue;
+      }
+
+      float f = 1 / a;
+      float s[3] = { origin[0] - v0.x, origin[1] - v0.y, origin[2] - v0.z };
+      float u = f * dot(s, h);
+      if (u < 0.0 || u > 1.0)
+      {
+        continue;
+      }
+
+      float q[3];
+      cross(s, edge1, q);
+      float v = f * dot(direction, q);
+      if (v < 0.0 || u + v > 1.0)
+      {
+        continue;
+      }
+
+      // faces are visited in ascending order per thread, so ties keep the smaller face id
+      float t = f * dot(edge2, q);
+      if (t > EPSILON && t < threadDistance)
+      {
+        threadDistance = t;
+        threadFace = faceId;
+      }
+    }
+
+#pragma omp critical
+    {
+      if (threadDistance < closestDistance || (threadDistance == closestDistance && threadFace < closestFace))
+      {
+        closestDistance = threadDistance;
+        closestFace = threadFace;
+      }
+    }
+  }
+
+  if (closestFace != std::numeric_limits<uint32_t>::max())
+  {
+    return std::make_pair(closestFace, closestDistance);
+  }
+  else
+  {
+    return {};
+  }
+}
+
+void castSphere(const Geometry& geometry, const std::array<float, 3>& center, float radius,
+                std::vector<uint8_t>& vertexHits, std::vector<uint32_t>& hitFaces)
+{
+  const std::vector<Vertex>& vertices = geometry.vertices;
+  const float centerX = center[0];
+  const float centerY = center[1];
+  const float centerZ = center[2];
+  const float squaredRadius = radius * radius;
+
+  // a face is hit if one of its vertices is inside, so every vertex is tested only once instead of once per face
+  vertexHits.resize(vertices.size());
+  uint8_t* hits = vertexHits.data();
+
+#pragma omp parallel for simd schedule(static)
+  for (size_t i = 0; i < vertices.size(); i++)
+  {
+    float dx = vertices[i].x - centerX;
+    float dy = vertices[i].y - centerY;
+    float dz = vertices[i].z - centerZ;
+    hits[i] = dx * dx + dy * dy + dz * dz <= squaredRadius;
+  }
+
+  hitFaces.clear();
+  collectFacesOfHitVertices(geometry, vertexHits, hitFaces);
+}
+
+void castBox(const Geometry& geometry, const float* planes, std::vector<uint8_t>& vertexHits,
+             std::vector<uint32_t>& hitFaces)
+{
+  const std::vector<Vertex>& vertices = geometry.vertices;
+
+  // a face is hit if one of its vertices is inside, so every vertex is tested only once instead of once per face
+  vertexHits.resize(vertices.size());
+  uint8_t* hits = vertexHits.data();
+
+#pragma omp parallel for simd schedule(static)
+  for (size_t i = 0; i < vertices.size(); i++)
+  {
+    bool inVolume = true;
+    for (int planeId = 0; planeId < 6; planeId++)
+    {
+      const float* plane = planes + planeId * 4;
+      inVolume = inVolume &&
+                 plane[0] * vertices[i].x + plane[1] * vertices[i].y + plane[2] * vertices[i].z + plane[3] > 0;
+    }
+    hits[i] = inVolume;
+  }
+
+  hitFaces.clear();
+  collectFacesOfHitVertices(geometry, vertexHits, hitFaces);
+}
+
+}  // End namespace rviz_map_plugin
@@ -0,0 +1,283 @@
+/*
+ *  Software License Agreement (BSD License)
+ *
+ *  Robot Operating System code by the University of Osnabrück
+ *  Copyright (c) 2015, University of Osnabrück
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ *  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ *  fly_through_benchmark.cpp
+ *
+ *  Measures the frame time of the chunked mesh of the MeshVisual while the camera flies through a synthetic grid
+ *  mesh, once with the whole mesh in a single chunk, as it was rendered before it was split, and once split into
+ *  chunks which are culled by Ogre. With a pixel error, the levels of detail of the chunks are used as well. The frames
+ *  are rendered into a window without vertical sync, so an X display is needed.
+ *
+ *  usage: fly_through_benchmark [grid size] [frames] [max pixel error]
+ *
+ */
+
+#include <ChunkedMesh.hpp>
+#include <Types.hpp>
+
+#include <rviz/ogre_helpers/render_system.h>
+
+#include <OGRE/OgreCamera.h>
+#include <OGRE/OgreMaterialManager.h>
+#include <OGRE/OgreRenderWindow.h>
+#include <OGRE/OgreRoot.h>
+#include <OGRE/OgreSceneManager.h>
+#include <OGRE/OgreSceneNode.h>
+#include <OGRE/OgreTechnique.h>
+#include <OGRE/OgreViewport.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace rviz_map_plugin;
+
+namespace
+{
+/// Edge length of the cells of the grid mesh
+const float CELL_SIZE = 0.1;
+
+/// Height of the camera above the mesh
+const float CAMERA_HEIGHT = 2.0;
+
+/// The view distance, about the one of a robot scale scene in rviz
+const float FAR_CLIP_DISTANCE = 50.0;
+
+/// Size of the window the frames are rendered into
+const unsigned int WINDOW_WIDTH = 1280;
+const unsigned int WINDOW_HEIGHT = 720;
+
+/// Frames rendered before the measurement, to upload the buffers and warm up the driver
+const size_t WARM_UP_FRAMES = 20;
+
+/**
+ * @brief Frame times of one run
+ */
+struct FrameStats
+{
+  double meanMs;
+  double p95Ms;
+  double maxMs;
+  double meanTriangles;
+  double meanBatches;
+};
+
+/**
+ * @brief Creates a hilly grid mesh of size x size cells with two faces each
+ */
+Geometry createGridMesh(uint32_t size)
+{
+  Geometry geometry;
+  for (uint32_t y = 0; y <= size; y++)
+  {
+    for (uint32_t x = 0; x <= size; x++)
+    {
+      float px = x * CELL_SIZE;
+      float py = y * CELL_SIZE;
+      geometry.vertices.push_back({ px, py, std::sin(0.2f * px) * std::cos(0.3f * py) });
+    }
+  }
+
+  for (uint32_t y = 0; y < size; y++)
+  {
+    for (uint32_t x = 0; x < size; x++)
+    {
+      uint32_t v0 = y * (size + 1) + x;
+      uint32_t v1 = v0 + 1;
+      uint32_t v2 = v0 + size + 1;
+      uint32_t v3 = v2 + 1;
+      geometry.faces.push_back({ { v0, v1, v3 } });
+      geometry.faces.push_back({ { v0, v3, v2 } });
+    }
+  }
+  return geometry;
+}
+
+/**
+ * @brief Flies the camera along a loop over the mesh and renders a frame at each step
+ *
+ * The camera looks ahead and slightly down, like a user following a robot, so most of the mesh is behind the
+ * camera or beyond the far clip distance.
+ */
+FrameStats flyThrough(Ogre::Root* root, Ogre::RenderWindow* window, Ogre::Camera* camera, ChunkedMesh& mesh,
+                      float extent, size_t frames, float maxPixelError)
+{
+  const Ogre::Vector3 center(extent / 2, extent / 2, 0);
+  const float radius = 0.35 * extent;
+
+  std::vector<double> frameTimes;
+  double triangles = 0;
+  double batches = 0;
+  for (size_t frame = 0; frame < WARM_UP_FRAMES + frames; frame++)
+  {
+    const float angle = 2 * M_PI * frame / (WARM_UP_FRAMES + frames);
+    const Ogre::Vector3 position = center + Ogre::Vector3(radius * std::cos(angle), radius * std::sin(angle), 0);
+    const Ogre::Vector3 direction(-std::sin(angle), std::cos(angle), -0.3);
+
+    auto start = std::chrono::steady_clock::now();
+    camera->setPosition(position + Ogre::Vector3(0, 0, CAMERA_HEIGHT));
+    camera->setDirection(direction);
+    mesh.updateLod(camera, maxPixelError);
+    root->renderOneFrame();
+    auto end = std::chrono::steady_clock::now();
+
+    if (frame >= WARM_UP_FRAMES)
+    {
+      frameTimes.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+      triangles += window->getTriangleCount();
+      batches += window->getBatchCount();
+    }
+  }
+
+  FrameStats stats;
+  stats.meanMs = 0;
+  for (double frameTime : frameTimes)
+  {
+    stats.meanMs += frameTime;
+  }
+  stats.meanMs /= std::max<size_t>(frames, 1);
+  std::sort(frameTimes.begin(), frameTimes.end());
+  stats.p95Ms = frameTimes.empty() ? 0 : frameTimes[std::min(frameTimes.size() - 1, frameTimes.size() * 95 / 100)];
+  stats.maxMs = frameTimes.empty() ? 0 : frameTimes.back();
+  stats.meanTriangles = triangles / std::max<size_t>(frames, 1);
+  stats.meanBatches = batches / std::max<size_t>(frames, 1);
+  return stats;
+}
+
+void printStats(const std::string& name, const FrameStats& stats)
+{
+  std::cout << name << ": mean " << stats.meanMs << " ms, 95% " << stats.p95Ms << " ms, max " << stats.maxMs
+            << " ms per frame, " << stats.meanTriangles << " triangles in " << stats.meanBatches << " batches"
+            << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  if (argc > 4)
+  {
+    std::cerr << "usage: " << argv[0] << " [grid size] [frames] [max pixel error]" << std::endl
+              << "  measures the frame time while flying through a grid mesh with 2 * size^2 faces, a pixel error"
+              << " greater than zero also uses the levels of detail" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const uint32_t gridSize = argc > 1 ? std::stoul(argv[1]) : 2000;
+  const size_t numFrames = argc > 2 ? std::stoul(argv[2]) : 500;
+  const float maxPixelError = argc > 3 ? std::stof(argv[3]) : 0;
+
+  Geometry geometry = createGridMesh(gridSize);
+  const float extent = gridSize * CELL_SIZE;
+  std::cout << "Grid mesh with " << geometry.vertices.size() << " vertices and " << geometry.faces.size()
+            << " faces, " << numFrames << " frames" << std::endl;
+
+  // the render system sets up Ogre with the plugins and the settings of rviz
+  Ogre::Root* root = rviz::RenderSystem::get()->root();
+
+  Ogre::NameValuePairList windowParams;
+  windowParams["vsync"] = "false";
+  Ogre::RenderWindow* window =
+      root->createRenderWindow("fly_through_benchmark", WINDOW_WIDTH, WINDOW_HEIGHT, false, &windowParams);
+
+  Ogre::SceneManager* sceneManager = root->createSceneManager(Ogre::ST_GENERIC);
+  Ogre::Camera* camera = sceneManager->createCamera("fly_through_camera");
+  camera->setNearClipDistance(0.1);
+  camera->setFarClipDistance(FAR_CLIP_DISTANCE);
+  camera->setFixedYawAxis(true, Ogre::Vector3::UNIT_Z);
+  Ogre::Viewport* viewport = window->addViewport(camera);
+  viewport->setBackgroundColour(Ogre::ColourValue::Black);
+  camera->setAspectRatio(static_cast<float>(WINDOW_WIDTH) / WINDOW_HEIGHT);
+
+  Ogre::MaterialPtr material = Ogre::MaterialManager::getSingleton().create("fly_through_material", "General");
+  material->getTechnique(0)->setLightingEnabled(false);
+  material->getTechnique(0)->getPass(0)->setAmbient(Ogre::ColourValue(0.8, 0.8, 0.8));
+
+  Ogre::SceneNode* sceneNode = sceneManager->getRootSceneNode()->createChildSceneNode();
+
+  {
+    // the whole mesh in one chunk, which can never be culled
+    auto start = std::chrono::steady_clock::now();
+    auto singleChunk = ChunkedMesh::buildChunks(geometry, geometry.faces.size());
+    ChunkedMesh mesh(sceneManager, sceneNode, "fly_through_single");
+    mesh.setGeometry(geometry, singleChunk);
+    mesh.setMaterial(material->getName());
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "Uploaded the mesh as one chunk in " << std::chrono::duration<double, std::milli>(end - start).count()
+              << " ms" << std::endl;
+
+    printStats("Single chunk", flyThrough(root, window, camera, mesh, extent, numFrames, 0));
+  }
+
+  {
+    auto start = std::chrono::steady_clock::now();
+    auto chunks = ChunkedMesh::buildChunks(geometry);
+    ChunkedMesh mesh(sceneManager, sceneNode, "fly_through_chunked");
+    mesh.setGeometry(geometry, chunks);
+    mesh.setMaterial(material->getName());
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "Built and uploaded " << chunks->size() << " chunks in "
+              << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+
+    printStats("Chunked", flyThrough(root, window, camera, mesh, extent, numFrames, 0));
+
+    if (maxPixelError > 0)
+    {
+      start = std::chrono::steady_clock::now();
+      mesh.setLods(ChunkedMesh::buildLods(geometry, *chunks));
+      end = std::chrono::steady_clock::now();
+      std::cout << "Built the levels of detail in " << std::chrono::duration<double, std::milli>(end - start).count()
+                << " ms" << std::endl;
+
+      printStats("Chunked with levels of detail",
+                 flyThrough(root, window, camera, mesh, extent, numFrames, maxPixelError));
+    }
+  }
+
+  sceneManager->destroySceneNode(sceneNode);
+  root->destroySceneManager(sceneManager);
+  root->detachRenderTarget(window);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,465 @@
+/*
+ *  Software License Agreement (BSD License)
+ *
+ *  Robot Operating System code by the University of Osnabrück
+ *  Copyright (c) 2015, University of Osnabrück
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ *  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ *  selection_benchmark.cpp
+ *
+ *  Compares the CPU implementation of the selection queries of the ClusterLabelTool with the OpenCL kernels on a
+ *  synthetic grid mesh. Both are run with the same rays, spheres and boxes, the times include the transfers the tool
+ *  does per query and the results of both are checked for agreement.
+ *
+ *  usage: selection_benchmark [grid size] [queries] [kernel file]
+ *
+ */
+
+#define CL_HPP_TARGET_OPENCL_VERSION 120
+#define CL_HPP_MINIMUM_OPENCL_VERSION 110
+#define CL_HPP_ENABLE_EXCEPTIONS
+
+#include <CL/cl2.hpp>
+#include <CLUtil.hpp>
+#include <SelectionQueries.hpp>
+#include <Types.hpp>
+
+#include <ros/package.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace rviz_map_plugin;
+
+namespace
+{
+/// Edge length of the cells of the grid mesh
+const float CELL_SIZE = 0.05;
+
+/// Radius of the sphere queries, about the default of the tool
+const float SPHERE_RADIUS = 0.5;
+
+/// Half of the extent of the box queries in the xy plane
+const float BOX_HALF_SIZE = 1.0;
+
+/**
+ * @brief Results of all queries of one implementation
+ */
+struct Results
+{
+  std::vector<uint32_t> rayFaces;
+  std::vector<std::vector<uint32_t>> sphereFaces;
+  std::vector<std::vector<uint32_t>> boxFaces;
+};
+
+/**
+ * @brief Creates a wavy grid mesh of size x size cells with two faces each
+ */
+Geometry createGridMesh(uint32_t size)
+{
+  Geometry geometry;
+  for (uint32_t y = 0; y <= size; y++)
+  {
+    for (uint32_t x = 0; x <= size; x++)
+    {
+      float px = x * CELL_SIZE;
+      float py = y * CELL_SIZE;
+      geometry.vertices.push_back({ px, py, 0.2f * std::sin(px) * std::cos(py) });
+    }
+  }
+
+  for (uint32_t y = 0; y < size; y++)
+  {
+    for (uint32_t x = 0; x < size; x++)
+    {
+      uint32_t v0 = y * (size + 1) + x;
+      uint32_t v1 = v0 + 1;
+      uint32_t v2 = v0 + size + 1;
+      uint32_t v3 = v2 + 1;
+      geometry.faces.push_back({ { v0, v1, v3 } });
+      geometry.faces.push_back({ { v0, v3, v2 } });
+    }
+  }
+  return geometry;
+}
+
+/**
+ * @brief Returns the six planes of an axis aligned box in the layout of the box queries
+ */
+std::array<float, 4 * 6> createBox(float x, float y)
+{
+  // x > x - h, x < x + h, y > y - h, y < y + h, z > -1, z < 1
+  return { 1, 0,  0, -(x - BOX_HALF_SIZE),  //
+           -1, 0, 0, x + BOX_HALF_SIZE,     //
+           0, 1,  0, -(y - BOX_HALF_SIZE),  //
+           0, -1, 0, y + BOX_HALF_SIZE,     //
+           0, 0,  1, 1,                     //
+           0, 0,  -1, 1 };
+}
+
+/**
+ * @brief Runs func count times and returns the mean time per run in microseconds
+ */
+double measure(size_t count, const std::function<void(size_t)>& func)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < count; i++)
+  {
+    func(i);
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() / std::max<size_t>(count, 1);
+}
+
+/**
+ * @brief Counts the queries whose hit faces differ between both implementations
+ */
+size_t countMismatches(std::vector<std::vector<uint32_t>>& a, std::vector<std::vector<uint32_t>>& b)
+{
+  size_t mismatches = 0;
+  for (size_t i = 0; i < a.size(); i++)
+  {
+    std::sort(a[i].begin(), a[i].end());
+    std::sort(b[i].begin(), b[i].end());
+    mismatches += a[i] != b[i];
+  }
+  return mismatches;
+}
+
+/**
+ * @brief The selection kernels set up like in the ClusterLabelTool
+ */
+class CLSelection
+{
+public:
+  CLSelection(const Geometry& geometry, const std::string& source)
+  {
+    // preferably the first GPU, otherwise the first device of any type
+    std::vector<cl::Platform> platforms;
+    cl::Platform::get(&platforms);
+    std::vector<cl::Device> devices;
+    for (const cl::Platform& platform : platforms)
+    {
+      std::vector<cl::Device> platformDevices;
+      platform.getDevices(CL_DEVICE_TYPE_ALL, &platformDevices);
+      devices.insert(devices.end(), platformDevices.begin(), platformDevices.end());
+    }
+    if (devices.empty())
+    {
+      throw cl::Error(CL_DEVICE_NOT_FOUND, "clGetDeviceIDs");
+    }
+    m_device = devices[0];
+    for (const cl::Device& device : devices)
+    {
+      if (device.getInfo<CL_DEVICE_TYPE>() == CL_DEVICE_TYPE_GPU)
+      {
+        m_device = device;
+        break;
+      }
+    }
+    std::cout << "Using device " << m_device.getInfo<CL_DEVICE_NAME>() << std::endl;
+
+    m_context = cl::Context(m_device);
+    m_queue = cl::CommandQueue(m_context, m_device, 0);
+
+    cl::Program program(m_context, source);
+    try
+    {
+      program.build({ m_device });
+    }
+    catch (cl::Error err)
+    {
+      std::cerr << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(m_device) << std::endl;
+      throw;
+    }
+
+    m_kernelRay = cl::Kernel(program, "cast_rays");
+    m_kernelReduce = cl::Kernel(program, "reduce_closest");
+    m_kernelSphere = cl::Kernel(program, "cast_sphere");
+    m_kernelBox = cl::Kernel(program, "cast_box");
+
+    // the reductions in the kernels need a work group size that is a power of two
+    size_t maxWorkGroupSize = std::min<size_t>(256, m_device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>());
+    for (cl::Kernel* kernel : { &m_kernelRay, &m_kernelReduce, &m_kernelSphere, &m_kernelBox })
+    {
+      maxWorkGroupSize = std::min(maxWorkGroupSize, kernel->getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(m_device));
+    }
+    while (m_workGroupSize * 2 <= maxWorkGroupSize)
+    {
+      m_workGroupSize *= 2;
+    }
+
+    cl_uint numFaces = geometry.faces.size();
+    m_numGroups = (numFaces + m_workGroupSize - 1) / m_workGroupSize;
+
+    cl::Buffer vertexBuffer(m_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                            sizeof(Vertex) * geometry.vertices.size(), const_cast<Vertex*>(geometry.vertices.data()));
+    cl::Buffer faceBuffer(m_context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(Face) * numFaces,
+                          const_cast<Face*>(geometry.faces.data()));
+    cl::Buffer groupDistanceBuffer(m_context, CL_MEM_READ_WRITE, sizeof(float) * m_numGroups);
+    cl::Buffer groupFaceBuffer(m_context, CL_MEM_READ_WRITE, sizeof(cl_uint) * m_numGroups);
+    m_closestHitBuffer = cl::Buffer(m_context, CL_MEM_WRITE_ONLY, sizeof(ClosestHit));
+    m_hitFaceBuffer = cl::Buffer(m_context, CL_MEM_WRITE_ONLY, sizeof(cl_uint) * numFaces);
+    m_hitCountBuffer = cl::Buffer(m_context, CL_MEM_READ_WRITE, sizeof(cl_uint));
+    m_rayBuffer = cl::Buffer(m_context, CL_MEM_READ_ONLY, sizeof(float) * 6);
+    m_sphereBuffer = cl::Buffer(m_context, CL_MEM_READ_ONLY, sizeof(float) * 4);
+    m_boxBuffer = cl::Buffer(m_context, CL_MEM_READ_ONLY, sizeof(float) * 4 * 6);
+
+    m_kernelRay.setArg(0, vertexBuffer);
+    m_kernelRay.setArg(1, faceBuffer);
+    m_kernelRay.setArg(2, numFaces);
+    m_kernelRay.setArg(3, m_rayBuffer);
+    m_kernelRay.setArg(4, groupDistanceBuffer);
+    m_kernelRay.setArg(5, groupFaceBuffer);
+    m_kernelRay.setArg(6, cl::Local(sizeof(float) * m_workGroupSize));
+    m_kernelRay.setArg(7, cl::Local(sizeof(cl_uint) * m_workGroupSize));
+
+    m_kernelReduce.setArg(0, groupDistanceBuffer);
+    m_kernelReduce.setArg(1, groupFaceBuffer);
+    m_kernelReduce.setArg(2, static_cast<cl_uint>(m_numGroups));
+    m_kernelReduce.setArg(3, m_closestHitBuffer);
+    m_kernelReduce.setArg(4, cl::Local(sizeof(float) * m_workGroupSize));
+    m_kernelReduce.setArg(5, cl::Local(sizeof(cl_uint) * m_workGroupSize));
+
+    m_kernelSphere.setArg(0, vertexBuffer);
+    m_kernelSphere.setArg(1, faceBuffer);
+    m_kernelSphere.setArg(2, numFaces);
+    m_kernelSphere.setArg(3, m_sphereBuffer);
+    m_kernelSphere.setArg(5, m_hitFaceBuffer);
+    m_kernelSphere.setArg(6, m_hitCountBuffer);
+
+    m_kernelBox.setArg(0, vertexBuffer);
+    m_kernelBox.setArg(1, faceBuffer);
+    m_kernelBox.setArg(2, numFaces);
+    m_kernelBox.setArg(3, m_boxBuffer);
+    m_kernelBox.setArg(4, m_hitFaceBuffer);
+    m_kernelBox.setArg(5, m_hitCountBuffer);
+
+    m_queue.finish();
+  }
+
+  uint32_t castRay(const std::array<float, 6>& ray)
+  {
+    m_queue.enqueueWriteBuffer(m_rayBuffer, CL_TRUE, 0, sizeof(float) * 6, ray.data());
+    m_queue.enqueueNDRangeKernel(m_kernelRay, cl::NullRange, cl::NDRange(m_numGroups * m_workGroupSize),
+                                 cl::NDRange(m_workGroupSize));
+    m_queue.enqueueNDRangeKernel(m_kernelReduce, cl::NullRange, cl::NDRange(m_workGroupSize),
+                                 cl::NDRange(m_workGroupSize));
+
+    ClosestHit closestHit;
+    m_queue.enqueueReadBuffer(m_closestHitBuffer, CL_TRUE, 0, sizeof(ClosestHit), &closestHit);
+    return closestHit.face;
+  }
+
+  std::vector<uint32_t> castSphere(const std::array<float, 3>& center, float radius)
+  {
+    std::array<float, 4> sphere = { center[0], center[1], center[2], 0 };
+    m_queue.enqueueWriteBuffer(m_sphereBuffer, CL_TRUE, 0, sizeof(float) * 4, sphere.data());
+    m_kernelSphere.setArg(4, radius);
+    return castSelectionKernel(m_kernelSphere);
+  }
+
+  std::vector<uint32_t> castBox(const std::array<float, 4 * 6>& planes)
+  {
+    m_queue.enqueueWriteBuffer(m_boxBuffer, CL_TRUE, 0, sizeof(float) * 4 * 6, planes.data());
+    return castSelectionKernel(m_kernelBox);
+  }
+
+private:
+  /// Layout of closest_hit_t of the kernels
+  struct ClosestHit
+  {
+    cl_uint face;
+    cl_float distance;
+  };
+
+  std::vector<uint32_t> castSelectionKernel(cl::Kernel& kernel)
+  {
+    static const cl_uint zero = 0;
+    cl_uint hitCount = 0;
+
+    m_queue.enqueueWriteBuffer(m_hitCountBuffer, CL_FALSE, 0, sizeof(cl_uint), &zero);
+    m_queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(m_numGroups * m_workGroupSize),
+                                 cl::NDRange(m_workGroupSize));
+    m_queue.enqueueReadBuffer(m_hitCountBuffer, CL_TRUE, 0, sizeof(cl_uint), &hitCount);
+
+    std::vector<uint32_t> hits(hitCount);
+    if (hitCount > 0)
+    {
+      m_queue.enqueueReadBuffer(m_hitFaceBuffer, CL_TRUE, 0, sizeof(cl_uint) * hitCount, hits.data());
+    }
+    return hits;
+  }
+
+  cl::Device m_device;
+  cl::Context m_context;
+  cl::CommandQueue m_queue;
+  cl::Kernel m_kernelRay;
+  cl::Kernel m_kernelReduce;
+  cl::Kernel m_kernelSphere;
+  cl::Kernel m_kernelBox;
+  cl::Buffer m_closestHitBuffer;
+  cl::Buffer m_hitFaceBuffer;
+  cl::Buffer m_hitCountBuffer;
+  cl::Buffer m_rayBuffer;
+  cl::Buffer m_sphereBuffer;
+  cl::Buffer m_boxBuffer;
+  size_t m_workGroupSize = 1;
+  size_t m_numGroups = 0;
+};
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  if (argc > 4)
+  {
+    std::cerr << "usage: " << argv[0] << " [grid size] [queries] [kernel file]" << std::endl
+              << "  compares the CPU and the OpenCL selection queries on a grid mesh with 2 * size^2 faces"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const uint32_t gridSize = argc > 1 ? std::stoul(argv[1]) : 1000;
+  const size_t numQueries = argc > 2 ? std::stoul(argv[2]) : 100;
+  const std::string kernelFile =
+      argc > 3 ? argv[3] : ros::package::getPath("rviz_map_plugin") + "/include/kernels/cast_rays.cl";
+
+  Geometry geometry = createGridMesh(gridSize);
+  std::cout << "Grid mesh with " << geometry.vertices.size() << " vertices and " << geometry.faces.size()
+            << " faces, " << numQueries << " queries of each type" << std::endl;
+
+  // slightly tilted rays from above the mesh, the spheres are placed at their hits like in the tool
+  const float extent = gridSize * CELL_SIZE;
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<float> position(0.1 * extent, 0.9 * extent);
+  std::uniform_real_distribution<float> tilt(-0.2, 0.2);
+  std::vector<std::array<float, 6>> rays(numQueries);
+  std::vector<std::array<float, 4 * 6>> boxes(numQueries);
+  for (size_t i = 0; i < numQueries; i++)
+  {
+    float dx = tilt(generator);
+    float dy = tilt(generator);
+    float length = std::sqrt(dx * dx + dy * dy + 1);
+    rays[i] = { position(generator), position(generator), 10, dx / length, dy / length, -1 / length };
+    boxes[i] = createBox(position(generator), position(generator));
+  }
+
+  std::vector<std::array<float, 3>> centers(numQueries);
+  for (size_t i = 0; i < numQueries; i++)
+  {
+    auto hit = castRay(geometry, rays[i]);
+    float t = hit ? hit->second : 10;
+    centers[i] = { rays[i][0] + t * rays[i][3], rays[i][1] + t * rays[i][4], rays[i][2] + t * rays[i][5] };
+  }
+
+  Results cpu;
+  cpu.rayFaces.resize(numQueries);
+  cpu.sphereFaces.resize(numQueries);
+  cpu.boxFaces.resize(numQueries);
+  std::vector<uint8_t> vertexHits;
+
+  double cpuRay = measure(numQueries, [&](size_t i) {
+    auto hit = castRay(geometry, rays[i]);
+    cpu.rayFaces[i] = hit ? hit->first : std::numeric_limits<uint32_t>::max();
+  });
+  double cpuSphere = measure(numQueries, [&](size_t i) {
+    castSphere(geometry, centers[i], SPHERE_RADIUS, vertexHits, cpu.sphereFaces[i]);
+  });
+  double cpuBox = measure(numQueries, [&](size_t i) {
+    castBox(geometry, boxes[i].data(), vertexHits, cpu.boxFaces[i]);
+  });
+
+  std::cout << "CPU:    ray " << cpuRay << " us, sphere " << cpuSphere << " us, box " << cpuBox << " us per query"
+            << std::endl;
+
+  std::ifstream in(kernelFile);
+  if (!in)
+  {
+    std::cerr << "Could not read the kernel file " << kernelFile << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::stringstream source;
+  source << in.rdbuf();
+
+  try
+  {
+    auto start = std::chrono::steady_clock::now();
+    CLSelection clSelection(geometry, source.str());
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "Set up OpenCL in " << std::chrono::duration<double, std::milli>(end - start).count() << " ms"
+              << std::endl;
+
+    Results device;
+    device.rayFaces.resize(numQueries);
+    device.sphereFaces.resize(numQueries);
+    device.boxFaces.resize(numQueries);
+
+    double clRay = measure(numQueries, [&](size_t i) { device.rayFaces[i] = clSelection.castRay(rays[i]); });
+    double clSphere =
+        measure(numQueries, [&](size_t i) { device.sphereFaces[i] = clSelection.castSphere(centers[i], SPHERE_RADIUS); });
+    double clBox = measure(numQueries, [&](size_t i) { device.boxFaces[i] = clSelection.castBox(boxes[i]); });
+
+    std::cout << "OpenCL: ray " << clRay << " us, sphere " << clSphere << " us, box " << clBox << " us per query"
+              << std::endl;
+
+    // faces or vertices right at the border of a query may be decided differently due to rounding
+    size_t rayMismatches = 0;
+    for (size_t i = 0; i < numQueries; i++)
+    {
+      rayMismatches += cpu.rayFaces[i] != device.rayFaces[i];
+    }
+    std::cout << "Differing results: " << rayMismatches << " rays, "
+              << countMismatches(cpu.sphereFaces, device.sphereFaces) << " spheres, "
+              << countMismatches(cpu.boxFaces, device.boxFaces) << " boxes" << std::endl;
+  }
+  catch (cl::Error err)
+  {
+    std::cerr << err.what() << ": " << CLUtil::getErrorString(err.err()) << std::endl;
+    std::cerr << "OpenCL is not available, only the CPU was measured" << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
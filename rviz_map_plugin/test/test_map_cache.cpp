@@ -0,0 +1,255 @@
+/*
+ *  Software License Agreement (BSD License)
+ *
+ *  Robot Operating System code by the University of Osnabrück
+ *  Copyright (c) 2015, University of Osnabrück
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ *
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *
+ *   3. Neither the name of the copyright holder nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ *  TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ *  ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ *
+ *  test_map_cache.cpp
+ *
+ */
+
+#include <MapCache.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace rviz_map_plugin;
+
+namespace
+{
+/**
+ * @brief A map file with two faces and every kind of data the MapDisplay caches
+ */
+class MapCacheTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    char name[] = "/tmp/rviz_map_plugin_test_map_cache_XXXXXX";
+    int fd = mkstemp(name);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(4, write(fd, "map\n", 4));
+    close(fd);
+    mapFile = name;
+
+    data.geometry = Geometry({ 0, 0, 0, 1, 0, 0, 0, 1, 0, 1, 1, 0 }, { 0, 1, 2, 1, 3, 2 });
+
+    MeshChunk chunk;
+    chunk.vertexIds = { 0, 1, 2, 3 };
+    chunk.faceIds = { 0, 1 };
+    chunk.indices = { 0, 1, 2, 1, 3, 2 };
+    chunk.bounds.setExtents(0, 0, 0, 1, 1, 0);
+    data.chunks.push_back(chunk);
+
+    Material material;
+    material.textureIndex = 0;
+    material.color = Color(1, 0, 0, 1);
+    material.faceIndices = { 0, 1 };
+    data.materials.push_back(material);
+
+    Texture texture;
+    texture.width = 2;
+    texture.height = 1;
+    texture.channels = 3;
+    texture.data = { 1, 2, 3, 4, 5, 6 };
+    texture.pixelFormat = "rgb8";
+    data.textures.push_back(texture);
+
+    data.colors.assign(4, Color(0, 1, 0, 1));
+    data.normals.assign(4, Normal(0, 0, 1));
+    data.texCoords = { TexCoords(0, 0), TexCoords(1, 0), TexCoords(0, 1), TexCoords(1, 1) };
+    data.clusters.push_back(Cluster("tree_1", { 1 }));
+    data.costs["roughness"] = { 0.1f, 0.2f, 0.3f, 0.4f };
+  }
+
+  void TearDown() override
+  {
+    std::remove(MapCache(mapFile).getPath().c_str());
+    std::remove(mapFile.c_str());
+  }
+
+  std::string mapFile;
+  MapData data;
+};
+}  // namespace
+
+TEST_F(MapCacheTest, LoadsWhatWasSaved)
+{
+  ASSERT_TRUE(MapCache(mapFile).save(data));
+
+  MapData loaded;
+  ASSERT_TRUE(MapCache(mapFile).load(loaded));
+
+  ASSERT_EQ(data.geometry.vertices.size(), loaded.geometry.vertices.size());
+  for (size_t i = 0; i < data.geometry.vertices.size(); i++)
+  {
+    EXPECT_EQ(data.geometry.vertices[i].x, loaded.geometry.vertices[i].x);
+    EXPECT_EQ(data.geometry.vertices[i].y, loaded.geometry.vertices[i].y);
+    EXPECT_EQ(data.geometry.vertices[i].z, loaded.geometry.vertices[i].z);
+  }
+  ASSERT_EQ(data.geometry.faces.size(), loaded.geometry.faces.size());
+  for (size_t i = 0; i < data.geometry.faces.size(); i++)
+  {
+    EXPECT_EQ(data.geometry.faces[i].vertexIndices, loaded.geometry.faces[i].vertexIndices);
+  }
+
+  ASSERT_EQ(1u, loaded.chunks.size());
+  EXPECT_EQ(data.chunks[0].vertexIds, loaded.chunks[0].vertexIds);
+  EXPECT_EQ(data.chunks[0].faceIds, loaded.chunks[0].faceIds);
+  EXPECT_EQ(data.chunks[0].indices, loaded.chunks[0].indices);
+  EXPECT_EQ(1.0f, loaded.chunks[0].bounds.getMaximum().y);
+
+  ASSERT_EQ(1u, loaded.materials.size());
+  ASSERT_TRUE(bool(loaded.materials[0].textureIndex));
+  EXPECT_EQ(0u, *loaded.materials[0].textureIndex);
+  EXPECT_EQ(1.0f, loaded.materials[0].color.r);
+  EXPECT_EQ(data.materials[0].faceIndices, loaded.materials[0].faceIndices);
+
+  ASSERT_EQ(1u, loaded.textures.size());
+  EXPECT_EQ(2u, loaded.textures[0].width);
+  EXPECT_EQ(data.textures[0].data, loaded.textures[0].data);
+  EXPECT_EQ("rgb8", loaded.textures[0].pixelFormat);
+
+  ASSERT_EQ(4u, loaded.colors.size());
+  EXPECT_EQ(1.0f, loaded.colors[3].g);
+  ASSERT_EQ(4u, loaded.normals.size());
+  EXPECT_EQ(1.0f, loaded.normals[3].z);
+  ASSERT_EQ(4u, loaded.texCoords.size());
+  EXPECT_EQ(1.0f, loaded.texCoords[3].v);
+
+  ASSERT_EQ(1u, loaded.clusters.size());
+  EXPECT_EQ("tree_1", loaded.clusters[0].name);
+  EXPECT_EQ(data.clusters[0].faces, loaded.clusters[0].faces);
+  EXPECT_EQ(data.costs, loaded.costs);
+}
+
+TEST_F(MapCacheTest, IsReadableByOthers)
+{
+  ASSERT_TRUE(MapCache(mapFile).save(data));
+
+  const mode_t mask = umask(0);
+  umask(mask);
+  struct stat cacheStat;
+  ASSERT_EQ(0, stat(MapCache(mapFile).getPath().c_str(), &cacheStat));
+  EXPECT_EQ(0644 & ~mask, cacheStat.st_mode & 0777);
+}
+
+TEST_F(MapCacheTest, IsIgnoredAfterTheMapChanged)
+{
+  ASSERT_TRUE(MapCache(mapFile).save(data));
+
+  std::ofstream(mapFile, std::ios::app) << "changed\n";
+
+  MapData loaded;
+  EXPECT_FALSE(MapCache(mapFile).load(loaded));
+}
+
+TEST_F(MapCacheTest, RejectsTruncatedCaches)
+{
+  MapCache cache(mapFile);
+  ASSERT_TRUE(cache.save(data));
+
+  struct stat cacheStat;
+  ASSERT_EQ(0, stat(cache.getPath().c_str(), &cacheStat));
+  for (off_t size : { off_t(0), off_t(16), cacheStat.st_size / 2, cacheStat.st_size - 1 })
+  {
+    ASSERT_EQ(0, truncate(cache.getPath().c_str(), size));
+    MapData loaded;
+    EXPECT_FALSE(cache.load(loaded)) << "truncated to " << size << " bytes";
+  }
+}
+
+TEST_F(MapCacheTest, RejectsIndicesOutsideOfTheMesh)
+{
+  MapCache cache(mapFile);
+  MapData loaded;
+
+  MapData damaged = data;
+  damaged.clusters[0].faces.push_back(2);
+  ASSERT_TRUE(cache.save(damaged));
+  EXPECT_FALSE(cache.load(loaded));
+
+  damaged = data;
+  damaged.chunks[0].indices[5] = 4;
+  ASSERT_TRUE(cache.save(damaged));
+  EXPECT_FALSE(cache.load(loaded));
+
+  damaged = data;
+  damaged.materials[0].faceIndices.push_back(2);
+  ASSERT_TRUE(cache.save(damaged));
+  EXPECT_FALSE(cache.load(loaded));
+}
+
+TEST_F(MapCacheTest, RejectsChannelsNotMatchingTheVertices)
+{
+  MapCache cache(mapFile);
+  MapData loaded;
+
+  MapData damaged = data;
+  damaged.colors.pop_back();
+  ASSERT_TRUE(cache.save(damaged));
+  EXPECT_FALSE(cache.load(loaded));
+
+  damaged = data;
+  damaged.normals.emplace_back(0, 0, 1);
+  ASSERT_TRUE(cache.save(damaged));
+  EXPECT_FALSE(cache.load(loaded));
+
+  damaged = data;
+  damaged.texCoords.pop_back();
+  ASSERT_TRUE(cache.save(damaged));
+  EXPECT_FALSE(cache.load(loaded));
+
+  damaged = data;
+  damaged.costs["roughness"].pop_back();
+  ASSERT_TRUE(cache.save(damaged));
+  EXPECT_FALSE(cache.load(loaded));
+
+  // channels the map does not have are fine
+  damaged = data;
+  damaged.colors.clear();
+  damaged.texCoords.clear();
+  ASSERT_TRUE(cache.save(damaged));
+  EXPECT_TRUE(cache.load(loaded));
+}